@@ -0,0 +1,405 @@
+// ============================================================================
+// ActionValidation.cpp - Action Checks Against the Game State Implementation
+// ============================================================================
+
+#include "ActionValidation.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <string_view>
+#include <utility>
+
+#include "Log.h"
+
+namespace ActionValidation
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+
+/// Actions whose unit_id must be one of the player's units
+constexpr std::array<std::string_view, 15> kUnitActions = {
+    "move_unit", "attack", "found_city", "fortify", "sleep", "skip", "delete", "pillage",
+    "build_improvement", "harvest", "remove_feature", "promote", "upgrade_unit", "send_trade_route", "repair"
+};
+
+/// Actions whose city_id must be one of the player's cities
+constexpr std::array<std::string_view, 4> kCityActions = {
+    "build", "purchase", "place_district", "city_ranged_attack"
+};
+
+/// Type-name prefixes tried when repairing a name Claude shortened
+constexpr std::array<std::string_view, 1> kTechPrefixes = {"TECH_"};
+constexpr std::array<std::string_view, 1> kCivicPrefixes = {"CIVIC_"};
+constexpr std::array<std::string_view, 1> kPromotionPrefixes = {"PROMOTION_"};
+constexpr std::array<std::string_view, 3> kBuildPrefixes = {"UNIT_", "BUILDING_", "DISTRICT_"};
+
+} // anonymous namespace
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+namespace
+{
+
+template <size_t N>
+bool Contains(const std::array<std::string_view, N>& names, std::string_view name)
+{
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+/// Read an integer id, accepting whole floats and digit strings
+bool ReadActionId(const json& value, int& out)
+{
+    if (value.is_number_integer())
+    {
+        out = value.get<int>();
+        return true;
+    }
+    if (value.is_number_float())
+    {
+        double number = value.get<double>();
+        out = static_cast<int>(number);
+        return number == static_cast<double>(out);
+    }
+    if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        char* end = nullptr;
+        long number = std::strtol(text.c_str(), &end, 10);
+        out = static_cast<int>(number);
+        return !text.empty() && end && *end == '\0';
+    }
+    return false;
+}
+
+/// Collect the "type" (or string) entries of an array member into a set
+/// @return false if the member is missing or not an array
+bool CollectTypeNames(const json& object, const char* key, std::unordered_set<std::string>& out)
+{
+    auto member = object.find(key);
+    if (member == object.end() || !member->is_array())
+    {
+        return false;
+    }
+
+    for (const json& entry : *member)
+    {
+        if (entry.is_string())
+        {
+            out.insert(entry.get<std::string>());
+        }
+        else if (entry.is_object())
+        {
+            for (const char* field : {"type", "tech", "civic"})
+            {
+                auto name = entry.find(field);
+                if (name != entry.end() && name->is_string())
+                {
+                    out.insert(name->get<std::string>());
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/// Find the listed type name Claude meant: exact, upper-cased with underscores
+/// for spaces, or either with one of the prefixes in front
+/// @return The listed name, or an empty string if none matches
+template <size_t N>
+std::string MatchTypeName(const std::string& name, const std::unordered_set<std::string>& listed,
+                          const std::array<std::string_view, N>& prefixes)
+{
+    if (listed.count(name))
+    {
+        return name;
+    }
+
+    std::string normalized = name;
+    for (char& c : normalized)
+    {
+        c = c == ' ' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    if (listed.count(normalized))
+    {
+        return normalized;
+    }
+    for (std::string_view prefix : prefixes)
+    {
+        std::string prefixed = std::string(prefix) + normalized;
+        if (listed.count(prefixed))
+        {
+            return prefixed;
+        }
+    }
+    return "";
+}
+
+/// Check (and where it is unambiguous, repair) a type-name field against a listed set
+/// @return false if the field is missing or matches nothing listed
+template <size_t N>
+bool CheckTypeField(json& action, const char* field, const std::unordered_set<std::string>& listed,
+                    const std::array<std::string_view, N>& prefixes, bool& repaired)
+{
+    auto value = action.find(field);
+    if (value == action.end() || !value->is_string())
+    {
+        return false;
+    }
+
+    std::string match = MatchTypeName(value->get<std::string>(), listed, prefixes);
+    if (match.empty())
+    {
+        return false;
+    }
+    if (match != value->get_ref<const std::string&>())
+    {
+        *value = match;
+        repaired = true;
+    }
+    return true;
+}
+
+/// Check an id field against an index, normalizing it to an integer
+/// @return Pointer to the indexed entry, or nullptr if the id is missing or unknown
+template <typename Facts>
+const Facts* CheckIdField(json& action, const char* field, const std::unordered_map<int, Facts>& listed,
+                          bool& repaired)
+{
+    int id = 0;
+    auto value = action.find(field);
+    if (value == action.end() || !ReadActionId(*value, id))
+    {
+        return nullptr;
+    }
+
+    auto entry = listed.find(id);
+    if (entry == listed.end())
+    {
+        return nullptr;
+    }
+    if (!value->is_number_integer())
+    {
+        *value = id;
+        repaired = true;
+    }
+    return &entry->second;
+}
+
+/// Compact description of an action for the rejection list (name plus its ids and type names)
+std::string DescribeAction(const json& action)
+{
+    if (!action.is_object())
+    {
+        return action.dump();
+    }
+
+    std::string text = action.value("action", std::string("?"));
+    for (const char* field : {"unit_id", "city_id", "item", "tech", "civic", "promotion"})
+    {
+        auto value = action.find(field);
+        if (value != action.end())
+        {
+            text += std::string(" ") + field + "=" + (value->is_string() ? value->get<std::string>() : value->dump());
+        }
+    }
+    return text;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+Index BuildIndex(const json& state)
+{
+    Index index;
+    if (!state.is_object())
+    {
+        return index;
+    }
+
+    auto units = state.find("units");
+    if (units != state.end() && units->is_array())
+    {
+        index.unitsListed = true;
+        index.units.reserve(units->size());
+        for (const json& unit : *units)
+        {
+            int id = 0;
+            auto idField = unit.is_object() ? unit.find("id") : unit.end();
+            if (idField == unit.end() || !ReadActionId(*idField, id))
+            {
+                continue;
+            }
+            UnitFacts& facts = index.units[id];
+            facts.isSettler = unit.value("isSettler", false) || unit.value("canFoundCity", false);
+            facts.canUpgrade = unit.value("canUpgrade", false);
+            facts.promotionsListed = unit.value("canPromote", false) &&
+                CollectTypeNames(unit, "availablePromotions", facts.promotions);
+        }
+    }
+
+    auto cities = state.find("cities");
+    if (cities != state.end() && cities->is_array())
+    {
+        index.citiesListed = true;
+        index.cities.reserve(cities->size());
+        for (const json& city : *cities)
+        {
+            int id = 0;
+            auto idField = city.is_object() ? city.find("id") : city.end();
+            if (idField == city.end() || !ReadActionId(*idField, id))
+            {
+                continue;
+            }
+            CityFacts& facts = index.cities[id];
+            // Only a menu the game itself produced (Lua marks it verified) rejects builds. Lua
+            // marks it partial when listing part of it failed; an empty one is treated the same
+            // way, so neither rejects builds the game would allow
+            auto canBuild = city.find("canBuild");
+            if (canBuild != city.end() && canBuild->is_object() && canBuild->value("verified", false) &&
+                !canBuild->value("partial", false))
+            {
+                for (const char* list : {"units", "buildings", "districts", "wonders"})
+                {
+                    CollectTypeNames(*canBuild, list, facts.buildables);
+                }
+                facts.buildablesListed = !facts.buildables.empty();
+            }
+        }
+    }
+
+    index.techsListed = CollectTypeNames(state, "availableTechs", index.techs);
+    index.civicsListed = CollectTypeNames(state, "availableCivics", index.civics);
+    return index;
+}
+
+Verdict Check(json& action, const Index& index, std::string& outReason)
+{
+    if (!action.is_object() || !action.contains("action") || !action["action"].is_string())
+    {
+        outReason = "no action name";
+        return Verdict::Rejected;
+    }
+
+    const std::string name = action["action"].get<std::string>();
+    bool repaired = false;
+
+    if (index.unitsListed && Contains(kUnitActions, name))
+    {
+        const UnitFacts* unit = CheckIdField(action, "unit_id", index.units, repaired);
+        if (!unit)
+        {
+            outReason = "unknown unit_id";
+            return Verdict::Rejected;
+        }
+        if (name == "found_city" && !unit->isSettler)
+        {
+            outReason = "unit can't found cities";
+            return Verdict::Rejected;
+        }
+        if (name == "upgrade_unit" && !unit->canUpgrade)
+        {
+            outReason = "unit can't upgrade";
+            return Verdict::Rejected;
+        }
+        if (name == "promote" && unit->promotionsListed &&
+            !CheckTypeField(action, "promotion", unit->promotions, kPromotionPrefixes, repaired))
+        {
+            outReason = "promotion not available";
+            return Verdict::Rejected;
+        }
+    }
+
+    if (index.citiesListed && Contains(kCityActions, name))
+    {
+        const CityFacts* city = CheckIdField(action, "city_id", index.cities, repaired);
+        if (!city)
+        {
+            outReason = "unknown city_id";
+            return Verdict::Rejected;
+        }
+        // Projects aren't in canBuild, so only names of listed kinds are checked
+        auto item = action.find("item");
+        if (name == "build" && city->buildablesListed && item != action.end() && item->is_string() &&
+            item->get_ref<const std::string&>().compare(0, 8, "PROJECT_") != 0 &&
+            !CheckTypeField(action, "item", city->buildables, kBuildPrefixes, repaired))
+        {
+            outReason = "not buildable in this city";
+            return Verdict::Rejected;
+        }
+    }
+
+    if (name == "research" && index.techsListed &&
+        !CheckTypeField(action, "tech", index.techs, kTechPrefixes, repaired))
+    {
+        outReason = "tech not available";
+        return Verdict::Rejected;
+    }
+
+    if (name == "civic" && index.civicsListed &&
+        !CheckTypeField(action, "civic", index.civics, kCivicPrefixes, repaired))
+    {
+        outReason = "civic not available";
+        return Verdict::Rejected;
+    }
+
+    return repaired ? Verdict::Repaired : Verdict::Valid;
+}
+
+std::vector<std::string> Filter(json& document, const Index& index)
+{
+    std::vector<std::string> rejected;
+    auto actions = document.is_object() ? document.find("actions") : document.end();
+    if (actions == document.end() || !actions->is_array())
+    {
+        return rejected;
+    }
+
+    size_t repairedCount = 0;
+    json kept = json::array();
+    for (json& action : *actions)
+    {
+        std::string reason;
+        Verdict verdict = Check(action, index, reason);
+        if (verdict == Verdict::Rejected)
+        {
+            rejected.push_back(DescribeAction(action) + ": " + reason);
+            continue;
+        }
+        repairedCount += verdict == Verdict::Repaired ? 1 : 0;
+        kept.push_back(std::move(action));
+    }
+    *actions = std::move(kept);
+
+    if (!rejected.empty())
+    {
+        document["rejected"] = rejected;
+    }
+    if (!rejected.empty() || repairedCount > 0)
+    {
+        std::string report;
+        for (const std::string& line : rejected)
+        {
+            report += (report.empty() ? "" : "; ") + line;
+        }
+        Log("[VALIDATE] Kept " + std::to_string(actions->size()) + " actions (" + std::to_string(repairedCount) +
+            " repaired), rejected " + std::to_string(rejected.size()) + (report.empty() ? "" : ": " + report));
+    }
+    return rejected;
+}
+
+} // namespace ActionValidation
@@ -0,0 +1,72 @@
+#pragma once
+
+// ============================================================================
+// ActionValidation.h - Action Checks Against the Game State
+// Checks Claude's actions against the game state they answer, so references to
+// units, cities, techs and civics the player doesn't have are dropped (or
+// repaired) before Lua spends a game call finding out
+// ============================================================================
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <json.hpp>
+
+namespace ActionValidation
+{
+
+/// What the state says about one of the player's units
+struct UnitFacts
+{
+    bool isSettler = false;
+    bool canUpgrade = false;
+    bool promotionsListed = false;      ///< availablePromotions was in the state
+    std::unordered_set<std::string> promotions;
+};
+
+/// What the state says about one of the player's cities
+struct CityFacts
+{
+    bool buildablesListed = false;      ///< canBuild was in the state, verified, complete and non-empty
+    std::unordered_set<std::string> buildables;
+};
+
+/// Hash lookups over a parsed game state (see BuildIndex)
+/// @note A list missing from the state (e.g. trimmed by the token budget) isn't checked
+struct Index
+{
+    bool unitsListed = false;
+    bool citiesListed = false;
+    bool techsListed = false;
+    bool civicsListed = false;
+    std::unordered_map<int, UnitFacts> units;
+    std::unordered_map<int, CityFacts> cities;
+    std::unordered_set<std::string> techs;
+    std::unordered_set<std::string> civics;
+};
+
+/// Outcome of checking one action
+enum class Verdict
+{
+    Valid,
+    Repaired,
+    Rejected
+};
+
+/// Index the parts of a parsed game state the validator checks
+[[nodiscard]] Index BuildIndex(const nlohmann::json& state);
+
+/// Check one action against the index
+/// @param outReason Set to a short reason when the action is rejected
+/// @note Ids given as strings or whole floats are rewritten as integers, and near-miss
+///       type names as the listed name, which counts as a repair
+[[nodiscard]] Verdict Check(nlohmann::json& action, const Index& index, std::string& outReason);
+
+/// Drop or repair the actions in a response document
+/// @return One "action: reason" entry per dropped action, also stored in the document's "rejected" array
+/// @note Legacy single-action documents aren't checked
+[[nodiscard]] std::vector<std::string> Filter(nlohmann::json& document, const Index& index);
+
+} // namespace ActionValidation
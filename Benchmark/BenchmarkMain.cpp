@@ -0,0 +1,415 @@
+// ============================================================================
+// BenchmarkMain.cpp - Offline Benchmark of the Request Pipeline
+// Replays recorded game states through ClaudeAPI against MockApiServer and
+// reports throughput and per-stage latency percentiles
+// ============================================================================
+
+#include "ClaudeAPI.h"
+#include "Log.h"
+#include "MockApiServer.h"
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Windows.h>
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    constexpr uint16_t kDefaultPort = 8787;
+    constexpr int kDefaultIterations = 5;
+    constexpr size_t kDefaultConcurrency = 1;
+    constexpr const char* kDefaultReply = R"({"actions":[{"action":"end_turn"}]})";
+    constexpr DWORD kPollIntervalMs = 1;
+}
+
+// ============================================================================
+// COMMAND LINE AND CORPUS
+// ============================================================================
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string corpusFolder;
+    int iterations = kDefaultIterations;    ///< Passes over the whole corpus
+    size_t concurrency = kDefaultConcurrency;
+    bool stream = false;
+    std::string responsesFile;              ///< Request recording to answer from instead of the mock
+    MockApiServer::Config server;
+};
+
+void PrintUsage()
+{
+    std::printf(
+        "Usage: ClaudeBenchmark <corpus folder> [options]\n"
+        "  Replays every *.json game state in the folder (recorded with\n"
+        "  SetClaudeAPIOption(\"record_states\", ...)) against a local mock API.\n"
+        "\n"
+        "  --iterations N     Passes over the corpus (default %d)\n"
+        "  --concurrency N    Requests in flight at once (default %zu)\n"
+        "  --first-byte MS    Mock delay before the response headers (default 0)\n"
+        "  --generate MS      Mock delay spread over the response body (default 0)\n"
+        "  --stream           Request streamed (SSE) responses\n"
+        "  --reply FILE       Model text the mock returns (default: a single end_turn)\n"
+        "  --responses FILE   Answer from a request recording (record_requests) instead of the mock\n"
+        "  --port N           Mock server port (default %u)\n"
+        "\n"
+        "Usage: ClaudeBenchmark --self-test\n"
+        "  Runs the encoder and parser checks, without a corpus or the mock API.\n",
+        kDefaultIterations, kDefaultConcurrency, static_cast<unsigned>(kDefaultPort));
+}
+
+bool ReadFileText(const std::string& path, std::string& outText)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    outText = contents.str();
+    return true;
+}
+
+bool ParseArguments(int argc, char** argv, Options& out)
+{
+    out.server.port = kDefaultPort;
+    out.server.replyText = kDefaultReply;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--stream")
+        {
+            out.stream = true;
+        }
+        else if (arg == "--iterations" && hasValue)
+        {
+            out.iterations = std::atoi(argv[++i]);
+        }
+        else if (arg == "--concurrency" && hasValue)
+        {
+            out.concurrency = static_cast<size_t>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--first-byte" && hasValue)
+        {
+            out.server.firstByteDelayMs = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--generate" && hasValue)
+        {
+            out.server.generateDelayMs = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--port" && hasValue)
+        {
+            out.server.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--reply" && hasValue)
+        {
+            if (!ReadFileText(argv[++i], out.server.replyText))
+            {
+                std::printf("Could not read reply file %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (arg == "--responses" && hasValue)
+        {
+            out.responsesFile = argv[++i];
+        }
+        else if (arg[0] != '-' && out.corpusFolder.empty())
+        {
+            out.corpusFolder = arg;
+        }
+        else
+        {
+            std::printf("Unknown or incomplete argument: %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    return !out.corpusFolder.empty() && out.iterations > 0 && out.concurrency > 0 && out.server.port > 0;
+}
+
+/// Load and parse every *.json in the folder, in file name (recording) order
+std::vector<json> LoadCorpus(const std::string& folder)
+{
+    std::vector<std::string> names;
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((folder + "\\*.json").c_str(), &findData);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            names.push_back(findData.cFileName);
+        } while (FindNextFileA(find, &findData));
+        FindClose(find);
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<json> states;
+    for (const std::string& name : names)
+    {
+        std::string text;
+        json state = ReadFileText(folder + "\\" + name, text) ? json::parse(text, nullptr, false) : json();
+        if (!state.is_object())
+        {
+            std::printf("Skipping %s (not a game state object)\n", name.c_str());
+            continue;
+        }
+        states.push_back(std::move(state));
+    }
+    return states;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// REPLAY AND REPORT
+// ============================================================================
+
+namespace
+{
+
+/// A request waiting for its reply
+struct InFlight
+{
+    ClaudeAPI::RequestId id = ClaudeAPI::kNoRequest;
+    double serializeMs = 0;
+};
+
+struct ReplayResult
+{
+    std::vector<ClaudeAPI::RequestMetrics> samples;
+    size_t failures = 0;
+    double wallMs = 0;
+};
+
+double ElapsedMs(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/// Send every state iterations times, keeping up to concurrency requests in flight
+/// @note Each request gets a fresh turn number so the DLL's per-turn cache never answers it
+ReplayResult Replay(std::vector<json>& states, const Options& options)
+{
+    ReplayResult result;
+    size_t total = states.size() * static_cast<size_t>(options.iterations);
+    size_t submitted = 0;
+    int nextTurn = 1;
+    std::vector<InFlight> inFlight;
+    uint64_t lastSequence = ClaudeAPI::GetMetricsSummary().requestCount;
+
+    Clock::time_point start = Clock::now();
+    while (submitted < total || !inFlight.empty())
+    {
+        while (submitted < total && inFlight.size() < options.concurrency)
+        {
+            json& state = states[submitted % states.size()];
+            state["turn"] = nextTurn++;
+
+            Clock::time_point serializeStart = Clock::now();
+            std::string gameStateJson = state.dump();
+            InFlight request;
+            request.serializeMs = ElapsedMs(serializeStart, Clock::now());
+
+            request.id = ClaudeAPI::StartAsyncRequest(gameStateJson);
+            submitted++;
+            if (request.id == ClaudeAPI::kNoRequest)
+            {
+                result.failures++;
+                continue;
+            }
+            inFlight.push_back(request);
+        }
+
+        bool anyFinished = false;
+        for (auto it = inFlight.begin(); it != inFlight.end();)
+        {
+            ClaudeAPI::AsyncState state = ClaudeAPI::GetAsyncState(it->id);
+            if (state == ClaudeAPI::AsyncState::Pending)
+            {
+                ++it;
+                continue;
+            }
+
+            if (state == ClaudeAPI::AsyncState::Ready)
+            {
+                (void)ClaudeAPI::GetAsyncResponse(it->id);
+            }
+            else
+            {
+                std::printf("Request #%u failed: %s\n", it->id, ClaudeAPI::GetAsyncError(it->id).c_str());
+                result.failures++;
+            }
+
+            // Finalizes the request's metrics (unless it was already finalized without Lua's stages)
+            ClaudeAPI::ReportLuaTimings(it->id, it->serializeMs, 0, 0);
+            it = inFlight.erase(it);
+            anyFinished = true;
+        }
+
+        // Collect in finalization order, so requests finalized by another path aren't lost
+        for (const ClaudeAPI::RequestMetrics& metrics : ClaudeAPI::GetFinishedMetrics(lastSequence))
+        {
+            lastSequence = metrics.sequence;
+            if (!metrics.failed)
+            {
+                result.samples.push_back(metrics);
+            }
+        }
+
+        if (!anyFinished)
+        {
+            Sleep(kPollIntervalMs);
+        }
+    }
+    result.wallMs = ElapsedMs(start, Clock::now());
+    return result;
+}
+
+/// Nearest-rank percentile of sorted values
+double Percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void PrintStage(const char* name, const std::vector<ClaudeAPI::RequestMetrics>& samples,
+                double ClaudeAPI::RequestMetrics::*stage)
+{
+    std::vector<double> values;
+    values.reserve(samples.size());
+    double sum = 0;
+    for (const ClaudeAPI::RequestMetrics& sample : samples)
+    {
+        values.push_back(sample.*stage);
+        sum += sample.*stage;
+    }
+    std::sort(values.begin(), values.end());
+
+    double mean = values.empty() ? 0 : sum / values.size();
+    std::printf("  %-12s %10.2f %10.2f %10.2f %10.2f\n", name,
+        Percentile(values, 0.50), Percentile(values, 0.99), mean, values.empty() ? 0 : values.back());
+}
+
+void PrintReport(const ReplayResult& result, const Options& options, size_t corpusSize)
+{
+    using Metrics = ClaudeAPI::RequestMetrics;
+
+    std::printf("\nCorpus: %zu states x %d iterations, concurrency %zu, %s responses\n",
+        corpusSize, options.iterations, options.concurrency, options.stream ? "streamed" : "buffered");
+    std::printf("Mock: first byte %ums, generate %ums, %llu API requests served\n",
+        options.server.firstByteDelayMs, options.server.generateDelayMs,
+        static_cast<unsigned long long>(MockApiServer::GetRequestCount()));
+    std::printf("Completed %zu requests (%zu failed) in %.1f ms: %.2f requests/s\n\n",
+        result.samples.size(), result.failures, result.wallMs,
+        result.wallMs > 0 ? result.samples.size() * 1000.0 / result.wallMs : 0.0);
+
+    std::printf("  %-12s %10s %10s %10s %10s\n", "stage (ms)", "p50", "p99", "mean", "max");
+    PrintStage("serialize", result.samples, &Metrics::serializeMs);
+    PrintStage("queue", result.samples, &Metrics::queueMs);
+    PrintStage("parse", result.samples, &Metrics::parseMs);
+    PrintStage("connect", result.samples, &Metrics::connectMs);
+    PrintStage("first byte", result.samples, &Metrics::firstByteMs);
+    PrintStage("download", result.samples, &Metrics::downloadMs);
+    PrintStage("extract", result.samples, &Metrics::extractMs);
+    PrintStage("total", result.samples, &Metrics::totalMs);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// ENTRY POINT
+// ============================================================================
+
+int main(int argc, char** argv)
+{
+    if (argc == 2 && std::string(argv[1]) == "--self-test")
+    {
+        InitLog();
+        int failed = SelfTest::RunAll();
+        ShutdownLog();
+        return failed == 0 ? 0 : 2;
+    }
+
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<json> states = LoadCorpus(options.corpusFolder);
+    if (states.empty())
+    {
+        std::printf("No game states found in %s\n", options.corpusFolder.c_str());
+        return 1;
+    }
+
+    InitLog();
+
+    if (!MockApiServer::Start(options.server))
+    {
+        std::printf("Could not start the mock API server on port %u\n", static_cast<unsigned>(options.server.port));
+        ShutdownLog();
+        return 1;
+    }
+
+    // The mock never checks the key, but Initialize needs one
+    char* existingKey = nullptr;
+    size_t keyLength = 0;
+    if (_dupenv_s(&existingKey, &keyLength, "ANTHROPIC_API_KEY") != 0 || existingKey == nullptr)
+    {
+        _putenv_s("ANTHROPIC_API_KEY", "benchmark");
+    }
+    free(existingKey);
+
+    // Measure the request pipeline itself: every state goes out in full and nothing is answered from a cache
+    bool configured =
+        ClaudeAPI::SetOption("api_endpoint", "http://127.0.0.1:" + std::to_string(options.server.port)) &&
+        ClaudeAPI::SetOption("stream", options.stream ? "true" : "false") &&
+        ClaudeAPI::SetOption("delta", "false") &&
+        ClaudeAPI::SetOption("history_tokens", "0") &&
+        ClaudeAPI::SetOption("response_cache", "false") &&
+        ClaudeAPI::SetOption("log_level", "warning") &&
+        (options.responsesFile.empty() || ClaudeAPI::SetOption("replay_requests", options.responsesFile));
+
+    int exitCode = 1;
+    if (configured && ClaudeAPI::Initialize())
+    {
+        ReplayResult result = Replay(states, options);
+        PrintReport(result, options, states.size());
+        exitCode = result.failures == 0 ? 0 : 2;
+    }
+    else
+    {
+        std::printf("Could not configure the Claude API, see civ6_claude_hook.log\n");
+    }
+
+    ClaudeAPI::Shutdown();
+    MockApiServer::Stop();
+    ShutdownLog();
+    return exitCode;
+}
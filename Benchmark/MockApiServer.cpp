@@ -0,0 +1,446 @@
+// ============================================================================
+// MockApiServer.cpp - Local Stand-in for the Anthropic Messages API
+// ============================================================================
+
+#include "MockApiServer.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <Windows.h>
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    constexpr size_t kReceiveBufferSize = 16 * 1024;
+    constexpr size_t kMaxHeaderBytes = 64 * 1024;       ///< Requests with larger headers are dropped
+    constexpr size_t kStreamPieceCount = 8;             ///< Text deltas a streamed reply is split into
+    constexpr size_t kBytesPerToken = 4;                ///< Same rough estimate the DLL uses
+    constexpr const char* kModelName = "mock-model";
+    constexpr DWORD kAcceptMinBackoffMs = 10;           ///< First wait after a failed accept
+    constexpr DWORD kAcceptMaxBackoffMs = 1000;         ///< Longest wait between accept retries
+}
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+    MockApiServer::Config g_config;
+    std::atomic<bool> g_running{false};
+    std::atomic<uint64_t> g_requestCount{0};
+
+    SOCKET g_listenSocket = INVALID_SOCKET;
+    std::thread g_acceptThread;
+
+    // Open connections, each served by its own thread (guarded by g_connectionsMutex)
+    std::mutex g_connectionsMutex;
+    std::vector<SOCKET> g_clientSockets;
+    std::vector<std::thread> g_connectionThreads;
+}
+
+// ============================================================================
+// HTTP HELPERS
+// ============================================================================
+
+namespace
+{
+
+/// The parts of a request the server looks at
+struct HttpRequest
+{
+    std::string method;
+    std::string path;
+    std::string body;
+};
+
+bool SendAll(SOCKET socket, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        int result = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (result == SOCKET_ERROR || result == 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+/// Read more bytes into buffer
+/// @return false once the connection is closed
+bool Receive(SOCKET socket, std::string& buffer)
+{
+    char chunk[kReceiveBufferSize];
+    int received = recv(socket, chunk, sizeof(chunk), 0);
+    if (received == SOCKET_ERROR || received == 0)
+    {
+        return false;
+    }
+    buffer.append(chunk, static_cast<size_t>(received));
+    return true;
+}
+
+/// Value of a header in a raw header block (case-insensitive name), or "" if absent
+std::string FindHeader(const std::string& headers, const std::string& name)
+{
+    auto lower = [](std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return s;
+    };
+
+    std::string lowerHeaders = lower(headers);
+    std::string key = "\r\n" + lower(name) + ":";
+    size_t pos = lowerHeaders.find(key);
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+
+    size_t valueStart = headers.find_first_not_of(' ', pos + key.size());
+    size_t valueEnd = headers.find("\r\n", valueStart);
+    return headers.substr(valueStart, valueEnd - valueStart);
+}
+
+/// Read the next request of a keep-alive connection
+/// @param buffer Bytes received but not consumed yet (carried between calls)
+/// @return false once the connection is closed or sent something malformed
+bool ReadRequest(SOCKET socket, std::string& buffer, HttpRequest& outRequest)
+{
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+    {
+        if (buffer.size() > kMaxHeaderBytes || !Receive(socket, buffer))
+        {
+            return false;
+        }
+    }
+
+    std::string headers = buffer.substr(0, headerEnd + 2);
+    size_t methodEnd = headers.find(' ');
+    size_t pathEnd = headers.find(' ', methodEnd + 1);
+    if (methodEnd == std::string::npos || pathEnd == std::string::npos)
+    {
+        return false;
+    }
+    outRequest.method = headers.substr(0, methodEnd);
+    outRequest.path = headers.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+    size_t contentLength = std::strtoull(FindHeader(headers, "Content-Length").c_str(), nullptr, 10);
+    size_t bodyStart = headerEnd + 4;
+    while (buffer.size() < bodyStart + contentLength)
+    {
+        if (!Receive(socket, buffer))
+        {
+            return false;
+        }
+    }
+
+    outRequest.body = buffer.substr(bodyStart, contentLength);
+    buffer.erase(0, bodyStart + contentLength);
+    return true;
+}
+
+bool SendResponse(SOCKET socket, const char* status, const std::string& body)
+{
+    std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: keep-alive\r\n\r\n" + body;
+    return SendAll(socket, response);
+}
+
+void SleepMs(unsigned ms)
+{
+    if (ms > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// MESSAGES API REPLIES
+// ============================================================================
+
+namespace
+{
+
+json MakeUsage(size_t inputTokens, size_t outputTokens)
+{
+    return {{"input_tokens", inputTokens}, {"output_tokens", outputTokens},
+            {"cache_creation_input_tokens", 0}, {"cache_read_input_tokens", 0}};
+}
+
+/// Whole reply in one body, sent once the generation delay has passed
+bool SendBufferedReply(SOCKET socket, size_t inputTokens)
+{
+    SleepMs(g_config.generateDelayMs);
+
+    json message = {
+        {"id", "msg_mock"},
+        {"type", "message"},
+        {"role", "assistant"},
+        {"model", kModelName},
+        {"content", json::array({{{"type", "text"}, {"text", g_config.replyText}}})},
+        {"stop_reason", "end_turn"},
+        {"usage", MakeUsage(inputTokens, g_config.replyText.size() / kBytesPerToken)}
+    };
+    return SendResponse(socket, "200 OK", message.dump());
+}
+
+/// Send one server-sent event as an HTTP chunk
+bool SendEvent(SOCKET socket, const char* type, const json& data)
+{
+    std::string event = std::string("event: ") + type + "\ndata: " + data.dump() + "\n\n";
+    char sizeLine[32];
+    sprintf_s(sizeLine, "%zx\r\n", event.size());
+    return SendAll(socket, sizeLine + event + "\r\n");
+}
+
+/// Reply as an event stream, with the text split into deltas spread over the generation delay
+bool SendStreamedReply(SOCKET socket, size_t inputTokens)
+{
+    std::string headers = "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: keep-alive\r\n\r\n";
+    if (!SendAll(socket, headers))
+    {
+        return false;
+    }
+
+    json start = {
+        {"type", "message_start"},
+        {"message", {{"id", "msg_mock"}, {"type", "message"}, {"role", "assistant"}, {"model", kModelName},
+                     {"content", json::array()}, {"usage", MakeUsage(inputTokens, 1)}}}
+    };
+    if (!SendEvent(socket, "message_start", start) ||
+        !SendEvent(socket, "content_block_start",
+            {{"type", "content_block_start"}, {"index", 0}, {"content_block", {{"type", "text"}, {"text", ""}}}}))
+    {
+        return false;
+    }
+
+    const std::string& text = g_config.replyText;
+    size_t pieceSize = std::max<size_t>(1, (text.size() + kStreamPieceCount - 1) / kStreamPieceCount);
+    unsigned pieceDelayMs = g_config.generateDelayMs / static_cast<unsigned>(kStreamPieceCount);
+
+    for (size_t offset = 0; offset < text.size(); offset += pieceSize)
+    {
+        SleepMs(pieceDelayMs);
+        json delta = {
+            {"type", "content_block_delta"},
+            {"index", 0},
+            {"delta", {{"type", "text_delta"}, {"text", text.substr(offset, pieceSize)}}}
+        };
+        if (!SendEvent(socket, "content_block_delta", delta))
+        {
+            return false;
+        }
+    }
+
+    json messageDelta = {
+        {"type", "message_delta"},
+        {"delta", {{"stop_reason", "end_turn"}}},
+        {"usage", {{"output_tokens", text.size() / kBytesPerToken}}}
+    };
+    return SendEvent(socket, "content_block_stop", {{"type", "content_block_stop"}, {"index", 0}}) &&
+           SendEvent(socket, "message_delta", messageDelta) &&
+           SendEvent(socket, "message_stop", {{"type", "message_stop"}}) &&
+           SendAll(socket, "0\r\n\r\n");
+}
+
+/// Answer requests on one connection until the client closes it
+void ServeConnection(SOCKET socket)
+{
+    std::string buffer;
+    HttpRequest request;
+
+    while (g_running.load() && ReadRequest(socket, buffer, request))
+    {
+        bool ok;
+        if (request.method == "GET")
+        {
+            // Connection pre-warm (/v1/models)
+            ok = SendResponse(socket, "200 OK", R"({"data":[],"has_more":false})");
+        }
+        else if (request.method == "POST")
+        {
+            g_requestCount.fetch_add(1);
+            SleepMs(g_config.firstByteDelayMs);
+
+            size_t inputTokens = request.body.size() / kBytesPerToken;
+            bool streaming = request.body.find(R"("stream":true)") != std::string::npos;
+            ok = streaming ? SendStreamedReply(socket, inputTokens) : SendBufferedReply(socket, inputTokens);
+        }
+        else
+        {
+            ok = SendResponse(socket, "405 Method Not Allowed",
+                R"({"type":"error","error":{"type":"invalid_request_error","message":"Unsupported method"}})");
+        }
+
+        if (!ok)
+        {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        g_clientSockets.erase(std::remove(g_clientSockets.begin(), g_clientSockets.end(), socket),
+                              g_clientSockets.end());
+    }
+    closesocket(socket);
+}
+
+void AcceptLoop()
+{
+    DWORD backoffMs = kAcceptMinBackoffMs;
+    while (g_running.load())
+    {
+        SOCKET client = accept(g_listenSocket, nullptr, nullptr);
+        if (client == INVALID_SOCKET)
+        {
+            // Stop closes the listening socket to end the loop
+            int error = WSAGetLastError();
+            if (!g_running.load() || error == WSAENOTSOCK || error == WSAEINTR || error == WSAEINVAL)
+            {
+                break;
+            }
+
+            Log("[MOCK] accept failed (" + std::to_string(error) + "), retrying in " +
+                std::to_string(backoffMs) + "ms");
+            Sleep(backoffMs);
+            backoffMs = std::min<DWORD>(backoffMs * 2, kAcceptMaxBackoffMs);
+            continue;
+        }
+        backoffMs = kAcceptMinBackoffMs;
+
+        // Replies are small; don't let Nagle hold back the last SSE chunk
+        BOOL noDelay = TRUE;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        g_clientSockets.push_back(client);
+        g_connectionThreads.emplace_back(ServeConnection, client);
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+namespace MockApiServer
+{
+
+bool Start(const Config& config)
+{
+    if (g_running.load())
+    {
+        return true;
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        Log("[MOCK] WSAStartup failed");
+        return false;
+    }
+
+    g_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (g_listenSocket == INVALID_SOCKET)
+    {
+        Log("[MOCK] socket failed: " + std::to_string(WSAGetLastError()));
+        WSACleanup();
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    if (bind(g_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(g_listenSocket, SOMAXCONN) == SOCKET_ERROR)
+    {
+        Log("[MOCK] Could not listen on port " + std::to_string(config.port) + ": " +
+            std::to_string(WSAGetLastError()));
+        closesocket(g_listenSocket);
+        g_listenSocket = INVALID_SOCKET;
+        WSACleanup();
+        return false;
+    }
+
+    g_config = config;
+    g_requestCount.store(0);
+    g_running.store(true);
+    g_acceptThread = std::thread(AcceptLoop);
+
+    Log("[MOCK] Listening on http://127.0.0.1:" + std::to_string(config.port) +
+        " (first byte " + std::to_string(config.firstByteDelayMs) + "ms, generate " +
+        std::to_string(config.generateDelayMs) + "ms)");
+    return true;
+}
+
+void Stop()
+{
+    if (!g_running.exchange(false))
+    {
+        return;
+    }
+
+    closesocket(g_listenSocket);
+    g_listenSocket = INVALID_SOCKET;
+    g_acceptThread.join();
+
+    // Shut down rather than close: each connection thread closes its own socket
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(g_connectionsMutex);
+        for (SOCKET client : g_clientSockets)
+        {
+            shutdown(client, SD_BOTH);
+        }
+        threads = std::move(g_connectionThreads);
+        g_connectionThreads.clear();
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    WSACleanup();
+    Log("[MOCK] Stopped after " + std::to_string(g_requestCount.load()) + " requests");
+}
+
+uint64_t GetRequestCount()
+{
+    return g_requestCount.load();
+}
+
+} // namespace MockApiServer
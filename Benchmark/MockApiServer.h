@@ -0,0 +1,42 @@
+#pragma once
+
+// ============================================================================
+// MockApiServer.h - Local Stand-in for the Anthropic Messages API
+// Plain HTTP/1.1 keep-alive server on 127.0.0.1 that answers every request
+// with a canned reply after a configurable delay, for offline benchmarking
+// ============================================================================
+
+#include <cstdint>
+#include <string>
+
+namespace MockApiServer
+{
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+/// How the server answers
+struct Config
+{
+    uint16_t port = 8787;
+    unsigned firstByteDelayMs = 0;  ///< Wait before the response headers (request latency and prompt processing)
+    unsigned generateDelayMs = 0;   ///< Spread over the body (generation time; streamed replies arrive in pieces)
+    std::string replyText;          ///< Model text returned in every reply
+};
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/// Start listening and serving on background threads
+/// @return false if the port could not be bound
+[[nodiscard]] bool Start(const Config& config);
+
+/// Close the listening socket and every open connection, then join the threads
+void Stop();
+
+/// Messages API requests answered since Start
+[[nodiscard]] uint64_t GetRequestCount();
+
+} // namespace MockApiServer
@@ -0,0 +1,299 @@
+// ============================================================================
+// SelfTest.cpp - Checks of the Request Pipeline's Encoders and Parsers
+// ============================================================================
+
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <json.hpp>
+
+#include "ClaudeAPI.h"
+#include "CompactState.h"
+#include "StateDelta.h"
+
+namespace SelfTest
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+namespace
+{
+
+/// Failures of the check running now
+int g_failures = 0;
+
+void Expect(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::printf("    expected: %s\n", what.c_str());
+        g_failures++;
+    }
+}
+
+/// Read the "@N NAME" lines of a compact type dictionary block
+std::vector<std::string> ParseDictionary(const std::string& block)
+{
+    std::vector<std::string> entries;
+    size_t start = 0;
+    while (start < block.size())
+    {
+        size_t end = block.find('\n', start);
+        std::string line = block.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t space = line.find(' ');
+        if (line.size() > 1 && line[0] == '@' && space != std::string::npos)
+        {
+            size_t id = std::strtoul(line.c_str() + 1, nullptr, 10);
+            entries.resize(std::max(entries.size(), id + 1));
+            entries[id] = line.substr(space + 1);
+        }
+        start = end == std::string::npos ? block.size() : end + 1;
+    }
+    return entries;
+}
+
+/// Undo the compact encoding the way the system prompt tells the model to read it
+json DecodeCompact(const json& value, const std::vector<std::string>& dictionary)
+{
+    if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        if (text.size() > 1 && text[0] == '@')
+        {
+            size_t id = std::strtoul(text.c_str() + 1, nullptr, 10);
+            return id < dictionary.size() ? json(dictionary[id]) : value;
+        }
+        return value;
+    }
+
+    if (value.is_object() && value.size() == 2 && value.contains("cols") && value.contains("rows"))
+    {
+        const json& columns = value["cols"];
+        json array = json::array();
+        for (const json& row : value["rows"])
+        {
+            json element = json::object();
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                if (row[i].is_null())
+                {
+                    continue;   // No such field
+                }
+                const std::string& name = columns[i].get_ref<const std::string&>();
+                size_t dot = name.find('.');
+                json field = DecodeCompact(row[i], dictionary);
+                if (dot == std::string::npos)
+                {
+                    element[name] = std::move(field);
+                }
+                else
+                {
+                    element[name.substr(0, dot)][name.substr(dot + 1)] = std::move(field);
+                }
+            }
+            array.push_back(std::move(element));
+        }
+        return array;
+    }
+
+    if (value.is_structured())
+    {
+        json out = value;
+        for (auto it = out.begin(); it != out.end(); ++it)
+        {
+            *it = DecodeCompact(*it, dictionary);
+        }
+        return out;
+    }
+    return value;
+}
+
+/// Apply changes the way the delta legend tells the model to
+void ApplyDelta(json& target, const json& changes)
+{
+    for (auto change = changes.begin(); change != changes.end(); ++change)
+    {
+        const std::string& key = change.key();
+        auto current = target.find(key);
+        if (change->is_null())
+        {
+            target.erase(key);
+        }
+        else if (current != target.end() && current->is_array() && change->is_object())
+        {
+            for (const json& removed : change->value("removed", json::array()))
+            {
+                std::string identity = StateDelta::ElementKey(removed);
+                json kept = json::array();
+                for (json& element : *current)
+                {
+                    if (StateDelta::ElementKey(element) != identity)
+                    {
+                        kept.push_back(std::move(element));
+                    }
+                }
+                *current = std::move(kept);
+            }
+            for (const json& updated : change->value("updated", json::array()))
+            {
+                for (json& element : *current)
+                {
+                    if (StateDelta::ElementKey(element) == StateDelta::ElementKey(updated))
+                    {
+                        ApplyDelta(element, updated);
+                    }
+                }
+            }
+            for (const json& added : change->value("added", json::array()))
+            {
+                current->push_back(added);
+            }
+        }
+        else if (current != target.end() && current->is_object() && change->is_object())
+        {
+            ApplyDelta(*current, *change);
+        }
+        else
+        {
+            target[key] = *change;
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+
+namespace
+{
+
+/// A compact keyframe plus a compact delta decodes to the new state
+void CompactDeltaRoundTrip()
+{
+    const json before = json::parse(R"({
+        "turn": 10,
+        "playerID": 0,
+        "units": [
+            {"id": 1, "x": 4, "y": 5, "type": "UNIT_WARRIOR", "movesLeft": 2, "fortified": true},
+            {"id": 2, "x": 6, "y": 5, "type": "UNIT_WARRIOR", "movesLeft": 2},
+            {"id": 3, "x": 7, "y": 8, "type": "UNIT_SETTLER", "movesLeft": 2, "isSettler": true}
+        ],
+        "cities": [
+            {"id": 65536, "x": 5, "y": 5, "population": 3, "production": "UNIT_WARRIOR",
+             "yields": {"food": 4.5, "production": 3}},
+            {"id": 131072, "x": 9, "y": 3, "population": 1, "production": "BUILDING_MONUMENT",
+             "yields": {"food": 2, "production": 1.5}}
+        ],
+        "visibleTerrain": [
+            {"x": 4, "y": 5, "terrainType": "TERRAIN_GRASS_HILLS"},
+            {"x": 6, "y": 5, "terrainType": "TERRAIN_GRASS_HILLS", "featureType": "FEATURE_FOREST"}
+        ]
+    })");
+
+    // Two units move, one loses a field, one is gone and one is new;
+    // a city's yields change and a forest is chopped
+    json after = before;
+    after["turn"] = 11;
+    after["units"][0]["x"] = 5;
+    after["units"][0].erase("fortified");
+    after["units"][1]["x"] = 7;
+    after["units"][1]["movesLeft"] = 0;
+    after["units"].erase(2);
+    after["units"].push_back(json::parse(R"({"id": 4, "x": 5, "y": 5, "type": "UNIT_BUILDER", "charges": 3})"));
+    after["cities"][0]["yields"]["food"] = 5.5;
+    after["cities"][1]["population"] = 2;
+    after["visibleTerrain"][1].erase("featureType");
+
+    const int playerID = 900;   // Not a real player, so no other check shares its dictionary
+    std::string dictionaryText;
+    std::string keyframe = CompactState::EncodeState(playerID, before, dictionaryText);
+
+    json changes;
+    Expect(StateDelta::Diff(before, after, changes), "the states differ");
+    std::string delta = CompactState::EncodeDelta(playerID, changes, dictionaryText);
+
+    std::vector<std::string> dictionary = ParseDictionary(dictionaryText);
+    json keyframeState = DecodeCompact(json::parse(keyframe), dictionary);
+    Expect(keyframeState == before, "the keyframe decodes to the old state");
+
+    json rebuilt = keyframeState;
+    ApplyDelta(rebuilt, DecodeCompact(json::parse(delta), dictionary));
+    Expect(rebuilt == after, "keyframe plus delta decodes to the new state, got " + rebuilt.dump());
+
+    // The unchanged fields of updated units must not come out as removals
+    json updated = json::parse(delta)["units"]["updated"];
+    Expect(updated.is_array(), "updated units stay a list of objects, got " + updated.dump());
+}
+
+/// api_endpoint accepts https anywhere and http only to loopback, IPv6 literals in brackets
+void ApiEndpointParsing()
+{
+    const std::vector<std::pair<const char*, bool>> endpoints = {
+        {"https://api.example.com", true},
+        {"https://api.example.com:8443/", true},
+        {"http://127.0.0.1:8787", true},
+        {"http://localhost", true},
+        {"http://[::1]:8080", true},
+        {"http://[::1]", true},
+        {"https://[2001:db8::1]:8443", true},
+        {"http://example.com", false},
+        {"http://[2001:db8::1]:8080", false},
+        {"http://[::1", false},
+        {"http://[::1]8080", false},
+        {"http://[]:8080", false},
+        {"http://[::1]:0", false},
+        {"http://[::1]:65536", false},
+        {"http://::1:8080", false},
+        {"https://api.example.com/v1", false},
+        {"ftp://[::1]", false},
+    };
+
+    for (const auto& [endpoint, valid] : endpoints)
+    {
+        Expect(ClaudeAPI::SetOption("api_endpoint", endpoint) == valid,
+               std::string(endpoint) + (valid ? " is accepted" : " is rejected"));
+    }
+    Expect(ClaudeAPI::SetOption("api_endpoint", "default"), "default restores the Anthropic API");
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int RunAll()
+{
+    const std::vector<std::pair<const char*, std::function<void()>>> checks = {
+        {"compact delta round trip", CompactDeltaRoundTrip},
+        {"api_endpoint parsing", ApiEndpointParsing},
+    };
+
+    int failed = 0;
+    for (const auto& [name, check] : checks)
+    {
+        g_failures = 0;
+        check();
+        std::printf("%s  %s\n", g_failures == 0 ? "PASS" : "FAIL", name);
+        failed += g_failures == 0 ? 0 : 1;
+    }
+    std::printf("%d of %zu checks failed\n", failed, checks.size());
+    CompactState::Reset();
+    return failed;
+}
+
+} // namespace SelfTest
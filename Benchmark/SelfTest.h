@@ -0,0 +1,15 @@
+#pragma once
+
+// ============================================================================
+// SelfTest.h - Checks of the Request Pipeline's Encoders and Parsers
+// Run with ClaudeBenchmark --self-test; needs no corpus, mock server or network
+// ============================================================================
+
+namespace SelfTest
+{
+
+/// Run every check and print one line per check
+/// @return Number of checks that failed
+[[nodiscard]] int RunAll();
+
+} // namespace SelfTest
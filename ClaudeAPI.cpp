@@ -3,16 +3,39 @@
 // ============================================================================
 
 #include "ClaudeAPI.h"
+#include "ActionValidation.h"
+#include "CompactState.h"
 #include "Log.h"
+#include "ModelRouting.h"
+#include "Profiler.h"
+#include "RequestRecorder.h"
+#include "ResponseCache.h"
+#include "ResponseStream.h"
+#include "StateBudget.h"
+#include "StateDelta.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <sstream>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -34,6 +57,8 @@ namespace
     // API Configuration
     constexpr const char* kApiHost = "api.anthropic.com";
     constexpr const char* kApiPath = "/v1/messages";
+    constexpr const char* kPrewarmPath = "/v1/models?limit=1";
+    constexpr const wchar_t* kUserAgent = L"Civ6ClaudeAI/1.0";
     constexpr const char* kApiVersion = "2023-06-01";
     constexpr const char* kDefaultModel = "claude-sonnet-4-5-20250929";
     constexpr int kDefaultMaxTokens = 4096;
@@ -44,6 +69,47 @@ namespace
 
     // HTTP status codes
     constexpr DWORD kHttpStatusOK = 200;
+
+    // Wait for WinHTTP to finish closing a request handle (its callback may still run until then)
+    constexpr DWORD kHttpCloseWaitMs = 5000;
+
+    // Retries of transient API failures
+    constexpr int kDefaultRetryAttempts = 3;
+    constexpr int kMaxRetryAttempts = 10;               ///< Upper bound for the "retry_attempts" option
+    /// Below the default request deadline, so the last try still has time
+    constexpr int kDefaultRetryDeadlineSeconds = 40;
+    constexpr double kRetryBaseDelayMs = 1000.0;       ///< First backoff, doubled for each retry
+    constexpr double kRetryMaxDelayMs = 16000.0;
+    constexpr DWORD kRetrySleepSliceMs = 50;           ///< Backoff sleeps wake this often to notice an abort
+    constexpr std::array<DWORD, 7> kRetryableStatuses = {408, 429, 500, 502, 503, 504, 529};
+
+    // Delta game state encoding
+    constexpr int kDefaultKeyframeInterval = 10;   ///< Turns between full snapshots
+    /// Send a keyframe if the delta is larger than this share of the full state
+    constexpr size_t kMaxDeltaPercent = 50;
+
+    // Async worker pool
+    /// Requests in flight at once (one per Claude-controlled player in multi-civ runs)
+    constexpr size_t kWorkerThreadCount = 4;
+    constexpr size_t kMaxQueuedRequests = 16;      ///< StartAsyncRequest fails beyond this
+
+    // Conversation history
+    constexpr size_t kDefaultHistoryTokens = 8000; ///< Budget for earlier turns kept in the conversation
+    /// Evict down to this share of the budget (keeps the cached prefix stable between evictions)
+    constexpr size_t kEvictTargetPercent = 50;
+    constexpr size_t kMaxEarlierTurnLines = 20;    ///< One-line summaries kept for evicted turns
+
+    // Game state recording (benchmark corpus)
+    constexpr const char* kRecordedStatesFolderName = "recorded_states";
+
+    // Request/response recording
+    constexpr size_t kDefaultRecordingMegabytes = 64;   ///< Per game; later exchanges are dropped
+    constexpr size_t kBytesPerMegabyte = 1024 * 1024;
+
+    // Request metrics
+    constexpr size_t kMaxUnreportedMetrics = 32;   ///< Requests kept waiting for Lua's timings
+    constexpr size_t kMaxFinishedMetrics = 256;    ///< Finalized requests kept for GetFinishedMetrics
+    constexpr const char* kMetricsTracePrefix = "civ6_claude_metrics_";
 }
 
 // ============================================================================
@@ -57,18 +123,170 @@ namespace
     std::string g_model = kDefaultModel;
     int g_maxTokens = kDefaultMaxTokens;
 
-    // Turn-based rate limiting
-    int g_lastQueriedTurn = -1;
-    int g_lastQueriedPlayer = -1;
-    std::string g_cachedResponse;
+    // Runtime options (set from Lua via SetOption)
+    std::atomic<bool> g_streamingEnabled{true};
+    std::atomic<bool> g_deltaEnabled{false};
+    std::atomic<bool> g_compactEnabled{false};
+    std::atomic<size_t> g_stateTokenBudget{0};     ///< 0 for no limit ("state_token_budget" option)
+    std::atomic<bool> g_modelRoutingEnabled{true}; ///< Pick the model from model_routing.json ("model_routing" option)
+    std::atomic<bool> g_validateActions{true};     ///< Check actions against the state ("validate_actions" option)
+    std::atomic<int> g_keyframeInterval{kDefaultKeyframeInterval};
+    std::atomic<size_t> g_historyTokenBudget{kDefaultHistoryTokens};
+    std::atomic<bool> g_responseCacheEnabled{false};   ///< Opt-in: its key needs the fully parsed state
+
+    /// The last turn Claude was queried for on behalf of one player
+    struct PlayerTurnRecord
+    {
+        int turn = -1;
+        json cachedResponse;   ///< Action document for that turn (null if none)
+    };
+
+    // Turn-based rate limiting, tracked per player so several players'
+    // requests can run side by side (guarded by g_turnTrackingMutex)
+    std::mutex g_turnTrackingMutex;
+    std::unordered_map<int, PlayerTurnRecord> g_playerTurns;
+
+    /// Lets another thread abort the HTTP call a worker is waiting on. The worker
+    /// stops at its next wait and closes the request handle itself, so no thread
+    /// ever uses a handle another thread closed
+    struct HttpAbortHandle
+    {
+        HttpAbortHandle() : event(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+        ~HttpAbortHandle()
+        {
+            if (event)
+            {
+                CloseHandle(event);
+            }
+        }
+        HttpAbortHandle(const HttpAbortHandle&) = delete;
+        HttpAbortHandle& operator=(const HttpAbortHandle&) = delete;
+
+        std::atomic<bool> aborted{false};   ///< Set once; later calls on this handle fail immediately
+        HANDLE event;                       ///< Manual-reset, set with aborted to wake the worker
+    };
+
+    /// One async request, from queueing until Lua retrieves the result
+    /// Note: All fields except cancelled and http are guarded by g_asyncMutex
+    struct AsyncRequest
+    {
+        RequestId id = kNoRequest;
+        RequestPriority priority = RequestPriority::Normal;
+        bool speculative = false;               ///< Provisional plan for the player's next turn
+        bool recorded = false;                  ///< Copy the game state to the recording folder
+        std::chrono::steady_clock::time_point queuedAt;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        bool timedOut = false;                  ///< The deadline passed before the request finished
+        std::string gameStateJson;              ///< Released once a worker picks the request up
+        AsyncState state = AsyncState::Pending;
+        json response;
+        std::string error;
+        std::vector<json> streamedActions;      ///< Received, not yet taken by Lua
+        std::vector<json> dispatchedActions;    ///< Already handed to Lua
+        std::atomic<bool> cancelled{false};
+        HttpAbortHandle http;
+    };
 
-    // Async request state
+    // Async request pool (guarded by g_asyncMutex)
     std::mutex g_asyncMutex;
-    std::atomic<AsyncState> g_asyncState{AsyncState::Idle};
-    std::string g_asyncResponse;
-    std::string g_asyncError;
-    std::thread g_asyncThread;
-    std::atomic<bool> g_asyncCancelled{false};
+    std::condition_variable g_asyncQueueCondition;
+    std::unordered_map<RequestId, std::shared_ptr<AsyncRequest>> g_asyncRequests;  ///< Not yet retrieved or cancelled
+    std::vector<std::shared_ptr<AsyncRequest>> g_asyncQueue;                        ///< Waiting for a worker
+    RequestId g_nextRequestId = 1;
+    RequestId g_latestRequestId = kNoRequest;
+    std::vector<std::thread> g_workerThreads;
+    bool g_workersStopping = false;
+
+    // Fails requests whose deadline passed (waits on g_asyncMutex)
+    std::thread g_deadlineThread;
+    std::condition_variable g_deadlineCondition;
+    std::atomic<int> g_requestDeadlineSeconds{0};  ///< Default deadline, 0 for none ("request_deadline" option)
+
+    // Size limit of one game's request recording ("record_requests_mb" option)
+    std::atomic<size_t> g_recordingMegabytes{kDefaultRecordingMegabytes};
+
+    // Retries of transient failures within one request ("retry_attempts" and "retry_deadline" options)
+    std::atomic<int> g_retryAttempts{kDefaultRetryAttempts};
+    std::atomic<int> g_retryDeadlineSeconds{kDefaultRetryDeadlineSeconds};
+
+    // JSON bytes parsed by the request running on this thread (per-turn pipeline counter)
+    thread_local uint64_t t_bytesParsed = 0;
+
+    // Metrics of the request running on this thread (nullptr outside RequestActions callers)
+    thread_local RequestMetrics* t_requestMetrics = nullptr;
+
+    // Abort handle of the request running on this thread (nullptr for calls that can't be cancelled)
+    thread_local HttpAbortHandle* t_httpAbort = nullptr;
+
+    // Finished requests (guarded by g_metricsMutex)
+    std::mutex g_metricsMutex;
+    std::deque<RequestMetrics> g_unreportedMetrics;    ///< Waiting for Lua's stages, oldest first
+    std::deque<RequestMetrics> g_finishedMetrics;      ///< Latest finalized requests, oldest first
+    MetricsSummary g_metricsSummary;
+    double g_metricsTotalMsSum = 0;
+    double g_metricsFirstByteMsSum = 0;
+    std::ofstream g_traceFile;                         ///< This game's JSONL trace (opened on first write)
+
+    // Token usage reported by the API
+    std::mutex g_usageMutex;
+    UsageStats g_usageStats;
+
+    /// Last full game state sent for a player; later requests send it again
+    /// unchanged (so it is read from the prompt cache) plus the changes since
+    struct StateBaseline
+    {
+        int turn = -1;
+        json state;         ///< Parsed snapshot the delta is computed against
+        std::string text;   ///< Exact text sent, reused byte-for-byte for cache hits
+    };
+
+    std::mutex g_baselineMutex;
+    std::unordered_map<int, StateBaseline> g_stateBaselines;   ///< Keyed by player ID
+
+    /// One earlier request/response pair kept in a player's conversation
+    struct ConversationExchange
+    {
+        int turn = -1;
+        std::string userText;       ///< Condensed user message: turn and action results, no game state
+        std::string assistantText;  ///< Claude's reply as received
+    };
+
+    /// Rolling conversation for one player
+    struct Conversation
+    {
+        std::deque<ConversationExchange> exchanges;
+        std::string earlierTurns;   ///< One line per evicted exchange, oldest first
+        std::string pendingResults; ///< Action results reported by Lua since the last request
+        size_t historyBytes = 0;    ///< Text held in exchanges
+
+        // Latest speculative request, held back until ResolveSpeculativeRequest
+        std::optional<ConversationExchange> speculativeExchange;
+        std::string speculativeResults; ///< Start of pendingResults that request already reported
+    };
+
+    std::mutex g_conversationMutex;
+    std::unordered_map<int, Conversation> g_conversations;  ///< Keyed by player ID
+
+    // Persistent WinHTTP handles, shared by every request so the TCP/TLS
+    // connection to the API host stays in WinHTTP's keep-alive pool
+    std::mutex g_httpMutex;
+    HINTERNET g_hSession = nullptr;
+    HINTERNET g_hConnect = nullptr;
+    std::string g_connectHost;
+    INTERNET_PORT g_connectPort = 0;
+
+    // Where requests go (guarded by g_httpMutex); the "api_endpoint" option
+    // points them elsewhere, e.g. at the benchmark's local mock server
+    std::string g_apiHost = kApiHost;
+    INTERNET_PORT g_apiPort = INTERNET_DEFAULT_HTTPS_PORT;
+    bool g_apiSecure = true;
+
+    // Game states handed to StartAsyncRequest are copied here when set (guarded by g_recordingMutex)
+    std::mutex g_recordingMutex;
+    std::string g_recordingFolder;
+    std::thread g_prewarmThread;
+    std::atomic<bool> g_prewarmStarted{false};
+    HttpAbortHandle g_prewarmAbort;                ///< Lets Shutdown cut a slow pre-warm short
 }
 
 // ============================================================================
@@ -78,33 +296,41 @@ namespace
 namespace
 {
 
-/// Escape special characters for JSON string
-std::string EscapeJson(const std::string& s)
+/// Append s to out with JSON string escaping (no surrounding quotes)
+void AppendJsonEscaped(std::string& out, std::string_view s)
 {
-    std::ostringstream o;
+    static constexpr char kHexDigits[] = "0123456789abcdef";
+
     for (char c : s)
     {
         switch (c)
         {
-        case '"': o << "\\\""; break;
-        case '\\': o << "\\\\"; break;
-        case '\b': o << "\\b"; break;
-        case '\f': o << "\\f"; break;
-        case '\n': o << "\\n"; break;
-        case '\r': o << "\\r"; break;
-        case '\t': o << "\\t"; break;
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
         default:
             if ('\x00' <= c && c <= '\x1f')
             {
-                o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                out += "\\u00";
+                out += kHexDigits[(c >> 4) & 0xF];
+                out += kHexDigits[c & 0xF];
             }
             else
             {
-                o << c;
+                out += c;
             }
         }
     }
-    return o.str();
+}
+
+/// Add to the current request's parsed-bytes counter
+void CountParsed(size_t bytes)
+{
+    t_bytesParsed += bytes;
 }
 
 /// Convert UTF-8 string to wide string for Windows API
@@ -129,18 +355,6 @@ std::wstring Utf8ToWide(const std::string& str)
     return wideStr;
 }
 
-/// Replace all occurrences of a substring
-std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
-{
-    size_t pos = 0;
-    while ((pos = str.find(from, pos)) != std::string::npos)
-    {
-        str.replace(pos, from.length(), to);
-        pos += to.length();
-    }
-    return str;
-}
-
 } // anonymous namespace
 
 // ============================================================================
@@ -151,8 +365,12 @@ namespace
 {
 
 /// Extract JSON from Claude's response (handles markdown code blocks)
-std::string ExtractJsonFromResponse(const std::string& content)
+/// @param outParsed Receives the parsed document when a candidate was validated, otherwise discarded
+/// @return Extracted JSON text (may still be invalid if outParsed is discarded)
+std::string ExtractJsonFromResponse(const std::string& content, json& outParsed)
 {
+    outParsed = json(json::value_t::discarded);
+
     std::string trimmed = content;
 
     // Strategy 1: Look for ```json ... ``` code blocks
@@ -219,16 +437,14 @@ std::string ExtractJsonFromResponse(const std::string& content)
         {
             std::string extracted = trimmed.substr(braceStart, braceEnd - braceStart + 1);
 
-            // Validate it's actually JSON
-            try
+            // Validate it's actually JSON, keeping the parse for the caller
+            CountParsed(extracted.size());
+            outParsed = json::parse(extracted, nullptr, false);
+            if (!outParsed.is_discarded())
             {
-                json test = json::parse(extracted);
                 return extracted;
             }
-            catch (const json::exception&)
-            {
-                Log("Found braces but content wasn't valid JSON");
-            }
+            Log("Found braces but content wasn't valid JSON");
         }
     }
 
@@ -253,725 +469,3462 @@ std::string ExtractJsonFromResponse(const std::string& content)
 namespace
 {
 
-/// Make HTTP POST request to Claude API
-std::string HttpPost(const std::string& host, const std::string& path,
-                     const std::string& body, const std::string& apiKey)
-{
-    std::string response;
-    HINTERNET hSession = nullptr;
-    HINTERNET hConnect = nullptr;
-    HINTERNET hRequest = nullptr;
+using Clock = std::chrono::steady_clock;
 
-    // Cleanup lambda
-    auto cleanup = [&]()
+/// Milliseconds between two time points (0 if either is unset)
+double ElapsedMs(Clock::time_point from, Clock::time_point to)
+{
+    if (from == Clock::time_point{} || to == Clock::time_point{})
     {
-        if (hRequest) WinHttpCloseHandle(hRequest);
-        if (hConnect) WinHttpCloseHandle(hConnect);
-        if (hSession) WinHttpCloseHandle(hSession);
-    };
+        return 0.0;
+    }
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
 
-    // Initialize WinHTTP
-    hSession = WinHttpOpen(
-        L"Civ6ClaudeAI/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME,
-        WINHTTP_NO_PROXY_BYPASS,
-        0);
+/// Timing breakdown of a single HTTP request
+struct HttpTimings
+{
+    Clock::time_point sendStart;        ///< WinHttpSendRequest called
+    Clock::time_point connectStart;     ///< Connecting to server (absent on reused connection)
+    Clock::time_point requestSending;   ///< Connection (and TLS) ready, request bytes going out
+    Clock::time_point requestSent;      ///< Request fully written
+    Clock::time_point firstByte;        ///< Response headers received
+    Clock::time_point complete;         ///< Body fully read
+    bool reusedConnection = true;       ///< Cleared when WinHTTP opens a new socket
+    DWORD statusCode = 0;
+    DWORD retryAfterSeconds = 0;        ///< retry-after header of a failed response (0 if absent)
+};
 
-    if (!hSession)
+/// One request handle in flight (the session is in WinHTTP async mode)
+/// @note The status callback fills in its results; it must outlive the handle,
+///       which is only gone once WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING arrived
+struct HttpCall
+{
+    HttpCall()
+        : stepDone(CreateEventW(nullptr, FALSE, FALSE, nullptr))
+        , closed(CreateEventW(nullptr, TRUE, FALSE, nullptr))
     {
-        Log("WinHttpOpen failed: " + std::to_string(GetLastError()));
-        cleanup();
-        return "";
     }
-
-    // Connect to server
-    std::wstring wideHost = Utf8ToWide(host);
-    hConnect = WinHttpConnect(hSession, wideHost.c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
-
-    if (!hConnect)
+    ~HttpCall()
     {
-        Log("WinHttpConnect failed: " + std::to_string(GetLastError()));
-        cleanup();
-        return "";
+        if (stepDone) CloseHandle(stepDone);
+        if (closed) CloseHandle(closed);
     }
-
-    // Create request
-    std::wstring widePath = Utf8ToWide(path);
-    hRequest = WinHttpOpenRequest(
-        hConnect,
-        L"POST",
-        widePath.c_str(),
-        nullptr,
-        WINHTTP_NO_REFERER,
-        WINHTTP_DEFAULT_ACCEPT_TYPES,
-        WINHTTP_FLAG_SECURE);
-
-    if (!hRequest)
+    HttpCall(const HttpCall&) = delete;
+    HttpCall& operator=(const HttpCall&) = delete;
+
+    HttpTimings timings;        ///< Connection phases, copied out once the handle is closed
+    HANDLE stepDone;            ///< Auto-reset, set when the pending send/receive/query/read completes
+    HANDLE closed;              ///< Manual-reset, set when the handle is fully closed
+    bool failed = false;        ///< The step ended in WINHTTP_CALLBACK_STATUS_REQUEST_ERROR
+    DWORD error = 0;            ///< WinHTTP error code when failed
+    DWORD bytes = 0;            ///< Bytes available (query) or read (read) by the step
+};
+
+/// WinHTTP status callback - records connection phase timestamps and completes the
+/// pending step of the request (runs on WinHTTP's threads)
+void CALLBACK HttpStatusCallback(HINTERNET hInternet, DWORD_PTR context, DWORD status,
+                                 LPVOID statusInfo, DWORD statusInfoLength)
+{
+    auto* call = reinterpret_cast<HttpCall*>(context);
+    if (!call)
     {
-        Log("WinHttpOpenRequest failed: " + std::to_string(GetLastError()));
-        cleanup();
-        return "";
+        return;
     }
 
-    // Build headers
-    std::wstring headers = L"Content-Type: application/json\r\n";
-    headers += L"x-api-key: " + Utf8ToWide(apiKey) + L"\r\n";
-    headers += L"anthropic-version: " + Utf8ToWide(kApiVersion) + L"\r\n";
-
-    // Send request
-    BOOL bResults = WinHttpSendRequest(
-        hRequest,
-        headers.c_str(),
-        static_cast<DWORD>(-1),
-        const_cast<char*>(body.c_str()),
-        static_cast<DWORD>(body.size()),
-        static_cast<DWORD>(body.size()),
-        0);
-
-    if (!bResults)
+    switch (status)
     {
-        Log("WinHttpSendRequest failed: " + std::to_string(GetLastError()));
-        cleanup();
-        return "";
+    case WINHTTP_CALLBACK_STATUS_CONNECTING_TO_SERVER:
+        call->timings.connectStart = Clock::now();
+        call->timings.reusedConnection = false;
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_SENDING_REQUEST:
+        call->timings.requestSending = Clock::now();
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_REQUEST_SENT:
+        call->timings.requestSent = Clock::now();
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+    case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+        SetEvent(call->stepDone);
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE:
+        call->bytes = *static_cast<DWORD*>(statusInfo);
+        SetEvent(call->stepDone);
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+        call->bytes = statusInfoLength;
+        SetEvent(call->stepDone);
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+        call->failed = true;
+        call->error = static_cast<WINHTTP_ASYNC_RESULT*>(statusInfo)->dwError;
+        SetEvent(call->stepDone);
+        break;
+
+    case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+        SetEvent(call->closed);
+        break;
+
+    default:
+        break;
     }
+}
 
-    // Receive response
-    bResults = WinHttpReceiveResponse(hRequest, nullptr);
-
-    if (!bResults)
+/// Whether a host name refers to this machine (localhost, 127.x.x.x or ::1)
+bool IsLoopbackHost(const std::string& host)
+{
+    if (host == "localhost" || host == "::1" || host == "[::1]")
     {
-        Log("WinHttpReceiveResponse failed: " + std::to_string(GetLastError()));
-        cleanup();
-        return "";
+        return true;
     }
+    return host.rfind("127.", 0) == 0 &&
+        host.find_first_not_of("0123456789.") == std::string::npos;
+}
 
-    // Check status code
-    DWORD statusCode = 0;
-    DWORD statusCodeSize = sizeof(statusCode);
-    WinHttpQueryHeaders(
-        hRequest,
-        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-        WINHTTP_HEADER_NAME_BY_INDEX,
-        &statusCode,
-        &statusCodeSize,
-        WINHTTP_NO_HEADER_INDEX);
+/// Split "http[s]://host[:port]" into its parts ("default" or "" restores the Anthropic API)
+/// @return false if value is not of that form, or is plain http to a host other than loopback
+/// @note An IPv6 host is written in brackets ("http://[::1]:8080") and kept with them,
+///       which is how WinHTTP takes it and how it goes into the Host header
+/// @note Plain http is only for a local mock server (the benchmark): the connection is not
+///       encrypted, so anything else could be read on the way
+bool ParseApiEndpoint(const std::string& value, std::string& outHost, INTERNET_PORT& outPort, bool& outSecure)
+{
+    if (value.empty() || value == "default")
+    {
+        outHost = kApiHost;
+        outPort = INTERNET_DEFAULT_HTTPS_PORT;
+        outSecure = true;
+        return true;
+    }
 
-    if (statusCode != kHttpStatusOK)
+    std::string_view rest(value);
+    if (rest.substr(0, 8) == "https://")
+    {
+        outSecure = true;
+        rest.remove_prefix(8);
+    }
+    else if (rest.substr(0, 7) == "http://")
+    {
+        outSecure = false;
+        rest.remove_prefix(7);
+    }
+    else
     {
-        Log("HTTP request failed with status: " + std::to_string(statusCode));
+        return false;
     }
 
-    // Read response data
-    DWORD dwSize = 0;
-    DWORD dwDownloaded = 0;
+    if (!rest.empty() && rest.back() == '/')
+    {
+        rest.remove_suffix(1);
+    }
 
-    do
+    // The port separator is the first ':' after the host, which for an IPv6 literal is after its ']'
+    size_t hostEnd = 0;
+    if (!rest.empty() && rest.front() == '[')
     {
-        dwSize = 0;
-        if (!WinHttpQueryDataAvailable(hRequest, &dwSize))
+        hostEnd = rest.find(']');
+        if (hostEnd == std::string_view::npos || hostEnd == 1 ||
+            rest.substr(1, hostEnd - 1).find_first_not_of("0123456789abcdefABCDEF:.") != std::string_view::npos)
         {
-            Log("WinHttpQueryDataAvailable failed: " + std::to_string(GetLastError()));
-            break;
+            return false;
+        }
+        hostEnd++;
+        if (hostEnd < rest.size() && rest[hostEnd] != ':')
+        {
+            return false;
         }
+    }
+    else
+    {
+        hostEnd = std::min(rest.find(':'), rest.size());
+    }
 
-        if (dwSize == 0) break;
+    std::string_view host = rest.substr(0, hostEnd);
+    if (host.empty() || (host.front() != '[' && host.find_first_of("/[]") != std::string_view::npos))
+    {
+        return false;
+    }
 
-        std::vector<char> chunk(dwSize + 1, 0);
-        if (!WinHttpReadData(hRequest, chunk.data(), dwSize, &dwDownloaded))
+    outPort = outSecure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT;
+    if (hostEnd < rest.size())
+    {
+        std::string portText(rest.substr(hostEnd + 1));
+        char* end = nullptr;
+        unsigned long port = std::strtoul(portText.c_str(), &end, 10);
+        if (portText.empty() || *end != '\0' || port == 0 || port > 65535)
         {
-            Log("WinHttpReadData failed: " + std::to_string(GetLastError()));
-            break;
+            return false;
         }
+        outPort = static_cast<INTERNET_PORT>(port);
+    }
 
-        response.append(chunk.data(), dwDownloaded);
-    } while (dwSize > 0);
-
-    cleanup();
-    return response;
+    outHost = std::string(host);
+    if (!outSecure && !IsLoopbackHost(outHost))
+    {
+        return false;
+    }
+    return true;
 }
 
-} // anonymous namespace
-
-// ============================================================================
-// GAME STATE PARSING
-// ============================================================================
-
-namespace
-{
-
-/// Extract turn number and player ID from game state JSON
-std::pair<int, int> ExtractTurnAndPlayer(const std::string& gameStateJson)
+/// Get the persistent connection handle for the API endpoint, creating session/connection on first use
+/// @param outSecure Set to whether requests on the connection must use TLS
+/// @param outAnthropicApi Set to whether the endpoint is the Anthropic API (the only host given the API key)
+/// @return Connect handle, or nullptr on failure
+HINTERNET GetConnection(bool& outSecure, bool& outAnthropicApi)
 {
-    int turn = -1;
-    int playerID = -1;
+    std::lock_guard<std::mutex> lock(g_httpMutex);
+    outSecure = g_apiSecure;
+    outAnthropicApi = g_apiSecure && g_apiHost == kApiHost;
 
-    try
+    if (!g_hSession)
     {
-        json gameState = json::parse(gameStateJson);
-
-        if (gameState.contains("turn"))
+        g_hSession = WinHttpOpen(
+            kUserAgent,
+            WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+            WINHTTP_NO_PROXY_NAME,
+            WINHTTP_NO_PROXY_BYPASS,
+            WINHTTP_FLAG_ASYNC);
+
+        if (!g_hSession)
         {
-            turn = gameState["turn"].get<int>();
+            Log("WinHttpOpen failed: " + std::to_string(GetLastError()));
+            return nullptr;
         }
-        if (gameState.contains("playerID"))
+
+#ifdef WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL
+        // HTTP/2 needs Windows 10 1607+; older systems silently stay on HTTP/1.1 keep-alive
+        DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+        if (!WinHttpSetOption(g_hSession, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols)))
         {
-            playerID = gameState["playerID"].get<int>();
+            Log("HTTP/2 not available (error " + std::to_string(GetLastError()) + "), using HTTP/1.1");
         }
+#endif
     }
-    catch (const json::exception& e)
+
+    if (g_hConnect && (g_connectHost != g_apiHost || g_connectPort != g_apiPort))
     {
-        Log("Warning: Could not extract turn/player from game state: " + std::string(e.what()));
+        WinHttpCloseHandle(g_hConnect);
+        g_hConnect = nullptr;
     }
 
-    return {turn, playerID};
-}
-
-/// Extract civilization and leader info from game state JSON
-std::pair<std::string, std::string> ExtractCivInfo(const std::string& gameStateJson)
-{
-    std::string civType = "Unknown";
-    std::string leaderType = "Unknown";
-
-    try
+    if (!g_hConnect)
     {
-        json gameState = json::parse(gameStateJson);
+        std::wstring wideHost = Utf8ToWide(g_apiHost);
+        g_hConnect = WinHttpConnect(g_hSession, wideHost.c_str(), g_apiPort, 0);
 
-        if (gameState.contains("player"))
+        if (!g_hConnect)
         {
-            auto& player = gameState["player"];
-
-            if (player.contains("civilizationType"))
-            {
-                civType = player["civilizationType"].get<std::string>();
-
-                // Clean up the type name (e.g., "CIVILIZATION_ROME" -> "Rome")
-                if (civType.find("CIVILIZATION_") == 0)
-                {
-                    civType = civType.substr(13); // Remove "CIVILIZATION_"
-
-                    if (!civType.empty())
-                    {
-                        civType[0] = static_cast<char>(toupper(civType[0]));
-                        for (size_t i = 1; i < civType.length(); i++)
-                        {
-                            civType[i] = static_cast<char>(tolower(civType[i]));
-                        }
-                        // Capitalize after underscores
-                        for (size_t i = 1; i < civType.length(); i++)
-                        {
-                            if (civType[i - 1] == '_')
-                            {
-                                civType[i] = static_cast<char>(toupper(civType[i]));
-                            }
-                        }
-                        // Remove underscores
-                        civType.erase(
-                            std::remove(civType.begin(), civType.end(), '_'),
-                            civType.end());
-                    }
-                }
-            }
-
-            if (player.contains("leaderType"))
-            {
-                leaderType = player["leaderType"].get<std::string>();
-
-                // Clean up leader name (e.g., "LEADER_TRAJAN" -> "Trajan")
-                if (leaderType.find("LEADER_") == 0)
-                {
-                    leaderType = leaderType.substr(7); // Remove "LEADER_"
-
-                    if (!leaderType.empty())
-                    {
-                        leaderType[0] = static_cast<char>(toupper(leaderType[0]));
-                        for (size_t i = 1; i < leaderType.length(); i++)
-                        {
-                            leaderType[i] = static_cast<char>(tolower(leaderType[i]));
-                        }
-                        for (size_t i = 1; i < leaderType.length(); i++)
-                        {
-                            if (leaderType[i - 1] == '_')
-                            {
-                                leaderType[i] = static_cast<char>(toupper(leaderType[i]));
-                            }
-                        }
-                        leaderType.erase(
-                            std::remove(leaderType.begin(), leaderType.end(), '_'),
-                            leaderType.end());
-                    }
-                }
-            }
+            Log("WinHttpConnect failed: " + std::to_string(GetLastError()));
+            return nullptr;
         }
-    }
-    catch (const json::exception& e)
-    {
-        Log("Warning: Could not extract civ info from game state: " + std::string(e.what()));
+        g_connectHost = g_apiHost;
+        g_connectPort = g_apiPort;
     }
 
-    return {civType, leaderType};
+    return g_hConnect;
 }
 
-} // anonymous namespace
-
-// ============================================================================
-// SYSTEM PROMPT
-// ============================================================================
-
-namespace
+/// Close the persistent session and connection handles
+void CloseConnection()
 {
+    std::lock_guard<std::mutex> lock(g_httpMutex);
+
+    if (g_hConnect) WinHttpCloseHandle(g_hConnect);
+    if (g_hSession) WinHttpCloseHandle(g_hSession);
+    g_hConnect = nullptr;
+    g_hSession = nullptr;
+    g_connectHost.clear();
+    g_connectPort = 0;
+}
 
-/// Get the path to the system prompt file in the mod folder
-std::string GetSystemPromptPath()
+/// Log connection setup vs time-to-first-byte for a finished request
+void LogHttpTimings(const HttpTimings& timings)
 {
-    char documentsPath[MAX_PATH];
-    if (SUCCEEDED(SHGetFolderPathA(nullptr, CSIDL_PERSONAL, nullptr, 0, documentsPath)))
-    {
-        return std::string(documentsPath) +
-            "\\My Games\\Sid Meier's Civilization VI\\Mods\\ClaudeAI\\system_prompt.txt";
-    }
-    return "";
+    double connectMs = timings.reusedConnection
+        ? 0.0
+        : ElapsedMs(timings.connectStart, timings.requestSending);
+    double ttfbMs = ElapsedMs(timings.requestSent, timings.firstByte);
+    double downloadMs = ElapsedMs(timings.firstByte, timings.complete);
+    double totalMs = ElapsedMs(timings.sendStart, timings.complete);
+
+    std::ostringstream o;
+    o << std::fixed << std::setprecision(1)
+      << "HTTP timing: connect=" << connectMs << "ms"
+      << (timings.reusedConnection ? " (reused)" : " (new)")
+      << " ttfb=" << ttfbMs << "ms"
+      << " download=" << downloadMs << "ms"
+      << " total=" << totalMs << "ms"
+      << " status=" << timings.statusCode;
+    Log(o.str());
 }
 
-/// Load system prompt from file and substitute placeholders
-std::string BuildSystemPrompt(const std::string& civType, const std::string& leaderType)
+/// Copy the HTTP stages into the metrics of the request running on this thread
+void RecordHttpTimings(const HttpTimings& timings)
 {
-    std::string promptPath = GetSystemPromptPath();
-    std::string prompt;
-
-    // Try to load from file
-    if (!promptPath.empty())
+    if (!t_requestMetrics)
     {
-        std::ifstream file(promptPath);
-        if (file.is_open())
-        {
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            prompt = buffer.str();
-            Log("Loaded system prompt from: " + promptPath);
-        }
-        else
-        {
-            Log("WARNING: Could not open system prompt file: " + promptPath);
-        }
+        return;
     }
 
-    // Use fallback if file loading failed
-    if (prompt.empty())
+    t_requestMetrics->reusedConnection = timings.reusedConnection;
+    t_requestMetrics->connectMs = timings.reusedConnection
+        ? 0.0
+        : ElapsedMs(timings.connectStart, timings.requestSending);
+    t_requestMetrics->firstByteMs = ElapsedMs(timings.requestSent, timings.firstByte);
+    t_requestMetrics->downloadMs = ElapsedMs(timings.firstByte, timings.complete);
+}
+
+/// Abort the HTTP call in progress on another thread
+/// @note Safe at any point: a call that hasn't started fails as soon as it does. Only
+///       flags the call; the worker closes its own request handle when it wakes
+void AbortHttp(HttpAbortHandle& abort)
+{
+    abort.aborted.store(true);
+    if (abort.event)
     {
-        Log("Using fallback system prompt");
-        prompt = "You are an AI playing Civilization VI as {LEADER_NAME} of {CIV_NAME}. "
-                 "Respond with a JSON object containing an 'actions' array. "
-                 "Valid actions: move_unit, attack, found_city, build, research, civic, end_turn. "
-                 "Always end with {\"action\": \"end_turn\"}. "
-                 "Respond ONLY with JSON, no explanation.";
+        SetEvent(abort.event);
     }
-
-    // Replace placeholders
-    prompt = ReplaceAll(prompt, "{CIV_NAME}", civType);
-    prompt = ReplaceAll(prompt, "{LEADER_NAME}", leaderType);
-
-    return prompt;
 }
 
-} // anonymous namespace
-
-// ============================================================================
-// PUBLIC API - INITIALIZATION
-// ============================================================================
-
-bool Initialize()
+/// Whether the call running on this thread was aborted
+bool IsHttpAborted()
 {
-    Log("Claude API initialization");
+    return t_httpAbort && t_httpAbort->aborted.load();
+}
 
-    if (g_apiKey.empty())
+/// Wait for the pending WinHTTP step of a call
+/// @param step Function name for the log
+/// @return false if the step failed or the call was aborted meanwhile
+bool AwaitHttpStep(HttpCall& call, const char* step)
+{
+    HANDLE waitHandles[] = { call.stepDone, t_httpAbort ? t_httpAbort->event : nullptr };
+    DWORD count = waitHandles[1] ? 2 : 1;
+    if (WaitForMultipleObjects(count, waitHandles, FALSE, INFINITE) != WAIT_OBJECT_0 || IsHttpAborted())
     {
-        char* envKey = nullptr;
-        size_t len = 0;
-
-        if (_dupenv_s(&envKey, &len, "ANTHROPIC_API_KEY") == 0 && envKey != nullptr)
-        {
-            g_apiKey = std::string(envKey);
-            free(envKey);
-            Log("Claude API key loaded from environment variable");
-        }
-        else
-        {
-            Log("ERROR: Claude API key not found in environment variable 'ANTHROPIC_API_KEY'");
-            return false;
-        }
+        Log("HTTP request aborted");
+        return false;
     }
 
+    if (call.failed)
+    {
+        Log(std::string(step) + " failed: " + std::to_string(call.error));
+        return false;
+    }
     return true;
 }
 
-void ResetTurnTracking()
+/// Start a WinHTTP step and wait for it to complete
+/// @param started Return value of the async WinHTTP call that starts the step
+bool RunHttpStep(HttpCall& call, BOOL started, const char* step)
 {
-    Log("Resetting Claude API turn tracking");
-    g_lastQueriedTurn = -1;
-    g_lastQueriedPlayer = -1;
-    g_cachedResponse.clear();
+    if (!started)
+    {
+        Log(std::string(step) + " failed: " + std::to_string(GetLastError()));
+        return false;
+    }
+    return AwaitHttpStep(call, step);
 }
 
-bool TestConnection()
+/// Receives body bytes as they arrive (streaming responses)
+using HttpChunkCallback = std::function<void(const char* data, size_t length)>;
+
+/// Send one request over the persistent connection
+/// @param onChunk If set, a 200 response body is delivered here instead of outResponse
+/// @return true if a response (of any status) was read in full; false on abort or a
+///         connection failure, including one partway through the body (outResponse is then empty)
+/// @note Checks for an abort before each WinHTTP call and while waiting on one; the
+///       request handle is only ever closed here
+bool SendHttpRequest(const wchar_t* verb, const std::string& path,
+                     const std::string& body, const std::string& apiKey,
+                     std::string& outResponse, HttpTimings& outTimings,
+                     const HttpChunkCallback& onChunk = nullptr)
 {
-    Log("Testing Claude API connection...");
-
-    if (!Initialize())
+    if (IsHttpAborted())
     {
-        Log("ERROR: Failed to initialize Claude API");
         return false;
     }
 
-    // Build simple test request
-    json requestBody;
-    requestBody["model"] = g_model;
-    requestBody["max_tokens"] = kMaxTestResponseTokens;
-    requestBody["messages"] = json::array({
-        {{"role", "user"}, {"content", "Reply with exactly: CONNECTION_OK"}}
-    });
-
-    std::string body = requestBody.dump();
-    std::string response = HttpPost(kApiHost, kApiPath, body, g_apiKey);
-
-    if (response.empty())
+    bool secure = true;
+    bool anthropicApi = true;
+    HINTERNET hConnect = GetConnection(secure, anthropicApi);
+    if (!hConnect)
     {
-        Log("ERROR: Empty response from Claude API test");
         return false;
     }
 
-    try
-    {
-        json responseJson = json::parse(response);
-
-        if (responseJson.contains("error"))
-        {
-            std::string errorMsg = responseJson["error"]["message"].get<std::string>();
-            Log("Claude API test failed: " + errorMsg);
-            return false;
+    // Create request
+    std::wstring widePath = Utf8ToWide(path);
+    HINTERNET hRequest = WinHttpOpenRequest(
+        hConnect,
+        verb,
+        widePath.c_str(),
+        nullptr,
+        WINHTTP_NO_REFERER,
+        WINHTTP_DEFAULT_ACCEPT_TYPES,
+        secure ? WINHTTP_FLAG_SECURE : 0);
+
+    if (!hRequest)
+    {
+        Log("WinHttpOpenRequest failed: " + std::to_string(GetLastError()));
+        return false;
+    }
+
+    // The status callback may still hold the call until the handle is fully closed,
+    // so a handle that doesn't close in time keeps its call alive (leaked) instead
+    auto call = std::make_unique<HttpCall>();
+    DWORD_PTR context = reinterpret_cast<DWORD_PTR>(call.get());
+    bool callbackSet = WinHttpSetOption(hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context)) &&
+        WinHttpSetStatusCallback(
+            hRequest,
+            HttpStatusCallback,
+            WINHTTP_CALLBACK_FLAG_CONNECTING_TO_SERVER |
+                WINHTTP_CALLBACK_FLAG_SENDING_REQUEST |
+                WINHTTP_CALLBACK_FLAG_REQUEST_SENT |
+                WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS |
+                WINHTTP_CALLBACK_FLAG_HANDLES,
+            0) != WINHTTP_INVALID_STATUS_CALLBACK;
+
+    // Connection phases are copied out once the callback can no longer touch them
+    auto cleanup = [&]()
+    {
+        WinHttpCloseHandle(hRequest);
+        if (callbackSet && WaitForSingleObject(call->closed, kHttpCloseWaitMs) != WAIT_OBJECT_0)
+        {
+            Log(LogLevel::Warning, "WARNING: WinHTTP request handle did not close in time");
+            call.release();
+            return;
+        }
+        outTimings.connectStart = call->timings.connectStart;
+        outTimings.requestSending = call->timings.requestSending;
+        outTimings.requestSent = call->timings.requestSent;
+        outTimings.reusedConnection = call->timings.reusedConnection;
+    };
+
+    if (!callbackSet)
+    {
+        Log("WinHttpSetStatusCallback failed: " + std::to_string(GetLastError()));
+        cleanup();
+        return false;
+    }
+
+    // Build headers
+    // The key only goes to the Anthropic API, never to an api_endpoint override
+    std::wstring headers = L"Content-Type: application/json\r\n";
+    if (anthropicApi)
+    {
+        headers += L"x-api-key: " + Utf8ToWide(apiKey) + L"\r\n";
+    }
+    headers += L"anthropic-version: " + Utf8ToWide(kApiVersion) + L"\r\n";
+
+    // Send request and wait for the response headers
+    outTimings.sendStart = Clock::now();
+    if (IsHttpAborted() ||
+        !RunHttpStep(*call, WinHttpSendRequest(
+                hRequest,
+                headers.c_str(),
+                static_cast<DWORD>(-1),
+                const_cast<char*>(body.c_str()),
+                static_cast<DWORD>(body.size()),
+                static_cast<DWORD>(body.size()),
+                context), "WinHttpSendRequest") ||
+        IsHttpAborted() ||
+        !RunHttpStep(*call, WinHttpReceiveResponse(hRequest, nullptr), "WinHttpReceiveResponse"))
+    {
+        cleanup();
+        return false;
+    }
+    outTimings.firstByte = Clock::now();
+
+    // Check status code (headers are available, so queries complete synchronously)
+    DWORD statusCodeSize = sizeof(outTimings.statusCode);
+    WinHttpQueryHeaders(
+        hRequest,
+        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+        WINHTTP_HEADER_NAME_BY_INDEX,
+        &outTimings.statusCode,
+        &statusCodeSize,
+        WINHTTP_NO_HEADER_INDEX);
+
+    if (outTimings.statusCode != kHttpStatusOK)
+    {
+        Log("HTTP request failed with status: " + std::to_string(outTimings.statusCode));
+
+        DWORD retryAfterSize = sizeof(outTimings.retryAfterSeconds);
+        if (!WinHttpQueryHeaders(
+                hRequest,
+                WINHTTP_QUERY_RETRY_AFTER | WINHTTP_QUERY_FLAG_NUMBER,
+                WINHTTP_HEADER_NAME_BY_INDEX,
+                &outTimings.retryAfterSeconds,
+                &retryAfterSize,
+                WINHTTP_NO_HEADER_INDEX))
+        {
+            outTimings.retryAfterSeconds = 0;
+        }
+    }
+
+    // Error bodies are always buffered so callers can report them
+    bool isStreaming = onChunk && outTimings.statusCode == kHttpStatusOK;
+
+    // Read response data; the buffer stays put while a read is pending
+    std::vector<char> chunk;
+    bool readFailed = false;
+    for (;;)
+    {
+        if (IsHttpAborted() ||
+            !RunHttpStep(*call, WinHttpQueryDataAvailable(hRequest, nullptr), "WinHttpQueryDataAvailable"))
+        {
+            readFailed = true;
+            break;
+        }
+
+        DWORD dwSize = call->bytes;
+        if (dwSize == 0) break;
+
+        chunk.resize(dwSize);
+        if (IsHttpAborted() ||
+            !RunHttpStep(*call, WinHttpReadData(hRequest, chunk.data(), dwSize, nullptr), "WinHttpReadData"))
+        {
+            readFailed = true;
+            break;
+        }
+
+        DWORD dwDownloaded = call->bytes;
+        if (isStreaming)
+        {
+            onChunk(chunk.data(), dwDownloaded);
+        }
+        else
+        {
+            outResponse.append(chunk.data(), dwDownloaded);
+        }
+    }
+
+    outTimings.complete = Clock::now();
+    cleanup();
+
+    // A body cut off by AbortHttp or a dropped connection is not a response
+    if (IsHttpAborted())
+    {
+        Log("HTTP request aborted while reading the response");
+        outResponse.clear();
+        return false;
+    }
+    if (readFailed)
+    {
+        Log("HTTP connection lost while reading the response, discarding " +
+            std::to_string(outResponse.size()) + " bytes");
+        outResponse.clear();
+        return false;
+    }
+    return true;
+}
+
+/// Attempts and time left for one logical request, shared by every try
+struct RetryBudget
+{
+    Clock::time_point start = Clock::now();
+    int retries = 0;            ///< Retries made so far
+};
+
+/// Whether a status may succeed if the same request is sent again
+bool IsRetryableStatus(DWORD statusCode)
+{
+    return std::find(kRetryableStatuses.begin(), kRetryableStatuses.end(), statusCode) != kRetryableStatuses.end();
+}
+
+/// Sleep before the next attempt: the server's retry-after if it sent one,
+/// otherwise jittered exponential backoff
+/// @return false if no attempts or time are left, or the call was aborted meanwhile
+bool WaitBeforeRetry(RetryBudget& budget, DWORD retryAfterSeconds, const std::string& reason)
+{
+    const int maxRetries = g_retryAttempts.load();
+    if (budget.retries >= maxRetries)
+    {
+        if (maxRetries > 0)
+        {
+            Log("[RETRY] " + reason + ", giving up after " + std::to_string(budget.retries) + " retries");
+        }
+        return false;
+    }
+
+    double delayMs = retryAfterSeconds * 1000.0;
+    if (retryAfterSeconds == 0)
+    {
+        // Half to full of the exponential step, so clients that failed together don't retry together
+        thread_local std::mt19937 generator{std::random_device{}()};
+        std::uniform_real_distribution<double> jitter(0.5, 1.0);
+        int step = (std::min)(budget.retries, kMaxRetryAttempts);
+        delayMs = (std::min)(kRetryMaxDelayMs, std::ldexp(kRetryBaseDelayMs, step)) * jitter(generator);
+    }
+
+    // A replay serves the recorded retry at once
+    if (RequestRecorder::IsReplaying())
+    {
+        delayMs = 0;
+    }
+
+    const double remainingMs = g_retryDeadlineSeconds.load() * 1000.0 - ElapsedMs(budget.start, Clock::now());
+    if (delayMs > remainingMs)
+    {
+        Log("[RETRY] " + reason + ", no time left for a retry in " + std::to_string(static_cast<int>(delayMs)) + "ms");
+        return false;
+    }
+
+    budget.retries++;
+    if (t_requestMetrics)
+    {
+        t_requestMetrics->retries = budget.retries;
+    }
+    Log("[RETRY] " + reason + ", retry " + std::to_string(budget.retries) + " of " + std::to_string(maxRetries) +
+        " in " + std::to_string(static_cast<int>(delayMs)) + "ms" + (retryAfterSeconds > 0 ? " (retry-after)" : ""));
+
+    const Clock::time_point wakeAt = Clock::now() +
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(delayMs));
+    while (Clock::now() < wakeAt)
+    {
+        if (IsHttpAborted())
+        {
+            return false;
+        }
+        Sleep(kRetrySleepSliceMs);
+    }
+    return !IsHttpAborted();
+}
+
+/// Answer one attempt from the replayed recording instead of the network
+/// @param outExhausted Set when the recording has nothing left for the path
+/// @return true if the recorded attempt got a response (of any status), like SendHttpRequest
+bool ReplayHttpRequest(const std::string& path, const std::string& body, std::string& outResponse,
+                       HttpTimings& outTimings, const HttpChunkCallback& onChunk, bool& outExhausted)
+{
+    RequestRecorder::Exchange exchange;
+    outExhausted = !RequestRecorder::TakeReplay(path, body, exchange);
+    if (outExhausted || exchange.statusCode == 0)
+    {
+        return false;
+    }
+
+    outTimings.statusCode = exchange.statusCode;
+    if (exchange.statusCode != kHttpStatusOK)
+    {
+        Log("[REPLAY] Recorded status: " + std::to_string(exchange.statusCode));
+    }
+    if (onChunk && exchange.statusCode == kHttpStatusOK)
+    {
+        onChunk(exchange.response.data(), exchange.response.size());
+    }
+    else
+    {
+        outResponse = std::move(exchange.response);
+    }
+    return true;
+}
+
+/// Make HTTP POST request to Claude API
+/// @param onChunk Optional streaming sink; when set, a 200 body is not returned
+/// @param retryBudget Shared with retries the caller makes itself (nullptr for a budget of this call alone)
+/// @note Connection failures and transient statuses (429, 5xx, 529) are sent again with the
+///       same body until the budget runs out; a non-200 body is returned for the caller to report.
+///       Nothing is retried once body bytes reached onChunk
+/// @note When recording, each attempt is written to the game's recording. When replaying,
+///       each attempt is answered from the recording instead, so failed attempts and their
+///       retries replay as they happened (without the backoff sleeps)
+std::string HttpPost(const std::string& path,
+                     const std::string& body, const std::string& apiKey,
+                     const HttpChunkCallback& onChunk = nullptr,
+                     RetryBudget* retryBudget = nullptr)
+{
+    PROFILE_ZONE(HttpPost);
+
+    RetryBudget localBudget;
+    RetryBudget& budget = retryBudget ? *retryBudget : localBudget;
+
+    // Streamed bytes are also kept for the recording
+    bool replaying = RequestRecorder::IsReplaying();
+    bool recording = !replaying && RequestRecorder::IsRecording();
+    bool delivered = false;
+    std::string streamed;
+    HttpChunkCallback trackedChunk;
+    if (onChunk)
+    {
+        trackedChunk = [&delivered, &onChunk, &streamed, recording](const char* data, size_t length)
+        {
+            delivered = true;
+            PROFILE_COUNT(ResponseBytesReceived, length);
+            if (recording)
+            {
+                streamed.append(data, length);
+            }
+            onChunk(data, length);
+        };
+    }
+
+    for (;;)
+    {
+        std::string response;
+        HttpTimings timings;
+        bool ok = false;
+
+        if (replaying)
+        {
+            bool exhausted = false;
+            ok = ReplayHttpRequest(path, body, response, timings, trackedChunk, exhausted);
+            if (exhausted)
+            {
+                return "";
+            }
+        }
+        else
+        {
+            ok = SendHttpRequest(L"POST", path, body, apiKey, response, timings, trackedChunk);
+
+            // A pooled connection may have been closed by the server while idle - retry once fresh
+            if (!ok && timings.reusedConnection && !delivered && !IsHttpAborted())
+            {
+                Log("Request on reused connection failed, retrying on a new connection");
+                response.clear();
+                timings = HttpTimings{};
+                ok = SendHttpRequest(L"POST", path, body, apiKey, response, timings, trackedChunk);
+            }
+
+            if (ok)
+            {
+                LogHttpTimings(timings);
+                RecordHttpTimings(timings);
+            }
+        }
+
+        PROFILE_COUNT(RequestBytesSent, body.size());
+        PROFILE_COUNT(ResponseBytesReceived, response.size());
+
+        if (recording)
+        {
+            RequestRecorder::Exchange exchange;
+            exchange.path = path;
+            exchange.requestBody = body;
+            // Streamed bytes are kept even if the connection then dropped, since the caller
+            // already acted on them; an undelivered body is only kept when it was complete
+            exchange.response = delivered ? std::move(streamed) : (ok ? response : std::string());
+            exchange.statusCode = ok || delivered ? timings.statusCode : 0;
+
+            // A failed attempt stopped somewhere between these points, so its times are left at 0
+            if (ok)
+            {
+                exchange.firstByteMs = ElapsedMs(timings.requestSent, timings.firstByte);
+                exchange.totalMs = ElapsedMs(timings.sendStart, timings.complete);
+            }
+            RequestRecorder::Record(exchange);
+            streamed.clear();
+        }
+
+        bool transient = !ok || IsRetryableStatus(timings.statusCode);
+        if (!transient || delivered || IsHttpAborted() ||
+            !WaitBeforeRetry(budget, ok ? timings.retryAfterSeconds : 0,
+                             ok ? "HTTP " + std::to_string(timings.statusCode) : std::string("Connection failed")))
+        {
+            return ok ? response : "";
+        }
+    }
+}
+
+/// Open the connection ahead of the first turn so the TCP/TLS handshake is off the critical path
+void PrewarmConnection(std::string apiKey)
+{
+    t_httpAbort = &g_prewarmAbort;
+
+    {
+        std::lock_guard<std::mutex> lock(g_httpMutex);
+        Log("Pre-warming connection to " + g_apiHost);
+    }
+
+    std::string response;
+    HttpTimings timings;
+    if (SendHttpRequest(L"GET", kPrewarmPath, "", apiKey, response, timings))
+    {
+        LogHttpTimings(timings);
+        Log("Connection pre-warm complete");
+    }
+    else
+    {
+        Log(LogLevel::Warning, "WARNING: Connection pre-warm failed, first request will connect cold");
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// TOKEN USAGE
+// ============================================================================
+
+namespace
+{
+
+/// Log a request's usage and add it to the session totals
+void RecordUsage(const TokenUsage& usage)
+{
+    uint64_t promptTokens = usage.inputTokens + usage.cacheCreationTokens + usage.cacheReadTokens;
+    uint64_t cachedPercent = promptTokens > 0 ? usage.cacheReadTokens * 100 / promptTokens : 0;
+
+    Log("[USAGE] input=" + std::to_string(usage.inputTokens) +
+        " cache_write=" + std::to_string(usage.cacheCreationTokens) +
+        " cache_read=" + std::to_string(usage.cacheReadTokens) +
+        " output=" + std::to_string(usage.outputTokens) +
+        " (" + std::to_string(cachedPercent) + "% of prompt from cache)");
+
+    std::lock_guard<std::mutex> lock(g_usageMutex);
+    g_usageStats.last = usage;
+    g_usageStats.total.inputTokens += usage.inputTokens;
+    g_usageStats.total.outputTokens += usage.outputTokens;
+    g_usageStats.total.cacheCreationTokens += usage.cacheCreationTokens;
+    g_usageStats.total.cacheReadTokens += usage.cacheReadTokens;
+    g_usageStats.requestCount++;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// REQUEST METRICS
+// Per-request timing breakdown, completed with Lua's stages and traced per game
+// ============================================================================
+
+namespace
+{
+
+json MetricsToJson(const RequestMetrics& metrics)
+{
+    return {
+        {"request", metrics.id},
+        {"player", metrics.playerID},
+        {"turn", metrics.turn},
+        {"response_cache_hit", metrics.responseCacheHit},
+        {"reused_connection", metrics.reusedConnection},
+        {"failed", metrics.failed},
+        {"model", metrics.model},
+        {"route", metrics.route},
+        {"max_tokens", metrics.maxTokens},
+        {"retries", metrics.retries},
+        {"serialize_ms", metrics.serializeMs},
+        {"queue_ms", metrics.queueMs},
+        {"parse_ms", metrics.parseMs},
+        {"connect_ms", metrics.connectMs},
+        {"first_byte_ms", metrics.firstByteMs},
+        {"download_ms", metrics.downloadMs},
+        {"extract_ms", metrics.extractMs},
+        {"decode_ms", metrics.decodeMs},
+        {"execute_ms", metrics.executeMs},
+        {"total_ms", metrics.totalMs},
+        {"input_tokens", metrics.usage.inputTokens},
+        {"output_tokens", metrics.usage.outputTokens},
+        {"cache_write_tokens", metrics.usage.cacheCreationTokens},
+        {"cache_read_tokens", metrics.usage.cacheReadTokens}
+    };
+}
+
+/// Append one request to this game's trace file, opening it on first use
+/// Note: Caller must hold g_metricsMutex lock
+void WriteTraceLine(const RequestMetrics& metrics)
+{
+    if (!g_traceFile.is_open())
+    {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char name[64];
+        sprintf_s(name, "%s%04d%02d%02d_%02d%02d%02d.jsonl", kMetricsTracePrefix,
+            st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+
+        g_traceFile.open(name, std::ios::out | std::ios::app);
+        if (!g_traceFile.is_open())
+        {
+            return;
+        }
+        Log(std::string("[METRICS] Writing request trace to ") + name);
+    }
+
+    g_traceFile << MetricsToJson(metrics).dump() << '\n';
+    g_traceFile.flush();
+}
+
+/// Fold a finished request into the session summary and the trace
+/// Note: Caller must hold g_metricsMutex lock
+void FinalizeMetrics(const RequestMetrics& unsequenced)
+{
+    g_metricsSummary.requestCount++;
+    RequestMetrics& metrics = g_finishedMetrics.emplace_back(unsequenced);
+    metrics.sequence = g_metricsSummary.requestCount;
+    if (g_finishedMetrics.size() > kMaxFinishedMetrics)
+    {
+        g_finishedMetrics.pop_front();
+    }
+
+    g_metricsSummary.last = metrics;
+    g_metricsTotalMsSum += metrics.totalMs;
+    g_metricsFirstByteMsSum += metrics.firstByteMs;
+    g_metricsSummary.averageTotalMs = g_metricsTotalMsSum / g_metricsSummary.requestCount;
+    g_metricsSummary.averageFirstByteMs = g_metricsFirstByteMsSum / g_metricsSummary.requestCount;
+
+    std::ostringstream o;
+    o << std::fixed << std::setprecision(1)
+      << "[METRICS] Request #" << metrics.id << " player " << metrics.playerID << " turn " << metrics.turn
+      << ": serialize=" << metrics.serializeMs << " queue=" << metrics.queueMs
+      << " parse=" << metrics.parseMs << " connect=" << metrics.connectMs
+      << " ttfb=" << metrics.firstByteMs << " download=" << metrics.downloadMs
+      << " extract=" << metrics.extractMs << " decode=" << metrics.decodeMs
+      << " execute=" << metrics.executeMs << " total=" << metrics.totalMs << "ms"
+      << (metrics.responseCacheHit ? " (response cache)" : "");
+    Log(o.str());
+
+    WriteTraceLine(metrics);
+}
+
+/// Hand over a request the DLL has finished; Lua adds its stages through ReportLuaTimings
+void PublishMetrics(const RequestMetrics& metrics)
+{
+    std::lock_guard<std::mutex> lock(g_metricsMutex);
+
+    // Blocking requests have no ID for Lua to report against
+    if (metrics.id == kNoRequest)
+    {
+        FinalizeMetrics(metrics);
+        return;
+    }
+
+    g_unreportedMetrics.push_back(metrics);
+    while (g_unreportedMetrics.size() > kMaxUnreportedMetrics)
+    {
+        FinalizeMetrics(g_unreportedMetrics.front());
+        g_unreportedMetrics.pop_front();
+    }
+}
+
+/// Close this game's trace so the next request starts a new file
+void StartNewMetricsTrace()
+{
+    std::lock_guard<std::mutex> lock(g_metricsMutex);
+    while (!g_unreportedMetrics.empty())
+    {
+        FinalizeMetrics(g_unreportedMetrics.front());
+        g_unreportedMetrics.pop_front();
+    }
+    if (g_traceFile.is_open())
+    {
+        g_traceFile.close();
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// GAME STATE PARSING
+// ============================================================================
+
+namespace
+{
+
+/// Fields the request pipeline needs from the game state
+struct GameStateSummary
+{
+    int turn = -1;
+    int playerID = -1;
+    std::string civType = "Unknown";
+    std::string leaderType = "Unknown";
+};
+
+/// SAX handler that picks turn, playerID and player civ/leader out of the
+/// game state in one pass without building a DOM
+class GameStateSummaryReader : public nlohmann::json_sax<json>
+{
+public:
+    explicit GameStateSummaryReader(GameStateSummary& summary) : m_summary(summary) {}
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t value) override { return OnNumber(static_cast<double>(value)); }
+    bool number_unsigned(number_unsigned_t value) override { return OnNumber(static_cast<double>(value)); }
+    bool number_float(number_float_t value, const string_t&) override { return OnNumber(value); }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t& value) override
+    {
+        if (m_inPlayer && m_depth == 2)
+        {
+            if (m_key == "civilizationType")
+            {
+                m_summary.civType = std::move(value);
+            }
+            else if (m_key == "leaderType")
+            {
+                m_summary.leaderType = std::move(value);
+            }
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        m_depth++;
+        if (m_depth == 2 && m_key == "player")
+        {
+            m_inPlayer = true;
+        }
+        m_key.clear();
+        return true;
+    }
+
+    bool end_object() override
+    {
+        m_depth--;
+        if (m_depth < 2)
+        {
+            m_inPlayer = false;
+        }
+        m_key.clear();
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        m_depth++;
+        m_key.clear();
+        return true;
+    }
+
+    bool end_array() override
+    {
+        m_depth--;
+        m_key.clear();
+        return true;
+    }
+
+    bool key(string_t& value) override
+    {
+        // Only keys at the two levels we read from are worth keeping
+        if (m_depth == 1 || (m_inPlayer && m_depth == 2))
+        {
+            m_key = std::move(value);
+        }
+        else
+        {
+            m_key.clear();
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override
+    {
+        Log("Warning: Could not read game state at byte " + std::to_string(position) + ": " + e.what());
+        return false;
+    }
+
+private:
+    bool OnNumber(double value)
+    {
+        if (m_depth == 1)
+        {
+            if (m_key == "turn")
+            {
+                m_summary.turn = static_cast<int>(value);
+            }
+            else if (m_key == "playerID")
+            {
+                m_summary.playerID = static_cast<int>(value);
+            }
+        }
+        return true;
+    }
+
+    GameStateSummary& m_summary;
+    std::string m_key;      ///< Most recent key at a depth we read from
+    int m_depth = 0;        ///< Container depth (1 = top-level object)
+    bool m_inPlayer = false;
+};
+
+/// Turn a game type name into a display name (e.g. "CIVILIZATION_NEW_ZEALAND" -> "NewZealand")
+void CleanTypeName(std::string& name, std::string_view prefix)
+{
+    if (name.compare(0, prefix.size(), prefix) != 0)
+    {
+        return;
+    }
+
+    name.erase(0, prefix.size());
+    if (name.empty())
+    {
+        return;
+    }
+
+    name[0] = static_cast<char>(toupper(name[0]));
+    for (size_t i = 1; i < name.length(); i++)
+    {
+        name[i] = static_cast<char>(tolower(name[i]));
+    }
+    // Capitalize after underscores
+    for (size_t i = 1; i < name.length(); i++)
+    {
+        if (name[i - 1] == '_')
+        {
+            name[i] = static_cast<char>(toupper(name[i]));
+        }
+    }
+    // Remove underscores
+    name.erase(std::remove(name.begin(), name.end(), '_'), name.end());
+}
+
+/// Read turn, player and civilization info from the game state in a single pass
+GameStateSummary SummarizeGameState(const std::string& gameStateJson)
+{
+    GameStateSummary summary;
+    GameStateSummaryReader reader(summary);
+
+    CountParsed(gameStateJson.size());
+    json::sax_parse(gameStateJson, &reader);
+
+    CleanTypeName(summary.civType, "CIVILIZATION_");
+    CleanTypeName(summary.leaderType, "LEADER_");
+    return summary;
+}
+
+/// Read the same fields from an already parsed game state
+GameStateSummary SummarizeGameState(const json& state)
+{
+    GameStateSummary summary;
+    if (!state.is_object())
+    {
+        return summary;
+    }
+
+    summary.turn = state.value("turn", -1);
+    summary.playerID = state.value("playerID", -1);
+
+    auto player = state.find("player");
+    if (player != state.end() && player->is_object())
+    {
+        summary.civType = player->value("civilizationType", summary.civType);
+        summary.leaderType = player->value("leaderType", summary.leaderType);
+    }
+
+    CleanTypeName(summary.civType, "CIVILIZATION_");
+    CleanTypeName(summary.leaderType, "LEADER_");
+    return summary;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// GAME STATE DELTAS
+// Keyframe or delta for each request, against the player's last keyframe
+// ============================================================================
+
+namespace
+{
+
+/// Game state part of the user message
+struct GameStateMessage
+{
+    std::string baseline;       ///< Keyframe state text (empty when delta encoding is off)
+    int baselineTurn = -1;
+    int turn = -1;
+    std::string changes;        ///< Delta against the keyframe (empty on a keyframe turn)
+    std::string state;          ///< Compact full state when there is no baseline (empty: send the verbose text)
+    std::string dictionary;     ///< Compact type dictionary block (empty when compact encoding is off)
+    bool provisional = false;   ///< State is from the end of the previous turn (speculative request)
+};
+
+/// Decide between a keyframe and a delta for this request and update the baseline
+/// @param state Parsed game state (discarded if it failed to parse)
+/// @param compact Send the state, baseline and delta in the compact encoding
+GameStateMessage EncodeGameStateMessage(const GameStateSummary& summary, const std::string& gameStateJson,
+                                        json&& state, bool compact)
+{
+    GameStateMessage message;
+    message.turn = summary.turn;
+    compact = compact && state.is_object();
+    if (!g_deltaEnabled.load() || summary.playerID < 0 || summary.turn < 0 || !state.is_object())
+    {
+        if (compact)
+        {
+            message.state = CompactState::EncodeState(summary.playerID, state, message.dictionary);
+            CompactState::LogSavings(summary.playerID, summary.turn, "state", gameStateJson.size(),
+                                     message.state.size(), message.dictionary.size());
+        }
+        return message;
+    }
+
+    std::lock_guard<std::mutex> lock(g_baselineMutex);
+    StateBaseline& baseline = g_stateBaselines[summary.playerID];
+
+    const char* keyframeReason = nullptr;
+    if (baseline.turn < 0)
+    {
+        keyframeReason = "no baseline";
+    }
+    else if (summary.turn < baseline.turn)
+    {
+        keyframeReason = "turn went backwards (reload)";
+    }
+    else if (summary.turn - baseline.turn >= g_keyframeInterval.load())
+    {
+        keyframeReason = "keyframe interval";
+    }
+    else
+    {
+        json changes;
+        if (!StateDelta::Diff(baseline.state, state, changes))
+        {
+            changes = json::object();
+        }
+
+        // The baseline text is compact too, so it is the size to compare against
+        size_t fullBytes = gameStateJson.size();
+        if (compact)
+        {
+            message.changes = CompactState::EncodeDelta(summary.playerID, changes, message.dictionary);
+            CompactState::LogSavings(summary.playerID, summary.turn, "delta", changes.dump().size(),
+                                     message.changes.size(), message.dictionary.size());
+            fullBytes = baseline.text.size();
+        }
+        else
+        {
+            message.changes = changes.dump();
+        }
+
+        if (message.changes.size() * 100 > fullBytes * kMaxDeltaPercent)
+        {
+            keyframeReason = "delta too large";
+            message.changes.clear();
+        }
+    }
+
+    if (keyframeReason)
+    {
+        Log("[DELTA] Keyframe for player " + std::to_string(summary.playerID) + " at turn " +
+            std::to_string(summary.turn) + " (" + keyframeReason + "), " +
+            std::to_string(gameStateJson.size()) + " bytes");
+        baseline.turn = summary.turn;
+        if (compact)
+        {
+            baseline.text = CompactState::EncodeState(summary.playerID, state, message.dictionary);
+            CompactState::LogSavings(summary.playerID, summary.turn, "keyframe", gameStateJson.size(),
+                                     baseline.text.size(), message.dictionary.size());
+        }
+        else
+        {
+            baseline.text = gameStateJson;
+        }
+        baseline.state = std::move(state);
+    }
+    else
+    {
+        Log("[DELTA] Player " + std::to_string(summary.playerID) + " turn " + std::to_string(summary.turn) +
+            ": " + std::to_string(message.changes.size()) + " byte delta against turn " +
+            std::to_string(baseline.turn) + " (full state " + std::to_string(gameStateJson.size()) + " bytes)");
+    }
+
+    message.baseline = baseline.text;
+    message.baselineTurn = baseline.turn;
+    return message;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// CONVERSATION HISTORY
+// Earlier turns of each player's conversation, kept within a token budget
+// ============================================================================
+
+namespace
+{
+
+/// History and results to include in one request
+struct ConversationContext
+{
+    std::string earlierTurns;
+    std::vector<ConversationExchange> exchanges;
+    std::string actionResults;  ///< Results of the actions from the previous reply
+};
+
+/// Condensed user message for a turn, as it is kept in the history
+std::string BuildTurnHeader(int turn, const std::string& actionResults)
+{
+    std::string text = "Turn " + std::to_string(turn) + ".";
+    if (!actionResults.empty())
+    {
+        text += " Results of your previous actions: " + actionResults;
+    }
+    return text;
+}
+
+/// One line naming the actions of an evicted exchange
+std::string SummarizeExchange(const ConversationExchange& exchange)
+{
+    json parsed;
+    std::string jsonStr = ExtractJsonFromResponse(exchange.assistantText, parsed);
+    if (parsed.is_discarded() && !jsonStr.empty())
+    {
+        CountParsed(jsonStr.size());
+        parsed = json::parse(jsonStr, nullptr, false);
+    }
+
+    std::string line = "Turn " + std::to_string(exchange.turn) + ":";
+    size_t named = 0;
+    if (parsed.is_object() && parsed.contains("actions") && parsed["actions"].is_array())
+    {
+        for (const json& action : parsed["actions"])
+        {
+            if (action.is_object() && action.contains("action") && action["action"].is_string())
+            {
+                line += (named++ == 0 ? " " : ", ") + action["action"].get<std::string>();
+            }
+        }
+    }
+    if (named == 0)
+    {
+        line += " (no actions)";
+    }
+    return line;
+}
+
+/// Drop the oldest exchanges once the history is over budget, keeping a one-line summary of each
+void EvictOldExchanges(Conversation& conversation, size_t budgetBytes)
+{
+    if (conversation.historyBytes <= budgetBytes)
+    {
+        return;
+    }
+
+    size_t targetBytes = budgetBytes * kEvictTargetPercent / 100;
+    size_t evicted = 0;
+    while (!conversation.exchanges.empty() && conversation.historyBytes > targetBytes)
+    {
+        const ConversationExchange& oldest = conversation.exchanges.front();
+        conversation.earlierTurns += SummarizeExchange(oldest) + "\n";
+        conversation.historyBytes -= oldest.userText.size() + oldest.assistantText.size();
+        conversation.exchanges.pop_front();
+        evicted++;
+    }
+
+    // Keep only the most recent summary lines
+    size_t lines = static_cast<size_t>(
+        std::count(conversation.earlierTurns.begin(), conversation.earlierTurns.end(), '\n'));
+    while (lines > kMaxEarlierTurnLines)
+    {
+        conversation.earlierTurns.erase(0, conversation.earlierTurns.find('\n') + 1);
+        lines--;
+    }
+
+    Log("[HISTORY] Evicted " + std::to_string(evicted) + " turns, " +
+        std::to_string(conversation.exchanges.size()) + " kept (" +
+        std::to_string(conversation.historyBytes / StateBudget::kBytesPerToken) + " tokens)");
+}
+
+/// Copy a player's history for a request and take the pending action results
+/// @param speculative Copy the pending results instead, they stay pending until the plan is adopted
+ConversationContext TakeConversationContext(int playerID, int turn, bool speculative)
+{
+    ConversationContext context;
+    if (playerID < 0)
+    {
+        return context;
+    }
+
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    Conversation& conversation = g_conversations[playerID];
+
+    // After loading an earlier save the history describes turns that never happened
+    if (!conversation.exchanges.empty() && turn < conversation.exchanges.back().turn)
+    {
+        Log("[HISTORY] Turn went backwards for player " + std::to_string(playerID) + ", clearing conversation");
+        conversation = Conversation();
+        return context;
+    }
+
+    if (speculative)
+    {
+        context.actionResults = conversation.pendingResults;
+        conversation.speculativeResults = conversation.pendingResults;
+        conversation.speculativeExchange.reset();
+    }
+    else
+    {
+        context.actionResults = std::move(conversation.pendingResults);
+        conversation.pendingResults.clear();
+        conversation.speculativeExchange.reset();
+        conversation.speculativeResults.clear();
+    }
+
+    if (g_historyTokenBudget.load() > 0)
+    {
+        context.earlierTurns = conversation.earlierTurns;
+        context.exchanges.assign(conversation.exchanges.begin(), conversation.exchanges.end());
+    }
+    return context;
+}
+
+/// Put action results back after a failed request so the next one still reports them
+void RestoreActionResults(int playerID, const std::string& actionResults)
+{
+    if (playerID < 0 || actionResults.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    std::string& pending = g_conversations[playerID].pendingResults;
+    pending = pending.empty() ? actionResults : actionResults + "; " + pending;
+}
+
+/// Append a completed request to the player's history
+/// @param speculative Hold the exchange back until ResolveSpeculativeRequest instead
+void RecordExchange(int playerID, int turn, const std::string& actionResults, const std::string& assistantText,
+                    bool speculative)
+{
+    size_t budgetTokens = g_historyTokenBudget.load();
+    if (playerID < 0 || budgetTokens == 0 || assistantText.empty())
+    {
+        return;
+    }
+
+    ConversationExchange exchange;
+    exchange.turn = turn;
+    exchange.userText = BuildTurnHeader(turn, actionResults);
+    exchange.assistantText = assistantText;
+
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    Conversation& conversation = g_conversations[playerID];
+    if (speculative)
+    {
+        conversation.speculativeExchange = std::move(exchange);
+        return;
+    }
+
+    conversation.historyBytes += exchange.userText.size() + exchange.assistantText.size();
+    conversation.exchanges.push_back(std::move(exchange));
+
+    EvictOldExchanges(conversation, budgetTokens * StateBudget::kBytesPerToken);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// SYSTEM PROMPT
+// ============================================================================
+
+namespace
+{
+
+/// Fallback used when system_prompt.txt cannot be read
+constexpr const char* kFallbackSystemPrompt =
+    "You are an AI playing Civilization VI as {LEADER_NAME} of {CIV_NAME}. "
+    "Respond with a JSON object containing an 'actions' array. "
+    "Valid actions: move_unit, attack, found_city, build, research, civic, end_turn. "
+    "Always end with {\"action\": \"end_turn\"}. "
+    "Respond ONLY with JSON, no explanation.";
+
+/// Appended in compact mode when system_prompt.txt has no compact state section
+constexpr const char* kFallbackCompactStateFormat =
+    "The game state is compacted: a list of objects is sent as {\"cols\": [names], \"rows\": [[values]]} "
+    "with null for a missing field, a column \"parent.field\" is a field of the object \"parent\", "
+    "\"@N\" stands for type name @N of the type dictionary (write the full name in actions), "
+    "and decimals are rounded to one place.";
+
+/// Markers around the part of system_prompt.txt that is only sent in compact mode
+constexpr std::string_view kCompactSectionBegin = "{BEGIN_COMPACT_STATE}";
+constexpr std::string_view kCompactSectionEnd = "{END_COMPACT_STATE}";
+
+/// System prompt split at its placeholders so substitution is a single pass
+struct PromptTemplate
+{
+    enum class Placeholder
+    {
+        CivName,
+        LeaderName
+    };
+
+    std::vector<std::string> literals;          ///< Text between placeholders (placeholders.size() + 1 entries)
+    std::vector<Placeholder> placeholders;      ///< Placeholder following each literal but the last
+    size_t literalLength = 0;                   ///< Total literal bytes, for reserve()
+};
+
+/// Loaded prompt template, reloaded only when the file's last-write time changes
+struct CachedPrompt
+{
+    std::mutex mutex;
+    std::string path;
+    bool pathResolved = false;
+    bool loaded = false;
+    bool fromFile = false;
+    FILETIME lastWriteTime{};
+    PromptTemplate compiled;
+    PromptTemplate compiledCompact;             ///< Including the compact state section
+};
+
+CachedPrompt g_systemPrompt;
+
+/// Whether a record_states folder name stays inside the mod folder: letters, digits,
+/// '-' and '_' only, so no drive, separator or ".." can appear
+bool IsRecordingFolderName(const std::string& name)
+{
+    return !name.empty() && name.size() <= MAX_PATH / 4 &&
+        std::all_of(name.begin(), name.end(), [](unsigned char c)
+        {
+            return std::isalnum(c) || c == '-' || c == '_';
+        });
+}
+
+/// Get the path to the system prompt file in the mod folder
+std::string GetSystemPromptPath()
+{
+    std::string modFolder = GetModFolderPath();
+    return modFolder.empty() ? modFolder : modFolder + "system_prompt.txt";
+}
+
+/// Split prompt text into literals and placeholders
+PromptTemplate CompilePromptTemplate(const std::string& text)
+{
+    static constexpr std::string_view kCivToken = "{CIV_NAME}";
+    static constexpr std::string_view kLeaderToken = "{LEADER_NAME}";
+
+    PromptTemplate compiled;
+    std::string_view view(text);
+    size_t literalStart = 0;
+    size_t pos = 0;
+
+    while ((pos = view.find('{', pos)) != std::string_view::npos)
+    {
+        std::string_view rest = view.substr(pos);
+        size_t tokenLength = 0;
+
+        if (rest.substr(0, kCivToken.size()) == kCivToken)
+        {
+            compiled.placeholders.push_back(PromptTemplate::Placeholder::CivName);
+            tokenLength = kCivToken.size();
+        }
+        else if (rest.substr(0, kLeaderToken.size()) == kLeaderToken)
+        {
+            compiled.placeholders.push_back(PromptTemplate::Placeholder::LeaderName);
+            tokenLength = kLeaderToken.size();
+        }
+        else
+        {
+            pos++;
+            continue;
+        }
+
+        compiled.literals.emplace_back(view.substr(literalStart, pos - literalStart));
+        pos += tokenLength;
+        literalStart = pos;
+    }
+
+    compiled.literals.emplace_back(view.substr(literalStart));
+
+    for (const std::string& literal : compiled.literals)
+    {
+        compiled.literalLength += literal.size();
+    }
+
+    return compiled;
+}
+
+/// Substitute civ and leader into a compiled template
+std::string RenderPromptTemplate(const PromptTemplate& compiled,
+                                 const std::string& civType, const std::string& leaderType)
+{
+    std::string prompt;
+    prompt.reserve(compiled.literalLength +
+                   compiled.placeholders.size() * std::max(civType.size(), leaderType.size()));
+
+    for (size_t i = 0; i < compiled.placeholders.size(); i++)
+    {
+        prompt += compiled.literals[i];
+        prompt += compiled.placeholders[i] == PromptTemplate::Placeholder::CivName ? civType : leaderType;
+    }
+    prompt += compiled.literals.back();
+
+    return prompt;
+}
+
+/// Split prompt text into the verbose variant (compact state section removed) and
+/// the compact variant (section kept, markers removed)
+void SplitCompactSection(const std::string& prompt, std::string& outVerbose, std::string& outCompact)
+{
+    size_t begin = prompt.find(kCompactSectionBegin);
+    size_t end = begin == std::string::npos ? std::string::npos : prompt.find(kCompactSectionEnd, begin);
+    if (end == std::string::npos)
+    {
+        outVerbose = prompt;
+        outCompact = prompt + "\n\n" + kFallbackCompactStateFormat;
+        return;
+    }
+
+    size_t sectionStart = begin + kCompactSectionBegin.size();
+    size_t after = end + kCompactSectionEnd.size();
+
+    // Drop the newline after each marker so the markers leave no blank lines behind
+    size_t bodyStart = sectionStart < prompt.size() && prompt[sectionStart] == '\n' ? sectionStart + 1 : sectionStart;
+    size_t rest = after < prompt.size() && prompt[after] == '\n' ? after + 1 : after;
+
+    outVerbose = prompt.substr(0, begin) + prompt.substr(rest);
+    outCompact = prompt.substr(0, begin) + prompt.substr(bodyStart, end - bodyStart) + prompt.substr(rest);
+}
+
+/// Read and compile the prompt file if it changed since the last load
+/// @note Caller must hold g_systemPrompt.mutex
+void RefreshSystemPrompt()
+{
+    if (!g_systemPrompt.pathResolved)
+    {
+        g_systemPrompt.path = GetSystemPromptPath();
+        g_systemPrompt.pathResolved = true;
+    }
+
+    const std::string& promptPath = g_systemPrompt.path;
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    bool fileExists = !promptPath.empty() &&
+        GetFileAttributesExA(promptPath.c_str(), GetFileExInfoStandard, &attributes);
+
+    // Unchanged since last load - nothing to do
+    if (g_systemPrompt.loaded && fileExists == g_systemPrompt.fromFile &&
+        (!fileExists ||
+         (attributes.ftLastWriteTime.dwLowDateTime == g_systemPrompt.lastWriteTime.dwLowDateTime &&
+          attributes.ftLastWriteTime.dwHighDateTime == g_systemPrompt.lastWriteTime.dwHighDateTime)))
+    {
+        return;
+    }
+
+    std::string prompt;
+
+    if (fileExists)
+    {
+        std::ifstream file(promptPath);
+        if (file.is_open())
+        {
+            prompt.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            Log("Loaded system prompt from: " + promptPath + " (" + std::to_string(prompt.size()) + " bytes)");
+        }
+        else
+        {
+            Log(LogLevel::Warning, "WARNING: Could not open system prompt file: " + promptPath);
+        }
+    }
+    else
+    {
+        Log(LogLevel::Warning, "WARNING: System prompt file not found: " + promptPath);
+    }
+
+    // Use fallback if file loading failed
+    bool fromFile = !prompt.empty();
+    if (!fromFile)
+    {
+        Log("Using fallback system prompt");
+        prompt = kFallbackSystemPrompt;
+    }
+
+    std::string verbosePrompt;
+    std::string compactPrompt;
+    SplitCompactSection(prompt, verbosePrompt, compactPrompt);
+    g_systemPrompt.compiled = CompilePromptTemplate(verbosePrompt);
+    g_systemPrompt.compiledCompact = CompilePromptTemplate(compactPrompt);
+    g_systemPrompt.fromFile = fromFile;
+    g_systemPrompt.lastWriteTime = fromFile ? attributes.ftLastWriteTime : FILETIME{};
+    g_systemPrompt.loaded = true;
+}
+
+/// Build the system prompt for a civ and leader from the cached template
+/// @param compact Include the section explaining the compact game state encoding
+std::string BuildSystemPrompt(const std::string& civType, const std::string& leaderType, bool compact)
+{
+    std::lock_guard<std::mutex> lock(g_systemPrompt.mutex);
+    RefreshSystemPrompt();
+    return RenderPromptTemplate(compact ? g_systemPrompt.compiledCompact : g_systemPrompt.compiled,
+                                civType, leaderType);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// ACTION VALIDATION
+// Reports the actions ActionValidation dropped with the player's next request
+// ============================================================================
+
+namespace
+{
+
+/// Validate a response and queue its rejections for the player's next request
+void ApplyActionValidation(json& document, const ActionValidation::Index& index, int playerID)
+{
+    std::vector<std::string> rejected = ActionValidation::Filter(document, index);
+    if (rejected.empty())
+    {
+        return;
+    }
+
+    std::string results = "rejected before execution:";
+    for (const std::string& line : rejected)
+    {
+        results += " " + line + ";";
+    }
+    results.pop_back();
+    RecordActionResults(playerID, results);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// RUNTIME OPTIONS
+// One handler per SetOption name, each validating and applying its value
+// ============================================================================
+
+namespace
+{
+
+/// Applies one option's value
+/// @return true if the value was valid and applied
+using OptionHandler = bool (*)(const std::string& name, const std::string& value);
+
+struct OptionEntry
+{
+    std::string_view name;
+    OptionHandler apply;
+};
+
+/// Log an invalid option value
+/// @return false, for the handler to return
+bool RejectOptionValue(const std::string& name, const std::string& value)
+{
+    Log(LogLevel::Warning, "WARNING: Invalid value for option '" + name + "': " + value);
+    return false;
+}
+
+/// Read "true"/"1" or "false"/"0"
+bool ParseFlagOption(const std::string& value, bool& out)
+{
+    out = value == "true" || value == "1";
+    return out || value == "false" || value == "0";
+}
+
+/// Read a whole number of at least 0
+bool ParseCountOption(const std::string& value, unsigned long long& out)
+{
+    char* end = nullptr;
+    out = std::strtoull(value.c_str(), &end, 10);
+    return !value.empty() && *end == '\0';
+}
+
+/// Read an int of at least 0 (text after the number is ignored)
+bool ParseIntOption(const std::string& value, int& out)
+{
+    out = std::atoi(value.c_str());
+    return out > 0 || (out == 0 && value == "0");
+}
+
+void LogFlagOption(const std::string& name, bool enabled)
+{
+    Log("Option " + name + " = " + (enabled ? "true" : "false"));
+}
+
+/// Apply a true/false option that only sets a flag
+bool SetFlagOption(const std::string& name, const std::string& value, std::atomic<bool>& flag)
+{
+    bool enabled = false;
+    if (!ParseFlagOption(value, enabled))
+    {
+        return RejectOptionValue(name, value);
+    }
+    flag.store(enabled);
+    LogFlagOption(name, enabled);
+    return true;
+}
+
+bool SetStreamOption(const std::string& name, const std::string& value)
+{
+    return SetFlagOption(name, value, g_streamingEnabled);
+}
+
+bool SetDeltaOption(const std::string& name, const std::string& value)
+{
+    bool enabled = false;
+    if (!ParseFlagOption(value, enabled))
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_deltaEnabled.store(enabled);
+    if (!enabled)
+    {
+        std::lock_guard<std::mutex> lock(g_baselineMutex);
+        g_stateBaselines.clear();
+    }
+    LogFlagOption(name, enabled);
+    return true;
+}
+
+bool SetCompactStateOption(const std::string& name, const std::string& value)
+{
+    bool enabled = false;
+    if (!ParseFlagOption(value, enabled))
+    {
+        return RejectOptionValue(name, value);
+    }
+    // Keyframes were sent in the other encoding, so start the deltas over
+    if (g_compactEnabled.exchange(enabled) != enabled)
+    {
+        std::lock_guard<std::mutex> lock(g_baselineMutex);
+        g_stateBaselines.clear();
+    }
+    LogFlagOption(name, enabled);
+    return true;
+}
+
+bool SetKeyframeIntervalOption(const std::string& name, const std::string& value)
+{
+    int interval = std::atoi(value.c_str());
+    if (interval < 1)
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_keyframeInterval.store(interval);
+    Log("Option keyframe_interval = " + std::to_string(interval));
+    return true;
+}
+
+bool SetStateTokenBudgetOption(const std::string& name, const std::string& value)
+{
+    unsigned long long budget = 0;
+    if (!ParseCountOption(value, budget))
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_stateTokenBudget.store(static_cast<size_t>(budget));
+    Log("Option state_token_budget = " + std::to_string(budget) + (budget == 0 ? " (no limit)" : ""));
+    return true;
+}
+
+bool SetModelRoutingOption(const std::string& name, const std::string& value)
+{
+    return SetFlagOption(name, value, g_modelRoutingEnabled);
+}
+
+bool SetValidateActionsOption(const std::string& name, const std::string& value)
+{
+    return SetFlagOption(name, value, g_validateActions);
+}
+
+bool SetHistoryTokensOption(const std::string& name, const std::string& value)
+{
+    unsigned long long budget = 0;
+    if (!ParseCountOption(value, budget))
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_historyTokenBudget.store(static_cast<size_t>(budget));
+    Log("Option history_tokens = " + std::to_string(budget) + (budget == 0 ? " (history disabled)" : ""));
+    return true;
+}
+
+bool SetResponseCacheOption(const std::string& name, const std::string& value)
+{
+    return SetFlagOption(name, value, g_responseCacheEnabled);
+}
+
+bool SetResponseCacheDiskOption(const std::string& name, const std::string& value)
+{
+    bool enabled = false;
+    if (!ParseFlagOption(value, enabled))
+    {
+        return RejectOptionValue(name, value);
+    }
+    ResponseCache::SetDiskEnabled(enabled);
+    LogFlagOption(name, enabled);
+    return true;
+}
+
+bool SetResponseCacheTtlOption(const std::string& name, const std::string& value)
+{
+    unsigned long long seconds = 0;
+    if (!ParseCountOption(value, seconds))
+    {
+        return RejectOptionValue(name, value);
+    }
+    ResponseCache::SetTtlSeconds(seconds);
+    Log("Option response_cache_ttl = " + std::to_string(seconds) + "s");
+    return true;
+}
+
+bool SetRequestDeadlineOption(const std::string& name, const std::string& value)
+{
+    int seconds = 0;
+    if (!ParseIntOption(value, seconds))
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_requestDeadlineSeconds.store(seconds);
+    Log("Option request_deadline = " + std::to_string(seconds) + "s" + (seconds == 0 ? " (no deadline)" : ""));
+    return true;
+}
+
+bool SetRetryAttemptsOption(const std::string& name, const std::string& value)
+{
+    int attempts = 0;
+    if (!ParseIntOption(value, attempts))
+    {
+        return RejectOptionValue(name, value);
+    }
+    if (attempts > kMaxRetryAttempts)
+    {
+        Log(LogLevel::Warning, "WARNING: Option retry_attempts capped at " + std::to_string(kMaxRetryAttempts) +
+            " (was " + value + ")");
+        attempts = kMaxRetryAttempts;
+    }
+    g_retryAttempts.store(attempts);
+    Log("Option retry_attempts = " + std::to_string(attempts));
+    return true;
+}
+
+bool SetRetryDeadlineOption(const std::string& name, const std::string& value)
+{
+    int seconds = 0;
+    if (!ParseIntOption(value, seconds))
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_retryDeadlineSeconds.store(seconds);
+    Log("Option retry_deadline = " + std::to_string(seconds) + "s");
+    return true;
+}
+
+bool SetApiEndpointOption(const std::string&, const std::string& value)
+{
+    std::string host;
+    INTERNET_PORT port = 0;
+    bool secure = true;
+    if (!ParseApiEndpoint(value, host, port, secure))
+    {
+        Log(LogLevel::Warning, "WARNING: Invalid value for option 'api_endpoint' "
+            "(https://host[:port], or http:// to a loopback host): " + value);
+        return false;
+    }
+
+    // The next request reconnects if the endpoint changed
+    std::lock_guard<std::mutex> lock(g_httpMutex);
+    g_apiHost = host;
+    g_apiPort = port;
+    g_apiSecure = secure;
+    Log("Option api_endpoint = " + std::string(secure ? "https://" : "http://") + host + ":" +
+        std::to_string(port));
+    return true;
+}
+
+bool SetRecordStatesOption(const std::string&, const std::string& value)
+{
+    // Recordings only go to a subfolder of the mod folder, never to a path Lua chooses
+    bool enabled = false;
+    bool isFlag = ParseFlagOption(value, enabled);
+    std::string folder;
+    if ((!isFlag || enabled) && !value.empty())
+    {
+        std::string subfolder = isFlag ? std::string(kRecordedStatesFolderName) : value;
+        if (!IsRecordingFolderName(subfolder))
+        {
+            Log(LogLevel::Warning, "WARNING: Invalid value for option 'record_states' "
+                "(true, false or a folder name of letters, digits, '-' and '_'): " + value);
+            return false;
+        }
+
+        folder = GetModFolderPath();
+        if (folder.empty())
+        {
+            Log(LogLevel::Warning, "WARNING: Mod folder not found, can't record game states");
+            return false;
+        }
+        folder += subfolder + "\\";
+        if (!CreateDirectoryA(folder.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            Log(LogLevel::Warning, "WARNING: Could not create recording folder " + folder + " (error " +
+                std::to_string(GetLastError()) + ")");
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_recordingMutex);
+    g_recordingFolder = folder;
+    Log("Option record_states = " + (folder.empty() ? std::string("off") : folder));
+    return true;
+}
+
+bool SetRecordRequestsOption(const std::string& name, const std::string& value)
+{
+    bool enabled = false;
+    if (!ParseFlagOption(value, enabled))
+    {
+        return RejectOptionValue(name, value);
+    }
+    if (enabled)
+    {
+        RequestRecorder::StartRecording(g_recordingMegabytes.load() * kBytesPerMegabyte);
+    }
+    else
+    {
+        RequestRecorder::StopRecording();
+    }
+    LogFlagOption(name, enabled);
+    return true;
+}
+
+bool SetRecordRequestsMbOption(const std::string& name, const std::string& value)
+{
+    unsigned long long megabytes = 0;
+    if (!ParseCountOption(value, megabytes) || megabytes == 0 || megabytes > 4096)
+    {
+        return RejectOptionValue(name, value);
+    }
+    g_recordingMegabytes.store(static_cast<size_t>(megabytes));
+    if (RequestRecorder::IsRecording())
+    {
+        RequestRecorder::StartRecording(static_cast<size_t>(megabytes) * kBytesPerMegabyte);
+    }
+    Log("Option record_requests_mb = " + value);
+    return true;
+}
+
+bool SetReplayRequestsOption(const std::string&, const std::string& value)
+{
+    if (value == "false" || value == "0" || value.empty())
+    {
+        RequestRecorder::StopReplay();
+        Log("Option replay_requests = false");
+        return true;
+    }
+    if (!RequestRecorder::StartReplay(value))
+    {
+        return false;
+    }
+    Log("Option replay_requests = " + value);
+    return true;
+}
+
+bool SetLogLevelOption(const std::string& name, const std::string& value)
+{
+    LogLevel level;
+    if (!ParseLogLevel(value, level))
+    {
+        return RejectOptionValue(name, value);
+    }
+    SetLogLevel(level);
+    Log("Option log_level = " + value);
+    return true;
+}
+
+/// Every option SetOption accepts (documented in ClaudeAPI.h)
+constexpr std::array<OptionEntry, 20> kOptions = {{
+    {"stream", SetStreamOption},
+    {"delta", SetDeltaOption},
+    {"compact_state", SetCompactStateOption},
+    {"keyframe_interval", SetKeyframeIntervalOption},
+    {"state_token_budget", SetStateTokenBudgetOption},
+    {"model_routing", SetModelRoutingOption},
+    {"validate_actions", SetValidateActionsOption},
+    {"history_tokens", SetHistoryTokensOption},
+    {"response_cache", SetResponseCacheOption},
+    {"response_cache_disk", SetResponseCacheDiskOption},
+    {"response_cache_ttl", SetResponseCacheTtlOption},
+    {"request_deadline", SetRequestDeadlineOption},
+    {"retry_attempts", SetRetryAttemptsOption},
+    {"retry_deadline", SetRetryDeadlineOption},
+    {"api_endpoint", SetApiEndpointOption},
+    {"record_states", SetRecordStatesOption},
+    {"record_requests", SetRecordRequestsOption},
+    {"record_requests_mb", SetRecordRequestsMbOption},
+    {"replay_requests", SetReplayRequestsOption},
+    {"log_level", SetLogLevelOption},
+}};
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API - INITIALIZATION
+// ============================================================================
+
+namespace
+{
+    void StartWorkerPool();
+    void StopWorkerPool();
+}
+
+std::string GetModFolderPath()
+{
+    char documentsPath[MAX_PATH];
+    if (SUCCEEDED(SHGetFolderPathA(nullptr, CSIDL_PERSONAL, nullptr, 0, documentsPath)))
+    {
+        return std::string(documentsPath) + "\\My Games\\Sid Meier's Civilization VI\\Mods\\ClaudeAI\\";
+    }
+    return "";
+}
+
+bool Initialize()
+{
+    Log("Claude API initialization");
+
+    if (g_apiKey.empty())
+    {
+        char* envKey = nullptr;
+        size_t len = 0;
+
+        if (_dupenv_s(&envKey, &len, "ANTHROPIC_API_KEY") == 0 && envKey != nullptr)
+        {
+            g_apiKey = std::string(envKey);
+            free(envKey);
+            Log("Claude API key loaded from environment variable");
+        }
+        else
+        {
+            Log(LogLevel::Error, "ERROR: Claude API key not found in environment variable 'ANTHROPIC_API_KEY'");
+            return false;
+        }
+    }
+
+    // Start the TLS handshake in the background once per process
+    if (!g_prewarmStarted.exchange(true))
+    {
+        g_prewarmThread = std::thread(PrewarmConnection, g_apiKey);
+    }
+
+    // Workers are created up front so no request pays for thread startup
+    StartWorkerPool();
+
+    return true;
+}
+
+void Shutdown()
+{
+    Log("Claude API shutdown");
+
+    StopWorkerPool();
+
+    AbortHttp(g_prewarmAbort);
+    if (g_prewarmThread.joinable())
+    {
+        g_prewarmThread.join();
+    }
+
+    CloseConnection();
+    Log("Persistent HTTP connection closed");
+
+    // The recording is left to the OS here: closing it flushes, trims and frees the
+    // compressor (Cabinet.dll), none of which belongs under the loader lock. Its header
+    // is current after every record, so the untrimmed file replays as is. Recordings
+    // are finalized when a new game starts (ResetTurnTracking) or recording is turned off
+    RequestRecorder::StopReplay();
+}
+
+void ResetTurnTracking()
+{
+    Log("Resetting Claude API turn tracking");
+    {
+        std::lock_guard<std::mutex> lock(g_turnTrackingMutex);
+        g_playerTurns.clear();
+    }
+
+    StartNewMetricsTrace();
+    RequestRecorder::StartNewGame();
+
+    // A new game starts from a full snapshot, an empty type dictionary and an empty
+    // conversation. The response cache is kept so a reloaded save is answered from it
+    {
+        std::lock_guard<std::mutex> lock(g_baselineMutex);
+        g_stateBaselines.clear();
+    }
+    CompactState::Reset();
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    g_conversations.clear();
+}
+
+bool SetOption(const std::string& name, const std::string& value)
+{
+    auto option = std::find_if(kOptions.begin(), kOptions.end(),
+        [&name](const OptionEntry& entry) { return entry.name == name; });
+    if (option == kOptions.end())
+    {
+        Log(LogLevel::Warning, "WARNING: Unknown Claude API option: " + name);
+        return false;
+    }
+    return option->apply(name, value);
+}
+
+UsageStats GetUsageStats()
+{
+    std::lock_guard<std::mutex> lock(g_usageMutex);
+    return g_usageStats;
+}
+
+MetricsSummary GetMetricsSummary()
+{
+    std::lock_guard<std::mutex> lock(g_metricsMutex);
+    return g_metricsSummary;
+}
+
+std::vector<RequestMetrics> GetFinishedMetrics(uint64_t afterSequence)
+{
+    std::lock_guard<std::mutex> lock(g_metricsMutex);
+    std::vector<RequestMetrics> finished;
+    for (const RequestMetrics& metrics : g_finishedMetrics)
+    {
+        if (metrics.sequence > afterSequence)
+        {
+            finished.push_back(metrics);
+        }
+    }
+    return finished;
+}
+
+void ReportLuaTimings(RequestId id, double serializeMs, double decodeMs, double executeMs)
+{
+    std::lock_guard<std::mutex> lock(g_metricsMutex);
+    auto it = std::find_if(g_unreportedMetrics.begin(), g_unreportedMetrics.end(),
+        [id](const RequestMetrics& metrics) { return metrics.id == id; });
+    if (it == g_unreportedMetrics.end())
+    {
+        LOG_DEBUG("[METRICS] No unreported metrics for request #" + std::to_string(id));
+        return;
+    }
+
+    it->serializeMs = serializeMs;
+    it->decodeMs = decodeMs;
+    it->executeMs = executeMs;
+    FinalizeMetrics(*it);
+    g_unreportedMetrics.erase(it);
+}
+
+ResponseCacheStats GetResponseCacheStats()
+{
+    return ResponseCache::GetStats();
+}
+
+void RecordActionResults(int playerID, const std::string& results)
+{
+    if (playerID < 0 || results.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    std::string& pending = g_conversations[playerID].pendingResults;
+    if (!pending.empty())
+    {
+        pending += "; ";
+    }
+    pending += results;
+}
+
+void ResolveSpeculativeRequest(int playerID, bool adopted)
+{
+    if (playerID < 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_conversationMutex);
+    auto it = g_conversations.find(playerID);
+    if (it == g_conversations.end())
+    {
+        return;
+    }
+
+    Conversation& conversation = it->second;
+    if (adopted)
+    {
+        // The adopted request already reported these results to Claude
+        const std::string& reported = conversation.speculativeResults;
+        if (!reported.empty() && conversation.pendingResults.compare(0, reported.size(), reported) == 0)
+        {
+            size_t consumed = reported.size();
+            if (conversation.pendingResults.compare(consumed, 2, "; ") == 0)
+            {
+                consumed += 2;
+            }
+            conversation.pendingResults.erase(0, consumed);
+        }
+
+        if (conversation.speculativeExchange)
+        {
+            ConversationExchange& exchange = *conversation.speculativeExchange;
+            conversation.historyBytes += exchange.userText.size() + exchange.assistantText.size();
+            conversation.exchanges.push_back(std::move(exchange));
+            EvictOldExchanges(conversation, g_historyTokenBudget.load() * StateBudget::kBytesPerToken);
+        }
+    }
+
+    Log(std::string("[PREFETCH] ") + (adopted ? "Adopted" : "Discarded") +
+        " speculative plan for player " + std::to_string(playerID));
+    conversation.speculativeExchange.reset();
+    conversation.speculativeResults.clear();
+}
+
+std::string ValidateResponseActions(const std::string& gameStateJson, const std::string& responseJson)
+{
+    CountParsed(gameStateJson.size() + responseJson.size());
+    json state = json::parse(gameStateJson, nullptr, false);
+    json document = json::parse(responseJson, nullptr, false);
+    if (state.is_discarded() || document.is_discarded())
+    {
+        Log("[VALIDATE] Could not parse the state or plan, leaving the plan unchecked");
+        return responseJson;
+    }
+
+    ApplyActionValidation(document, ActionValidation::BuildIndex(state), SummarizeGameState(state).playerID);
+    return document.dump();
+}
+
+bool TestConnection()
+{
+    Log("Testing Claude API connection...");
+
+    if (!Initialize())
+    {
+        Log(LogLevel::Error, "ERROR: Failed to initialize Claude API");
+        return false;
+    }
+
+    // Build simple test request
+    json requestBody;
+    requestBody["model"] = g_model;
+    requestBody["max_tokens"] = kMaxTestResponseTokens;
+    requestBody["messages"] = json::array({
+        {{"role", "user"}, {"content", "Reply with exactly: CONNECTION_OK"}}
+    });
+
+    std::string body = requestBody.dump();
+    std::string response = HttpPost(kApiPath, body, g_apiKey);
+
+    if (response.empty())
+    {
+        Log(LogLevel::Error, "ERROR: Empty response from Claude API test");
+        return false;
+    }
+
+    try
+    {
+        json responseJson = json::parse(response);
+
+        if (responseJson.contains("error"))
+        {
+            std::string errorMsg = responseJson["error"]["message"].get<std::string>();
+            Log("Claude API test failed: " + errorMsg);
+            return false;
+        }
+
+        if (responseJson.contains("content") &&
+            responseJson["content"].is_array() &&
+            !responseJson["content"].empty())
+        {
+            std::string content = responseJson["content"][0]["text"].get<std::string>();
+            Log("Claude API test response: " + content);
+            Log("Claude API connection test SUCCESSFUL!");
+            return true;
+        }
+
+        Log(LogLevel::Error, "ERROR: Unexpected response format in test");
+        return false;
+    }
+    catch (const json::exception& e)
+    {
+        Log(LogLevel::Error, "ERROR: Failed to parse test response: " + std::string(e.what()));
+        return false;
+    }
+}
+
+// ============================================================================
+// MESSAGE REQUESTS
+// ============================================================================
+
+namespace
+{
+
+/// Assistant output of one Messages API call
+struct MessageResult
+{
+    std::string text;   ///< Assistant text (valid when error is empty)
+    std::string error;  ///< Error message for Lua (empty on success)
+    TokenUsage usage;   ///< Token usage reported by the API
+    bool partial = false;   ///< Only the actions received before the stream broke
+};
+
+/// Stream error types worth sending the request again for
+bool IsRetryableStreamError(const std::string& type)
+{
+    return type == "overloaded_error" || type == "api_error" || type == "rate_limit_error";
+}
+
+/// Send a non-streaming request and pull the assistant text out of the response
+MessageResult SendMessageRequest(const std::string& body)
+{
+    MessageResult result;
+    std::string response = HttpPost(kApiPath, body, g_apiKey);
+
+    if (response.empty())
+    {
+        Log(LogLevel::Error, "ERROR: Empty response from Claude API");
+        result.error = "Empty response";
+        return result;
+    }
+
+    Log("Received response from Claude API (" + std::to_string(response.size()) + " bytes)");
+
+    try
+    {
+        CountParsed(response.size());
+        json responseJson = json::parse(response);
+
+        // Check for API error
+        if (responseJson.contains("error"))
+        {
+            result.error = responseJson["error"]["message"].get<std::string>();
+            Log("Claude API error: " + result.error);
+            return result;
+        }
+
+        ResponseStream::ParseUsage(responseJson.value("usage", json::object()), result.usage);
+
+        // Extract content
+        if (responseJson.contains("content") &&
+            responseJson["content"].is_array() &&
+            !responseJson["content"].empty())
+        {
+            result.text = responseJson["content"][0]["text"].get<std::string>();
+            return result;
+        }
+
+        Log(LogLevel::Error, "ERROR: Unexpected response format from Claude API");
+        result.error = "Unexpected response format";
+    }
+    catch (const json::exception& e)
+    {
+        Log(LogLevel::Error, "ERROR: Failed to parse Claude API response: " + std::string(e.what()));
+        Log("Raw response: " + response.substr(0, kMaxJsonPreviewLength));
+        result.error = "JSON parse error";
+    }
+
+    return result;
+}
+
+/// Send a streaming request, handing each completed action to onAction as it arrives
+/// @param body Request body built with stream enabled
+/// @param actionIndex State to validate each action against first (nullptr to hand on all)
+/// @note A stream that breaks before any action is sent again within one retry budget.
+///       Once actions have reached onAction, Lua may already be executing them, so a
+///       broken stream ends the request with just those actions instead
+MessageResult SendStreamingMessageRequest(const std::string& body, const ResponseStream::ActionCallback& onAction,
+                                          const ActionValidation::Index* actionIndex)
+{
+    MessageResult result;
+    RetryBudget budget;
+
+    // Copies of the actions handed on, kept if the stream breaks after them.
+    // Rejected actions never reach Lua, so they aren't kept or counted
+    std::vector<json> received;
+    ResponseStream::ActionCallback keepAction = [&received, &onAction, actionIndex](json action)
+    {
+        std::string reason;
+        if (actionIndex && ActionValidation::Check(action, *actionIndex, reason) == ActionValidation::Verdict::Rejected)
+        {
+            return;
+        }
+        received.push_back(action);
+        onAction(std::move(action));
+    };
+
+    for (;;)
+    {
+        ResponseStream::MessageStream stream(keepAction);
+        std::string errorBody = HttpPost(
+            kApiPath, body, g_apiKey,
+            [&stream](const char* data, size_t length) { stream.Feed(data, length); },
+            &budget);
+        CountParsed(stream.GetParsedBytes());
+
+        bool broken = !stream.GetError().empty() || (stream.HasStarted() && !stream.IsComplete());
+        if (broken && !received.empty())
+        {
+            Log("[RETRY] Stream broke after " + std::to_string(received.size()) +
+                " actions, keeping them instead of retrying");
+            result.text = json{{"actions", received}}.dump();
+            result.usage = stream.GetUsage();
+            result.partial = true;
+            return result;
+        }
+
+        if (!stream.GetError().empty())
+        {
+            if (IsRetryableStreamError(stream.GetErrorType()) &&
+                WaitBeforeRetry(budget, 0, "Stream " + stream.GetErrorType()))
+            {
+                continue;
+            }
+            result.error = stream.GetError();
+            return result;
+        }
+
+        if (broken && WaitBeforeRetry(budget, 0, "Stream ended before message_stop"))
+        {
+            continue;
+        }
+
+        if (!stream.HasStarted())
+        {
+            // Non-200 responses come back as a plain JSON error body rather than an event stream
+            CountParsed(errorBody.size());
+            json errorJson = json::parse(errorBody, nullptr, false);
+            if (!errorJson.is_discarded() && errorJson.contains("error"))
+            {
+                result.error = errorJson["error"].value("message", "Unknown API error");
+                Log("Claude API error: " + result.error);
+            }
+            else
+            {
+                Log(LogLevel::Error, "ERROR: Empty response from Claude API");
+                result.error = "Empty response";
+            }
+            return result;
+        }
+
+        if (!stream.IsComplete())
+        {
+            Log(LogLevel::Warning, "WARNING: Stream ended before message_stop, using partial text");
+        }
+
+        Log("Received streamed response (" + std::to_string(stream.GetText().size()) + " chars, " +
+            std::to_string(stream.GetStreamedActionCount()) + " actions streamed)");
+        result.text = stream.GetText();
+        result.usage = stream.GetUsage();
+        return result;
+    }
+}
+
+/// Append a text content block, optionally marked as a cache breakpoint
+void AppendTextBlock(std::string& body, std::string_view text, bool cacheBreakpoint)
+{
+    body += R"({"type":"text","text":")";
+    AppendJsonEscaped(body, text);
+    body += cacheBreakpoint ? R"(","cache_control":{"type":"ephemeral"}})" : R"("})";
+}
+
+/// Serialize a Messages API request in one pass
+/// @note The game state is escaped straight into the body rather than going
+///       through a json value and dump(), which would copy it twice more
+/// @note Cache breakpoints sit on the stable prefix: the system prompt (varies
+///       only by civ and leader), the delta keyframe (unchanged until the next
+///       keyframe), the compact type dictionary (grows when new type names appear,
+///       so it follows the keyframe rather than invalidating it) and the end of
+///       the conversation history
+std::string BuildRequestBody(const ModelRouting::Decision& route, const std::string& systemPrompt,
+                             const std::string& gameStateJson, const GameStateMessage& delta,
+                             const ConversationContext& history, bool stream)
+{
+    static constexpr std::string_view kUserPrefix = "Current game state:\n";
+    static constexpr std::string_view kUserSuffix = "\n\nWhat is your next action?";
+    static constexpr std::string_view kKeyframeSuffix =
+        "The game state in the system prompt is the current state.\n\nWhat is your next action?";
+    static constexpr std::string_view kDeltaLegend =
+        "Only fields that changed are listed, null means the field was removed, and lists of "
+        "units, cities and plots give \"added\", \"updated\" and \"removed\" entries identified "
+        "by id or x/y. Apply them to the game state in the system prompt to get the current state:\n";
+
+    size_t historyBytes = history.earlierTurns.size();
+    for (const ConversationExchange& exchange : history.exchanges)
+    {
+        historyBytes += exchange.userText.size() + exchange.assistantText.size() + 128;
+    }
+
+    const std::string& currentState = delta.state.empty() ? gameStateJson : delta.state;
+    size_t stateBytes = delta.baseline.empty() ? currentState.size() : delta.baseline.size() + delta.changes.size();
+    stateBytes += delta.dictionary.size();
+
+    std::string body;
+    body.reserve(systemPrompt.size() + stateBytes + stateBytes / 8 + historyBytes + 512);
+
+    body += R"({"model":")";
+    AppendJsonEscaped(body, route.model);
+    body += R"(","max_tokens":)";
+    body += std::to_string(route.maxTokens);
+    if (stream)
+    {
+        body += R"(,"stream":true)";
+    }
+
+    body += R"(,"system":[)";
+    AppendTextBlock(body, systemPrompt, true);
+    if (!delta.baseline.empty())
+    {
+        body += ',';
+        AppendTextBlock(body, "Game state at turn " + std::to_string(delta.baselineTurn) + ":\n" + delta.baseline,
+                        true);
+    }
+    if (!delta.dictionary.empty())
+    {
+        body += ',';
+        AppendTextBlock(body, delta.dictionary, true);
+    }
+    body += R"(],"messages":[)";
+
+    // Earlier turns: condensed user messages and Claude's replies
+    for (size_t i = 0; i < history.exchanges.size(); i++)
+    {
+        const ConversationExchange& exchange = history.exchanges[i];
+        bool last = (i + 1 == history.exchanges.size());
+
+        body += R"({"role":"user","content":[)";
+        if (i == 0 && !history.earlierTurns.empty())
+        {
+            AppendTextBlock(body, "Earlier turns:\n" + history.earlierTurns, false);
+            body += ',';
+        }
+        AppendTextBlock(body, exchange.userText, false);
+        body += R"(]},{"role":"assistant","content":[)";
+        AppendTextBlock(body, exchange.assistantText, last);
+        body += R"(]},)";
+    }
+
+    // This turn
+    body += R"({"role":"user","content":")";
+    if (!history.exchanges.empty() || !history.actionResults.empty() || delta.provisional)
+    {
+        AppendJsonEscaped(body, BuildTurnHeader(delta.turn, history.actionResults));
+        AppendJsonEscaped(body, "\n\n");
+    }
+    if (delta.provisional)
+    {
+        AppendJsonEscaped(body, "This is a provisional plan: the state below is from the end of turn " +
+            std::to_string(delta.turn - 1) + ", before the other civilizations have moved. "
+            "Plan this turn as if it starts from that state.\n\n");
+    }
+
+    if (delta.baseline.empty())
+    {
+        AppendJsonEscaped(body, kUserPrefix);
+        AppendJsonEscaped(body, currentState);
+        AppendJsonEscaped(body, kUserSuffix);
+    }
+    else if (delta.changes.empty())
+    {
+        AppendJsonEscaped(body, kKeyframeSuffix);
+    }
+    else
+    {
+        AppendJsonEscaped(body, "Changes since turn " + std::to_string(delta.baselineTurn) + ". ");
+        AppendJsonEscaped(body, kDeltaLegend);
+        AppendJsonEscaped(body, delta.changes);
+        AppendJsonEscaped(body, kUserSuffix);
+    }
+    body += R"("}]})";
+
+    return body;
+}
+
+/// Result of RequestActions, handed between stages as a parsed document
+struct ActionResponse
+{
+    json document;      ///< Action JSON for Lua, or {"error": "..."} on failure
+    std::string error;  ///< Error message (empty on success)
+};
+
+/// Build a failed ActionResponse
+ActionResponse MakeErrorResponse(const std::string& message)
+{
+    return {{{"error", message}}, message};
+}
+
+/// Turn assistant text into the action document returned to Lua
+json BuildActionResult(const std::string& content)
+{
+    Log("Claude raw response: " + content);
+
+    json actionJson;
+    std::string jsonStr = ExtractJsonFromResponse(content, actionJson);
+
+    if (jsonStr.empty())
+    {
+        Log("Warning: Could not extract JSON from Claude response");
+        return {{"action", "end_turn"}, {"reason", content}};
+    }
+
+    if (actionJson.is_discarded())
+    {
+        CountParsed(jsonStr.size());
+        actionJson = json::parse(jsonStr, nullptr, false);
+    }
+
+    if (actionJson.is_discarded())
+    {
+        Log("Warning: Extracted text was not valid JSON");
+        Log("Extracted text was: " + jsonStr);
+        return {{"action", "end_turn"}, {"reason", "Invalid JSON from Claude"}};
+    }
+
+    Log("Successfully parsed action: " + jsonStr);
+    return actionJson;
+}
+
+/// Update a player's turn record so repeated queries for the turn return this document
+void RememberTurnResponse(int playerID, int turn, const json& document)
+{
+    std::lock_guard<std::mutex> lock(g_turnTrackingMutex);
+    g_playerTurns[playerID] = {turn, document};
+}
+
+/// Shared implementation of GetActionFromClaude
+/// @param onAction If set (and streaming is enabled), receives actions as they are generated
+/// @param speculative Plan the next turn from this end-of-turn state (see StartAsyncRequest)
+ActionResponse RequestActions(const std::string& gameStateJson, const ResponseStream::ActionCallback& onAction,
+                              bool speculative = false)
+{
+    Log("GetActionFromClaude called");
+
+    if (g_apiKey.empty())
+    {
+        Log(LogLevel::Error, "ERROR: API key not set. Call Initialize() first.");
+        return MakeErrorResponse("API key not set");
+    }
+
+    t_bytesParsed = 0;
+
+    // Stage timings go to the caller's metrics when it provided them
+    RequestMetrics untracked;
+    RequestMetrics& metrics = t_requestMetrics ? *t_requestMetrics : untracked;
+    Clock::time_point parseStart = Clock::now();
+
+    // One pass over the game state for rate limiting and civ info. Delta
+    // encoding and the response cache need the parsed document anyway, so
+    // read the summary from it
+    json parsedState;
+    GameStateSummary summary;
+    bool useResponseCache = !speculative && g_responseCacheEnabled.load();
+    bool compact = g_compactEnabled.load();
+    size_t budgetTokens = g_stateTokenBudget.load();
+    bool validate = !speculative && g_validateActions.load();
+    bool routing = g_modelRoutingEnabled.load() && ModelRouting::HasRules();
+    if (g_deltaEnabled.load() || useResponseCache || compact || budgetTokens > 0 || validate || routing)
+    {
+        CountParsed(gameStateJson.size());
+        parsedState = json::parse(gameStateJson, nullptr, false);
+        summary = SummarizeGameState(parsedState);
+    }
+    else
+    {
+        summary = SummarizeGameState(gameStateJson);
+    }
+    int currentTurn = summary.turn;
+    int currentPlayer = summary.playerID;
+    Log("Turn: " + std::to_string(currentTurn) + ", Player: " + std::to_string(currentPlayer));
+    metrics.playerID = currentPlayer;
+    metrics.turn = currentTurn;
+
+    // Indexed before the budget trims anything, since the actions answer the full state.
+    // A speculative plan answers a state that doesn't exist yet, so it isn't checked
+    ActionValidation::Index actionIndex;
+    if (validate)
+    {
+        actionIndex = ActionValidation::BuildIndex(parsedState);
+    }
+
+    // Over the token budget: trim low-priority sections and send the trimmed text from here on
+    std::string trimmedStateJson;
+    std::vector<std::string> trimmed;
+    if (budgetTokens > 0 && StateBudget::Apply(parsedState, budgetTokens, trimmed))
+    {
+        std::string report;
+        for (const std::string& line : trimmed)
+        {
+            report += (report.empty() ? "" : "; ") + line;
+        }
+        Log("[BUDGET] Player " + std::to_string(currentPlayer) + " turn " + std::to_string(currentTurn) +
+            " trimmed: " + report);
+        parsedState["omittedForSize"] = trimmed;
+        trimmedStateJson = parsedState.dump();
+    }
+    const std::string& stateJson = trimmedStateJson.empty() ? gameStateJson : trimmedStateJson;
+
+    // Check if we've already queried for this turn/player (a speculative
+    // request plans the next turn, so it never matches)
+    if (!speculative && currentTurn >= 0 && currentPlayer >= 0)
+    {
+        std::lock_guard<std::mutex> lock(g_turnTrackingMutex);
+        auto record = g_playerTurns.find(currentPlayer);
+        if (record != g_playerTurns.end() && record->second.turn == currentTurn)
+        {
+            Log("Already queried Claude for turn " + std::to_string(currentTurn) +
+                " player " + std::to_string(currentPlayer) + ", returning cached response");
+
+            if (!record->second.cachedResponse.is_null())
+            {
+                return {record->second.cachedResponse, ""};
+            }
+            return {{{"action", "end_turn"}, {"reason", "Already queried this turn"}}, ""};
+        }
+    }
+
+    // Routine turns go to a cheaper model, complex ones escalate
+    ModelRouting::Decision route = routing ? ModelRouting::Choose(parsedState, g_model, g_maxTokens)
+                                           : ModelRouting::Decision{"", g_model, g_maxTokens};
+    if (!route.route.empty())
+    {
+        Log("[ROUTING] Player " + std::to_string(currentPlayer) + " turn " + std::to_string(currentTurn) +
+            ": route " + route.route + " -> " + route.model +
+            " (max_tokens " + std::to_string(route.maxTokens) + ")");
+    }
+    metrics.route = route.route;
+    metrics.model = route.model;
+    metrics.maxTokens = route.maxTokens;
+
+    Log("Playing as: " + summary.leaderType + " of " + summary.civType);
+    std::string systemPrompt = BuildSystemPrompt(summary.civType, summary.leaderType, compact);
+
+    // The same state seen before (a reloaded save, a refired turn event) gets the same reply
+    uint64_t cacheKey = 0;
+    useResponseCache = useResponseCache && parsedState.is_object();
+    if (useResponseCache)
+    {
+        cacheKey = ResponseCache::ComputeKey(route.model, systemPrompt, parsedState);
+
+        std::string cachedText;
+        if (ResponseCache::Lookup(cacheKey, cachedText))
+        {
+            Log("[RESPONSE CACHE] Hit " + ResponseCache::FormatKey(cacheKey) + " for turn " +
+                std::to_string(currentTurn) + " player " + std::to_string(currentPlayer) + ", skipping the API call");
+
+            ConversationContext history = TakeConversationContext(currentPlayer, currentTurn, false);
+            RecordExchange(currentPlayer, currentTurn, history.actionResults, cachedText, false);
+            metrics.responseCacheHit = true;
+
+            Clock::time_point extractStart = Clock::now();
+            metrics.parseMs = ElapsedMs(parseStart, extractStart);
+            ActionResponse result{BuildActionResult(cachedText), ""};
+            if (validate)
+            {
+                ApplyActionValidation(result.document, actionIndex, currentPlayer);
+            }
+            metrics.extractMs = ElapsedMs(extractStart, Clock::now());
+
+            RememberTurnResponse(currentPlayer, currentTurn, result.document);
+            return result;
         }
+        LOG_DEBUG("[RESPONSE CACHE] Miss " + ResponseCache::FormatKey(cacheKey));
+    }
 
-        if (responseJson.contains("content") &&
-            responseJson["content"].is_array() &&
-            !responseJson["content"].empty())
+    // Build request
+    bool useStreaming = onAction && g_streamingEnabled.load();
+
+    GameStateMessage delta = EncodeGameStateMessage(summary, stateJson, std::move(parsedState), compact);
+    if (speculative && currentTurn >= 0)
+    {
+        delta.turn = currentTurn + 1;
+        delta.provisional = true;
+        Log("[PREFETCH] Speculative request for player " + std::to_string(currentPlayer) +
+            " turn " + std::to_string(delta.turn));
+    }
+    ConversationContext history = TakeConversationContext(currentPlayer, delta.turn, speculative);
+    std::string body = BuildRequestBody(route, systemPrompt, stateJson, delta, history, useStreaming);
+    metrics.parseMs = ElapsedMs(parseStart, Clock::now());
+
+    // Make the API call
+    Log(useStreaming ? "Sending streaming request to Claude API..." : "Sending request to Claude API...");
+
+    // Streamed actions get the same checks as the final document, so the ones
+    // Lua already received still match it (see StripDispatchedActions)
+    MessageResult message = useStreaming
+        ? SendStreamingMessageRequest(body, onAction, validate ? &actionIndex : nullptr)
+        : SendMessageRequest(body);
+
+    if (!message.error.empty())
+    {
+        if (!speculative)
         {
-            std::string content = responseJson["content"][0]["text"].get<std::string>();
-            Log("Claude API test response: " + content);
-            Log("Claude API connection test SUCCESSFUL!");
-            return true;
+            RestoreActionResults(currentPlayer, history.actionResults);
         }
+        return MakeErrorResponse(message.error);
+    }
 
-        Log("ERROR: Unexpected response format in test");
-        return false;
+    RecordUsage(message.usage);
+    RecordExchange(currentPlayer, delta.turn, history.actionResults, message.text, speculative);
+    metrics.usage = message.usage;
+
+    Clock::time_point extractStart = Clock::now();
+    ActionResponse result{BuildActionResult(message.text), ""};
+    if (validate)
+    {
+        ApplyActionValidation(result.document, actionIndex, currentPlayer);
     }
-    catch (const json::exception& e)
+    metrics.extractMs = ElapsedMs(extractStart, Clock::now());
+    if (speculative)
     {
-        Log("ERROR: Failed to parse test response: " + std::string(e.what()));
-        return false;
+        // Not cached for the turn, Lua may still discard it
+        return result;
+    }
+
+    // Only complete replies that parsed into an action list are worth replaying
+    if (useResponseCache && !message.partial && result.document.contains("actions"))
+    {
+        ResponseCache::Store(cacheKey, message.text);
     }
+
+    // Cache response and update turn tracking
+    RememberTurnResponse(currentPlayer, currentTurn, result.document);
+
+    Log("Cached response for turn " + std::to_string(currentTurn) +
+        " player " + std::to_string(currentPlayer));
+    Log("[PIPELINE] Parsed " + std::to_string(t_bytesParsed) + " JSON bytes this turn (game state " +
+        std::to_string(stateJson.size()) + ", request body " + std::to_string(body.size()) + ")");
+
+    return result;
 }
 
+} // anonymous namespace
+
 // ============================================================================
 // PUBLIC API - BLOCKING REQUEST
 // ============================================================================
 
 std::string GetActionFromClaude(const std::string& gameStateJson)
 {
-    Log("GetActionFromClaude called");
+    RequestMetrics metrics;
+    Clock::time_point start = Clock::now();
 
-    if (g_apiKey.empty())
-    {
-        Log("ERROR: API key not set. Call Initialize() first.");
-        return R"({"error":"API key not set"})";
-    }
+    t_requestMetrics = &metrics;
+    ActionResponse result = RequestActions(gameStateJson, nullptr);
+    t_requestMetrics = nullptr;
 
-    // Extract turn and player info for rate limiting
-    auto [currentTurn, currentPlayer] = ExtractTurnAndPlayer(gameStateJson);
-    Log("Turn: " + std::to_string(currentTurn) + ", Player: " + std::to_string(currentPlayer));
+    metrics.failed = !result.error.empty();
+    metrics.totalMs = ElapsedMs(start, Clock::now());
+    PublishMetrics(metrics);
+
+    return result.document.dump();
+}
+
+// ============================================================================
+// PUBLIC API - ASYNC REQUEST
+// A fixed pool of worker threads serves a priority queue of requests
+// ============================================================================
+
+namespace
+{
 
-    // Check if we've already queried for this turn/player
-    if (currentTurn >= 0 && currentPlayer >= 0)
+/// Take the highest-priority queued request (oldest first within a priority)
+/// Note: Caller must hold g_asyncMutex lock and the queue must not be empty
+std::shared_ptr<AsyncRequest> PopNextRequest()
+{
+    auto next = g_asyncQueue.begin();
+    for (auto it = g_asyncQueue.begin(); it != g_asyncQueue.end(); ++it)
     {
-        if (currentTurn == g_lastQueriedTurn && currentPlayer == g_lastQueriedPlayer)
+        if ((*it)->priority > (*next)->priority)
         {
-            Log("Already queried Claude for turn " + std::to_string(currentTurn) +
-                " player " + std::to_string(currentPlayer) + ", returning cached response");
-
-            if (!g_cachedResponse.empty())
-            {
-                return g_cachedResponse;
-            }
-            return R"({"action":"end_turn","reason":"Already queried this turn"})";
+            next = it;
         }
     }
 
-    // Extract civilization info from game state
-    auto [civType, leaderType] = ExtractCivInfo(gameStateJson);
-    Log("Playing as: " + leaderType + " of " + civType);
-
-    // Build request
-    std::string systemPrompt = BuildSystemPrompt(civType, leaderType);
+    std::shared_ptr<AsyncRequest> request = std::move(*next);
+    g_asyncQueue.erase(next);
+    return request;
+}
 
-    json requestBody;
-    requestBody["model"] = g_model;
-    requestBody["max_tokens"] = g_maxTokens;
-    requestBody["system"] = systemPrompt;
-    requestBody["messages"] = json::array({
-        {{"role", "user"}, {"content", "Current game state:\n" + gameStateJson + "\n\nWhat is your next action?"}}
-    });
+/// Whether game states are being copied to a recording folder ("record_states" option)
+bool IsRecordingGameStates()
+{
+    std::lock_guard<std::mutex> lock(g_recordingMutex);
+    return !g_recordingFolder.empty();
+}
 
-    std::string body = requestBody.dump();
-    Log("Sending request to Claude API...");
+/// Write a request's game state to the recording folder as state_<date>_<time>_<id>.json
+void RecordGameState(RequestId id, const std::string& gameStateJson)
+{
+    std::string folder;
+    {
+        std::lock_guard<std::mutex> lock(g_recordingMutex);
+        folder = g_recordingFolder;
+    }
+    if (folder.empty())
+    {
+        return;
+    }
 
-    // Make the API call
-    std::string response = HttpPost(kApiHost, kApiPath, body, g_apiKey);
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    char name[64];
+    sprintf_s(name, "state_%04d%02d%02d_%02d%02d%02d_%05u.json",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, id);
 
-    if (response.empty())
+    std::string path = folder + name;
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
     {
-        Log("ERROR: Empty response from Claude API");
-        return R"({"error":"Empty response"})";
+        Log(LogLevel::Warning, "[RECORD] WARNING: Could not write " + path);
+        return;
     }
+    file.write(gameStateJson.data(), static_cast<std::streamsize>(gameStateJson.size()));
+    LOG_DEBUG("[RECORD] Saved game state of request #" + std::to_string(id) + " to " + path);
+}
 
-    Log("Received response from Claude API (" + std::to_string(response.size()) + " bytes)");
+/// Run one request on the calling worker and store its result
+void RunAsyncRequest(AsyncRequest& request)
+{
+    std::string tag = "[ASYNC #" + std::to_string(request.id) + "] ";
+    Log(tag + "Started on worker");
 
-    // Parse the response
-    try
+    std::string gameStateJson;
+    RequestMetrics metrics;
+    metrics.id = request.id;
     {
-        json responseJson = json::parse(response);
+        PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+        gameStateJson = std::move(request.gameStateJson);
+        request.gameStateJson.clear();
+        metrics.queueMs = ElapsedMs(request.queuedAt, Clock::now());
+    }
 
-        // Check for API error
-        if (responseJson.contains("error"))
-        {
-            std::string errorMsg = responseJson["error"]["message"].get<std::string>();
-            Log("Claude API error: " + errorMsg);
-            return R"({"error":")" + EscapeJson(errorMsg) + R"("})";
-        }
+    if (request.recorded)
+    {
+        RecordGameState(request.id, gameStateJson);
+    }
 
-        // Extract content
-        if (responseJson.contains("content") &&
-            responseJson["content"].is_array() &&
-            !responseJson["content"].empty())
+    t_requestMetrics = &metrics;
+    t_httpAbort = &request.http;
+    ActionResponse result;
+    try
+    {
+        // Call the blocking function, queueing actions for Lua as they stream in.
+        // Speculative plans are only executed whole, once Lua has checked them
+        ResponseStream::ActionCallback onAction;
+        if (!request.speculative)
         {
-            std::string content = responseJson["content"][0]["text"].get<std::string>();
-            Log("Claude raw response: " + content);
-
-            std::string result;
-            std::string jsonStr = ExtractJsonFromResponse(content);
-
-            if (!jsonStr.empty())
+            onAction = [&request, &tag](json action)
             {
-                try
-                {
-                    json actionJson = json::parse(jsonStr);
-                    result = actionJson.dump();
-                    Log("Successfully parsed action: " + result);
-                }
-                catch (const json::exception& e)
+                if (request.cancelled.load())
                 {
-                    Log("Warning: Extracted text was not valid JSON: " + std::string(e.what()));
-                    Log("Extracted text was: " + jsonStr);
-                    result = R"({"action":"end_turn","reason":"Invalid JSON from Claude"})";
+                    return;
                 }
-            }
-            else
-            {
-                Log("Warning: Could not extract JSON from Claude response");
-                result = R"({"action":"end_turn","reason":")" + EscapeJson(content) + R"("})";
-            }
-
-            // Cache response and update turn tracking
-            g_lastQueriedTurn = currentTurn;
-            g_lastQueriedPlayer = currentPlayer;
-            g_cachedResponse = result;
+                PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+                request.streamedActions.push_back(std::move(action));
+                Log("[STREAM] " + tag + "Queued streamed action #" +
+                    std::to_string(request.dispatchedActions.size() + request.streamedActions.size()));
+            };
+        }
+        result = RequestActions(gameStateJson, onAction, request.speculative);
+    }
+    catch (const std::exception& e)
+    {
+        result = MakeErrorResponse(std::string("Exception: ") + e.what());
+    }
+    t_requestMetrics = nullptr;
+    t_httpAbort = nullptr;
 
-            Log("Cached response for turn " + std::to_string(currentTurn) +
-                " player " + std::to_string(currentPlayer));
+    if (request.cancelled.load())
+    {
+        Log(tag + "Cancelled, discarding result");
+        return;
+    }
 
-            return result;
+    {
+        PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+        if (request.timedOut)
+        {
+            result = MakeErrorResponse("Deadline exceeded");
         }
+    }
 
-        Log("ERROR: Unexpected response format from Claude API");
-        return R"({"error":"Unexpected response format"})";
+    // Published before the result so Lua can report its stages as soon as it sees Ready
+    metrics.failed = !result.error.empty();
+    metrics.totalMs = ElapsedMs(request.queuedAt, Clock::now());
+    PublishMetrics(metrics);
+
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+    if (!result.error.empty())
+    {
+        request.error = std::move(result.error);
+        request.state = AsyncState::Failed;
+        Log(tag + "Completed with error: " + request.error);
     }
-    catch (const json::exception& e)
+    else
     {
-        Log("ERROR: Failed to parse Claude API response: " + std::string(e.what()));
-        Log("Raw response: " + response.substr(0, kMaxJsonPreviewLength));
-        return R"({"error":"JSON parse error"})";
+        request.response = std::move(result.document);
+        request.state = AsyncState::Ready;
+        Log(tag + "Completed successfully");
     }
 }
 
-// ============================================================================
-// PUBLIC API - ASYNC REQUEST
-// ============================================================================
-
-namespace
+/// Fail a request whose deadline has passed: drop it from the queue, or abort its HTTP call
+/// Note: Caller must hold g_asyncMutex lock
+void ExpireRequest(const std::shared_ptr<AsyncRequest>& request)
 {
+    request->timedOut = true;
 
-/// Background worker function for async requests
-void AsyncWorkerThread(std::string gameStateJson)
-{
-    Log("[ASYNC] Worker thread started");
+    auto queued = std::find(g_asyncQueue.begin(), g_asyncQueue.end(), request);
+    if (queued != g_asyncQueue.end())
+    {
+        g_asyncQueue.erase(queued);
+        request->error = "Deadline exceeded before a worker was free";
+        request->state = AsyncState::Failed;
+    }
+    else
+    {
+        // The worker reports the failure once its HTTP call returns
+        AbortHttp(request->http);
+    }
+    Log("[ASYNC #" + std::to_string(request->id) + "] Deadline exceeded, " +
+        (queued != g_asyncQueue.end() ? "removed from the queue" : "aborting"));
+}
 
-    try
+/// Watch the deadlines of pending requests until the pool is stopped
+void DeadlineThread()
+{
+    std::unique_lock<std::mutex> lock(g_asyncMutex);
+    while (!g_workersStopping)
     {
-        // Check if cancelled before starting
-        if (g_asyncCancelled.load())
+        Clock::time_point now = Clock::now();
+        Clock::time_point next = Clock::time_point::max();
+
+        for (auto& [id, request] : g_asyncRequests)
         {
-            Log("[ASYNC] Request cancelled before starting");
-            std::lock_guard<std::mutex> lock(g_asyncMutex);
-            g_asyncState.store(AsyncState::Idle);
-            return;
+            if (request->state != AsyncState::Pending || request->timedOut)
+            {
+                continue;
+            }
+            if (request->deadline <= now)
+            {
+                ExpireRequest(request);
+            }
+            else
+            {
+                next = std::min(next, request->deadline);
+            }
         }
 
-        // Call the blocking function
-        std::string result = GetActionFromClaude(gameStateJson);
-
-        // Check if cancelled after completion
-        if (g_asyncCancelled.load())
+        if (next == Clock::time_point::max())
         {
-            Log("[ASYNC] Request cancelled after completion");
-            std::lock_guard<std::mutex> lock(g_asyncMutex);
-            g_asyncState.store(AsyncState::Idle);
-            return;
+            g_deadlineCondition.wait(lock);
+        }
+        else
+        {
+            g_deadlineCondition.wait_until(lock, next);
         }
+    }
+}
+
+/// Worker loop: serve queued requests until the pool is stopped
+void AsyncWorkerThread(size_t workerIndex)
+{
+    Log("[ASYNC] Worker " + std::to_string(workerIndex) + " started");
 
-        // Store the result
+    for (;;)
+    {
+        std::shared_ptr<AsyncRequest> request;
         {
-            std::lock_guard<std::mutex> lock(g_asyncMutex);
-            g_asyncResponse = result;
+            std::unique_lock<std::mutex> lock(g_asyncMutex);
+            g_asyncQueueCondition.wait(lock, [] { return g_workersStopping || !g_asyncQueue.empty(); });
 
-            // Check if it's an error response
-            try
-            {
-                json resultJson = json::parse(result);
-                if (resultJson.contains("error"))
-                {
-                    g_asyncError = resultJson["error"].get<std::string>();
-                    g_asyncState.store(AsyncState::Failed);
-                    Log("[ASYNC] Request completed with error: " + g_asyncError);
-                }
-                else
-                {
-                    g_asyncState.store(AsyncState::Ready);
-                    Log("[ASYNC] Request completed successfully");
-                }
-            }
-            catch (...)
+            if (g_workersStopping)
             {
-                g_asyncState.store(AsyncState::Ready);
-                Log("[ASYNC] Request completed (response not parsed)");
+                break;
             }
+            request = PopNextRequest();
         }
+
+        PROFILE_ZONE(WorkerRequest);
+        RunAsyncRequest(*request);
     }
-    catch (const std::exception& e)
+
+    Log("[ASYNC] Worker " + std::to_string(workerIndex) + " finished");
+}
+
+/// Start the worker threads once per process
+void StartWorkerPool()
+{
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+    if (!g_workerThreads.empty() || g_workersStopping)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < kWorkerThreadCount; i++)
+    {
+        g_workerThreads.emplace_back(AsyncWorkerThread, i);
+    }
+    g_deadlineThread = std::thread(DeadlineThread);
+    Log("[ASYNC] Worker pool started with " + std::to_string(kWorkerThreadCount) + " threads");
+}
+
+/// Stop and join the worker threads (queued requests are dropped, running ones aborted)
+void StopWorkerPool()
+{
+    std::vector<std::thread> workers;
+    {
+        PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+        g_workersStopping = true;
+        g_asyncQueue.clear();
+        workers.swap(g_workerThreads);
+
+        // Workers return as soon as their HTTP call fails, instead of waiting for the reply
+        for (auto& [id, request] : g_asyncRequests)
+        {
+            request->cancelled.store(true);
+            AbortHttp(request->http);
+        }
+    }
+    g_asyncQueueCondition.notify_all();
+    g_deadlineCondition.notify_all();
+
+    if (g_deadlineThread.joinable())
     {
-        std::lock_guard<std::mutex> lock(g_asyncMutex);
-        g_asyncError = std::string("Exception: ") + e.what();
-        g_asyncState.store(AsyncState::Failed);
-        Log("[ASYNC] Worker thread exception: " + g_asyncError);
+        g_deadlineThread.join();
     }
 
-    Log("[ASYNC] Worker thread finished");
+    for (std::thread& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+/// Look up a request that hasn't been retrieved or cancelled
+/// Note: Caller must hold g_asyncMutex lock
+AsyncRequest* FindRequest(RequestId id)
+{
+    auto it = g_asyncRequests.find(id);
+    return it == g_asyncRequests.end() ? nullptr : it->second.get();
 }
 
 } // anonymous namespace
 
-bool StartAsyncRequest(const std::string& gameStateJson)
+RequestId StartAsyncRequest(const std::string& gameStateJson, RequestPriority priority, bool speculative,
+                            int deadlineSeconds)
 {
     Log("[ASYNC] StartAsyncRequest called");
 
-    // Check current state
-    AsyncState currentState = g_asyncState.load();
-    if (currentState == AsyncState::Pending)
+    // Initialize if needed (also starts the worker pool)
+    if (g_apiKey.empty() && !Initialize())
     {
-        Log("[ASYNC] Request already pending, ignoring new request");
-        return false;
+        Log("[ASYNC] Failed to initialize API");
+        return kNoRequest;
     }
 
-    // Join previous thread if it exists
-    if (g_asyncThread.joinable())
+    auto request = std::make_shared<AsyncRequest>();
+    request->priority = priority;
+    request->speculative = speculative;
+    request->gameStateJson = gameStateJson;
+    request->queuedAt = Clock::now();
+
+    if (deadlineSeconds == kUseDefaultDeadline)
+    {
+        deadlineSeconds = g_requestDeadlineSeconds.load();
+    }
+    if (deadlineSeconds > 0)
     {
-        Log("[ASYNC] Joining previous thread");
-        g_asyncThread.join();
+        request->deadline = request->queuedAt + std::chrono::seconds(deadlineSeconds);
     }
 
-    // Initialize if needed
-    if (g_apiKey.empty())
+    // Written out by the worker so the game thread doesn't wait on the disk
+    request->recorded = IsRecordingGameStates();
+
     {
-        if (!Initialize())
+        PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+        if (g_workersStopping)
         {
-            Log("[ASYNC] Failed to initialize API");
-            std::lock_guard<std::mutex> lock(g_asyncMutex);
-            g_asyncError = "Failed to initialize API";
-            g_asyncState.store(AsyncState::Failed);
-            return false;
+            Log("[ASYNC] Worker pool stopped, ignoring new request");
+            return kNoRequest;
+        }
+        if (g_asyncQueue.size() >= kMaxQueuedRequests)
+        {
+            Log("[ASYNC] Request queue full (" + std::to_string(g_asyncQueue.size()) + "), ignoring new request");
+            return kNoRequest;
         }
+
+        // Speculative requests don't become "latest", so polls without an ID keep following the turn
+        request->id = g_nextRequestId++;
+        if (!speculative)
+        {
+            g_latestRequestId = request->id;
+        }
+        g_asyncRequests[request->id] = request;
+        g_asyncQueue.push_back(request);
+        if (deadlineSeconds > 0)
+        {
+            g_deadlineCondition.notify_one();
+        }
+
+        Log("[ASYNC] Queued " + std::string(speculative ? "speculative " : "") + "request #" +
+            std::to_string(request->id) + " (priority " + std::to_string(static_cast<int>(priority)) + ", " +
+            std::to_string(g_asyncQueue.size()) + " queued)");
     }
+    g_asyncQueueCondition.notify_one();
+
+    return request->id;
+}
 
-    // Reset state
+bool ParseRequestPriority(const std::string& name, RequestPriority& outPriority)
+{
+    if (name == "low")
+    {
+        outPriority = RequestPriority::Low;
+    }
+    else if (name == "normal")
+    {
+        outPriority = RequestPriority::Normal;
+    }
+    else if (name == "high")
+    {
+        outPriority = RequestPriority::High;
+    }
+    else
     {
-        std::lock_guard<std::mutex> lock(g_asyncMutex);
-        g_asyncResponse.clear();
-        g_asyncError.clear();
-        g_asyncCancelled.store(false);
-        g_asyncState.store(AsyncState::Pending);
+        return false;
     }
+    return true;
+}
 
-    // Start worker thread
-    Log("[ASYNC] Starting worker thread");
-    g_asyncThread = std::thread(AsyncWorkerThread, gameStateJson);
+RequestId GetLatestRequestId()
+{
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+    return g_latestRequestId;
+}
 
-    return true;
+AsyncState GetAsyncState(RequestId id)
+{
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+    AsyncRequest* request = FindRequest(id);
+    return request ? request->state : AsyncState::Idle;
+}
+
+namespace
+{
+
+/// Remove actions Lua already received during streaming from the final response
+void StripDispatchedActions(json& responseJson, const std::vector<json>& dispatched)
+{
+    if (!responseJson.is_object() || !responseJson.contains("actions") || !responseJson["actions"].is_array())
+    {
+        Log(LogLevel::Warning, "[STREAM] WARNING: Final response has no actions array, returning it unchanged");
+        return;
+    }
+
+    json& actions = responseJson["actions"];
+    size_t matched = 0;
+    while (matched < dispatched.size() && matched < actions.size() &&
+           actions[matched] == dispatched[matched])
+    {
+        matched++;
+    }
+
+    if (matched < dispatched.size())
+    {
+        Log(LogLevel::Warning, "[STREAM] WARNING: Final response diverged from streamed actions after #" +
+            std::to_string(matched));
+    }
+
+    actions.erase(actions.begin(), actions.begin() + static_cast<std::ptrdiff_t>(matched));
+    responseJson["streamed"] = matched;
 }
 
-AsyncState GetAsyncState()
+} // anonymous namespace
+
+std::string GetAsyncResponse(RequestId id)
 {
-    return g_asyncState.load();
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+
+    AsyncRequest* request = FindRequest(id);
+    if (!request || request->state != AsyncState::Ready)
+    {
+        return "";
+    }
+
+    json response = std::move(request->response);
+    if (!request->dispatchedActions.empty())
+    {
+        StripDispatchedActions(response, request->dispatchedActions);
+    }
+    g_asyncRequests.erase(id);
+
+    Log("[ASYNC] Response for request #" + std::to_string(id) + " retrieved");
+    return response.dump();
 }
 
-std::string GetAsyncResponse()
+std::string TakeStreamedActions(RequestId id)
 {
-    std::lock_guard<std::mutex> lock(g_asyncMutex);
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
 
-    if (g_asyncState.load() != AsyncState::Ready)
+    AsyncRequest* request = FindRequest(id);
+    if (!request || request->state != AsyncState::Pending || request->streamedActions.empty())
     {
         return "";
     }
 
-    std::string response = std::move(g_asyncResponse);
-    g_asyncResponse.clear();
-    g_asyncState.store(AsyncState::Idle);
+    json batch;
+    batch["actions"] = json::array();
+    for (json& action : request->streamedActions)
+    {
+        batch["actions"].push_back(action);
+        request->dispatchedActions.push_back(std::move(action));
+    }
+    request->streamedActions.clear();
 
-    Log("[ASYNC] Response retrieved, state reset to Idle");
-    return response;
+    Log("[STREAM] Handing " + std::to_string(batch["actions"].size()) + " streamed actions of request #" +
+        std::to_string(id) + " to Lua");
+    return batch.dump();
 }
 
-std::string GetAsyncError()
+std::string GetAsyncError(RequestId id)
 {
-    std::lock_guard<std::mutex> lock(g_asyncMutex);
-    return g_asyncError;
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+
+    AsyncRequest* request = FindRequest(id);
+    if (!request)
+    {
+        return "";
+    }
+
+    std::string error = request->error;
+    if (request->state == AsyncState::Failed)
+    {
+        g_asyncRequests.erase(id);
+    }
+    return error;
 }
 
-void CancelAsyncRequest()
+void CancelAsyncRequest(RequestId id)
 {
-    Log("[ASYNC] CancelAsyncRequest called");
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
+
+    auto it = g_asyncRequests.find(id);
+    if (it == g_asyncRequests.end())
+    {
+        return;
+    }
 
-    g_asyncCancelled.store(true);
+    // A running request's HTTP call is aborted; its worker drops the result
+    it->second->cancelled.store(true);
+    AbortHttp(it->second->http);
+    g_asyncQueue.erase(std::remove(g_asyncQueue.begin(), g_asyncQueue.end(), it->second), g_asyncQueue.end());
+    g_asyncRequests.erase(it);
+
+    Log("[ASYNC] Request #" + std::to_string(id) + " cancelled");
+}
+
+void CancelAllAsyncRequests()
+{
+    PROFILE_LOCK_GUARD(lock, g_asyncMutex, AsyncRequests);
 
-    // Wait for thread to finish
-    if (g_asyncThread.joinable())
+    for (auto& [id, request] : g_asyncRequests)
     {
-        Log("[ASYNC] Waiting for thread to finish");
-        g_asyncThread.join();
+        request->cancelled.store(true);
+        AbortHttp(request->http);
     }
 
-    std::lock_guard<std::mutex> lock(g_asyncMutex);
-    g_asyncState.store(AsyncState::Idle);
-    g_asyncResponse.clear();
-    g_asyncError.clear();
+    size_t count = g_asyncRequests.size();
+    g_asyncQueue.clear();
+    g_asyncRequests.clear();
 
-    Log("[ASYNC] Request cancelled and state reset");
+    Log("[ASYNC] Cancelled " + std::to_string(count) + " requests");
 }
 
 } // namespace ClaudeAPI
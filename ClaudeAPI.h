@@ -5,7 +5,9 @@
 // Handles communication with Anthropic's Claude API for game AI decisions
 // ============================================================================
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <json.hpp>
 
@@ -22,27 +24,208 @@ namespace ClaudeAPI
 /// State of an asynchronous API request
 enum class AsyncState
 {
-    Idle,       ///< No request in progress
-    Pending,    ///< Request in progress
+    Idle,       ///< No such request (never started, retrieved or cancelled)
+    Pending,    ///< Queued or in progress
     Ready,      ///< Response ready to retrieve
     Failed      ///< Request failed (can't use Error - Windows macro conflict)
 };
 
+/// Identifies an async request; IDs are never reused within a session
+using RequestId = uint32_t;
+constexpr RequestId kNoRequest = 0;
+
+/// Deadline argument of StartAsyncRequest that uses the "request_deadline" option
+constexpr int kUseDefaultDeadline = -1;
+
+/// Order in which queued requests are picked up by the worker pool
+enum class RequestPriority
+{
+    Low,
+    Normal,     ///< Turn planning
+    High        ///< Time-sensitive replies such as diplomacy
+};
+
+// ============================================================================
+// TOKEN USAGE
+// ============================================================================
+
+/// Token counts from the "usage" object of a Messages API response
+struct TokenUsage
+{
+    uint64_t inputTokens = 0;           ///< Input tokens processed without the prompt cache
+    uint64_t outputTokens = 0;          ///< Generated tokens
+    uint64_t cacheCreationTokens = 0;   ///< Input tokens written to the prompt cache
+    uint64_t cacheReadTokens = 0;       ///< Input tokens served from the prompt cache
+};
+
+/// Usage of the most recent request plus running totals for this session
+struct UsageStats
+{
+    TokenUsage last;
+    TokenUsage total;
+    uint64_t requestCount = 0;  ///< Requests that reported usage
+};
+
+/// Counters of the content-addressed response cache for this session
+struct ResponseCacheStats
+{
+    uint64_t hits = 0;          ///< Requests answered from the cache (memory or disk)
+    uint64_t diskHits = 0;      ///< Hits that were read back from the cache folder
+    uint64_t misses = 0;        ///< Lookups that went to the API
+    uint64_t stores = 0;        ///< Replies added to the cache
+    uint64_t expired = 0;       ///< Entries dropped for being older than the TTL
+};
+
+// ============================================================================
+// REQUEST METRICS
+// ============================================================================
+
+/// Where the time of one request went, in milliseconds (0 when a stage didn't run)
+struct RequestMetrics
+{
+    RequestId id = kNoRequest;
+    uint64_t sequence = 0;              ///< Order the request was finalized in (1-based, 0 until then)
+    int playerID = -1;
+    int turn = -1;
+    bool responseCacheHit = false;      ///< Answered from the response cache (no HTTP stages)
+    bool reusedConnection = true;       ///< HTTP request went out on a pooled connection
+    bool failed = false;
+
+    std::string model;                  ///< Model the request was sent to
+    std::string route;                  ///< model_routing.json route that chose it (empty when routing is off)
+    int maxTokens = 0;                  ///< max_tokens sent with the request
+    int retries = 0;                    ///< Attempts repeated after transient API failures
+
+    double serializeMs = 0;     ///< Lua: building and encoding the game state (reported by Lua)
+    double queueMs = 0;         ///< Waiting for a worker thread
+    double parseMs = 0;         ///< C++: parsing the game state and building the request body
+    double connectMs = 0;       ///< TCP and TLS setup (0 on a reused connection)
+    double firstByteMs = 0;     ///< Request sent until the response headers arrived
+    double downloadMs = 0;      ///< Reading the body (covers generation when streaming)
+    double extractMs = 0;       ///< Extracting and parsing the action JSON from the reply
+    double decodeMs = 0;        ///< Lua: decoding the response (reported by Lua)
+    double executeMs = 0;       ///< Lua: executing the actions (reported by Lua)
+    double totalMs = 0;         ///< Queued until the response was ready
+
+    TokenUsage usage;
+};
+
+/// Session summary returned alongside the latest request
+struct MetricsSummary
+{
+    RequestMetrics last;            ///< Most recently completed request (id is kNoRequest if none)
+    uint64_t requestCount = 0;      ///< Requests completed this session
+    double averageTotalMs = 0;
+    double averageFirstByteMs = 0;
+};
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
 
 /// Initialize the Claude API (loads API key from environment)
+/// @note First successful call pre-warms the HTTPS connection on a background thread
+///       and starts the async worker pool
 /// @return true if initialization succeeded
 [[nodiscard]] bool Initialize();
 
-/// Reset turn tracking (call when starting a new game)
+/// Stop the worker pool and release the persistent HTTP session and connection (call on DLL unload)
+/// @note Leaves the current request recording open; it is complete on disk without being closed
+void Shutdown();
+
+/// Reset turn tracking, conversations and baselines, and close this game's metrics
+/// trace and request recording (called from Lua via ResetClaudeAPIGame on game load)
 void ResetTurnTracking();
 
+/// Set a runtime option (called from Lua via SetClaudeAPIOption)
+/// @param name Option name: "stream" (true/false - stream responses and dispatch actions early),
+///             "delta" (true/false - send changes against a cached keyframe instead of the full state),
+///             "keyframe_interval" (turns between full snapshots in delta mode),
+///             "compact_state" (true/false - send the state as column tables with a type-name
+///             dictionary and rounded decimals; system_prompt.txt's {BEGIN_COMPACT_STATE} section explains it),
+///             "state_token_budget" (estimated tokens per game state, 0 for no limit; larger states lose
+///             distant terrain, then the build menus of busy cities, then unit detail away from enemies,
+///             and list what was dropped in "omittedForSize"),
+///             "model_routing" (true/false - pick the model and max_tokens per request from the rules in
+///             the mod's model_routing.json, matched against signals such as war, settlers and empty
+///             production queues; without the file every request uses the default model),
+///             "validate_actions" (true/false - drop actions whose unit, city, build item, tech or civic
+///             the game state doesn't list, repair near-miss ids and type names, and report the
+///             rejections in the document's "rejected" array and with the player's next request),
+///             "history_tokens" (token budget for earlier turns of the conversation, 0 disables),
+///             "response_cache" (true/false, default false - answer identical game states from earlier replies),
+///             "response_cache_disk" (true/false - also keep replies in the mod's response_cache folder),
+///             "response_cache_ttl" (seconds a cached reply stays valid),
+///             "request_deadline" (seconds after queueing an async request fails and its HTTP call
+///             is aborted, 0 for none),
+///             "retry_attempts" (times a request is sent again after a connection failure, a 429, 5xx
+///             or 529 status, or an overloaded stream; 0 disables, at most 10) and "retry_deadline" (seconds from
+///             the first attempt within which retries may start; retry-after is honored, otherwise
+///             the backoff is jittered exponential),
+///             "api_endpoint" (https://host[:port] to send requests to, with an IPv6 host in brackets;
+///             http:// only to a loopback host, "default" for the Anthropic API; the API key is only
+///             sent to the Anthropic API),
+///             "record_states" (true for the mod's recorded_states folder, the name of another folder
+///             in the mod folder (letters, digits, '-', '_'), or false -
+///             save each async request's game state as a JSON file, e.g. for the benchmark corpus),
+///             "record_requests" (true/false - append every API request body, raw response and timing
+///             to this game's compressed civ6_claude_requests_<date>_<time>.bin),
+///             "record_requests_mb" (size limit of one game's recording; later exchanges are dropped),
+///             "replay_requests" (a recording's path, or false - answer requests from it instead of the network),
+///             "log_level" (debug/info/warning/error - minimum level written to the log)
+/// @param value Option value as a string
+/// @return true if the option was recognized and applied
+bool SetOption(const std::string& name, const std::string& value);
+
+/// Get token usage reported by the API (exposed to Lua via GetClaudeAPIUsage)
+[[nodiscard]] UsageStats GetUsageStats();
+
+/// Get response cache hit/miss counters (exposed to Lua via GetClaudeAPIUsage)
+[[nodiscard]] ResponseCacheStats GetResponseCacheStats();
+
+/// Get the timing breakdown of the latest request (exposed to Lua via GetClaudeAPIMetrics)
+[[nodiscard]] MetricsSummary GetMetricsSummary();
+
+/// Get the requests finalized after the one with the given sequence number, oldest first
+/// @param afterSequence Sequence of the last request already seen (0 for all that are kept)
+/// @note Only the latest kMaxFinishedMetrics (256) requests are kept; poll at least that often
+[[nodiscard]] std::vector<RequestMetrics> GetFinishedMetrics(uint64_t afterSequence);
+
+/// Complete a request's metrics with the stages timed in Lua and write its trace line
+/// @param id Request the timings belong to
+/// @note Each request is written once to civ6_claude_metrics_<date>_<time>.jsonl
+///       (one file per game); requests Lua never reports are written without these stages
+void ReportLuaTimings(RequestId id, double serializeMs, double decodeMs, double executeMs);
+
+/// Report how the actions from Claude's last reply turned out
+/// @param playerID Player the actions were executed for
+/// @param results Condensed results (e.g. "move_unit unit 5: ok; found_city unit 7: failed")
+/// @note Sent to Claude at the start of the player's next request and kept in the conversation history
+void RecordActionResults(int playerID, const std::string& results);
+
+/// Keep or drop the plan of the player's latest speculative request
+/// @param playerID Player the speculative request was made for
+/// @param adopted true if Lua is executing the plan (its exchange joins the
+///        conversation and the action results it reported are consumed)
+/// @note Call once the turn the request planned for has started
+void ResolveSpeculativeRequest(int playerID, bool adopted);
+
+/// Check a response's actions against a game state, as "validate_actions" does for turn requests
+/// @param gameStateJson State the actions are about to run against
+/// @param responseJson Response document from CheckAsyncRequest
+/// @return The document with invalid actions dropped or repaired (rejections are reported in the
+///         player's next request), or responseJson unchanged if either doesn't parse
+/// @note For adopted speculative plans, which were made before this turn's state existed
+[[nodiscard]] std::string ValidateResponseActions(const std::string& gameStateJson, const std::string& responseJson);
+
 /// Test API connection with a simple query
 /// @return true if connection test succeeded
 [[nodiscard]] bool TestConnection();
 
+/// Get the mod folder (with a trailing backslash), or an empty string if Documents can't be found
+/// @note system_prompt.txt, model_routing.json and the recording and cache folders live here
+[[nodiscard]] std::string GetModFolderPath();
+
 // ============================================================================
 // BLOCKING API (Legacy)
 // ============================================================================
@@ -58,24 +241,50 @@ void ResetTurnTracking();
 // ASYNC API (Non-blocking)
 // ============================================================================
 
-/// Start an async request (returns immediately)
+/// Queue an async request for the worker pool (returns immediately)
 /// @param gameStateJson JSON string containing current game state
-/// @return true if request was started, false if one is already pending
-[[nodiscard]] bool StartAsyncRequest(const std::string& gameStateJson);
+/// @param priority Higher priorities are started first; equal priorities run in order
+/// @param speculative Plan the player's next turn from this end-of-turn state. The request skips
+///        the per-turn cache, doesn't stream, and its exchange is held back from the conversation
+///        until ResolveSpeculativeRequest
+/// @param deadlineSeconds Fail the request this long after queueing it (0 for none,
+///        kUseDefaultDeadline for the "request_deadline" option)
+/// @return ID of the queued request, or kNoRequest if the queue is full or the API is unavailable
+[[nodiscard]] RequestId StartAsyncRequest(const std::string& gameStateJson,
+                                          RequestPriority priority = RequestPriority::Normal,
+                                          bool speculative = false,
+                                          int deadlineSeconds = kUseDefaultDeadline);
+
+/// Parse "low", "normal" or "high"
+/// @return true if name was recognized
+[[nodiscard]] bool ParseRequestPriority(const std::string& name, RequestPriority& outPriority);
+
+/// ID of the most recently started request (kNoRequest if none)
+[[nodiscard]] RequestId GetLatestRequestId();
 
 /// Check if a response is ready
-/// @return Current state of the async request
-[[nodiscard]] AsyncState GetAsyncState();
+/// @return Current state of the request (Idle if the ID is unknown)
+[[nodiscard]] AsyncState GetAsyncState(RequestId id);
 
 /// Get the async response (only valid when state is Ready)
-/// @return Response JSON string, resets state to Idle after retrieval
-[[nodiscard]] std::string GetAsyncResponse();
+/// @return Response JSON string; the request is released after retrieval
+/// @note Actions already returned by TakeStreamedActions are removed from the
+///       "actions" array, and a "streamed" count of them is added
+[[nodiscard]] std::string GetAsyncResponse(RequestId id);
+
+/// Take actions that have finished streaming while the request is still Pending
+/// @return {"actions":[...]} JSON string, or empty string if nothing new arrived
+[[nodiscard]] std::string TakeStreamedActions(RequestId id);
 
 /// Get error message (only valid when state is Failed)
-/// @return Error message describing what went wrong
-[[nodiscard]] std::string GetAsyncError();
+/// @return Error message describing what went wrong; the request is released after retrieval
+[[nodiscard]] std::string GetAsyncError(RequestId id);
+
+/// Cancel a queued or running request (its result is discarded)
+/// @note Returns immediately; a running request's HTTP call is aborted, freeing its worker
+void CancelAsyncRequest(RequestId id);
 
-/// Cancel any pending async request
-void CancelAsyncRequest();
+/// Cancel every queued and running request
+void CancelAllAsyncRequests();
 
 } // namespace ClaudeAPI
@@ -0,0 +1,376 @@
+// ============================================================================
+// CompactState.cpp - Compact Columnar Game State Encoding Implementation
+// ============================================================================
+
+#include "CompactState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Log.h"
+#include "StateBudget.h"
+
+namespace CompactState
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    constexpr size_t kMinTableRows = 2;            ///< Shorter arrays of objects are not worth a column header
+    constexpr size_t kMinInternLength = 4;         ///< Shorter type names cost no more than their "@N" id
+    constexpr size_t kMaxDictionaryEntries = 1024; ///< Per player; later names stay inline
+    constexpr double kCompactNumberScale = 10.0;   ///< Decimals are rounded to one place
+}
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+    /// Type names interned for one player
+    struct CompactDictionary
+    {
+        std::unordered_map<std::string, size_t> ids;
+        std::vector<std::string> entries;
+        std::string text;   ///< Dictionary block as sent, extended as entries are added
+    };
+
+    std::mutex g_compactMutex;
+    std::unordered_map<int, CompactDictionary> g_compactDictionaries;   ///< Keyed by player ID
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+namespace
+{
+
+
+/// Type names ("GRASS_HILLS", "WARRIOR"): upper case letters, digits and underscores
+bool IsTypeName(const std::string& value)
+{
+    if (value.size() < kMinInternLength || value[0] < 'A' || value[0] > 'Z')
+    {
+        return false;
+    }
+    for (char c : value)
+    {
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Count how often each type name occurs in a value
+void CountTypeNames(const json& value, std::unordered_map<std::string, size_t>& counts)
+{
+    if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        if (IsTypeName(text))
+        {
+            counts[text]++;
+        }
+    }
+    else if (value.is_structured())
+    {
+        for (const json& child : value)
+        {
+            CountTypeNames(child, counts);
+        }
+    }
+}
+
+/// An object whose fields are all scalars, which a table spreads over "field.sub" columns
+bool IsFlatObject(const json& value)
+{
+    if (!value.is_object() || value.empty())
+    {
+        return false;
+    }
+    for (const json& child : value)
+    {
+        if (child.is_structured())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// The {"added","updated","removed"} object StateDelta::Diff writes for a keyed array
+bool IsKeyedArrayDiff(const json& value)
+{
+    if (!value.is_object() || value.empty())
+    {
+        return false;
+    }
+    for (auto it = value.begin(); it != value.end(); ++it)
+    {
+        if ((it.key() != "added" && it.key() != "updated" && it.key() != "removed") || !it.value().is_array())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Rewrites one value against a player's dictionary
+/// @note Caller must hold g_compactMutex for the encoder's lifetime
+class CompactEncoder
+{
+public:
+    /// @param delta source is a StateDelta::Diff result, whose "updated" lists are never tables
+    CompactEncoder(CompactDictionary& dictionary, const json& source, bool delta)
+        : m_dictionary(dictionary)
+        , m_delta(delta)
+    {
+        CountTypeNames(source, m_counts);
+    }
+
+    json Encode(const json& value)
+    {
+        if (value.is_string())
+        {
+            return EncodeString(value.get_ref<const std::string&>());
+        }
+        if (value.is_number_float())
+        {
+            double rounded = std::round(value.get<double>() * kCompactNumberScale) / kCompactNumberScale;
+            if (rounded == std::floor(rounded) && std::abs(rounded) < 1e15)
+            {
+                return static_cast<int64_t>(rounded);
+            }
+            return rounded;
+        }
+        if (value.is_object())
+        {
+            // Updated entries list changed fields only, so a table's null would read as a removal
+            bool keyedDiff = m_delta && IsKeyedArrayDiff(value);
+            json out = json::object();
+            for (auto it = value.begin(); it != value.end(); ++it)
+            {
+                out[it.key()] = keyedDiff && it.key() == "updated" ? EncodeElements(it.value()) : Encode(it.value());
+            }
+            return out;
+        }
+        if (value.is_array())
+        {
+            return IsTable(value) ? EncodeTable(value) : EncodeElements(value);
+        }
+        return value;
+    }
+
+    size_t AddedEntries() const { return m_added; }
+
+private:
+    /// An array of objects long enough to send as a table
+    static bool IsTable(const json& array)
+    {
+        if (array.size() < kMinTableRows)
+        {
+            return false;
+        }
+        for (const json& element : array)
+        {
+            if (!element.is_object())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Encode each element of an array on its own
+    json EncodeElements(const json& array)
+    {
+        json out = json::array();
+        for (const json& element : array)
+        {
+            out.push_back(Encode(element));
+        }
+        return out;
+    }
+
+    /// Replace a type name with its dictionary id, adding it when it repeats in this value
+    json EncodeString(const std::string& text)
+    {
+        auto known = m_dictionary.ids.find(text);
+        if (known != m_dictionary.ids.end())
+        {
+            return "@" + std::to_string(known->second);
+        }
+
+        auto count = m_counts.find(text);
+        if (count == m_counts.end() || count->second < 2 ||
+            m_dictionary.entries.size() >= kMaxDictionaryEntries)
+        {
+            return text;
+        }
+
+        size_t id = m_dictionary.entries.size();
+        m_dictionary.ids.emplace(text, id);
+        m_dictionary.entries.push_back(text);
+        m_dictionary.text += "@" + std::to_string(id) + " " + text + "\n";
+        m_added++;
+        return "@" + std::to_string(id);
+    }
+
+    /// {"cols": [...], "rows": [[...], ...]}, with flat object fields spread over "field.sub" columns
+    json EncodeTable(const json& array)
+    {
+        struct Column
+        {
+            std::string key;
+            std::vector<std::string> subkeys;   ///< Non-empty when the field is spread out
+            bool flat = true;
+        };
+
+        std::vector<Column> columns;
+        std::unordered_map<std::string, size_t> columnIndex;
+        for (const json& element : array)
+        {
+            for (auto it = element.begin(); it != element.end(); ++it)
+            {
+                auto [found, inserted] = columnIndex.emplace(it.key(), columns.size());
+                if (inserted)
+                {
+                    columns.push_back({it.key()});
+                }
+                Column& column = columns[found->second];
+
+                // null means "absent" and doesn't decide whether the field can be spread
+                if (it.value().is_null())
+                {
+                    continue;
+                }
+                if (!IsFlatObject(it.value()))
+                {
+                    column.flat = false;
+                    continue;
+                }
+                for (auto sub = it.value().begin(); sub != it.value().end(); ++sub)
+                {
+                    if (std::find(column.subkeys.begin(), column.subkeys.end(), sub.key()) == column.subkeys.end())
+                    {
+                        column.subkeys.push_back(sub.key());
+                    }
+                }
+            }
+        }
+
+        json names = json::array();
+        for (Column& column : columns)
+        {
+            if (!column.flat || column.subkeys.empty())
+            {
+                column.flat = false;
+                names.push_back(column.key);
+                continue;
+            }
+            for (const std::string& sub : column.subkeys)
+            {
+                names.push_back(column.key + "." + sub);
+            }
+        }
+
+        json rows = json::array();
+        for (const json& element : array)
+        {
+            json row = json::array();
+            for (const Column& column : columns)
+            {
+                auto field = element.find(column.key);
+                bool present = field != element.end() && !field->is_null();
+                if (!column.flat)
+                {
+                    row.push_back(present ? Encode(*field) : json());
+                    continue;
+                }
+                for (const std::string& sub : column.subkeys)
+                {
+                    auto value = present ? field->find(sub) : field;
+                    row.push_back(present && value != field->end() ? Encode(*value) : json());
+                }
+            }
+            rows.push_back(std::move(row));
+        }
+
+        return {{"cols", std::move(names)}, {"rows", std::move(rows)}};
+    }
+
+    CompactDictionary& m_dictionary;
+    bool m_delta;
+    std::unordered_map<std::string, size_t> m_counts;
+    size_t m_added = 0;
+};
+
+/// Compact-encode a value for a player, interning type names in the player's dictionary
+std::string EncodeForPlayer(int playerID, const json& value, bool delta, std::string& outDictionary)
+{
+    std::lock_guard<std::mutex> lock(g_compactMutex);
+    CompactDictionary& dictionary = g_compactDictionaries[playerID];
+
+    CompactEncoder encoder(dictionary, value, delta);
+    std::string text = encoder.Encode(value).dump();
+    if (encoder.AddedEntries() > 0)
+    {
+        LOG_DEBUG("[COMPACT] Player " + std::to_string(playerID) + " dictionary +" +
+            std::to_string(encoder.AddedEntries()) + " (" + std::to_string(dictionary.entries.size()) + " entries)");
+    }
+
+    outDictionary = dictionary.text.empty() ? std::string() : "Type dictionary:\n" + dictionary.text;
+    return text;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+std::string EncodeState(int playerID, const json& state, std::string& outDictionary)
+{
+    return EncodeForPlayer(playerID, state, false, outDictionary);
+}
+
+std::string EncodeDelta(int playerID, const json& changes, std::string& outDictionary)
+{
+    return EncodeForPlayer(playerID, changes, true, outDictionary);
+}
+
+void Reset()
+{
+    std::lock_guard<std::mutex> lock(g_compactMutex);
+    g_compactDictionaries.clear();
+}
+
+void LogSavings(int playerID, int turn, const char* what, size_t verboseBytes,
+                size_t compactBytes, size_t dictionaryBytes)
+{
+    size_t sentBytes = compactBytes + dictionaryBytes;
+    long long savedPercent = verboseBytes > 0
+        ? 100 - static_cast<long long>(sentBytes * 100 / verboseBytes)
+        : 0;
+    Log("[COMPACT] Player " + std::to_string(playerID) + " turn " + std::to_string(turn) + " " + what +
+        ": verbose " + std::to_string(verboseBytes) + " bytes (~" +
+        std::to_string(verboseBytes / StateBudget::kBytesPerToken) + " tokens), compact " +
+        std::to_string(compactBytes) + " + " + std::to_string(dictionaryBytes) + " byte dictionary (~" +
+        std::to_string(sentBytes / StateBudget::kBytesPerToken) + " tokens), " +
+        std::to_string(savedPercent) + "% smaller");
+}
+
+} // namespace CompactState
@@ -0,0 +1,38 @@
+#pragma once
+
+// ============================================================================
+// CompactState.h - Compact Columnar Game State Encoding
+// Sends arrays of objects as column tables, replaces repeated type names with
+// ids from a per-player dictionary and rounds decimals to one place
+// ============================================================================
+
+#include <cstddef>
+#include <string>
+
+#include <json.hpp>
+
+namespace CompactState
+{
+
+/// Compact-encode a full game state for a player, interning type names in the player's dictionary
+/// @param outDictionary Receives the player's dictionary block after encoding (empty while it has no entries)
+/// @note A table row has null where its object has no such field
+/// @note Dictionary entries are only appended, so an id names the same type in
+///       every state, baseline and delta sent to the player
+[[nodiscard]] std::string EncodeState(int playerID, const nlohmann::json& state, std::string& outDictionary);
+
+/// Compact-encode changes from StateDelta::Diff for a player
+/// @param outDictionary Receives the player's dictionary block after encoding
+/// @note "updated" lists stay lists of objects: in a delta null marks a removed
+///       field, and a table would also write null for every field left unchanged
+[[nodiscard]] std::string EncodeDelta(int playerID, const nlohmann::json& changes, std::string& outDictionary);
+
+/// Forget every player's dictionary (a new game starts with an empty one)
+void Reset();
+
+/// Log how much smaller the compact encoding is than the verbose JSON
+/// @param what What was encoded ("state", "delta" or "keyframe")
+void LogSavings(int playerID, int turn, const char* what, size_t verboseBytes,
+                size_t compactBytes, size_t dictionaryBytes);
+
+} // namespace CompactState
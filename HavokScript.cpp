@@ -41,6 +41,11 @@ namespace hks {
 	hksi_lua_settableType settable;
 	hksi_lua_pushstringType pushstring;
 	hksi_lua_pushlstringType pushlstring;
+	hksi_lua_typeType type;
+	hksi_lua_nextType next;
+	hksi_lua_tolstringType tolstring;
+	hksi_lua_pushnilType pushnil;
+	hksi_lua_concatType concat;
 
 	namespace {
 		static void InitHavokScriptImports(HMODULE hksDll) {
@@ -76,6 +81,11 @@ namespace hks {
 			isuserdata = (hksi_lua_isuserdataType)GetProcAddress(hksDll, "?hksi_lua_isuserdata@@YAHPEAUlua_State@@H@Z");
 			pushstring = (hksi_lua_pushstringType)GetProcAddress(hksDll, "?hksi_lua_pushstring@@YAXPEAUlua_State@@PEBD@Z");
 			pushlstring = (hksi_lua_pushlstringType)GetProcAddress(hksDll, "?hksi_lua_pushlstring@@YAXPEAUlua_State@@PEBD_K@Z");
+			type = (hksi_lua_typeType)GetProcAddress(hksDll, "?hksi_lua_type@@YAHPEAUlua_State@@H@Z");
+			next = (hksi_lua_nextType)GetProcAddress(hksDll, "?hksi_lua_next@@YAHPEAUlua_State@@H@Z");
+			tolstring = (hksi_lua_tolstringType)GetProcAddress(hksDll, "?hksi_lua_tolstring@@YAPEBDPEAUlua_State@@HPEA_K@Z");
+			pushnil = (hksi_lua_pushnilType)GetProcAddress(hksDll, "?hksi_lua_pushnil@@YAXPEAUlua_State@@@Z");
+			concat = (hksi_lua_concatType)GetProcAddress(hksDll, "?hksi_lua_concat@@YAXPEAUlua_State@@H@Z");
 		}
 	}
 
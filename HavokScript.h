@@ -76,7 +76,7 @@ namespace hks {
 	extern hksi_lua_settableType settable;
 	typedef int(__cdecl* hksi_lua_isnumberType)(hks::lua_State*, int);
 	extern hksi_lua_isnumberType isnumber;
-	typedef int(__cdecl* hksi_lua_tonumberType)(hks::lua_State*, int);
+	typedef double(__cdecl* hksi_lua_tonumberType)(hks::lua_State*, int);
 	extern hksi_lua_tonumberType tonumber;
 	typedef int(__cdecl* hksi_lua_isuserdataType)(hks::lua_State*, int);
 	extern hksi_lua_isuserdataType isuserdata;
@@ -84,6 +84,25 @@ namespace hks {
 	extern hksi_lua_pushstringType pushstring;
 	typedef void(__cdecl* hksi_lua_pushlstringType)(hks::lua_State*, const char*, size_t);
 	extern hksi_lua_pushlstringType pushlstring;
+	typedef int(__cdecl* hksi_lua_typeType)(hks::lua_State*, int);
+	extern hksi_lua_typeType type;
+	typedef int(__cdecl* hksi_lua_nextType)(hks::lua_State*, int);
+	extern hksi_lua_nextType next;
+	typedef const char*(__cdecl* hksi_lua_tolstringType)(hks::lua_State*, int, size_t*);
+	extern hksi_lua_tolstringType tolstring;
+	typedef void(__cdecl* hksi_lua_pushnilType)(hks::lua_State*);
+	extern hksi_lua_pushnilType pushnil;
+	typedef void(__cdecl* hksi_lua_concatType)(hks::lua_State*, int);
+	extern hksi_lua_concatType concat;
+
+	// Value type tags returned by hks::type (HavokScript numbering)
+	constexpr int TNONE = -1;
+	constexpr int TNIL = 0;
+	constexpr int TBOOLEAN = 1;
+	constexpr int TLIGHTUSERDATA = 2;
+	constexpr int TNUMBER = 3;
+	constexpr int TSTRING = 4;
+	constexpr int TTABLE = 5;
 
 	extern int checkplayerid(lua_State*, int);
 	extern void pushboolean(lua_State* L, bool value);
@@ -4,11 +4,20 @@
 
 #include "HavokScriptIntegration.h"
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 
 #include "ClaudeAPI.h"
 #include "Log.h"
+#include "LuaJson.h"
+#include "PlotIndex.h"
+#include "Profiler.h"
+#include "UICommandQueue.h"
 #include "MinHook.h"
 
 // ============================================================================
@@ -21,6 +30,12 @@ namespace
     constexpr int kRetryDelayMs = 100;
     constexpr size_t kJsonPreviewLength = 512;
     constexpr size_t kLongResponseThreshold = 400;
+
+    /// Bytes per GetClaudeResponseChunk call (kept under the push limit)
+    constexpr size_t kResponseChunkSize = kLongResponseThreshold;
+
+    /// Slots in the lock-free registered-state cache (must be a power of two)
+    constexpr size_t kRegisteredStateCacheSize = 64;
 }
 
 // ============================================================================
@@ -47,8 +62,33 @@ namespace
     /// Mutex protecting g_registeredStates access from multiple threads
     std::mutex g_registeredStatesMutex;
 
+    /// Lock-free open-addressed cache of registered states, checked before the mutex.
+    /// Slots are only written while holding g_registeredStatesMutex and never cleared
+    /// while the hook is live, so readers can probe without locking.
+    std::array<std::atomic<hks::lua_State*>, kRegisteredStateCacheSize> g_registeredStateCache{};
+
+    /// Most recent registered state seen on this thread (UI and gameplay each stick to one)
+    thread_local hks::lua_State* t_lastRegisteredState = nullptr;
+
+    /// Pcalls that took the mutex and searched the set. Fast-path hits run on every
+    /// pcall of every state, so they are only counted in Profile builds (PcallFastPath)
+    std::atomic<uint64_t> g_pcallSlowPathCount{0};
+
     /// Track if Claude API has been initialized
     bool g_claudeAPIInitialized = false;
+
+    /// Reusable output buffer for native JSON encoding (keeps its capacity between turns)
+    std::mutex g_encodeBufferMutex;
+    std::string g_encodeBuffer;
+
+    /// Game states being assembled by AppendGameStateSection, keyed by player ID
+    /// (each an open JSON object until StartClaudeAPIRequest closes and sends it)
+    std::mutex g_gameStateSectionsMutex;
+    std::unordered_map<int, std::string> g_gameStateSections;
+
+    /// Long response waiting to be read through GetClaudeResponseChunk
+    std::mutex g_chunkedResponseMutex;
+    std::string g_chunkedResponse;
 }
 
 // ============================================================================
@@ -61,7 +101,10 @@ namespace
     void PushStringToLua(hks::lua_State* L, const char* str);
     void PushStringToLua(hks::lua_State* L, const std::string& str);
     void LogMinHookError(MH_STATUS status);
-    std::string EscapeForLua(const std::string& str);
+    void PushBooleanToLua(hks::lua_State* L, bool value);
+    int PushResponseToLua(hks::lua_State* L, const std::string& status, std::string response);
+    bool IsStateRegisteredFast(hks::lua_State* L);
+    void CacheRegisteredState(hks::lua_State* L);
 }
 
 // ============================================================================
@@ -70,27 +113,114 @@ namespace
 
 namespace
 {
-    /// Hooked lua_pcall function - captures Lua states and registers functions
-    int __cdecl HookedPcall(hks::lua_State* L, int nargs, int nresults, int errfunc)
+    /// Get the first cache slot to probe for a state pointer
+    size_t RegisteredStateCacheSlot(hks::lua_State* L)
+    {
+        // Lua states are heap allocated, so the low bits carry no information
+        uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(L) >> 4);
+        hash *= 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash >> 32) & (kRegisteredStateCacheSize - 1);
+    }
+
+    /// Check whether a state is already registered without taking the mutex
+    bool IsStateRegisteredFast(hks::lua_State* L)
+    {
+        if (t_lastRegisteredState == L)
+        {
+            return true;
+        }
+
+        size_t slot = RegisteredStateCacheSlot(L);
+        for (size_t probe = 0; probe < kRegisteredStateCacheSize; probe++)
+        {
+            hks::lua_State* cached = g_registeredStateCache[slot].load(std::memory_order_acquire);
+            if (cached == L)
+            {
+                t_lastRegisteredState = L;
+                return true;
+            }
+            if (cached == nullptr)
+            {
+                return false;
+            }
+            slot = (slot + 1) & (kRegisteredStateCacheSize - 1);
+        }
+
+        return false;
+    }
+
+    /// Publish a registered state to the lock-free cache
+    /// Note: Caller must hold g_registeredStatesMutex lock
+    void CacheRegisteredState(hks::lua_State* L)
     {
-        // Capture first state for DoString (atomic compare-exchange)
-        hks::lua_State* expected = nullptr;
-        if (L && g_luaState.compare_exchange_strong(expected, L))
+        t_lastRegisteredState = L;
+
+        size_t slot = RegisteredStateCacheSlot(L);
+        for (size_t probe = 0; probe < kRegisteredStateCacheSize; probe++)
         {
-            Log("========================================");
-            Log("*** LUA STATE CAPTURED via Pcall ***");
-            LogHex("Lua State Address", L);
-            Log("========================================");
+            hks::lua_State* cached = g_registeredStateCache[slot].load(std::memory_order_relaxed);
+            if (cached == L)
+            {
+                return;
+            }
+            if (cached == nullptr)
+            {
+                g_registeredStateCache[slot].store(L, std::memory_order_release);
+                return;
+            }
+            slot = (slot + 1) & (kRegisteredStateCacheSize - 1);
         }
 
-        // Register our function in EVERY Lua state we encounter
-        // This ensures both UI and Gameplay states have access
-        if (L && !g_shutdownRequested.load())
+        // Table full - this state keeps using the slow path, which is still correct
+        Log(LogLevel::Warning, "[WARNING] Registered state cache full, state will use locked lookup");
+    }
+
+    /// Hooked lua_pcall function - captures Lua states and registers functions
+    int __cdecl HookedPcall(hks::lua_State* L, int nargs, int nresults, int errfunc)
+    {
+        // The hook's own overhead, excluding the original pcall
         {
-            std::lock_guard<std::mutex> lock(g_registeredStatesMutex);
-            if (g_registeredStates.find(L) == g_registeredStates.end())
+            PROFILE_ZONE(PcallHook);
+
+            // Capture first state for DoString (plain load first so the common case stays read-only)
+            hks::lua_State* expected = nullptr;
+            if (L && g_luaState.load(std::memory_order_relaxed) == nullptr &&
+                g_luaState.compare_exchange_strong(expected, L))
+            {
+                Log("========================================");
+                Log("*** LUA STATE CAPTURED via Pcall ***");
+                LogHex("Lua State Address", L);
+                Log("========================================");
+
+                // Wake LuaStateWaitThread in dllmain.cpp
+                if (g_luaStateCapturedEvent)
+                {
+                    SetEvent(g_luaStateCapturedEvent);
+                }
+            }
+
+            // Register our function in EVERY Lua state we encounter
+            // This ensures both UI and Gameplay states have access
+            if (L && !g_shutdownRequested.load())
             {
-                RegisterFunctionInState(L);
+                if (IsStateRegisteredFast(L))
+                {
+                    PROFILE_COUNT(PcallFastPath, 1);
+                }
+                else
+                {
+                    g_pcallSlowPathCount.fetch_add(1, std::memory_order_relaxed);
+
+                    PROFILE_LOCK_GUARD(lock, g_registeredStatesMutex, RegisteredStates);
+                    if (g_registeredStates.find(L) == g_registeredStates.end())
+                    {
+                        RegisterFunctionInState(L);
+                    }
+                    if (g_registeredStates.find(L) != g_registeredStates.end())
+                    {
+                        CacheRegisteredState(L);
+                    }
+                }
             }
         }
 
@@ -108,6 +238,9 @@ namespace
     /// Push a C string to Lua (with fallback methods)
     void PushStringToLua(hks::lua_State* L, const char* str)
     {
+        PROFILE_ZONE(PushString);
+        PROFILE_COUNT(LuaBytesPushed, str ? std::strlen(str) : 0);
+
         if (hks::pushstring)
         {
             hks::pushstring(L, str);
@@ -118,73 +251,79 @@ namespace
         }
         else
         {
-            Log("[ERROR] No string push function available!");
+            Log(LogLevel::Error, "[ERROR] No string push function available!");
         }
     }
 
     /// Push a std::string to Lua with explicit length (safer for long strings)
     void PushStringToLua(hks::lua_State* L, const std::string& str)
     {
-        Log("[DEBUG] PushStringToLua called with string length: " + std::to_string(str.length()));
-        Log("[DEBUG] pushlstring=" + std::to_string(reinterpret_cast<uintptr_t>(hks::pushlstring)) +
+        PROFILE_ZONE(PushString);
+        PROFILE_COUNT(LuaBytesPushed, str.length());
+
+        LOG_DEBUG("[DEBUG] PushStringToLua called with string length: " + std::to_string(str.length()));
+        LOG_DEBUG("[DEBUG] pushlstring=" + std::to_string(reinterpret_cast<uintptr_t>(hks::pushlstring)) +
             " pushstring=" + std::to_string(reinterpret_cast<uintptr_t>(hks::pushstring)));
 
         if (hks::pushlstring)
         {
-            Log("[DEBUG] Using pushlstring with length " + std::to_string(str.length()));
+            LOG_DEBUG("[DEBUG] Using pushlstring with length " + std::to_string(str.length()));
             hks::pushlstring(L, str.c_str(), str.length());
         }
         else if (hks::pushstring)
         {
-            Log("[DEBUG] Falling back to pushstring (pushlstring not available)");
+            LOG_DEBUG("[DEBUG] Falling back to pushstring (pushlstring not available)");
             hks::pushstring(L, str.c_str());
         }
         else if (hks::pushfstring)
         {
-            Log("[DEBUG] Falling back to pushfstring");
+            LOG_DEBUG("[DEBUG] Falling back to pushfstring");
             hks::pushfstring(L, "%s", str.c_str());
         }
         else
         {
-            Log("[ERROR] No string push function available!");
+            Log(LogLevel::Error, "[ERROR] No string push function available!");
         }
     }
 
-    /// Escape a string for use in Lua string literal
-    std::string EscapeForLua(const std::string& str)
+    /// Push a boolean, falling back to 0/1 if pushboolean is unavailable
+    void PushBooleanToLua(hks::lua_State* L, bool value)
     {
-        std::string escaped = str;
-
-        // Escape backslashes first, then quotes
-        size_t pos = 0;
-        while ((pos = escaped.find('\\', pos)) != std::string::npos)
+        if (hks::pushboolean != nullptr)
         {
-            escaped.replace(pos, 1, "\\\\");
-            pos += 2;
+            hks::pushboolean(L, value ? 1 : 0);
         }
-
-        pos = 0;
-        while ((pos = escaped.find('"', pos)) != std::string::npos)
+        else if (hks::pushinteger != nullptr)
         {
-            escaped.replace(pos, 1, "\\\"");
-            pos += 2;
+            hks::pushinteger(L, value ? 1 : 0);
         }
+    }
 
-        pos = 0;
-        while ((pos = escaped.find('\n', pos)) != std::string::npos)
+    /// Push a status and response string, handing long responses over in chunks
+    /// @param status Status for Lua ("ready", "partial"); "_chunked" is appended for chunked responses
+    /// @return Number of values pushed (status plus response or chunk count)
+    int PushResponseToLua(hks::lua_State* L, const std::string& status, std::string response)
+    {
+        // WORKAROUND: long strings don't survive the push to Lua, so hand out a
+        // chunk count and let Lua pull the text with GetClaudeResponseChunk(i)
+        if (response.length() > kLongResponseThreshold && hks::pushinteger)
         {
-            escaped.replace(pos, 1, "\\n");
-            pos += 2;
-        }
+            size_t chunkCount = (response.length() + kResponseChunkSize - 1) / kResponseChunkSize;
+            Log("[ASYNC LUA] Handing off long response in " + std::to_string(chunkCount) + " chunks");
 
-        pos = 0;
-        while ((pos = escaped.find('\r', pos)) != std::string::npos)
-        {
-            escaped.replace(pos, 1, "\\r");
-            pos += 2;
+            {
+                std::lock_guard<std::mutex> lock(g_chunkedResponseMutex);
+                g_chunkedResponse = std::move(response);
+            }
+
+            PushStringToLua(L, status + "_chunked");
+            hks::pushinteger(L, static_cast<int>(chunkCount));
+            return 2;
         }
 
-        return escaped;
+        PushStringToLua(L, status);
+        PushStringToLua(L, response);
+        return 2;
     }
 }
 
@@ -218,7 +357,7 @@ namespace
             }
             else
             {
-                Log("[WARNING] Claude API initialization failed");
+                Log(LogLevel::Warning, "[WARNING] Claude API initialization failed");
             }
             g_claudeAPIInitialized = true;
         }
@@ -237,6 +376,89 @@ namespace
         hks::pushnamedcclosure(L, lua_CancelClaudeAPIRequest, 0, "CancelClaudeAPIRequest", 0);
         hks::setfield(L, hks::LUA_GLOBAL, "CancelClaudeAPIRequest");
 
+        // Only expose the native encoder when its hks imports resolved, so Lua can
+        // use "EncodeJSON ~= nil" to choose between it and TableToJSON
+        if (LuaJson::IsEncoderAvailable())
+        {
+            hks::pushnamedcclosure(L, lua_EncodeJSON, 0, "EncodeJSON", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "EncodeJSON");
+
+            hks::pushnamedcclosure(L, lua_AppendGameStateSection, 0, "AppendGameStateSection", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "AppendGameStateSection");
+
+            hks::pushnamedcclosure(L, lua_DiscardGameStateSections, 0, "DiscardGameStateSections", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "DiscardGameStateSections");
+        }
+
+        if (LuaJson::IsDecoderAvailable())
+        {
+            hks::pushnamedcclosure(L, lua_DecodeClaudeActions, 0, "DecodeClaudeActions", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "DecodeClaudeActions");
+        }
+
+        // Same availability rule as the JSON functions: Lua falls back when they're nil
+        if (PlotIndex::IsAvailable())
+        {
+            hks::pushnamedcclosure(L, lua_GetPlotsInRange, 0, "GetPlotsInRange", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "GetPlotsInRange");
+
+            hks::pushnamedcclosure(L, lua_GetChangedPlots, 0, "GetChangedPlots", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "GetChangedPlots");
+        }
+
+        // Both contexts get all of them; each side only uses its own direction, and
+        // the queue serializes any second caller of a side
+        if (UICommandQueue::IsAvailable())
+        {
+            hks::pushnamedcclosure(L, lua_PushUICommand, 0, "PushUICommand", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "PushUICommand");
+
+            hks::pushnamedcclosure(L, lua_DrainUICommands, 0, "DrainUICommands", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "DrainUICommands");
+
+            hks::pushnamedcclosure(L, lua_PushUICommandResult, 0, "PushUICommandResult", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "PushUICommandResult");
+
+            hks::pushnamedcclosure(L, lua_DrainUICommandResults, 0, "DrainUICommandResults", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "DrainUICommandResults");
+
+            hks::pushnamedcclosure(L, lua_ClearUICommands, 0, "ClearUICommands", 0);
+            hks::setfield(L, hks::LUA_GLOBAL, "ClearUICommands");
+        }
+
+        hks::pushnamedcclosure(L, lua_RecordClaudeActionResults, 0, "RecordClaudeActionResults", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "RecordClaudeActionResults");
+
+        hks::pushnamedcclosure(L, lua_ResetClaudeAPIGame, 0, "ResetClaudeAPIGame", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "ResetClaudeAPIGame");
+
+        hks::pushnamedcclosure(L, lua_ResolveClaudeSpeculativeRequest, 0, "ResolveClaudeSpeculativeRequest", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "ResolveClaudeSpeculativeRequest");
+
+        hks::pushnamedcclosure(L, lua_ValidateClaudeActions, 0, "ValidateClaudeActions", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "ValidateClaudeActions");
+
+        hks::pushnamedcclosure(L, lua_GetClaudeResponseChunk, 0, "GetClaudeResponseChunk", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "GetClaudeResponseChunk");
+
+        hks::pushnamedcclosure(L, lua_SetClaudeAPIOption, 0, "SetClaudeAPIOption", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "SetClaudeAPIOption");
+
+        hks::pushnamedcclosure(L, lua_GetClaudeAPIUsage, 0, "GetClaudeAPIUsage", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "GetClaudeAPIUsage");
+
+        hks::pushnamedcclosure(L, lua_GetClaudeAPIMetrics, 0, "GetClaudeAPIMetrics", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "GetClaudeAPIMetrics");
+
+        hks::pushnamedcclosure(L, lua_ReportClaudeRequestTimings, 0, "ReportClaudeRequestTimings", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "ReportClaudeRequestTimings");
+
+#ifdef CLAUDEMOD_PROFILE
+        // Profile builds only, so Lua can use "ProfileClaudeFrame ~= nil" to hook frames
+        hks::pushnamedcclosure(L, lua_ProfileClaudeFrame, 0, "ProfileClaudeFrame", 0);
+        hks::setfield(L, hks::LUA_GLOBAL, "ProfileClaudeFrame");
+#endif
+
         // Track that we've registered in this state
         g_registeredStates.insert(L);
 
@@ -246,8 +468,35 @@ namespace
         Log("  - StartClaudeAPIRequest (async, non-blocking)");
         Log("  - CheckClaudeAPIResponse (async, poll for result)");
         Log("  - CancelClaudeAPIRequest (async, cancel pending)");
+        Log("  - GetClaudeResponseChunk (async, read long responses)");
+        Log("  - RecordClaudeActionResults (conversation, report action results)");
+        Log("  - ResetClaudeAPIGame (new game, reset per-game state)");
+        Log("  - ResolveClaudeSpeculativeRequest (prefetch, keep or drop a provisional plan)");
+        Log("  - ValidateClaudeActions (prefetch, check an adopted plan against this turn)");
+        Log(std::string("  - EncodeJSON (native table encoder) ") +
+            (LuaJson::IsEncoderAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - AppendGameStateSection / DiscardGameStateSections (incremental game state) ") +
+            (LuaJson::IsEncoderAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - DecodeClaudeActions (native response decoder) ") +
+            (LuaJson::IsDecoderAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - GetPlotsInRange / GetChangedPlots (native terrain index) ") +
+            (PlotIndex::IsAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - PushUICommand / DrainUICommands (gameplay -> UI command queue) ") +
+            (UICommandQueue::IsAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - PushUICommandResult / DrainUICommandResults (UI -> gameplay results) ") +
+            (UICommandQueue::IsAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log(std::string("  - ClearUICommands (discard queued UI commands) ") +
+            (UICommandQueue::IsAvailable() ? "" : "[NOT AVAILABLE - hks imports missing]"));
+        Log("  - SetClaudeAPIOption (configure DLL options)");
+        Log("  - GetClaudeAPIUsage (token and prompt cache usage)");
+        Log("  - GetClaudeAPIMetrics (per-request latency breakdown)");
+        Log("  - ReportClaudeRequestTimings (metrics, report Lua-side stage times)");
+#ifdef CLAUDEMOD_PROFILE
+        Log("  - ProfileClaudeFrame (Profile build, mark a rendered frame)");
+#endif
         LogHex("State Address", L);
         Log("Total states registered: " + std::to_string(g_registeredStates.size()));
+        Log("Pcall hook slow paths so far: " + std::to_string(g_pcallSlowPathCount.load()));
         Log("========================================");
     }
 }
@@ -271,7 +520,7 @@ void InitializeHavokScriptIntegration()
     }
     else
     {
-        Log("[ERROR] Failed to load HavokScript::pcall.");
+        Log(LogLevel::Error, "[ERROR] Failed to load HavokScript::pcall.");
         return;
     }
 
@@ -285,16 +534,27 @@ void InitializeHavokScriptIntegration()
     }
     else
     {
-        Log("[ERROR] Failed to load HavokScript::dostring - ExecuteLuaCode won't work!");
+        Log(LogLevel::Error, "[ERROR] Failed to load HavokScript::dostring - ExecuteLuaCode won't work!");
     }
 
     // Log other important functions
-    Log(hks::getfield ? "[OK] getfield loaded" : "[ERROR] getfield NOT loaded");
-    Log(hks::setfield ? "[OK] setfield loaded" : "[ERROR] setfield NOT loaded");
-    Log(hks::pushinteger ? "[OK] pushinteger loaded" : "[ERROR] pushinteger NOT loaded");
-    Log(hks::pushnamedcclosure ? "[OK] pushnamedcclosure loaded" : "[ERROR] pushnamedcclosure NOT loaded");
-    Log(hks::gettop ? "[OK] gettop loaded" : "[ERROR] gettop NOT loaded");
-    Log(hks::checklstring ? "[OK] checklstring loaded" : "[ERROR] checklstring NOT loaded");
+    const auto logLoaded = [](const std::string& name, bool loaded)
+    {
+        if (loaded)
+        {
+            Log("[OK] " + name + " loaded");
+        }
+        else
+        {
+            Log(LogLevel::Error, "[ERROR] " + name + " NOT loaded");
+        }
+    };
+    logLoaded("getfield", hks::getfield != nullptr);
+    logLoaded("setfield", hks::setfield != nullptr);
+    logLoaded("pushinteger", hks::pushinteger != nullptr);
+    logLoaded("pushnamedcclosure", hks::pushnamedcclosure != nullptr);
+    logLoaded("gettop", hks::gettop != nullptr);
+    logLoaded("checklstring", hks::checklstring != nullptr);
 
     Log("HavokScript integration initialized");
     Log("========================================");
@@ -304,7 +564,7 @@ void InstallPcallHook()
 {
     if (!hks::pcall)
     {
-        Log("[ERROR] Cannot install pcall hook: HavokScript::pcall is null.");
+        Log(LogLevel::Error, "[ERROR] Cannot install pcall hook: HavokScript::pcall is null.");
         return;
     }
 
@@ -330,13 +590,13 @@ void InstallPcallHook()
             }
             else
             {
-                Log("[ERROR] Failed to enable pcall hook (MH_STATUS: " + std::to_string(status) + ")");
+                Log(LogLevel::Error, "[ERROR] Failed to enable pcall hook (MH_STATUS: " + std::to_string(status) + ")");
                 return;
             }
         }
         else if (status == MH_ERROR_ALREADY_CREATED)
         {
-            Log("[WARNING] pcall hook already created. Attempting to enable...");
+            Log(LogLevel::Warning, "[WARNING] pcall hook already created. Attempting to enable...");
             status = MH_EnableHook(hks::pcall);
             if (status == MH_OK || status == MH_ERROR_ENABLED)
             {
@@ -346,14 +606,15 @@ void InstallPcallHook()
             }
             else
             {
-                Log("[ERROR] Failed to enable existing pcall hook (MH_STATUS: " + std::to_string(status) + ")");
+                Log(LogLevel::Error, "[ERROR] Failed to enable existing pcall hook (MH_STATUS: " +
+                    std::to_string(status) + ")");
                 return;
             }
         }
         else if (status == MH_ERROR_MEMORY_ALLOC && attempt < kMaxHookRetries)
         {
             // Memory allocation failed - this can be transient, retry after a short delay
-            Log("[WARNING] Memory allocation failed on attempt " + std::to_string(attempt) +
+            Log(LogLevel::Warning, "[WARNING] Memory allocation failed on attempt " + std::to_string(attempt) +
                 "/" + std::to_string(kMaxHookRetries) +
                 ", retrying in " + std::to_string(kRetryDelayMs) + "ms...");
             Sleep(kRetryDelayMs);
@@ -361,7 +622,7 @@ void InstallPcallHook()
         }
         else
         {
-            Log("[ERROR] Failed to create pcall hook (MH_STATUS: " + std::to_string(status) + ")");
+            Log(LogLevel::Error, "[ERROR] Failed to create pcall hook (MH_STATUS: " + std::to_string(status) + ")");
             LogMinHookError(status);
             return;
         }
@@ -441,11 +702,29 @@ void CleanupHavokScriptIntegration()
     {
         std::lock_guard<std::mutex> lock(g_registeredStatesMutex);
         g_registeredStates.clear();
+        for (auto& slot : g_registeredStateCache)
+        {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
     }
 
+    PcallHookStats stats = GetPcallHookStats();
+    Log("Pcall hook slow paths: " + std::to_string(stats.slowPathCalls));
+
     Log("HavokScript integration cleaned up");
 }
 
+// ============================================================================
+// DIAGNOSTICS
+// ============================================================================
+
+PcallHookStats GetPcallHookStats()
+{
+    PcallHookStats stats;
+    stats.slowPathCalls = g_pcallSlowPathCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
 // ============================================================================
 // LUA CODE EXECUTION
 // ============================================================================
@@ -455,14 +734,14 @@ bool ExecuteLuaCode(const char* code)
     // Don't execute during shutdown
     if (g_shutdownRequested.load())
     {
-        Log("[WARNING] Cannot execute Lua code: shutdown in progress.");
+        Log(LogLevel::Warning, "[WARNING] Cannot execute Lua code: shutdown in progress.");
         return false;
     }
 
     hks::lua_State* L = g_luaState.load();
     if (!L)
     {
-        Log("[ERROR] Cannot execute Lua code: Lua state is null.");
+        Log(LogLevel::Error, "[ERROR] Cannot execute Lua code: Lua state is null.");
         return false;
     }
 
@@ -470,7 +749,7 @@ bool ExecuteLuaCode(const char* code)
     // pcall expects compiled Lua code on the stack, DoString compiles and executes a string
     if (!g_originalDostring)
     {
-        Log("[ERROR] Cannot execute Lua code: DoString not available.");
+        Log(LogLevel::Error, "[ERROR] Cannot execute Lua code: DoString not available.");
         return false;
     }
 
@@ -486,7 +765,7 @@ bool ExecuteLuaCode(const char* code)
     }
     else
     {
-        Log("[ERROR] Lua code execution failed with error code: " + std::to_string(result));
+        Log(LogLevel::Error, "[ERROR] Lua code execution failed with error code: " + std::to_string(result));
         return false;
     }
 }
@@ -500,7 +779,7 @@ int lua_SendGameStateToClaudeAPI(hks::lua_State* L)
     // Don't process during shutdown
     if (g_shutdownRequested.load())
     {
-        Log("[WARNING] SendGameStateToClaudeAPI called during shutdown, ignoring");
+        Log(LogLevel::Warning, "[WARNING] SendGameStateToClaudeAPI called during shutdown, ignoring");
         PushStringToLua(L, R"({"error":"Shutdown in progress"})");
         return 1;
     }
@@ -539,7 +818,7 @@ int lua_SendGameStateToClaudeAPI(hks::lua_State* L)
         }
     }
 
-    Log("[ERROR] No valid game state received");
+    Log(LogLevel::Error, "[ERROR] No valid game state received");
     PushStringToLua(L, R"({"error":"No game state received"})");
     return 1;
 }
@@ -548,25 +827,132 @@ int lua_SendGameStateToClaudeAPI(hks::lua_State* L)
 // LUA-CALLABLE FUNCTIONS: ASYNC API
 // ============================================================================
 
-int lua_StartClaudeAPIRequest(hks::lua_State* L)
+namespace
 {
-    if (g_shutdownRequested.load())
+    /// Read the optional priority argument ("low", "normal" or "high")
+    ClaudeAPI::RequestPriority ReadRequestPriority(hks::lua_State* L, int index, int numArgs)
     {
-        Log("[WARNING] StartClaudeAPIRequest called during shutdown");
-        if (hks::pushboolean != nullptr)
+        ClaudeAPI::RequestPriority priority = ClaudeAPI::RequestPriority::Normal;
+        if (numArgs >= index && hks::type && hks::type(L, index) == hks::TSTRING && hks::checklstring)
         {
-            hks::pushboolean(L, 0);
+            size_t len = 0;
+            const char* name = hks::checklstring(L, index, &len);
+            if (name && !ClaudeAPI::ParseRequestPriority(std::string(name, len), priority))
+            {
+                Log(LogLevel::Warning, "[ASYNC LUA] WARNING: Unknown request priority '" + std::string(name, len) +
+                    "', using normal");
+            }
         }
-        else if (hks::pushinteger != nullptr)
+        return priority;
+    }
+
+    /// Read the optional deadline argument (seconds), defaulting to the "request_deadline" option
+    int ReadRequestDeadline(hks::lua_State* L, int index, int numArgs)
+    {
+        if (numArgs >= index && hks::type && hks::type(L, index) == hks::TNUMBER && hks::checkinteger)
+        {
+            int seconds = hks::checkinteger(L, index);
+            return seconds < 0 ? ClaudeAPI::kUseDefaultDeadline : seconds;
+        }
+        return ClaudeAPI::kUseDefaultDeadline;
+    }
+
+    /// Read the optional request ID argument, defaulting to the latest request
+    ClaudeAPI::RequestId ReadRequestId(hks::lua_State* L, int index, int numArgs)
+    {
+        if (numArgs >= index && hks::type && hks::type(L, index) == hks::TNUMBER && hks::checkinteger)
+        {
+            return static_cast<ClaudeAPI::RequestId>(hks::checkinteger(L, index));
+        }
+        return ClaudeAPI::GetLatestRequestId();
+    }
+
+    /// Push the request ID, or false if the request wasn't queued
+    int PushRequestIdToLua(hks::lua_State* L, ClaudeAPI::RequestId id)
+    {
+        Log("[ASYNC LUA] Request started: " + (id != ClaudeAPI::kNoRequest ? "#" + std::to_string(id) : "false"));
+        if (id != ClaudeAPI::kNoRequest && hks::pushinteger)
+        {
+            hks::pushinteger(L, static_cast<int>(id));
+        }
+        else
         {
-            hks::pushinteger(L, 0);
+            PushBooleanToLua(L, false);
         }
         return 1;
     }
+}
+
+int lua_StartClaudeAPIRequest(hks::lua_State* L)
+{
+    if (g_shutdownRequested.load())
+    {
+        Log(LogLevel::Warning, "[WARNING] StartClaudeAPIRequest called during shutdown");
+        PushBooleanToLua(L, false);
+        return 1;
+    }
 
     Log("[ASYNC LUA] StartClaudeAPIRequest called");
 
     int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    ClaudeAPI::RequestPriority priority = ReadRequestPriority(L, 2, numArgs);
+    bool speculative = numArgs >= 3 && hks::toboolean && hks::toboolean(L, 3) != 0;
+    int deadlineSeconds = ReadRequestDeadline(L, 4, numArgs);
+
+    // Player ID: close and send the game state built with AppendGameStateSection
+    // (checked before strings, which numbers would also pass as)
+    if (numArgs >= 1 && hks::type && hks::type(L, 1) == hks::TNUMBER && hks::checkinteger)
+    {
+        int playerID = hks::checkinteger(L, 1);
+        std::string gameState;
+        {
+            std::lock_guard<std::mutex> lock(g_gameStateSectionsMutex);
+            auto sections = g_gameStateSections.find(playerID);
+            if (sections != g_gameStateSections.end())
+            {
+                gameState = std::move(sections->second);
+                g_gameStateSections.erase(sections);
+            }
+        }
+
+        if (gameState.empty())
+        {
+            Log(LogLevel::Error, "[ASYNC LUA] ERROR: No game state sections gathered for player " +
+                std::to_string(playerID));
+            PushBooleanToLua(L, false);
+            return 1;
+        }
+
+        gameState += '}';
+        Log("[ASYNC LUA] Sending game state assembled from sections for player " + std::to_string(playerID) +
+            ": " + std::to_string(gameState.length()) + " bytes");
+
+        return PushRequestIdToLua(L, ClaudeAPI::StartAsyncRequest(gameState, priority, speculative, deadlineSeconds));
+    }
+
+    // Game state table: encode natively straight into the reusable buffer
+    if (numArgs >= 1 && hks::type && hks::type(L, 1) == hks::TTABLE)
+    {
+        std::lock_guard<std::mutex> lock(g_encodeBufferMutex);
+        g_encodeBuffer.clear();
+
+        auto encodeStart = std::chrono::steady_clock::now();
+        if (!LuaJson::EncodeValue(L, 1, g_encodeBuffer))
+        {
+            Log(LogLevel::Error, "[ASYNC LUA] ERROR: Game state table passed but native encoder is unavailable");
+            PushBooleanToLua(L, false);
+            return 1;
+        }
+        double encodeMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - encodeStart).count();
+
+        Log("[ASYNC LUA] Encoded game state table natively: " + std::to_string(g_encodeBuffer.length()) +
+            " bytes in " + std::to_string(encodeMs) + " ms");
+
+        return PushRequestIdToLua(
+            L, ClaudeAPI::StartAsyncRequest(g_encodeBuffer, priority, speculative, deadlineSeconds));
+    }
+
     if (numArgs >= 1 && hks::checklstring)
     {
         size_t len = 0;
@@ -580,102 +966,70 @@ int lua_StartClaudeAPIRequest(hks::lua_State* L)
             size_t logLen = len > kJsonPreviewLength ? kJsonPreviewLength : len;
             Log("[ASYNC LUA] Game state preview: " + std::string(gameStateJson, logLen));
 
-            bool started = ClaudeAPI::StartAsyncRequest(gameStateStr);
-
-            Log(std::string("[ASYNC LUA] Request started: ") + (started ? "true" : "false"));
-
-            if (hks::pushboolean != nullptr)
-            {
-                hks::pushboolean(L, started ? 1 : 0);
-            }
-            else if (hks::pushinteger != nullptr)
-            {
-                hks::pushinteger(L, started ? 1 : 0);
-            }
-            return 1;
+            return PushRequestIdToLua(
+                L, ClaudeAPI::StartAsyncRequest(gameStateStr, priority, speculative, deadlineSeconds));
         }
     }
 
-    Log("[ASYNC LUA] ERROR: No valid game state received");
-    if (hks::pushboolean != nullptr)
-    {
-        hks::pushboolean(L, 0);
-    }
-    else if (hks::pushinteger != nullptr)
-    {
-        hks::pushinteger(L, 0);
-    }
+    Log(LogLevel::Error, "[ASYNC LUA] ERROR: No valid game state received");
+    PushBooleanToLua(L, false);
     return 1;
 }
 
 int lua_CheckClaudeAPIResponse(hks::lua_State* L)
 {
+    PROFILE_ZONE(CheckResponse);
+
     if (g_shutdownRequested.load())
     {
-        Log("[WARNING] CheckClaudeAPIResponse called during shutdown");
+        Log(LogLevel::Warning, "[WARNING] CheckClaudeAPIResponse called during shutdown");
         PushStringToLua(L, "error");
         PushStringToLua(L, "Shutdown in progress");
         return 2;
     }
 
-    ClaudeAPI::AsyncState state = ClaudeAPI::GetAsyncState();
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    ClaudeAPI::RequestId id = ReadRequestId(L, 1, numArgs);
+    ClaudeAPI::AsyncState state = ClaudeAPI::GetAsyncState(id);
 
     switch (state)
     {
     case ClaudeAPI::AsyncState::Idle:
-        Log("[ASYNC LUA] CheckClaudeAPIResponse: IDLE (no request)");
+        Log("[ASYNC LUA] CheckClaudeAPIResponse: IDLE (no request #" + std::to_string(id) + ")");
         PushStringToLua(L, "idle");
         return 1;
 
     case ClaudeAPI::AsyncState::Pending:
+    {
+        // Hand out actions that finished streaming while the model keeps generating
+        std::string streamed = ClaudeAPI::TakeStreamedActions(id);
+        if (!streamed.empty())
+        {
+            Log("[ASYNC LUA] CheckClaudeAPIResponse: PARTIAL #" + std::to_string(id) +
+                ", length=" + std::to_string(streamed.length()));
+            return PushResponseToLua(L, "partial", streamed);
+        }
+
         // Still waiting - return "pending"
         PushStringToLua(L, "pending");
         return 1;
+    }
 
     case ClaudeAPI::AsyncState::Ready:
     {
         // Response ready - retrieve and return it
-        std::string response = ClaudeAPI::GetAsyncResponse();
-        Log("[ASYNC LUA] CheckClaudeAPIResponse: READY, response length=" +
-            std::to_string(response.length()));
-
-        // WORKAROUND: pushfstring has a 512 byte limit, so we use Game.SetProperty
-        // to pass long strings and return just the length
-        if (response.length() > kLongResponseThreshold)
-        {
-            // Store response in Game property via Lua execution
-            std::string escaped = EscapeForLua(response);
-            std::string luaCode = "Game.SetProperty(\"ClaudeAI_LongResponse\", \"" + escaped + "\")";
-            Log("[ASYNC LUA] Storing long response via Game.SetProperty");
-
-            if (hks::dostring)
-            {
-                int result = hks::dostring(L, luaCode.c_str());
-                if (result == 0)
-                {
-                    Log("[ASYNC LUA] Successfully stored response in Game property");
-                    PushStringToLua(L, "ready_long");
-                    return 1;
-                }
-                else
-                {
-                    Log("[ASYNC LUA] Failed to store response in Game property, error=" +
-                        std::to_string(result));
-                }
-            }
-        }
+        std::string response = ClaudeAPI::GetAsyncResponse(id);
+        Log("[ASYNC LUA] CheckClaudeAPIResponse: READY #" + std::to_string(id) +
+            ", response length=" + std::to_string(response.length()));
 
-        // For short responses or if Game.SetProperty failed, use direct push
-        PushStringToLua(L, "ready");
-        PushStringToLua(L, response);
-        return 2;
+        return PushResponseToLua(L, "ready", response);
     }
 
     case ClaudeAPI::AsyncState::Failed:
     {
         // Error occurred
-        std::string errorMsg = ClaudeAPI::GetAsyncError();
-        Log("[ASYNC LUA] CheckClaudeAPIResponse: ERROR - " + errorMsg);
+        std::string errorMsg = ClaudeAPI::GetAsyncError(id);
+        Log(LogLevel::Error, "[ASYNC LUA] CheckClaudeAPIResponse: ERROR #" + std::to_string(id) + " - " + errorMsg);
         PushStringToLua(L, "error");
         PushStringToLua(L, errorMsg.c_str());
         return 2;
@@ -691,7 +1045,409 @@ int lua_CheckClaudeAPIResponse(hks::lua_State* L)
 
 int lua_CancelClaudeAPIRequest(hks::lua_State* L)
 {
-    Log("[ASYNC LUA] CancelClaudeAPIRequest called");
-    ClaudeAPI::CancelAsyncRequest();
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs >= 1 && hks::type && hks::type(L, 1) == hks::TNUMBER && hks::checkinteger)
+    {
+        int id = hks::checkinteger(L, 1);
+        Log("[ASYNC LUA] CancelClaudeAPIRequest called for #" + std::to_string(id));
+        ClaudeAPI::CancelAsyncRequest(static_cast<ClaudeAPI::RequestId>(id));
+    }
+    else
+    {
+        Log("[ASYNC LUA] CancelClaudeAPIRequest called, cancelling all requests");
+        ClaudeAPI::CancelAllAsyncRequests();
+    }
+
+    std::lock_guard<std::mutex> lock(g_chunkedResponseMutex);
+    g_chunkedResponse.clear();
+    return 0;
+}
+
+int lua_EncodeJSON(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 1)
+    {
+        Log("[LUA] EncodeJSON requires a value to encode");
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(g_encodeBufferMutex);
+    g_encodeBuffer.clear();
+
+    if (!LuaJson::EncodeValue(L, 1, g_encodeBuffer))
+    {
+        Log("[LUA] EncodeJSON: native encoder unavailable");
+        return 0;
+    }
+
+    PushStringToLua(L, g_encodeBuffer);
+    return 1;
+}
+
+int lua_AppendGameStateSection(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 3 || !hks::checkinteger || !hks::type || hks::type(L, 2) != hks::TSTRING)
+    {
+        Log("[LUA] AppendGameStateSection requires (playerID, name, value [, first])");
+        PushBooleanToLua(L, false);
+        return 1;
+    }
+
+    int playerID = hks::checkinteger(L, 1);
+    bool first = numArgs >= 4 && hks::toboolean && hks::toboolean(L, 4) != 0;
+
+    std::lock_guard<std::mutex> lock(g_gameStateSectionsMutex);
+    auto sections = g_gameStateSections.find(playerID);
+    if (first)
+    {
+        sections = g_gameStateSections.insert_or_assign(playerID, std::string("{")).first;
+    }
+    else if (sections == g_gameStateSections.end())
+    {
+        Log("[LUA] AppendGameStateSection: no game state started for player " + std::to_string(playerID));
+        PushBooleanToLua(L, false);
+        return 1;
+    }
+
+    // Name and value go straight into the player's buffer; a failed encode is rolled back
+    std::string& buffer = sections->second;
+    size_t rollback = buffer.size();
+    if (buffer.size() > 1)
+    {
+        buffer += ',';
+    }
+
+    bool encoded = LuaJson::EncodeValue(L, 2, buffer);
+    buffer += ':';
+    encoded = encoded && LuaJson::EncodeValue(L, 3, buffer);
+    if (!encoded)
+    {
+        buffer.resize(rollback);
+        Log("[LUA] AppendGameStateSection: native encoder unavailable");
+    }
+
+    PushBooleanToLua(L, encoded);
+    return 1;
+}
+
+int lua_DiscardGameStateSections(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 1 || !hks::checkinteger)
+    {
+        Log("[LUA] DiscardGameStateSections requires (playerID)");
+        return 0;
+    }
+
+    int playerID = hks::checkinteger(L, 1);
+    std::lock_guard<std::mutex> lock(g_gameStateSectionsMutex);
+    if (g_gameStateSections.erase(playerID) > 0)
+    {
+        LOG_DEBUG("[LUA] Discarded unsent game state sections for player " + std::to_string(playerID));
+    }
+    return 0;
+}
+
+int lua_RecordClaudeActionResults(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 2 || !hks::checkinteger || !hks::checklstring)
+    {
+        Log("[LUA] RecordClaudeActionResults requires (playerID, results) arguments");
+        return 0;
+    }
+
+    int playerID = hks::checkinteger(L, 1);
+    size_t length = 0;
+    const char* results = hks::checklstring(L, 2, &length);
+    if (results)
+    {
+        ClaudeAPI::RecordActionResults(playerID, std::string(results, length));
+    }
+    return 0;
+}
+
+int lua_ResetClaudeAPIGame(hks::lua_State* L)
+{
+    (void)L;
+    ClaudeAPI::ResetTurnTracking();
+
+    std::lock_guard<std::mutex> lock(g_gameStateSectionsMutex);
+    g_gameStateSections.clear();
+    return 0;
+}
+
+int lua_ResolveClaudeSpeculativeRequest(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 2 || !hks::checkinteger || !hks::toboolean)
+    {
+        Log("[LUA] ResolveClaudeSpeculativeRequest requires (playerID, adopted) arguments");
+        return 0;
+    }
+
+    ClaudeAPI::ResolveSpeculativeRequest(hks::checkinteger(L, 1), hks::toboolean(L, 2) != 0);
+    return 0;
+}
+
+int lua_ValidateClaudeActions(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 2 || !hks::checklstring)
+    {
+        Log("[LUA] ValidateClaudeActions requires (stateJson, responseJson) arguments");
+        return 0;
+    }
+
+    size_t stateLength = 0;
+    size_t responseLength = 0;
+    const char* stateJson = hks::checklstring(L, 1, &stateLength);
+    const char* responseJson = hks::checklstring(L, 2, &responseLength);
+    if (!stateJson || !responseJson)
+    {
+        return 0;
+    }
+
+    PushStringToLua(L, ClaudeAPI::ValidateResponseActions(std::string(stateJson, stateLength),
+                                                          std::string(responseJson, responseLength)));
+    return 1;
+}
+
+int lua_DecodeClaudeActions(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 1 || !hks::checklstring)
+    {
+        Log("[LUA] DecodeClaudeActions requires a JSON string");
+        return 0;
+    }
+
+    size_t length = 0;
+    const char* text = hks::checklstring(L, 1, &length);
+    if (!text)
+    {
+        return 0;
+    }
+
+    return LuaJson::PushClaudeActions(L, text, length);
+}
+
+int lua_GetPlotsInRange(hks::lua_State* L)
+{
+    return PlotIndex::PushPlotsInRange(L);
+}
+
+int lua_GetChangedPlots(hks::lua_State* L)
+{
+    return PlotIndex::PushChangedPlots(L);
+}
+
+int lua_PushUICommand(hks::lua_State* L)
+{
+    return UICommandQueue::PushCommand(L);
+}
+
+int lua_DrainUICommands(hks::lua_State* L)
+{
+    return UICommandQueue::DrainCommands(L);
+}
+
+int lua_PushUICommandResult(hks::lua_State* L)
+{
+    return UICommandQueue::PushResult(L);
+}
+
+int lua_DrainUICommandResults(hks::lua_State* L)
+{
+    return UICommandQueue::DrainResults(L);
+}
+
+int lua_ClearUICommands(hks::lua_State* L)
+{
+    (void)L;
+    UICommandQueue::ClearCommands();
+    return 0;
+}
+
+int lua_GetClaudeResponseChunk(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 1 || !hks::checkinteger)
+    {
+        Log("[ASYNC LUA] GetClaudeResponseChunk requires a chunk index");
+        return 0;
+    }
+
+    int index = hks::checkinteger(L, 1);
+
+    std::lock_guard<std::mutex> lock(g_chunkedResponseMutex);
+    size_t offset = static_cast<size_t>(index - 1) * kResponseChunkSize;
+    if (index < 1 || offset >= g_chunkedResponse.length())
+    {
+        Log("[ASYNC LUA] GetClaudeResponseChunk: index " + std::to_string(index) + " out of range");
+        return 0;
+    }
+
+    PushStringToLua(L, g_chunkedResponse.substr(offset, kResponseChunkSize));
+
+    // Last chunk read - release the buffer
+    if (offset + kResponseChunkSize >= g_chunkedResponse.length())
+    {
+        g_chunkedResponse.clear();
+    }
+    return 1;
+}
+
+// ============================================================================
+// LUA-CALLABLE FUNCTIONS: CONFIGURATION
+// ============================================================================
+
+int lua_SetClaudeAPIOption(hks::lua_State* L)
+{
+    bool applied = false;
+
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs >= 2 && hks::checklstring)
+    {
+        size_t nameLen = 0;
+        size_t valueLen = 0;
+        const char* name = hks::checklstring(L, 1, &nameLen);
+        const char* value = hks::checklstring(L, 2, &valueLen);
+
+        if (name && value)
+        {
+            applied = ClaudeAPI::SetOption(std::string(name, nameLen), std::string(value, valueLen));
+        }
+    }
+    else
+    {
+        Log("[LUA] SetClaudeAPIOption requires (name, value) string arguments");
+    }
+
+    PushBooleanToLua(L, applied);
+    return 1;
+}
+
+int lua_GetClaudeAPIUsage(hks::lua_State* L)
+{
+    if (!hks::createtable || !hks::pushnumber || !hks::setfield)
+    {
+        Log("[LUA] GetClaudeAPIUsage: table functions not available");
+        return 0;
+    }
+
+    ClaudeAPI::UsageStats stats = ClaudeAPI::GetUsageStats();
+    ClaudeAPI::ResponseCacheStats cacheStats = ClaudeAPI::GetResponseCacheStats();
+
+    auto setNumber = [L](const char* key, uint64_t value)
+    {
+        hks::pushnumber(L, static_cast<double>(value));
+        hks::setfield(L, -2, key);
+    };
+
+    hks::createtable(L, 0, 13);
+    setNumber("last_input", stats.last.inputTokens);
+    setNumber("last_output", stats.last.outputTokens);
+    setNumber("last_cache_write", stats.last.cacheCreationTokens);
+    setNumber("last_cache_read", stats.last.cacheReadTokens);
+    setNumber("total_input", stats.total.inputTokens);
+    setNumber("total_output", stats.total.outputTokens);
+    setNumber("total_cache_write", stats.total.cacheCreationTokens);
+    setNumber("total_cache_read", stats.total.cacheReadTokens);
+    setNumber("requests", stats.requestCount);
+    setNumber("response_cache_hits", cacheStats.hits);
+    setNumber("response_cache_disk_hits", cacheStats.diskHits);
+    setNumber("response_cache_misses", cacheStats.misses);
+    setNumber("response_cache_expired", cacheStats.expired);
+    return 1;
+}
+
+int lua_GetClaudeAPIMetrics(hks::lua_State* L)
+{
+    if (!hks::createtable || !hks::pushnumber || !hks::setfield)
+    {
+        Log("[LUA] GetClaudeAPIMetrics: table functions not available");
+        return 0;
+    }
+
+    ClaudeAPI::MetricsSummary summary = ClaudeAPI::GetMetricsSummary();
+    if (summary.last.id == ClaudeAPI::kNoRequest && summary.requestCount == 0)
+    {
+        if (hks::pushnil)
+        {
+            hks::pushnil(L);
+            return 1;
+        }
+        return 0;
+    }
+
+    const ClaudeAPI::RequestMetrics& last = summary.last;
+
+    auto setNumber = [L](const char* key, double value)
+    {
+        hks::pushnumber(L, value);
+        hks::setfield(L, -2, key);
+    };
+    auto setBoolean = [L](const char* key, bool value)
+    {
+        PushBooleanToLua(L, value);
+        hks::setfield(L, -2, key);
+    };
+    auto setString = [L](const char* key, const std::string& value)
+    {
+        PushStringToLua(L, value);
+        hks::setfield(L, -2, key);
+    };
+
+    hks::createtable(L, 0, 25);
+    setNumber("request", static_cast<double>(last.id));
+    setNumber("player", last.playerID);
+    setNumber("turn", last.turn);
+    setString("model", last.model);
+    setString("route", last.route);
+    setNumber("max_tokens", last.maxTokens);
+    setNumber("serialize_ms", last.serializeMs);
+    setNumber("queue_ms", last.queueMs);
+    setNumber("parse_ms", last.parseMs);
+    setNumber("connect_ms", last.connectMs);
+    setNumber("first_byte_ms", last.firstByteMs);
+    setNumber("download_ms", last.downloadMs);
+    setNumber("extract_ms", last.extractMs);
+    setNumber("decode_ms", last.decodeMs);
+    setNumber("execute_ms", last.executeMs);
+    setNumber("total_ms", last.totalMs);
+    setNumber("input_tokens", static_cast<double>(last.usage.inputTokens));
+    setNumber("output_tokens", static_cast<double>(last.usage.outputTokens));
+    setNumber("cache_read", static_cast<double>(last.usage.cacheReadTokens));
+    setNumber("cache_write", static_cast<double>(last.usage.cacheCreationTokens));
+    setBoolean("response_cache_hit", last.responseCacheHit);
+    setBoolean("reused_connection", last.reusedConnection);
+    setNumber("requests", static_cast<double>(summary.requestCount));
+    setNumber("avg_total_ms", summary.averageTotalMs);
+    setNumber("avg_first_byte_ms", summary.averageFirstByteMs);
+    return 1;
+}
+
+int lua_ReportClaudeRequestTimings(hks::lua_State* L)
+{
+    int numArgs = hks::gettop ? hks::gettop(L) : 0;
+    if (numArgs < 4 || !hks::checkinteger || !hks::tonumber)
+    {
+        Log("[LUA] ReportClaudeRequestTimings requires (requestID, serializeMs, decodeMs, executeMs) arguments");
+        return 0;
+    }
+
+    ClaudeAPI::RequestId id = static_cast<ClaudeAPI::RequestId>(hks::checkinteger(L, 1));
+    ClaudeAPI::ReportLuaTimings(id, hks::tonumber(L, 2), hks::tonumber(L, 3), hks::tonumber(L, 4));
+    return 0;
+}
+
+#ifdef CLAUDEMOD_PROFILE
+int lua_ProfileClaudeFrame(hks::lua_State* L)
+{
+    PROFILE_FRAME();
     return 0;
 }
+#endif
@@ -6,6 +6,7 @@
 // ============================================================================
 
 #include <atomic>
+#include <cstdint>
 
 #include "HavokScript.h"
 
@@ -20,6 +21,9 @@ extern std::atomic<hks::lua_State*> g_luaState;
 /// Shutdown flag (defined in dllmain.cpp)
 extern std::atomic<bool> g_shutdownRequested;
 
+/// Manual-reset event signalled when g_luaState is first captured (defined in dllmain.cpp)
+extern HANDLE g_luaStateCapturedEvent;
+
 // ============================================================================
 // INITIALIZATION
 // ============================================================================
@@ -32,6 +36,20 @@ void InitializeHavokScriptIntegration();
 /// This hooks lua_pcall to intercept all Lua calls and register our functions
 void InstallPcallHook();
 
+// ============================================================================
+// DIAGNOSTICS
+// ============================================================================
+
+/// Counters for the pcall hook registration check
+/// @note Fast-path hits are only counted in Profile builds, as the PcallFastPath counter
+struct PcallHookStats
+{
+    uint64_t slowPathCalls = 0;     ///< Pcalls that took the mutex and searched the set
+};
+
+/// Get pcall hook path counters
+[[nodiscard]] PcallHookStats GetPcallHookStats();
+
 // ============================================================================
 // LUA EXECUTION
 // ============================================================================
@@ -50,18 +68,143 @@ void InstallPcallHook();
 /// @note Automatically registered in all Lua states via hooked_pcall
 int lua_SendGameStateToClaudeAPI(hks::lua_State* L);
 
-/// Start an async Claude API request (non-blocking)
-/// @return 1 (boolean on stack: true if request started)
+/// Queue an async Claude API request (non-blocking):
+/// StartClaudeAPIRequest(gameState [, priority [, speculative [, deadline]]])
+/// @note Accepts the game state as a JSON string or as a table, which is encoded
+///       natively without creating a Lua string, or as a player ID to send the
+///       sections gathered for that player with AppendGameStateSection
+/// @note priority is "low", "normal" (default) or "high"; higher priorities start first
+/// @note speculative = true plans the player's next turn from an end-of-turn state
+///       (see ResolveClaudeSpeculativeRequest)
+/// @note deadline is in seconds (0 for none); without it the "request_deadline" option applies.
+///       A request past its deadline fails with "Deadline exceeded"
+/// @return 1 (request ID on stack, or false if the request was not queued)
 int lua_StartClaudeAPIRequest(hks::lua_State* L);
 
-/// Check if async response is ready
+/// Check if an async response is ready: CheckClaudeAPIResponse([requestID])
 /// @return 1-2 values: status string, optional response/error
+/// @note Without an ID the most recently started request is checked
+/// @note Status "partial" carries actions streamed so far; the request stays pending
+/// @note Responses over the push limit come back as "<status>_chunked" plus a chunk
+///       count, read with GetClaudeResponseChunk
 int lua_CheckClaudeAPIResponse(hks::lua_State* L);
 
-/// Cancel any pending async request
+/// Cancel an async request: CancelClaudeAPIRequest([requestID])
 /// @return 0 (no values)
+/// @note Without an ID every queued and running request is cancelled
 int lua_CancelClaudeAPIRequest(hks::lua_State* L);
 
+/// Add one top-level field to a player's game state: AppendGameStateSection(playerID, name, value [, first])
+/// @return 1 (true if the section was added, false otherwise)
+/// @note first = true starts a new game state, discarding unsent sections from an abandoned one
+/// @note The value is encoded natively as it arrives; StartClaudeAPIRequest(playerID)
+///       sends the finished state
+/// @note Only registered when the native encoder's hks imports were resolved
+int lua_AppendGameStateSection(hks::lua_State* L);
+
+/// Drop a player's unsent game state sections: DiscardGameStateSections(playerID)
+/// @return 0 (no values)
+/// @note Called when an incremental build is abandoned; registered with AppendGameStateSection
+int lua_DiscardGameStateSections(hks::lua_State* L);
+
+/// Encode a Lua value as JSON: EncodeJSON(value)
+/// @return 1 (JSON string) or 0 if the native encoder is unavailable
+/// @note Only registered when the hks imports it needs were resolved
+int lua_EncodeJSON(hks::lua_State* L);
+
+/// Report executed action results for the next request: RecordClaudeActionResults(playerID, results)
+/// @return 0 (no values)
+int lua_RecordClaudeActionResults(hks::lua_State* L);
+
+/// Start per-game DLL state afresh: ResetClaudeAPIGame()
+/// @return 0 (no values)
+/// @note Gameplay context, on game load; closes the previous game's trace and recording
+///       and drops unsent game state sections
+int lua_ResetClaudeAPIGame(hks::lua_State* L);
+
+/// Keep or drop a player's provisional next-turn plan: ResolveClaudeSpeculativeRequest(playerID, adopted)
+/// @return 0 (no values)
+int lua_ResolveClaudeSpeculativeRequest(hks::lua_State* L);
+
+/// Check an adopted speculative plan against this turn's state: ValidateClaudeActions(stateJson, responseJson)
+/// @return 1 (the response JSON with invalid actions dropped)
+int lua_ValidateClaudeActions(hks::lua_State* L);
+
+/// Decode a Claude response into Lua tables: DecodeClaudeActions(json)
+/// @return 1 (table with "actions" and optional "errors" arrays) or 2 (nil, error message)
+/// @note Only registered when the hks imports it needs were resolved
+int lua_DecodeClaudeActions(hks::lua_State* L);
+
+/// List plots near a set of positions: GetPlotsInRange(width, height, wrapX, radius, positions)
+/// @return 1 (sorted array of plot indices, y * width + x) or 0 on invalid arguments
+/// @note positions is a flat {x1, y1, x2, y2, ...} array; distance is in hexes
+/// @note Only registered when the hks imports it needs were resolved
+int lua_GetPlotsInRange(hks::lua_State* L);
+
+/// Find plots that need re-serializing: GetChangedPlots(playerID, epoch, plotIndices, signatures)
+/// @return 1 (array of 1-based positions into plotIndices) or 0 on invalid arguments
+/// @note Reports plots whose signature differs from the player's previous call,
+///       or every plot when epoch changed
+/// @note Only registered when the hks imports it needs were resolved
+int lua_GetChangedPlots(hks::lua_State* L);
+
+/// Queue a command for the UI context: PushUICommand(name, payload)
+/// @return 1 (true if queued, false if invalid or the queue is full)
+/// @note Gameplay context only; payload uses the command's Game property format
+/// @note Only registered when the hks imports it needs were resolved
+int lua_PushUICommand(hks::lua_State* L);
+
+/// Take the queued UI commands: DrainUICommands()
+/// @return 1 (array of {name, payload} tables, oldest first)
+/// @note UI context only
+int lua_DrainUICommands(hks::lua_State* L);
+
+/// Report a UI command's outcome to the gameplay context: PushUICommandResult(name, result)
+/// @return 1 (true if queued, false if invalid or the queue is full)
+/// @note UI context only; result is "ok" or an error message
+int lua_PushUICommandResult(hks::lua_State* L);
+
+/// Take the reported UI command outcomes: DrainUICommandResults()
+/// @return 1 (array of {name, payload} tables, oldest first)
+/// @note Gameplay context only
+int lua_DrainUICommandResults(hks::lua_State* L);
+
+/// Discard every queued UI command and result: ClearUICommands()
+/// @return 0
+/// @note Gameplay context only; called at the start of each turn and on game load
+int lua_ClearUICommands(hks::lua_State* L);
+
+/// Read part of a long response: GetClaudeResponseChunk(index)
+/// @return 1 (string chunk, 1-based) or 0 if index is out of range
+/// @note Valid after CheckClaudeAPIResponse returns "ready_chunked"/"partial_chunked"
+///       with a chunk count; the buffer is released once the last chunk is read
+int lua_GetClaudeResponseChunk(hks::lua_State* L);
+
+/// Set a DLL runtime option: SetClaudeAPIOption(name, value)
+/// @return 1 (boolean on stack: true if the option was applied)
+int lua_SetClaudeAPIOption(hks::lua_State* L);
+
+/// Get API token usage: GetClaudeAPIUsage()
+/// @return 1 (table with last_* and total_* input/output/cache_write/cache_read counts, plus requests)
+int lua_GetClaudeAPIUsage(hks::lua_State* L);
+
+/// Get the latency breakdown of the latest finished request: GetClaudeAPIMetrics()
+/// @return 1 (table with request/player/turn, *_ms stage times, token counts, response_cache_hit,
+///         reused_connection, plus requests/avg_total_ms/avg_first_byte_ms) or nil before any request
+int lua_GetClaudeAPIMetrics(hks::lua_State* L);
+
+/// Report Lua-side stage times for a request: ReportClaudeRequestTimings(requestID, serializeMs, decodeMs, executeMs)
+/// @return 0 (no values)
+/// @note Call once the response has been handled; the request's metrics are traced afterwards
+int lua_ReportClaudeRequestTimings(hks::lua_State* L);
+
+#ifdef CLAUDEMOD_PROFILE
+/// Mark one rendered frame for the profiler: ProfileClaudeFrame()
+/// @return 0 (no values)
+/// @note Profile configuration only; called from the UI context's per-frame update
+int lua_ProfileClaudeFrame(hks::lua_State* L);
+#endif
+
 // ============================================================================
 // CLEANUP
 // ============================================================================
@@ -4,8 +4,13 @@
 
 #include "Log.h"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <Windows.h>
 
 // ============================================================================
@@ -15,19 +20,66 @@
 namespace
 {
     constexpr const char* kLogFileName = "civ6_claude_hook.log";
+    constexpr const char* kRotatedLogFileName = "civ6_claude_hook.1.log";
     constexpr size_t kTimestampBufferSize = 64;
     constexpr size_t kHexBufferSize = 128;
+
+    /// Queue slots (power of two); producers drop messages rather than wait when full
+    constexpr size_t kLogQueueCapacity = 4096;
+    static_assert((kLogQueueCapacity & (kLogQueueCapacity - 1)) == 0, "Queue capacity must be a power of two");
+
+    /// How often the writer drains the queue when not woken early
+    constexpr DWORD kLogFlushIntervalMs = 100;
+
+    /// Time ShutdownLog waits for the writer to finish before draining itself
+    constexpr DWORD kLogShutdownWaitMs = 500;
+
+    /// Rotate the log file once it grows past this size
+    constexpr std::streamoff kMaxLogFileBytes = 16 * 1024 * 1024;
 }
 
 // ============================================================================
-// IMPLEMENTATION
+// MODULE STATE
 // ============================================================================
 
-std::string GetTimestamp()
+namespace
 {
-    SYSTEMTIME st;
-    GetLocalTime(&st);
+    /// One queued message. sequence follows the bounded MPMC queue scheme:
+    /// equal to the position when free, position + 1 once filled
+    struct LogSlot
+    {
+        std::atomic<size_t> sequence{0};
+        SYSTEMTIME time{};
+        std::string message;
+    };
+
+    std::array<LogSlot, kLogQueueCapacity> g_logQueue;
+    std::atomic<size_t> g_enqueuePos{0};
+    size_t g_dequeuePos = 0;                        ///< Owned by whoever is draining
+
+    std::atomic<int> g_minLevel{static_cast<int>(LogLevel::Info)};
+    std::atomic<bool> g_writerRunning{false};       ///< Log() queues only while true
+    std::atomic<int> g_activeProducers{0};          ///< Log() calls between the running check and enqueue
+    std::atomic<bool> g_writerStopping{false};
+    std::atomic<uint64_t> g_droppedCount{0};
+
+    std::thread g_writerThread;
+    HANDLE g_wakeEvent = nullptr;                   ///< Auto-reset, wakes the writer early
+    HANDLE g_writerDoneEvent = nullptr;             ///< Manual-reset, set after the final drain
+
+    std::ofstream g_logFile;                        ///< Owned by whoever is draining
+    std::mutex g_syncWriteMutex;                    ///< Serializes the synchronous fallback
+}
+
+// ============================================================================
+// INTERNAL HELPERS
+// ============================================================================
 
+namespace
+{
+
+std::string FormatTimestamp(const SYSTEMTIME& st)
+{
     char buffer[kTimestampBufferSize];
     sprintf_s(buffer, "[%02d:%02d:%02d.%03d]",
         st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
@@ -35,20 +87,173 @@ std::string GetTimestamp()
     return std::string(buffer);
 }
 
-void Log(const std::string& message)
+/// Write one line with open/append/close (used before InitLog and after ShutdownLog)
+void WriteLineSync(const std::string& timestamped)
 {
-    std::string timestamped = GetTimestamp() + " " + message;
-
-    // Output to debug console (visible in DebugView)
     OutputDebugStringA((timestamped + "\n").c_str());
 
-    // Also write to file
+    std::lock_guard<std::mutex> lock(g_syncWriteMutex);
     std::ofstream logFile(kLogFileName, std::ios::app);
     if (logFile.is_open())
     {
-        logFile << timestamped << std::endl;
-        logFile.flush();
+        logFile << timestamped << '\n';
+    }
+}
+
+bool TryEnqueue(std::string&& message)
+{
+    size_t pos = g_enqueuePos.load(std::memory_order_relaxed);
+    LogSlot* slot = nullptr;
+
+    for (;;)
+    {
+        slot = &g_logQueue[pos & (kLogQueueCapacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (g_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // Full
+        }
+        else
+        {
+            pos = g_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    GetLocalTime(&slot->time);
+    slot->message = std::move(message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/// Pop the next message (single consumer)
+bool TryDequeue(SYSTEMTIME& outTime, std::string& outMessage)
+{
+    LogSlot& slot = g_logQueue[g_dequeuePos & (kLogQueueCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != g_dequeuePos + 1)
+    {
+        return false;
+    }
+
+    outTime = slot.time;
+    outMessage = std::move(slot.message);
+    slot.message.clear();
+    slot.sequence.store(g_dequeuePos + kLogQueueCapacity, std::memory_order_release);
+    g_dequeuePos++;
+    return true;
+}
+
+void OpenLogFile(std::ios::openmode mode)
+{
+    g_logFile.open(kLogFileName, std::ios::out | mode);
+}
+
+/// Move the current log aside and start a fresh one
+void RotateLogFile()
+{
+    g_logFile.close();
+    MoveFileExA(kLogFileName, kRotatedLogFileName, MOVEFILE_REPLACE_EXISTING);
+    OpenLogFile(std::ios::trunc);
+    if (g_logFile.is_open())
+    {
+        g_logFile << GetTimestamp() << " [LOG] Rotated, previous log is " << kRotatedLogFileName << '\n';
+    }
+}
+
+/// Write everything queued so far in one batch
+void DrainQueue()
+{
+    std::string batch;
+    SYSTEMTIME time;
+    std::string message;
+
+    while (TryDequeue(time, message))
+    {
+        std::string line = FormatTimestamp(time) + " " + message + "\n";
+        OutputDebugStringA(line.c_str());
+        batch += line;
+    }
+
+    uint64_t dropped = g_droppedCount.exchange(0);
+    if (dropped > 0)
+    {
+        batch += GetTimestamp() + " [LOG] Queue full, dropped " + std::to_string(dropped) + " messages\n";
+    }
+
+    if (batch.empty() || !g_logFile.is_open())
+    {
+        return;
+    }
+
+    g_logFile.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+    g_logFile.flush();
+
+    if (g_logFile.tellp() > kMaxLogFileBytes)
+    {
+        RotateLogFile();
+    }
+}
+
+void WriterThread()
+{
+    while (!g_writerStopping.load())
+    {
+        WaitForSingleObject(g_wakeEvent, kLogFlushIntervalMs);
+        DrainQueue();
+    }
+
+    DrainQueue();
+    g_logFile.close();
+    SetEvent(g_writerDoneEvent);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// IMPLEMENTATION
+// ============================================================================
+
+std::string GetTimestamp()
+{
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    return FormatTimestamp(st);
+}
+
+void Log(const std::string& message)
+{
+    Log(LogLevel::Info, message);
+}
+
+void Log(LogLevel level, const std::string& message)
+{
+    if (!IsLogLevelEnabled(level))
+    {
+        return;
+    }
+
+    // Announce the enqueue before checking the flag so ShutdownLog can wait for it
+    g_activeProducers.fetch_add(1);
+    if (!g_writerRunning.load())
+    {
+        g_activeProducers.fetch_sub(1);
+        WriteLineSync(GetTimestamp() + " " + message);
+        return;
+    }
+
+    if (!TryEnqueue(std::string(message)))
+    {
+        g_droppedCount.fetch_add(1, std::memory_order_relaxed);
     }
+    g_activeProducers.fetch_sub(1);
 }
 
 void LogHex(const std::string& name, void* address)
@@ -58,13 +263,129 @@ void LogHex(const std::string& name, void* address)
     Log(buffer);
 }
 
+void SetLogLevel(LogLevel level)
+{
+    g_minLevel.store(static_cast<int>(level));
+}
+
+bool IsLogLevelEnabled(LogLevel level)
+{
+    return static_cast<int>(level) >= g_minLevel.load(std::memory_order_relaxed);
+}
+
+bool ParseLogLevel(const std::string& name, LogLevel& outLevel)
+{
+    if (name == "debug")
+    {
+        outLevel = LogLevel::Debug;
+    }
+    else if (name == "info")
+    {
+        outLevel = LogLevel::Info;
+    }
+    else if (name == "warning")
+    {
+        outLevel = LogLevel::Warning;
+    }
+    else if (name == "error")
+    {
+        outLevel = LogLevel::Error;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
 void InitLog()
 {
-    std::ofstream logFile(kLogFileName, std::ios::out | std::ios::trunc);
-    if (logFile.is_open())
+    if (g_writerRunning.load())
+    {
+        return;
+    }
+
+    OpenLogFile(std::ios::trunc);
+    if (g_logFile.is_open())
     {
-        logFile << "=== Civ6 Claude Hook Initialized ===" << std::endl;
-        logFile << "Timestamp: " << GetTimestamp() << std::endl;
-        logFile << "========================================" << std::endl;
+        g_logFile << "=== Civ6 Claude Hook Initialized ===" << '\n';
+        g_logFile << "Timestamp: " << GetTimestamp() << '\n';
+        g_logFile << "========================================" << '\n';
+        g_logFile.flush();
     }
+
+    for (size_t i = 0; i < kLogQueueCapacity; i++)
+    {
+        g_logQueue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    g_enqueuePos.store(0);
+    g_dequeuePos = 0;
+
+    g_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    g_writerDoneEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!g_wakeEvent || !g_writerDoneEvent)
+    {
+        // Stay on the synchronous path
+        g_logFile.close();
+        return;
+    }
+
+    g_writerStopping.store(false);
+    g_writerThread = std::thread(WriterThread);
+    g_writerRunning.store(true, std::memory_order_release);
+}
+
+void ShutdownLog()
+{
+    // Close the queue, then let producers that already passed the check finish
+    // enqueueing so the final drain sees their messages. Bounded because threads
+    // killed at process exit never decrement the count
+    if (!g_writerRunning.exchange(false))
+    {
+        return;
+    }
+
+    ULONGLONG producerDeadline = GetTickCount64() + kLogShutdownWaitMs;
+    while (g_activeProducers.load() > 0 && GetTickCount64() < producerDeadline)
+    {
+        SwitchToThread();
+    }
+
+    g_writerStopping.store(true);
+    SetEvent(g_wakeEvent);
+
+    bool writerFinished = WaitForSingleObject(g_writerDoneEvent, kLogShutdownWaitMs) == WAIT_OBJECT_0;
+    if (!writerFinished)
+    {
+        DWORD exitCode = 0;
+        bool writerAlive = GetExitCodeThread(g_writerThread.native_handle(), &exitCode) &&
+                           exitCode == STILL_ACTIVE;
+
+        if (writerAlive)
+        {
+            // Still writing - it drains on its own; leave the events open for it
+            g_writerThread.detach();
+            return;
+        }
+
+        // At process exit the writer has already been terminated without
+        // draining, so nothing else is consuming - drain here
+        if (!g_logFile.is_open())
+        {
+            OpenLogFile(std::ios::app);
+        }
+        DrainQueue();
+        g_logFile.close();
+    }
+
+    // Don't join under the loader lock - the thread has finished its work either way
+    if (g_writerThread.joinable())
+    {
+        g_writerThread.detach();
+    }
+
+    CloseHandle(g_wakeEvent);
+    CloseHandle(g_writerDoneEvent);
+    g_wakeEvent = nullptr;
+    g_writerDoneEvent = nullptr;
 }
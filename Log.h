@@ -7,22 +7,59 @@
 
 #include <string>
 
+// ============================================================================
+// LOG LEVELS
+// ============================================================================
+
+/// Severity of a log message; messages below the current level are discarded
+enum class LogLevel
+{
+    Debug,      ///< Verbose tracing (off by default)
+    Info,       ///< Normal operation
+    Warning,    ///< Recoverable problems
+    Error       ///< Failures
+};
+
+/// Log at Debug level without building the message when Debug is disabled
+#define LOG_DEBUG(message) \
+    do { if (IsLogLevelEnabled(LogLevel::Debug)) { Log(LogLevel::Debug, message); } } while (0)
+
 // ============================================================================
 // PUBLIC API
 // ============================================================================
 
-/// Initialize the log file (call once at DLL startup)
+/// Initialize the log file and start the background writer (call once at DLL startup)
 void InitLog();
 
+/// Flush all queued messages and stop the background writer (call on DLL_PROCESS_DETACH)
+/// @note Messages logged afterwards are written synchronously
+void ShutdownLog();
+
 /// Log a message with timestamp to debug console and file
 /// @param message The message to log
+/// @note Queued for the writer thread; never blocks on file I/O
 void Log(const std::string& message);
 
+/// Log a message at the given level
+/// @param level Severity; dropped if below the current log level
+/// @param message The message to log
+void Log(LogLevel level, const std::string& message);
+
 /// Log a hex address with a descriptive name
 /// @param name Description of the address
 /// @param address The pointer value to log
 void LogHex(const std::string& name, void* address);
 
+/// Set the minimum level that is written
+void SetLogLevel(LogLevel level);
+
+/// Check whether messages at a level would be written
+[[nodiscard]] bool IsLogLevelEnabled(LogLevel level);
+
+/// Parse "debug", "info", "warning" or "error"
+/// @return true if name was recognized
+[[nodiscard]] bool ParseLogLevel(const std::string& name, LogLevel& outLevel);
+
 // ============================================================================
 // INTERNAL HELPERS
 // ============================================================================
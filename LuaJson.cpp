@@ -0,0 +1,690 @@
+// ============================================================================
+// LuaJson.cpp - Native JSON Encoding and Decoding of Lua Values Implementation
+// ============================================================================
+
+#include "LuaJson.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <json.hpp>
+
+#include "Log.h"
+
+namespace LuaJson
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    /// Maximum table nesting. Each level holds a key and value on the stack, and
+    /// C functions are only guaranteed LUA_MINSTACK (20) free slots
+    constexpr int kMaxEncodeDepth = 8;
+
+    /// Large enough for any "%.14g" double
+    constexpr size_t kNumberBufferSize = 32;
+
+    /// Maximum nesting of a decoded response (result table, actions array,
+    /// action, field value, ...). Each level holds a table and a key on the stack
+    constexpr int kMaxDecodeDepth = 6;
+
+    /// Longest string pushed in one piece; longer strings don't survive the push
+    /// (same limit as the response chunking in HavokScriptIntegration)
+    constexpr size_t kMaxPushLength = 400;
+
+    /// Pieces pushed before they are joined with concat, bounding stack use
+    constexpr int kMaxConcatPieces = 4;
+}
+
+// ============================================================================
+// VALUE WRITERS
+// ============================================================================
+
+namespace
+{
+
+void EncodeAt(hks::lua_State* L, int index, std::string& out, int depth);
+
+/// Convert a relative stack index to an absolute one so it survives pushes
+int AbsoluteIndex(hks::lua_State* L, int index)
+{
+    return index > 0 ? index : hks::gettop(L) + index + 1;
+}
+
+/// Write a number the way Lua's tostring does ("%.14g"); NaN and infinity become null
+void AppendNumber(std::string& out, double value)
+{
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+
+    char buffer[kNumberBufferSize];
+    int length = sprintf_s(buffer, "%.14g", value);
+    if (length > 0)
+    {
+        out.append(buffer, static_cast<size_t>(length));
+    }
+}
+
+/// Write a quoted, escaped JSON string
+void AppendString(std::string& out, const char* data, size_t length)
+{
+    static constexpr char kHexDigits[] = "0123456789abcdef";
+
+    out += '"';
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = data[i];
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ('\x00' <= c && c <= '\x1f')
+            {
+                out += "\\u00";
+                out += kHexDigits[(c >> 4) & 0xF];
+                out += kHexDigits[c & 0xF];
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+/// Check whether a table's keys are exactly 1..length (the TableToJSON array test)
+bool IsSequence(hks::lua_State* L, int tableIndex, size_t length)
+{
+    size_t count = 0;
+
+    hks::pushnil(L);
+    while (hks::next(L, tableIndex))
+    {
+        // Key at -2, value at -1
+        if (hks::type(L, -2) != hks::TNUMBER)
+        {
+            hks::pop(L, 2);
+            return false;
+        }
+
+        double key = hks::tonumber(L, -2);
+        if (key < 1.0 || key > static_cast<double>(length) || key != std::floor(key))
+        {
+            hks::pop(L, 2);
+            return false;
+        }
+
+        count++;
+        hks::pop(L, 1);
+    }
+
+    return count == length;
+}
+
+void EncodeTable(hks::lua_State* L, int tableIndex, std::string& out, int depth)
+{
+    if (depth >= kMaxEncodeDepth)
+    {
+        Log(LogLevel::Warning, "[LuaJson] WARNING: Table nesting exceeds " + std::to_string(kMaxEncodeDepth) +
+            ", encoding null");
+        out += "null";
+        return;
+    }
+
+    size_t length = static_cast<size_t>(hks::objlen(L, tableIndex));
+
+    if (IsSequence(L, tableIndex, length))
+    {
+        out += '[';
+        for (size_t i = 1; i <= length; i++)
+        {
+            if (i > 1)
+            {
+                out += ',';
+            }
+            hks::rawgeti(L, tableIndex, static_cast<int>(i));
+            EncodeAt(L, hks::gettop(L), out, depth + 1);
+            hks::pop(L, 1);
+        }
+        out += ']';
+        return;
+    }
+
+    out += '{';
+    bool first = true;
+
+    hks::pushnil(L);
+    while (hks::next(L, tableIndex))
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+
+        // Never tolstring the key in place - converting it would break next()
+        int keyType = hks::type(L, -2);
+        if (keyType == hks::TSTRING)
+        {
+            size_t keyLength = 0;
+            const char* key = hks::tolstring(L, -2, &keyLength);
+            AppendString(out, key, keyLength);
+        }
+        else if (keyType == hks::TNUMBER)
+        {
+            out += '"';
+            AppendNumber(out, hks::tonumber(L, -2));
+            out += '"';
+        }
+        else if (keyType == hks::TBOOLEAN)
+        {
+            out += hks::toboolean(L, -2) ? "\"true\"" : "\"false\"";
+        }
+        else
+        {
+            // Tables, functions and userdata as keys have no stable name
+            out += "\"?\"";
+        }
+
+        out += ':';
+        EncodeAt(L, hks::gettop(L), out, depth + 1);
+        hks::pop(L, 1);
+    }
+    out += '}';
+}
+
+void EncodeAt(hks::lua_State* L, int index, std::string& out, int depth)
+{
+    switch (hks::type(L, index))
+    {
+    case hks::TBOOLEAN:
+        out += hks::toboolean(L, index) ? "true" : "false";
+        break;
+
+    case hks::TNUMBER:
+        AppendNumber(out, hks::tonumber(L, index));
+        break;
+
+    case hks::TSTRING:
+    {
+        size_t length = 0;
+        const char* value = hks::tolstring(L, index, &length);
+        AppendString(out, value, value ? length : 0);
+        break;
+    }
+
+    case hks::TTABLE:
+        EncodeTable(L, index, out, depth);
+        break;
+
+    default:
+        // nil, functions, userdata and threads have no JSON form
+        out += "null";
+        break;
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// VALUE READERS
+// ============================================================================
+
+namespace
+{
+
+/// How a known action field is checked before it is handed to Lua
+enum class FieldType
+{
+    Integer,    ///< Ids and coordinates; numeric strings are accepted
+    String,     ///< Type names and free text
+    SlotMap     ///< {"0": "POLICY_X", ...} - becomes a table keyed by slot number
+};
+
+struct FieldRule
+{
+    const char* name;
+    FieldType type;
+};
+
+/// Fields read by the Lua action handlers; everything else is passed through as-is
+constexpr FieldRule kActionFieldRules[] = {
+    {"unit_id", FieldType::Integer},
+    {"city_id", FieldType::Integer},
+    {"x", FieldType::Integer},
+    {"y", FieldType::Integer},
+    {"target_x", FieldType::Integer},
+    {"target_y", FieldType::Integer},
+    {"target_player", FieldType::Integer},
+    {"destination_city_id", FieldType::Integer},
+    {"destination_owner_id", FieldType::Integer},
+    {"destination_x", FieldType::Integer},
+    {"destination_y", FieldType::Integer},
+    {"item", FieldType::String},
+    {"tech", FieldType::String},
+    {"civic", FieldType::String},
+    {"government", FieldType::String},
+    {"district", FieldType::String},
+    {"improvement", FieldType::String},
+    {"promotion", FieldType::String},
+    {"currency", FieldType::String},
+    {"war_type", FieldType::String},
+    {"response", FieldType::String},
+    {"reason", FieldType::String},
+    {"strategy_notes", FieldType::String},
+    {"tactical_notes", FieldType::String},
+    {"policies", FieldType::SlotMap},
+};
+
+const FieldRule* FindFieldRule(const std::string& name)
+{
+    for (const FieldRule& rule : kActionFieldRules)
+    {
+        if (name == rule.name)
+        {
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+/// Push a string of any length, joining pieces on the Lua side when it is too
+/// long to push at once
+void PushString(hks::lua_State* L, const std::string& value)
+{
+    if (value.length() <= kMaxPushLength)
+    {
+        hks::pushlstring(L, value.data(), value.length());
+        return;
+    }
+
+    int pending = 0;
+    for (size_t offset = 0; offset < value.length(); offset += kMaxPushLength)
+    {
+        size_t length = (std::min)(kMaxPushLength, value.length() - offset);
+        hks::pushlstring(L, value.data() + offset, length);
+        pending++;
+
+        if (pending == kMaxConcatPieces)
+        {
+            hks::concat(L, pending);
+            pending = 1;
+        }
+    }
+
+    if (pending > 1)
+    {
+        hks::concat(L, pending);
+    }
+}
+
+/// Parse an integer the way Lua's tonumber would accept it
+bool ParseInteger(const json& value, double& out)
+{
+    if (value.is_number())
+    {
+        out = value.get<double>();
+    }
+    else if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        char* end = nullptr;
+        out = std::strtod(text.c_str(), &end);
+        if (text.empty() || end != text.c_str() + text.length())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return std::isfinite(out) && out == std::floor(out);
+}
+
+/// Short JSON type name for validation messages
+const char* DescribeType(const json& value)
+{
+    if (value.is_number_float())
+    {
+        return "a fractional number";
+    }
+    if (value.is_number())
+    {
+        return "a number";
+    }
+    if (value.is_string())
+    {
+        return "a string";
+    }
+    if (value.is_boolean())
+    {
+        return "a boolean";
+    }
+    if (value.is_array())
+    {
+        return "an array";
+    }
+    if (value.is_object())
+    {
+        return "an object";
+    }
+    return "null";
+}
+
+/// Push any JSON value without validation (objects keep their string keys)
+void PushValue(hks::lua_State* L, const json& value, int depth, std::vector<std::string>& errors)
+{
+    if (depth >= kMaxDecodeDepth && value.is_structured())
+    {
+        errors.push_back("nesting exceeds " + std::to_string(kMaxDecodeDepth) + " levels, value dropped");
+        hks::pushnil(L);
+        return;
+    }
+
+    switch (value.type())
+    {
+    case json::value_t::boolean:
+        hks::pushboolean(L, value.get<bool>());
+        break;
+
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    case json::value_t::number_float:
+        hks::pushnumber(L, value.get<double>());
+        break;
+
+    case json::value_t::string:
+        PushString(L, value.get_ref<const std::string&>());
+        break;
+
+    case json::value_t::array:
+    {
+        hks::createtable(L, static_cast<int>(value.size()), 0);
+        int index = 1;
+        for (const json& element : value)
+        {
+            hks::pushnumber(L, static_cast<double>(index++));
+            PushValue(L, element, depth + 1, errors);
+            hks::settable(L, -3);
+        }
+        break;
+    }
+
+    case json::value_t::object:
+        hks::createtable(L, 0, static_cast<int>(value.size()));
+        for (const auto& [key, element] : value.items())
+        {
+            PushValue(L, element, depth + 1, errors);
+            hks::setfield(L, -2, key.c_str());
+        }
+        break;
+
+    default:
+        hks::pushnil(L);
+        break;
+    }
+}
+
+/// Push a policy slot map, accepting {"0": "POLICY_X"} or ["POLICY_X", ...] (slot 0 first)
+bool PushSlotMap(hks::lua_State* L, const json& value)
+{
+    if (!value.is_object() && !value.is_array())
+    {
+        return false;
+    }
+
+    hks::createtable(L, 0, static_cast<int>(value.size()));
+    int slot = 0;
+    for (const auto& [key, policy] : value.items())
+    {
+        double slotIndex = slot++;
+        if (value.is_object() && !ParseInteger(json(key), slotIndex))
+        {
+            continue;
+        }
+        if (!policy.is_string())
+        {
+            continue;
+        }
+
+        hks::pushnumber(L, slotIndex);
+        PushString(L, policy.get_ref<const std::string&>());
+        hks::settable(L, -3);
+    }
+    return true;
+}
+
+/// Push one action as a table, checking the types of known fields
+/// @return false if the action was rejected (nothing pushed)
+bool PushAction(hks::lua_State* L, const json& action, size_t position, int depth,
+                std::vector<std::string>& errors)
+{
+    std::string label = "action " + std::to_string(position);
+
+    if (!action.is_object())
+    {
+        errors.push_back(label + ": expected an object, got " + DescribeType(action));
+        return false;
+    }
+
+    auto name = action.find("action");
+    if (name == action.end() || !name->is_string())
+    {
+        errors.push_back(label + ": missing \"action\" name");
+        return false;
+    }
+    label += " (" + name->get<std::string>() + ")";
+
+    hks::createtable(L, 0, static_cast<int>(action.size()));
+    for (const auto& [key, value] : action.items())
+    {
+        const FieldRule* rule = FindFieldRule(key);
+        if (!rule || value.is_null())
+        {
+            PushValue(L, value, depth + 1, errors);
+            hks::setfield(L, -2, key.c_str());
+            continue;
+        }
+
+        bool valid = false;
+        switch (rule->type)
+        {
+        case FieldType::Integer:
+        {
+            double number = 0.0;
+            valid = ParseInteger(value, number);
+            if (valid)
+            {
+                hks::pushnumber(L, number);
+            }
+            break;
+        }
+
+        case FieldType::String:
+            valid = value.is_string();
+            if (valid)
+            {
+                PushString(L, value.get_ref<const std::string&>());
+            }
+            break;
+
+        case FieldType::SlotMap:
+            valid = PushSlotMap(L, value);
+            break;
+        }
+
+        if (valid)
+        {
+            hks::setfield(L, -2, key.c_str());
+        }
+        else
+        {
+            errors.push_back(label + ": " + key + " should be " +
+                (rule->type == FieldType::Integer ? "an integer" :
+                 rule->type == FieldType::String ? "a string" : "a slot map") +
+                ", got " + DescribeType(value));
+        }
+    }
+    return true;
+}
+
+/// Push the "actions" array, skipping rejected entries
+void PushActionList(hks::lua_State* L, const json& actions, int depth, size_t& outCount,
+                    std::vector<std::string>& errors)
+{
+    hks::createtable(L, static_cast<int>(actions.size()), 0);
+    outCount = 0;
+
+    size_t position = 0;
+    for (const json& action : actions)
+    {
+        position++;
+        hks::pushnumber(L, static_cast<double>(outCount + 1));
+        if (PushAction(L, action, position, depth + 1, errors))
+        {
+            hks::settable(L, -3);
+            outCount++;
+        }
+        else
+        {
+            hks::pop(L, 1);
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool IsEncoderAvailable()
+{
+    return hks::type && hks::next && hks::tolstring && hks::pushnil && hks::pop &&
+           hks::gettop && hks::objlen && hks::rawgeti && hks::tonumber && hks::toboolean;
+}
+
+bool EncodeValue(hks::lua_State* L, int index, std::string& out)
+{
+    if (!L || !IsEncoderAvailable())
+    {
+        return false;
+    }
+
+    EncodeAt(L, AbsoluteIndex(L, index), out, 0);
+    return true;
+}
+
+bool IsDecoderAvailable()
+{
+    return hks::createtable && hks::setfield && hks::settable && hks::pushnumber &&
+           hks::pushlstring && hks::pushnil && hks::concat && hks::pop;
+}
+
+int PushClaudeActions(hks::lua_State* L, const char* text, size_t length)
+{
+    if (!L || !text || !IsDecoderAvailable())
+    {
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    json document = json::parse(text, text + length, nullptr, false);
+    if (document.is_discarded() || !document.is_object())
+    {
+        Log(LogLevel::Error, "[DECODE] ERROR: Response is not a JSON object (" + std::to_string(length) + " bytes)");
+        hks::pushnil(L);
+        PushString(L, "Response is not a JSON object");
+        return 2;
+    }
+
+    std::vector<std::string> errors;
+    size_t actionCount = 0;
+
+    hks::createtable(L, 0, static_cast<int>(document.size()) + 1);
+
+    auto actions = document.find("actions");
+    if (actions != document.end())
+    {
+        if (actions->is_array())
+        {
+            PushActionList(L, *actions, 0, actionCount, errors);
+        }
+        else
+        {
+            errors.push_back("\"actions\" should be an array, got " + std::string(DescribeType(*actions)));
+            hks::createtable(L, 0, 0);
+        }
+        hks::setfield(L, -2, "actions");
+
+        for (const auto& [key, value] : document.items())
+        {
+            if (key != "actions")
+            {
+                PushValue(L, value, 1, errors);
+                hks::setfield(L, -2, key.c_str());
+            }
+        }
+    }
+    else if (document.contains("action"))
+    {
+        // Legacy single-action format
+        PushActionList(L, json::array({document}), 0, actionCount, errors);
+        hks::setfield(L, -2, "actions");
+    }
+    else
+    {
+        // Error responses and anything else without actions
+        hks::createtable(L, 0, 0);
+        hks::setfield(L, -2, "actions");
+
+        for (const auto& [key, value] : document.items())
+        {
+            PushValue(L, value, 1, errors);
+            hks::setfield(L, -2, key.c_str());
+        }
+    }
+
+    if (!errors.empty())
+    {
+        hks::createtable(L, static_cast<int>(errors.size()), 0);
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            Log(LogLevel::Warning, "[DECODE] WARNING: " + errors[i]);
+            hks::pushnumber(L, static_cast<double>(i + 1));
+            PushString(L, errors[i]);
+            hks::settable(L, -3);
+        }
+        hks::setfield(L, -2, "errors");
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Log("[DECODE] " + std::to_string(actionCount) + " actions, " + std::to_string(errors.size()) +
+        " validation errors from " + std::to_string(length) + " bytes in " +
+        std::to_string(elapsedMs) + " ms");
+    return 1;
+}
+
+} // namespace LuaJson
@@ -0,0 +1,53 @@
+#pragma once
+
+// ============================================================================
+// LuaJson.h - Native JSON Encoding and Decoding of Lua Values
+// Walks Lua tables through the hks API and writes JSON into a C++ buffer,
+// and builds Lua tables from Claude's JSON responses
+// ============================================================================
+
+#include <string>
+
+#include "HavokScript.h"
+
+namespace LuaJson
+{
+
+// ============================================================================
+// ENCODING
+// ============================================================================
+
+/// Check that the hks functions the encoder needs were resolved
+/// @return true if EncodeValue can be used
+[[nodiscard]] bool IsEncoderAvailable();
+
+/// Append the JSON encoding of a Lua value to a buffer
+/// @param L Lua state
+/// @param index Stack index of the value (relative or absolute)
+/// @param out Buffer to append to (not cleared, so callers can reuse its capacity)
+/// @return false if the encoder is unavailable (out is left unchanged)
+/// @note Output matches ClaudeAI.TableToJSON: sequences 1..n become arrays
+///       (empty tables are "[]"), everything else becomes an object
+/// @note Functions, userdata and nested tables past the depth limit encode as null
+[[nodiscard]] bool EncodeValue(hks::lua_State* L, int index, std::string& out);
+
+// ============================================================================
+// DECODING
+// ============================================================================
+
+/// Check that the hks functions the decoder needs were resolved
+/// @return true if PushClaudeActions can be used
+[[nodiscard]] bool IsDecoderAvailable();
+
+/// Parse a Claude response and push it onto the Lua stack as a table
+/// @param L Lua state
+/// @param text Response JSON ({"actions":[...]} or a single legacy action object)
+/// @param length Length of text in bytes
+/// @return Number of values pushed: the result table, or nil and an error message
+/// @note The table has an "actions" array plus the other top-level fields
+///       (e.g. "error", "streamed"). Known action fields are type-checked;
+///       mismatches are listed in an "errors" array and the field is dropped
+/// @note Actions without an "action" name are skipped and reported in "errors"
+[[nodiscard]] int PushClaudeActions(hks::lua_State* L, const char* text, size_t length);
+
+} // namespace LuaJson
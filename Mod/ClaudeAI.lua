@@ -15,12 +15,70 @@ ClaudeAI.Config = {
     -- Set to -1 to auto-detect the local human player
     -- Set to a specific ID (0, 1, 2, etc.) to control a specific player
     controlledPlayerID = -1,
+    -- Further player IDs Claude also controls (hot-seat and all-AI runs); their
+    -- requests run in parallel with the controlled player's
+    additionalPlayerIDs = {},
     -- Is Claude AI enabled?
     enabled = true,
     -- Enable debug logging
     debugLogging = true,
     -- Auto-process turns when it's Claude's turn (set to false to require manual trigger)
     autoProcessTurn = true,
+    -- Stream responses and start executing actions before the full reply has arrived
+    streamResponses = true,
+    -- Minimum level written to civ6_claude_hook.log: "debug", "info", "warning" or "error"
+    dllLogLevel = "info",
+    -- Serialize game state with the DLL's native encoder when it is available
+    nativeJsonEncoder = true,
+    -- Parse Claude's responses with the DLL's native decoder when it is available
+    nativeJsonDecoder = true,
+    -- Find plots near units and cities with the DLL's native index, re-serializing only changed plots
+    nativeTerrainIndex = true,
+    -- Send only the changes since a cached full snapshot, with a full snapshot every N turns
+    deltaGameState = true,
+    deltaKeyframeInterval = 10,
+    -- Send the state as column tables with a type-name dictionary (fewer input tokens)
+    compactGameState = false,
+    -- Estimated tokens a game state may use before the DLL trims low-priority parts (0 for no limit)
+    stateTokenBudget = 40000,
+    -- Build the turn-start game state across frames (at most serializeBudgetMs of work per frame)
+    -- instead of in one pass, so the game doesn't hitch; needs the native encoder
+    incrementalSerialization = true,
+    serializeBudgetMs = 4,
+    -- Pick the model and max_tokens per turn from the rules in the mod's model_routing.json
+    -- (routine turns to a small, fast model; wars, settlers and diplomacy escalate)
+    modelRouting = true,
+    -- Drop actions on units, cities, techs and civics the game state doesn't list before
+    -- they reach the handlers; the rejections are reported with the next request
+    validateActions = true,
+    -- Tokens of earlier turns (Claude's replies and action results) kept in the conversation; 0 disables
+    historyTokenBudget = 8000,
+    -- When a turn ends, ask Claude for a provisional plan for the next one; it is used
+    -- at turn start if our units, cities and wars haven't changed in between
+    speculativePrefetch = false,
+    -- Answer a game state the DLL has already seen (reloaded save, refired turn) from the
+    -- earlier reply; optionally also kept on disk in the mod's response_cache folder.
+    -- Off by default: its key needs the fully parsed state on every request
+    responseCache = false,
+    responseCacheOnDisk = false,
+    responseCacheTtlSeconds = 24 * 60 * 60,
+    -- Save each request's game state to the mod's recorded_states folder (benchmark corpus)
+    recordGameStates = false,
+    -- Record every API request body and raw response to a compressed file per game
+    -- (civ6_claude_requests_*.bin, capped at recordRequestsMaxMB), and optionally answer
+    -- requests from such a file instead of the network (a path, or false)
+    recordRequests = false,
+    recordRequestsMaxMB = 64,
+    replayRequestsFile = false,
+    -- Seconds before the DLL aborts a request (0 for none). Kept below ASYNC_TIMEOUT_SECONDS
+    -- so the DLL reports the failure before the Lua-side timeout gives up on it
+    requestDeadlineSeconds = 55,
+    -- Retries of rate-limited, overloaded or dropped API calls within one request, and the
+    -- seconds from the first attempt within which a retry may start (kept below the deadline)
+    retryAttempts = 3,
+    retryDeadlineSeconds = 40,
+    -- Speculative prefetches wait behind other players' turns at low priority, so they get longer
+    prefetchDeadlineSeconds = 180,
 }
 
 -- ============================================================================
@@ -49,7 +107,6 @@ local PROPERTY_KEYS = {
     -- Persistent data
     STRATEGY_NOTES = "ClaudeAI_StrategyNotes",
     TACTICAL_NOTES = "ClaudeAI_TacticalNotes",
-    LONG_RESPONSE = "ClaudeAI_LongResponse",
 }
 
 -- Keys for ExposedMembers (shared between contexts)
@@ -65,6 +122,7 @@ local LIMITS = {
     ASYNC_TIMEOUT_SECONDS = 60,
     POLL_LOG_INTERVAL = 500,  -- Log every N polls
     MAX_JSON_PREVIEW_LENGTH = 500,
+    TERRAIN_REFRESH_TURNS = 5,  -- Re-serialize every cached plot this often (yields change with techs and policies)
 }
 
 -- ============================================================================
@@ -327,8 +385,11 @@ function ClaudeAI.NotifyPlayerSet(playerID, civName, leaderName)
     end
 end
 
--- Clear all UI request properties (called at start and end of turn)
+-- Clear all UI request properties and queued UI commands (called at start of turn and on game load)
 function ClaudeAI.ClearUIRequestProperties()
+    if ClearUICommands then
+        ClearUICommands()
+    end
     if Game and Game.SetProperty then
         Game.SetProperty(PROPERTY_KEYS.REQUEST_END_TURN, 0)
         Game.SetProperty(PROPERTY_KEYS.REQUEST_RESEARCH, "")
@@ -358,8 +419,11 @@ function ClaudeAI.NotifyTurnEnded(playerID)
         LuaEvents.ClaudeAI_TurnEnded(playerID)
     end
 
-    -- Clear the thinking indicator (UI can't do this because SetProperty doesn't work there)
-    ClaudeAI.NotifyThinking(false)
+    -- Clear the thinking indicator (UI can't do this because SetProperty doesn't work there),
+    -- unless another Claude player is still waiting for its response
+    if not ClaudeAI.IsAnyPlayerWaiting() then
+        ClaudeAI.NotifyThinking(false)
+    end
 
     -- NOTE: Do NOT clear request properties here - UI needs time to poll and process them
     -- Properties are cleared at the start of the next turn in NotifyTurnStarted
@@ -383,102 +447,116 @@ function ClaudeAI.NotifyThinking(isThinking)
     end
 end
 
--- Request the UI context to end the turn (uses Game.SetProperty for cross-context communication)
-function ClaudeAI.RequestEndTurn()
-    ClaudeAI.Log("Requesting UI to end turn...")
+-- Send a request to the UI context. With the DLL's command queue the UI drains
+-- every request of a batch in one frame; otherwise each kind has its own Game
+-- property, polled separately (and a second request of a kind before the next
+-- poll replaces the first)
+-- payload uses the property's string format either way
+local function SendUIRequest(command, propertyKey, payload)
+    if PushUICommand then
+        if PushUICommand(command, tostring(payload)) then
+            ClaudeAI.Log("Queued UI command " .. command)
+            return true
+        end
+        ClaudeAI.Log("WARNING: UI command queue rejected " .. command)
+        return false
+    end
+
     if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_END_TURN, 1)
-        ClaudeAI.Log("Set REQUEST_END_TURN = 1")
+        Game.SetProperty(propertyKey, payload)
+        ClaudeAI.Log("Set " .. propertyKey)
         return true
-    else
-        ClaudeAI.Log("WARNING: Game.SetProperty not available")
-        return false
     end
+    ClaudeAI.Log("WARNING: Game.SetProperty not available")
+    return false
+end
+
+-- Log what the UI reported for the commands it executed since the last call
+function ClaudeAI.DrainUICommandResults()
+    if not DrainUICommandResults then
+        return
+    end
+
+    local results = DrainUICommandResults()
+    if not results or #results == 0 then
+        return
+    end
+
+    local failures = {}
+    for _, result in ipairs(results) do
+        if result.payload ~= "ok" then
+            table.insert(failures, tostring(result.name) .. " (" .. tostring(result.payload) .. ")")
+        end
+    end
+    ClaudeAI.Log("[UI QUEUE] UI executed " .. #results .. " commands" ..
+        (#failures > 0 and (", failed: " .. table.concat(failures, ", ")) or ""))
+end
+
+-- Request the UI context to end the turn
+function ClaudeAI.RequestEndTurn()
+    ClaudeAI.Log("Requesting UI to end turn...")
+    return SendUIRequest("end_turn", PROPERTY_KEYS.REQUEST_END_TURN, 1)
 end
 
 -- Request the UI context to set research (for human players, dismisses modal)
 function ClaudeAI.RequestResearch(playerID, techHash)
     ClaudeAI.Log("Requesting UI to set research: " .. tostring(techHash))
-    if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_RESEARCH, tostring(playerID) .. "," .. tostring(techHash))
-        ClaudeAI.Log("Set REQUEST_RESEARCH")
-        return true
-    end
-    return false
+    return SendUIRequest("research", PROPERTY_KEYS.REQUEST_RESEARCH, tostring(playerID) .. "," .. tostring(techHash))
 end
 
 -- Request the UI context to set civic (for human players, dismisses modal)
 function ClaudeAI.RequestCivic(playerID, civicHash)
     ClaudeAI.Log("Requesting UI to set civic: " .. tostring(civicHash))
-    if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_CIVIC, tostring(playerID) .. "," .. tostring(civicHash))
-        ClaudeAI.Log("Set REQUEST_CIVIC")
-        return true
-    end
-    return false
+    return SendUIRequest("civic", PROPERTY_KEYS.REQUEST_CIVIC, tostring(playerID) .. "," .. tostring(civicHash))
 end
 
 -- Request the UI context to set city production (for human players)
 function ClaudeAI.RequestProduction(playerID, cityID, productionType, productionHash)
     ClaudeAI.Log("Requesting UI to set production: " .. tostring(productionType) .. " hash=" .. tostring(productionHash))
-    if Game and Game.SetProperty then
-        local requestStr = tostring(playerID) .. "," .. tostring(cityID) .. "," .. tostring(productionType) .. "," .. tostring(productionHash)
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_PRODUCTION, requestStr)
-        ClaudeAI.Log("Set REQUEST_PRODUCTION")
-        return true
-    end
-    return false
+    local requestStr = tostring(playerID) .. "," .. tostring(cityID) .. "," ..
+        tostring(productionType) .. "," .. tostring(productionHash)
+    return SendUIRequest("production", PROPERTY_KEYS.REQUEST_PRODUCTION, requestStr)
 end
 
 -- Request the UI context to change government (for human players)
 function ClaudeAI.RequestGovernment(playerID, governmentHash)
     ClaudeAI.Log("Requesting UI to change government: hash=" .. tostring(governmentHash))
-    if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_GOVERNMENT, tostring(playerID) .. "," .. tostring(governmentHash))
-        ClaudeAI.Log("Set REQUEST_GOVERNMENT")
-        return true
-    end
-    return false
+    return SendUIRequest("government", PROPERTY_KEYS.REQUEST_GOVERNMENT,
+        tostring(playerID) .. "," .. tostring(governmentHash))
 end
 
 -- Request the UI context to set policies (for human players)
 -- policyAssignments is a table: {[slotIndex] = policyHash, ...}
 function ClaudeAI.RequestPolicy(playerID, policyAssignments)
     ClaudeAI.Log("Requesting UI to set policies")
-    if Game and Game.SetProperty then
-        local parts = {tostring(playerID)}
-        for slotIndex, policyHash in pairs(policyAssignments) do
-            table.insert(parts, tostring(slotIndex) .. ":" .. tostring(policyHash))
-        end
-        local requestStr = table.concat(parts, ",")
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_POLICY, requestStr)
-        ClaudeAI.Log("Set REQUEST_POLICY: " .. requestStr)
-        return true
+    local parts = {tostring(playerID)}
+    for slotIndex, policyHash in pairs(policyAssignments) do
+        table.insert(parts, tostring(slotIndex) .. ":" .. tostring(policyHash))
     end
-    return false
+    local requestStr = table.concat(parts, ",")
+    ClaudeAI.Log("Policy request: " .. requestStr)
+    return SendUIRequest("policy", PROPERTY_KEYS.REQUEST_POLICY, requestStr)
 end
 
 -- Request the UI to dismiss blocking notifications (research/civic completed, etc.)
 function ClaudeAI.RequestDismissNotifications()
     ClaudeAI.Log("Requesting UI to dismiss blocking notifications")
-    if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.DISMISS_NOTIFICATIONS, 1)
-        ClaudeAI.Log("Set DISMISS_NOTIFICATIONS = 1")
-        return true
-    end
-    return false
+    return SendUIRequest("dismiss_notifications", PROPERTY_KEYS.DISMISS_NOTIFICATIONS, 1)
 end
 
 -- Request the UI to perform a diplomacy action
 -- Actions: "dismiss", "respond,playerID,responseType", "declare_war,playerID", "make_peace,playerID"
 function ClaudeAI.RequestDiplomacyAction(actionStr)
     ClaudeAI.Log("Requesting diplomacy action: " .. tostring(actionStr))
-    if Game and Game.SetProperty then
-        Game.SetProperty(PROPERTY_KEYS.REQUEST_DIPLOMACY, actionStr)
-        ClaudeAI.Log("Set REQUEST_DIPLOMACY = " .. actionStr)
-        return true
-    end
-    return false
+    return SendUIRequest("diplomacy", PROPERTY_KEYS.REQUEST_DIPLOMACY, actionStr)
+end
+
+-- Request the UI to place a district (for human players)
+-- Format: playerID,cityID,districtHash,plotX,plotY
+function ClaudeAI.RequestPlaceDistrict(playerID, cityID, districtHash, plotX, plotY)
+    local requestStr = playerID .. "," .. cityID .. "," .. districtHash .. "," .. plotX .. "," .. plotY
+    ClaudeAI.Log("Requesting UI to place district: " .. requestStr)
+    return SendUIRequest("place_district", PROPERTY_KEYS.REQUEST_PLACE_DISTRICT, requestStr)
 end
 
 -- Enable/disable auto-dismiss of diplomacy popups (first meeting, etc.)
@@ -683,6 +761,18 @@ function ClaudeAI.ClearTacticalNotes()
     ClaudeAI.SetTacticalNotes("")
 end
 
+-- Encode a table as JSON, preferring the DLL's native EncodeJSON when available
+function ClaudeAI.EncodeJSON(tbl)
+    if EncodeJSON and ClaudeAI.Config.nativeJsonEncoder then
+        local json = EncodeJSON(tbl)
+        if json then
+            return json
+        end
+        ClaudeAI.Log("WARNING: Native EncodeJSON failed, falling back to TableToJSON")
+    end
+    return ClaudeAI.TableToJSON(tbl)
+end
+
 -- JSON encoder for Lua tables (Civ6 doesn't have built-in JSON)
 function ClaudeAI.TableToJSON(tbl, indent)
     indent = indent or 0
@@ -804,6 +894,21 @@ end
 function ClaudeAI.DecodeJSON(jsonStr)
     if not jsonStr or jsonStr == "" then return nil end
 
+    -- The DLL parses the whole response at once, keeps every field and reports type errors
+    if DecodeClaudeActions and ClaudeAI.Config.nativeJsonDecoder then
+        local decoded, err = DecodeClaudeActions(jsonStr)
+        if decoded then
+            if decoded.errors then
+                for _, message in ipairs(decoded.errors) do
+                    ClaudeAI.Log("WARNING: Response validation: " .. message)
+                end
+            end
+            ClaudeAI.Log("Decoded " .. #decoded.actions .. " actions (native)")
+            return decoded
+        end
+        ClaudeAI.Log("WARNING: Native decode failed (" .. tostring(err) .. "), using pattern decoder")
+    end
+
     local result = { actions = {} }
 
     ClaudeAI.Log("DEBUG DecodeJSON: input length = " .. #jsonStr)
@@ -1249,73 +1354,216 @@ function ClaudeAI.SerializePlot(pPlot, playerID)
     return result
 end
 
--- Get visible terrain around all units (within a certain radius)
+-- Serialized plots from earlier turns, reused while a plot's signature is unchanged
+-- ClaudeAI.TerrainCache[playerID][plotIndex] = table from SerializePlot
+ClaudeAI.TerrainCache = {}
+
+-- Fingerprint of the plot fields that change during a game (improvements built,
+-- features cleared, cities founded); yield changes are caught by the periodic refresh
+local function GetPlotSignature(pPlot)
+    local feature = pPlot:GetFeatureType() + 1
+    local resource = pPlot:GetResourceType() + 1
+    local improvement = pPlot:GetImprovementType() + 1
+    local city = pPlot:IsCity() and 1 or 0
+    return (((pPlot:GetTerrainType() * 256 + feature) * 256 + resource) * 256 + improvement) * 2 + city
+end
+
+-- Get visible terrain around all units and cities (within a certain radius)
 function ClaudeAI.GetVisibleTerrain(playerID, radius)
-    radius = radius or 3  -- Default 3 tile radius around units
+    local walk = ClaudeAI.NewTerrainWalk(playerID, radius)
+    ClaudeAI.StepTerrainWalk(walk, math.huge)
+    return walk.visiblePlots
+end
 
-    local visiblePlots = {}
-    local seenPlots = {}  -- Track already serialized plots to avoid duplicates
-    local pPlayer = Players[playerID]
+-- Start a terrain walk. StepTerrainWalk runs it in slices, so the incremental
+-- build can stop at its frame budget and carry on from the same plot next tick
+-- Uses the DLL's plot index when available, otherwise scans a square around each position in Lua
+function ClaudeAI.NewTerrainWalk(playerID, radius)
+    return {
+        playerID = playerID,
+        radius = radius or 3,  -- Default 3 tile radius around units
+        phase = "start",
+        cursor = 1,
+        visiblePlots = {},
+    }
+end
 
-    if not pPlayer then return visiblePlots end
+-- Phases of a terrain walk: each returns the next phase, or nil if it stopped at
+-- the deadline (walk.cursor then says where it resumes)
+local TerrainWalkPhases = {}
 
-    local pVisibility = PlayersVisibility[playerID]
+-- Work on the walk until os.clock() reaches deadline (always at least one plot)
+-- Returns true once walk.visiblePlots is complete
+function ClaudeAI.StepTerrainWalk(walk, deadline)
+    while walk.phase ~= "done" do
+        local nextPhase = TerrainWalkPhases[walk.phase](walk, deadline)
+        if not nextPhase then
+            return false
+        end
+        walk.phase = nextPhase
+    end
+    return true
+end
 
-    -- Get terrain around each unit
+-- Native path: hex neighborhoods from GetPlotsInRange, and only plots that GetChangedPlots
+-- reports (or that aren't cached yet) go through SerializePlot
+function TerrainWalkPhases.start(walk)
+    local pPlayer = Players[walk.playerID]
+    if not pPlayer then return "done" end
+    if not (GetPlotsInRange and GetChangedPlots and ClaudeAI.Config.nativeTerrainIndex) then
+        return "luaStart"
+    end
+    if not Map.GetGridSize or not Map.GetPlotByIndex then
+        ClaudeAI.Log("WARNING: Native plot index failed, falling back to Lua terrain scan")
+        return "luaStart"
+    end
+
+    -- Flat {x1, y1, x2, y2, ...} list of unit and city positions
+    local positions = {}
     local pUnits = pPlayer:GetUnits()
     if pUnits and pUnits.Members then
         for _, pUnit in pUnits:Members() do
-            local unitX = pUnit:GetX()
-            local unitY = pUnit:GetY()
+            positions[#positions + 1] = pUnit:GetX()
+            positions[#positions + 1] = pUnit:GetY()
+        end
+    end
+    local pCities = pPlayer:GetCities()
+    if pCities and pCities.Members then
+        for _, pCity in pCities:Members() do
+            positions[#positions + 1] = pCity:GetX()
+            positions[#positions + 1] = pCity:GetY()
+        end
+    end
 
-            for dx = -radius, radius do
-                for dy = -radius, radius do
-                    local plotX = unitX + dx
-                    local plotY = unitY + dy
-                    local plotKey = plotX .. "," .. plotY
+    local width, height = Map.GetGridSize()
+    local wrapX = Map.IsWrapX and Map.IsWrapX() or false
+    walk.plotIndices = GetPlotsInRange(width, height, wrapX, walk.radius, positions)
+    if not walk.plotIndices then
+        ClaudeAI.Log("WARNING: Native plot index failed, falling back to Lua terrain scan")
+        return "luaStart"
+    end
 
-                    if not seenPlots[plotKey] then
-                        local pPlot = Map.GetPlot(plotX, plotY)
-                        if pPlot then
-                            -- Check if plot is visible to player
-                            local isVisible = true
-                            if pVisibility then
-                                pcall(function()
-                                    isVisible = pVisibility:IsVisible(plotX, plotY) or pVisibility:IsRevealed(plotX, plotY)
-                                end)
-                            end
+    walk.indices, walk.signatures, walk.pPlots = {}, {}, {}
+    walk.cursor = 1
+    return "filter"
+end
 
-                            if isVisible then
-                                local plotData = ClaudeAI.SerializePlot(pPlot, playerID)
-                                if plotData then
-                                    table.insert(visiblePlots, plotData)
-                                    seenPlots[plotKey] = true
-                                end
-                            end
-                        end
-                    end
-                end
+-- Keep revealed plots and fingerprint them for the change check. As on the Lua
+-- path, a plot whose visibility check errors is kept rather than failing the build
+function TerrainWalkPhases.filter(walk, deadline)
+    local pVisibility = PlayersVisibility[walk.playerID]
+    local function IsPlotKnown(x, y)
+        return pVisibility:IsVisible(x, y) or pVisibility:IsRevealed(x, y)
+    end
+    local plotIndices, indices = walk.plotIndices, walk.indices
+    while walk.cursor <= #plotIndices do
+        local plotIndex = plotIndices[walk.cursor]
+        local pPlot = Map.GetPlotByIndex(plotIndex)
+        if pPlot then
+            local x, y = pPlot:GetX(), pPlot:GetY()
+            local ok, known = true, true
+            if pVisibility then
+                ok, known = pcall(IsPlotKnown, x, y)
+            end
+            if not ok or known then
+                local count = #indices + 1
+                indices[count] = plotIndex
+                walk.signatures[count] = GetPlotSignature(pPlot)
+                walk.pPlots[count] = pPlot
             end
         end
+        walk.cursor = walk.cursor + 1
+        if os.clock() >= deadline then return nil end
+    end
+
+    local epoch = math.floor(Game.GetCurrentGameTurn() / LIMITS.TERRAIN_REFRESH_TURNS)
+    walk.changed = GetChangedPlots(walk.playerID, epoch, indices, walk.signatures)
+    walk.isChanged = {}
+    for _, position in ipairs(walk.changed or {}) do
+        walk.isChanged[position] = true
     end
 
-    -- Also get terrain around cities
+    -- The DLL outlives the Lua state across loads, so a missing cache entry is also re-serialized
+    walk.cache = ClaudeAI.TerrainCache[walk.playerID] or {}
+    walk.newCache = {}
+    walk.serialized = 0
+    walk.cursor = 1
+    return "serialize"
+end
+
+function TerrainWalkPhases.serialize(walk, deadline)
+    local indices, visiblePlots = walk.indices, walk.visiblePlots
+    while walk.cursor <= #indices do
+        local position = walk.cursor
+        local plotIndex = indices[position]
+        local plotData = walk.cache[plotIndex]
+        if not plotData or not walk.changed or walk.isChanged[position] then
+            plotData = ClaudeAI.SerializePlot(walk.pPlots[position], walk.playerID)
+            walk.serialized = walk.serialized + 1
+        end
+        if plotData then
+            walk.newCache[plotIndex] = plotData
+            visiblePlots[#visiblePlots + 1] = plotData
+        end
+        walk.cursor = position + 1
+        if os.clock() >= deadline then return nil end
+    end
+    ClaudeAI.TerrainCache[walk.playerID] = walk.newCache
+
+    ClaudeAI.Log("Terrain: " .. #visiblePlots .. " plots, " .. walk.serialized .. " serialized")
+    return "done"
+end
+
+-- Lua path: scans a (2r+1)^2 square around each unit and city
+function TerrainWalkPhases.luaStart(walk)
+    local pPlayer = Players[walk.playerID]
+    if not pPlayer then return "done" end
+
+    -- Plots around units are checked for visibility, plots around cities always count
+    local centers = {}
+    local pUnits = pPlayer:GetUnits()
+    if pUnits and pUnits.Members then
+        for _, pUnit in pUnits:Members() do
+            centers[#centers + 1] = { x = pUnit:GetX(), y = pUnit:GetY(), checkVisibility = true }
+        end
+    end
     local pCities = pPlayer:GetCities()
     if pCities and pCities.Members then
         for _, pCity in pCities:Members() do
-            local cityX = pCity:GetX()
-            local cityY = pCity:GetY()
+            centers[#centers + 1] = { x = pCity:GetX(), y = pCity:GetY(), checkVisibility = false }
+        end
+    end
 
-            for dx = -radius, radius do
-                for dy = -radius, radius do
-                    local plotX = cityX + dx
-                    local plotY = cityY + dy
-                    local plotKey = plotX .. "," .. plotY
+    walk.centers = centers
+    walk.seenPlots = {}  -- Track already serialized plots to avoid duplicates
+    walk.cursor = 1
+    return "luaScan"
+end
 
-                    if not seenPlots[plotKey] then
-                        local pPlot = Map.GetPlot(plotX, plotY)
-                        if pPlot then
-                            local plotData = ClaudeAI.SerializePlot(pPlot, playerID)
+function TerrainWalkPhases.luaScan(walk, deadline)
+    local pVisibility = PlayersVisibility[walk.playerID]
+    local radius, seenPlots, visiblePlots = walk.radius, walk.seenPlots, walk.visiblePlots
+    while walk.cursor <= #walk.centers do
+        local center = walk.centers[walk.cursor]
+        for dx = -radius, radius do
+            for dy = -radius, radius do
+                local plotX = center.x + dx
+                local plotY = center.y + dy
+                local plotKey = plotX .. "," .. plotY
+
+                if not seenPlots[plotKey] then
+                    local pPlot = Map.GetPlot(plotX, plotY)
+                    if pPlot then
+                        -- Check if plot is visible to player
+                        local isVisible = true
+                        if center.checkVisibility and pVisibility then
+                            pcall(function()
+                                isVisible = pVisibility:IsVisible(plotX, plotY) or pVisibility:IsRevealed(plotX, plotY)
+                            end)
+                        end
+
+                        if isVisible then
+                            local plotData = ClaudeAI.SerializePlot(pPlot, walk.playerID)
                             if plotData then
                                 table.insert(visiblePlots, plotData)
                                 seenPlots[plotKey] = true
@@ -1325,9 +1573,10 @@ function ClaudeAI.GetVisibleTerrain(playerID, radius)
                 end
             end
         end
+        walk.cursor = walk.cursor + 1
+        if os.clock() >= deadline then return nil end
     end
-
-    return visiblePlots
+    return "done"
 end
 
 -- ============================================================================
@@ -1485,6 +1734,48 @@ function ClaudeAI.SerializeCity(pCity, playerID)
     return result
 end
 
+-- Get the set of traits the player's civilization and leader grant (their unique items' TraitType)
+function ClaudeAI.GetPlayerTraits(playerID)
+    local traits = {}
+    pcall(function()
+        local config = PlayerConfigurations and PlayerConfigurations[playerID]
+        if not config then return end
+        local civType = config:GetCivilizationTypeName()
+        local leaderType = config:GetLeaderTypeName()
+        if GameInfo.CivilizationTraits then
+            for row in GameInfo.CivilizationTraits() do
+                if row.CivilizationType == civType then traits[row.TraitType] = true end
+            end
+        end
+        if GameInfo.LeaderTraits then
+            for row in GameInfo.LeaderTraits() do
+                if row.LeaderType == leaderType then traits[row.TraitType] = true end
+            end
+        end
+    end)
+    return traits
+end
+
+-- Get the set of base unit, building and district types the player's unique items replace
+function ClaudeAI.GetReplacedItems(playerTraits)
+    local replaced = {}
+    local function addReplacements(replaceTable, infoTable, uniqueField, baseField)
+        if not replaceTable or not infoTable then return end
+        for row in replaceTable() do
+            local unique = infoTable[row[uniqueField]]
+            if unique and unique.TraitType and playerTraits[unique.TraitType] then
+                replaced[row[baseField]] = true
+            end
+        end
+    end
+    pcall(function()
+        addReplacements(GameInfo.UnitReplaces, GameInfo.Units, "CivUniqueUnitType", "ReplacesUnitType")
+        addReplacements(GameInfo.BuildingReplaces, GameInfo.Buildings, "CivUniqueBuildingType", "ReplacesBuildingType")
+        addReplacements(GameInfo.DistrictReplaces, GameInfo.Districts, "CivUniqueDistrictType", "ReplacesDistrictType")
+    end)
+    return replaced
+end
+
 -- Check if player meets tech prerequisite
 function ClaudeAI.HasTechPrereq(playerID, prereqTech)
     if not prereqTech then return true end  -- No prereq = always available
@@ -1792,7 +2083,10 @@ function ClaudeAI.GetUnitStrategicResource(unitType)
     return resource
 end
 
--- Get buildable items for a city by checking all prerequisites
+-- Get buildable items for a city
+-- Asks the city's build queue (CanProduce) when this context has it and marks the lists
+-- verified; otherwise they come from the prerequisite checks below, which only approximate
+-- the game's rules, and the DLL treats them as advisory
 function ClaudeAI.GetCityBuildables(pCity, playerID)
     local buildables = {
         units = {},
@@ -1805,14 +2099,45 @@ function ClaudeAI.GetCityBuildables(pCity, playerID)
     local cityPopulation = 1
     pcall(function() cityPopulation = pCity:GetPopulation() end)
 
+    -- Unique items (TraitType) are listed only for the civ and leader they belong to,
+    -- and the base items they replace aren't listed for that civ
+    local playerTraits = ClaudeAI.GetPlayerTraits(playerID)
+    local replaced = ClaudeAI.GetReplacedItems(playerTraits)
+    local function isOtherCivsUnique(row)
+        return row.TraitType ~= nil and not playerTraits[row.TraitType]
+    end
+
+    -- The game's own answer, or nil if the queue can't say (then the heuristic decides)
+    local pBuildQueue = SafeGet(pCity, "GetBuildQueue")
+    local verified = pBuildQueue ~= nil and pBuildQueue.CanProduce ~= nil
+    local function gameAllows(row)
+        if not verified then return nil end
+        local ok, allowed = pcall(pBuildQueue.CanProduce, pBuildQueue, row.Hash, true)
+        if not ok then
+            verified = false
+            return nil
+        end
+        return allowed == true
+    end
+
+    -- The DLL checks "build" actions against these lists, so mark them if any part failed
+    local function collect(fn)
+        local ok, err = pcall(fn)
+        if not ok then
+            buildables.partial = true
+            ClaudeAI.Log("WARNING: Error listing buildables: " .. tostring(err))
+        end
+    end
+
     -- Get all units the player can potentially build
-    pcall(function()
+    collect(function()
         if GameInfo.Units then
             for row in GameInfo.Units() do
-                -- Skip if it's a unique unit (has TraitType) - these are civ-specific
-                local dominated = row.TraitType ~= nil
+                -- Skip other civs' unique units and the units ours replace
+                local dominated = isOtherCivsUnique(row) or replaced[row.UnitType]
+                local allowed = not dominated and gameAllows(row)
 
-                if not dominated then
+                if allowed == nil then
                     local hasTech = ClaudeAI.HasTechPrereq(playerID, row.PrereqTech)
                     local hasCivic = ClaudeAI.HasCivicPrereq(playerID, row.PrereqCivic)
 
@@ -1826,25 +2151,28 @@ function ClaudeAI.GetCityBuildables(pCity, playerID)
                         canAffordPop = false
                     end
 
-                    if hasTech and hasCivic and hasResource and canAffordPop then
-                        table.insert(buildables.units, {
-                            type = row.UnitType,
-                            cost = row.Cost,
-                        })
-                    end
+                    allowed = hasTech and hasCivic and hasResource and canAffordPop
+                end
+
+                if allowed then
+                    table.insert(buildables.units, {
+                        type = row.UnitType,
+                        cost = row.Cost,
+                    })
                 end
             end
         end
     end)
 
     -- Get all buildings (filter by all prereqs)
-    pcall(function()
+    collect(function()
         if GameInfo.Buildings then
             for row in GameInfo.Buildings() do
-                -- Skip wonders (IsWonder) and unique buildings (TraitType)
-                local dominated = row.IsWonder or row.TraitType ~= nil
+                -- Skip wonders (IsWonder), other civs' unique buildings and the buildings ours replace
+                local dominated = row.IsWonder or isOtherCivsUnique(row) or replaced[row.BuildingType]
+                local allowed = not dominated and gameAllows(row)
 
-                if not dominated then
+                if allowed == nil then
                     local hasTech = ClaudeAI.HasTechPrereq(playerID, row.PrereqTech)
                     local hasCivic = ClaudeAI.HasCivicPrereq(playerID, row.PrereqCivic)
 
@@ -1854,50 +2182,56 @@ function ClaudeAI.GetCityBuildables(pCity, playerID)
                     -- Check if city already has this building
                     local alreadyHas = ClaudeAI.CityHasBuilding(pCity, row.BuildingType)
 
-                    if hasTech and hasCivic and hasDistrict and not alreadyHas then
-                        table.insert(buildables.buildings, {
-                            type = row.BuildingType,
-                            cost = row.Cost,
-                        })
-                    end
+                    allowed = hasTech and hasCivic and hasDistrict and not alreadyHas
+                end
+
+                if allowed then
+                    table.insert(buildables.buildings, {
+                        type = row.BuildingType,
+                        cost = row.Cost,
+                    })
                 end
             end
         end
     end)
 
     -- Get all districts (filter by tech/civic prereqs and not already built)
-    pcall(function()
+    collect(function()
         if GameInfo.Districts then
+            -- Approximate district limit: one at population 1, another every 3 population.
+            -- GetNumDistricts counts the city center, which doesn't take a slot
+            local specialtyDistricts = 0
+            pcall(function()
+                local pDistricts = pCity:GetDistricts()
+                if pDistricts then
+                    specialtyDistricts = math.max(pDistricts:GetNumDistricts() - 1, 0)
+                end
+            end)
+            local canBuildMore = specialtyDistricts < math.floor((cityPopulation + 2) / 3)
+
             for row in GameInfo.Districts() do
-                -- Skip unique districts (TraitType) and special districts
-                local dominated = row.TraitType ~= nil
+                -- Skip other civs' unique districts, the districts ours replace and special districts
+                local dominated = isOtherCivsUnique(row)
+                    or replaced[row.DistrictType]
                     or row.DistrictType == "DISTRICT_CITY_CENTER"
                     or row.DistrictType == "DISTRICT_WONDER"
+                local allowed = not dominated and gameAllows(row)
 
-                if not dominated then
+                if allowed == nil then
                     local hasTech = ClaudeAI.HasTechPrereq(playerID, row.PrereqTech)
                     local hasCivic = ClaudeAI.HasCivicPrereq(playerID, row.PrereqCivic)
 
                     -- Check if city already has this district
                     local alreadyHas = ClaudeAI.CityHasDistrict(pCity, row.DistrictType)
 
-                    -- Check population requirement for districts (1 district per 3 pop, roughly)
-                    -- This is approximate - actual formula is more complex
-                    local districtCount = 0
-                    pcall(function()
-                        local pDistricts = pCity:GetDistricts()
-                        if pDistricts then
-                            districtCount = pDistricts:GetNumDistricts()
-                        end
-                    end)
-                    local canBuildMore = (cityPopulation >= districtCount * 3) or districtCount == 0
+                    allowed = hasTech and hasCivic and not alreadyHas and canBuildMore
+                end
 
-                    if hasTech and hasCivic and not alreadyHas and canBuildMore then
-                        table.insert(buildables.districts, {
-                            type = row.DistrictType,
-                            cost = row.Cost,
-                        })
-                    end
+                if allowed then
+                    table.insert(buildables.districts, {
+                        type = row.DistrictType,
+                        cost = row.Cost,
+                    })
                 end
             end
         end
@@ -1905,10 +2239,12 @@ function ClaudeAI.GetCityBuildables(pCity, playerID)
 
     -- Get wonders (only if prereqs met and not already built globally)
     buildables.wonders = {}
-    pcall(function()
+    collect(function()
         if GameInfo.Buildings then
             for row in GameInfo.Buildings() do
-                if row.IsWonder then
+                local allowed = row.IsWonder and gameAllows(row)
+
+                if allowed == nil then
                     local hasTech = ClaudeAI.HasTechPrereq(playerID, row.PrereqTech)
                     local hasCivic = ClaudeAI.HasCivicPrereq(playerID, row.PrereqCivic)
 
@@ -1918,17 +2254,22 @@ function ClaudeAI.GetCityBuildables(pCity, playerID)
                     -- Check if wonder has already been built anywhere in the world
                     local alreadyBuilt = ClaudeAI.IsWonderBuilt(row.BuildingType)
 
-                    if hasTech and hasCivic and hasDistrict and not alreadyBuilt then
-                        table.insert(buildables.wonders, {
-                            type = row.BuildingType,
-                            cost = row.Cost,
-                        })
-                    end
+                    allowed = hasTech and hasCivic and hasDistrict and not alreadyBuilt
+                end
+
+                if allowed then
+                    table.insert(buildables.wonders, {
+                        type = row.BuildingType,
+                        cost = row.Cost,
+                    })
                 end
             end
         end
     end)
 
+    -- Only lists the game produced end to end may be used to reject a build
+    buildables.verified = verified or nil
+
     return buildables
 end
 
@@ -2715,50 +3056,49 @@ end
 
 -- ============================================================================
 -- MAIN GAME STATE FUNCTION
+-- The state is built in steps, each filling some top-level fields. BuildGameState
+-- runs them all at once; the incremental serializer spreads them over frames
 -- ============================================================================
 
-function ClaudeAI.GetGameState(playerID)
-    local pPlayer = Players[playerID]
-    if not pPlayer then
-        return '{"error":"Invalid player ID"}'
-    end
-
-    ClaudeAI.Log("Gathering game state for player " .. playerID)
+-- Turn, player identity and the player's own summary
+local function BuildPlayerSection(playerID, pPlayer, fields)
+    fields.turn = Game.GetCurrentGameTurn()
+    fields.playerID = playerID
+    fields.player = ClaudeAI.SerializePlayerState(playerID)
+end
 
-    -- Get civics with current civic info
+-- Techs and civics that can be researched
+local function BuildResearchSection(playerID, pPlayer, fields)
     local availableCivics, currentCivic, currentCivicTurns = ClaudeAI.GetAvailableCivics(playerID)
+    fields.availableTechs = ClaudeAI.GetAvailableTechs(playerID)
+    fields.availableCivics = availableCivics
+    -- Current civic being researched (important: don't switch away from this!)
+    fields.currentCivic = currentCivic
+    fields.currentCivicTurns = currentCivicTurns
+end
 
-    local gameState = {
-        turn = Game.GetCurrentGameTurn(),
-        playerID = playerID,
-        player = ClaudeAI.SerializePlayerState(playerID),
-        cities = {},
-        units = {},
-        visibleEnemyUnits = {},
-        visibleEnemyCities = {},
-        availableTechs = ClaudeAI.GetAvailableTechs(playerID),
-        availableCivics = availableCivics,
-        -- Current civic being researched (important: don't switch away from this!)
-        currentCivic = currentCivic,
-        currentCivicTurns = currentCivicTurns,
-        -- Government info gathered from UI context via ExposedMembers
-        -- (PlayerCulture APIs only work in UI context)
-        governmentInfo = ClaudeAI.GetGovernmentInfoFromUI(),
-        -- Diplomacy info - met players, wars, alliances, etc.
-        diplomacy = ClaudeAI.SerializeDiplomacy(playerID),
-        -- Re-enabled: These only use Game.GetProperty which is safe
-        strategyNotes = ClaudeAI.GetStrategyNotes(),
-        tacticalNotes = ClaudeAI.GetTacticalNotes(),
-    }
+-- Government, diplomacy and Claude's own notes
+local function BuildPoliticsSection(playerID, pPlayer, fields)
+    -- Government info gathered from UI context via ExposedMembers
+    -- (PlayerCulture APIs only work in UI context)
+    fields.governmentInfo = ClaudeAI.GetGovernmentInfoFromUI()
+    -- Diplomacy info - met players, wars, alliances, etc.
+    fields.diplomacy = ClaudeAI.SerializeDiplomacy(playerID)
+    -- Re-enabled: These only use Game.GetProperty which is safe
+    fields.strategyNotes = ClaudeAI.GetStrategyNotes()
+    fields.tacticalNotes = ClaudeAI.GetTacticalNotes()
+end
 
-    -- Serialize own cities (with error handling)
+-- Serialize own cities (with error handling)
+local function BuildCitiesSection(playerID, pPlayer, fields)
+    fields.cities = {}
     local success, err = pcall(function()
         local pCities = pPlayer:GetCities()
         if pCities and pCities.Members then
             for _, pCity in pCities:Members() do
                 local cityData = ClaudeAI.SerializeCity(pCity, playerID)
                 if cityData then
-                    table.insert(gameState.cities, cityData)
+                    table.insert(fields.cities, cityData)
                 end
             end
         end
@@ -2766,15 +3106,18 @@ function ClaudeAI.GetGameState(playerID)
     if not success then
         ClaudeAI.Log("WARNING: Error serializing cities: " .. tostring(err))
     end
+end
 
-    -- Serialize own units (with error handling)
-    success, err = pcall(function()
+-- Serialize own units (with error handling)
+local function BuildUnitsSection(playerID, pPlayer, fields)
+    fields.units = {}
+    local success, err = pcall(function()
         local pUnits = pPlayer:GetUnits()
         if pUnits and pUnits.Members then
             for _, pUnit in pUnits:Members() do
                 local unitData = ClaudeAI.SerializeUnit(pUnit)
                 if unitData then
-                    table.insert(gameState.units, unitData)
+                    table.insert(fields.units, unitData)
                 end
             end
         end
@@ -2782,9 +3125,13 @@ function ClaudeAI.GetGameState(playerID)
     if not success then
         ClaudeAI.Log("WARNING: Error serializing units: " .. tostring(err))
     end
+end
 
-    -- Serialize visible enemy units and cities (with error handling)
-    success, err = pcall(function()
+-- Serialize visible enemy units and cities (with error handling)
+local function BuildEnemiesSection(playerID, pPlayer, fields)
+    fields.visibleEnemyUnits = {}
+    fields.visibleEnemyCities = {}
+    local success, err = pcall(function()
         local pVisibility = PlayersVisibility[playerID]
         if not pVisibility then
             ClaudeAI.Log("WARNING: PlayersVisibility not available")
@@ -2805,7 +3152,7 @@ function ClaudeAI.GetGameState(playerID)
                         if pVisibility:IsVisible(x, y) then
                             local unitData = ClaudeAI.SerializeEnemyUnit(pUnit)
                             if unitData then
-                                table.insert(gameState.visibleEnemyUnits, unitData)
+                                table.insert(fields.visibleEnemyUnits, unitData)
                             end
                         end
                     end
@@ -2819,7 +3166,7 @@ function ClaudeAI.GetGameState(playerID)
                         if pVisibility:IsVisible(x, y) then
                             local cityData = ClaudeAI.SerializeEnemyCity(pCity)
                             if cityData then
-                                table.insert(gameState.visibleEnemyCities, cityData)
+                                table.insert(fields.visibleEnemyCities, cityData)
                             end
                         end
                     end
@@ -2841,7 +3188,7 @@ function ClaudeAI.GetGameState(playerID)
                                 local unitData = ClaudeAI.SerializeEnemyUnit(pUnit)
                                 if unitData then
                                     unitData.isBarbarian = true  -- Mark as barbarian for Claude
-                                    table.insert(gameState.visibleEnemyUnits, unitData)
+                                    table.insert(fields.visibleEnemyUnits, unitData)
                                 end
                             end
                         end
@@ -2853,19 +3200,184 @@ function ClaudeAI.GetGameState(playerID)
     if not success then
         ClaudeAI.Log("WARNING: Error serializing enemy info: " .. tostring(err))
     end
+end
 
-    -- Serialize visible terrain around units/cities (with error handling)
-    success, err = pcall(function()
-        gameState.visibleTerrain = ClaudeAI.GetVisibleTerrain(playerID, 3)  -- 3 tile radius
+-- Serialize visible terrain around units/cities (with error handling)
+-- With a job and deadline (incremental build) the walk stops at the deadline and
+-- returns false, keeping its place in job.terrainWalk for the next tick
+local function BuildTerrainSection(playerID, pPlayer, fields, job, deadline)
+    local finished = true
+    local success, err = pcall(function()
+        local walk = job and job.terrainWalk or ClaudeAI.NewTerrainWalk(playerID, 3)  -- 3 tile radius
+        if not ClaudeAI.StepTerrainWalk(walk, deadline or math.huge) then
+            job.terrainWalk = walk
+            finished = false
+            return
+        end
+        fields.visibleTerrain = walk.visiblePlots
     end)
+    if job and finished then
+        job.terrainWalk = nil
+    end
     if not success then
         ClaudeAI.Log("WARNING: Error serializing terrain: " .. tostring(err))
-        gameState.visibleTerrain = {}
+        fields.visibleTerrain = {}
+        return true
+    end
+    return finished
+end
+
+-- Steps in build order (the terrain step is the most expensive, so it goes last)
+-- A step is called as step(playerID, pPlayer, fields, job, deadline); only the
+-- terrain step uses the last two, and returns false when it needs another tick
+local GAME_STATE_STEPS = {
+    BuildPlayerSection,
+    BuildResearchSection,
+    BuildPoliticsSection,
+    BuildCitiesSection,
+    BuildUnitsSection,
+    BuildEnemiesSection,
+    BuildTerrainSection,
+}
+
+local function LogGameStateCounts(counts)
+    ClaudeAI.Log("State: " .. counts.units .. " units, " .. counts.cities .. " cities, " ..
+        counts.enemyUnits .. " enemy units, " .. counts.tiles .. " visible tiles")
+end
+
+-- Note the sizes a step produced, for the summary log line
+local function CountSectionFields(fields, counts)
+    if fields.units then counts.units = #fields.units end
+    if fields.cities then counts.cities = #fields.cities end
+    if fields.visibleEnemyUnits then counts.enemyUnits = #fields.visibleEnemyUnits end
+    if fields.visibleTerrain then counts.tiles = #fields.visibleTerrain end
+end
+
+-- Gather the game state table for a player
+-- Returns the table, or nil if the player is invalid
+function ClaudeAI.BuildGameState(playerID)
+    local pPlayer = Players[playerID]
+    if not pPlayer then
+        return nil
+    end
+
+    ClaudeAI.Log("Gathering game state for player " .. playerID)
+
+    local gameState = {}
+    for _, buildStep in ipairs(GAME_STATE_STEPS) do
+        buildStep(playerID, pPlayer, gameState)
     end
 
-    ClaudeAI.Log("State: " .. #gameState.units .. " units, " .. #gameState.cities .. " cities, " .. #(gameState.visibleEnemyUnits or {}) .. " enemy units, " .. #(gameState.visibleTerrain or {}) .. " visible tiles")
+    local counts = { units = 0, cities = 0, enemyUnits = 0, tiles = 0 }
+    CountSectionFields(gameState, counts)
+    LogGameStateCounts(counts)
 
-    return ClaudeAI.TableToJSON(gameState)
+    return gameState
+end
+
+-- Serialize the game state for a player to JSON
+function ClaudeAI.GetGameState(playerID)
+    local gameState = ClaudeAI.BuildGameState(playerID)
+    if not gameState then
+        return '{"error":"Invalid player ID"}'
+    end
+    return ClaudeAI.EncodeJSON(gameState)
+end
+
+-- ============================================================================
+-- INCREMENTAL GAME STATE
+-- Runs the build steps a few at a time on GameCoreEventPublishComplete ticks,
+-- each within Config.serializeBudgetMs, and hands every finished field to the
+-- DLL with AppendGameStateSection. The request goes out after the last step
+-- ============================================================================
+
+-- In-progress serializations keyed by player ID:
+-- { step = next step index, turn, ticks, workMs, counts, onComplete(playerID, started, workMs) }
+ClaudeAI.Serializations = {}
+
+function ClaudeAI.CanSerializeIncrementally()
+    return ClaudeAI.Config.incrementalSerialization and AppendGameStateSection ~= nil and
+        ClaudeAI.Config.nativeJsonEncoder
+end
+
+function ClaudeAI.IsAnySerializationPending()
+    return next(ClaudeAI.Serializations) ~= nil
+end
+
+-- Start building a player's game state over the next frames
+-- onComplete(playerID, started, workMs) gets StartClaudeAPIRequest's result and the game-thread time spent
+function ClaudeAI.StartIncrementalGameState(playerID, onComplete)
+    ClaudeAI.Log("Gathering game state for player " .. playerID .. " over the next frames")
+    ClaudeAI.Serializations[playerID] = {
+        step = 1,
+        turn = Game.GetCurrentGameTurn(),
+        ticks = 0,
+        workMs = 0,
+        counts = { units = 0, cities = 0, enemyUnits = 0, tiles = 0 },
+        onComplete = onComplete,
+    }
+    ClaudeAI.EnsurePollHandler()
+
+    -- The first slice runs right away, within the same budget as the rest
+    ClaudeAI.AdvanceSerialization(playerID)
+end
+
+-- Run build steps for one player until this tick's budget is spent. Steps before
+-- the terrain one run whole; the terrain walk checks the budget per plot and resumes next tick
+function ClaudeAI.AdvanceSerialization(playerID)
+    local job = ClaudeAI.Serializations[playerID]
+    if not job then
+        return
+    end
+
+    local pPlayer = Players[playerID]
+    if not pPlayer or job.turn ~= Game.GetCurrentGameTurn() then
+        ClaudeAI.Log("[SERIALIZE] Abandoning game state for player " .. tostring(playerID) ..
+            " (turn or player changed)")
+        ClaudeAI.Serializations[playerID] = nil
+        if DiscardGameStateSections then
+            DiscardGameStateSections(playerID)
+        end
+        if not ClaudeAI.IsAnyPlayerWaiting() then
+            ClaudeAI.NotifyThinking(false)
+        end
+        ClaudeAI.ReleasePollHandler()
+        return
+    end
+
+    local tickStart = os.clock()
+    local budgetSeconds = (ClaudeAI.Config.serializeBudgetMs or 0) / 1000
+    job.ticks = job.ticks + 1
+
+    repeat
+        local fields = {}
+        local deadline = tickStart + budgetSeconds
+        local finished = GAME_STATE_STEPS[job.step](playerID, pPlayer, fields, job, deadline) ~= false
+        CountSectionFields(fields, job.counts)
+        for name, value in pairs(fields) do
+            if not AppendGameStateSection(playerID, name, value, not job.started) then
+                ClaudeAI.Log("[SERIALIZE] WARNING: Could not append section " .. name)
+            end
+            job.started = true
+        end
+        if not finished then
+            break
+        end
+        job.step = job.step + 1
+    until job.step > #GAME_STATE_STEPS or os.clock() - tickStart >= budgetSeconds
+
+    job.workMs = job.workMs + (os.clock() - tickStart) * 1000
+    if job.step <= #GAME_STATE_STEPS then
+        return
+    end
+
+    ClaudeAI.Serializations[playerID] = nil
+    LogGameStateCounts(job.counts)
+    ClaudeAI.Log(string.format("[SERIALIZE] Game state for player %d built over %d frames (%.1f ms on the game thread)",
+        playerID, job.ticks, job.workMs))
+
+    local started = StartClaudeAPIRequest(playerID)
+    job.onComplete(playerID, started, job.workMs)
 end
 
 -- ============================================================================
@@ -4727,10 +5239,9 @@ function ActionHandlers.place_district(playerID, action, pPlayer, isLocalPlayer)
     local success, err = pcall(function()
         if isLocalPlayer then
             -- Use UI request for district placement
-            -- Format: playerID,cityID,districtHash,plotX,plotY
-            local requestStr = playerID .. "," .. action.city_id .. "," .. districtInfo.Hash .. "," .. plotX .. "," .. plotY
-            Game.SetProperty(PROPERTY_KEYS.REQUEST_PLACE_DISTRICT, requestStr)
-            ClaudeAI.Log("District placement request sent via Game property")
+            if not ClaudeAI.RequestPlaceDistrict(playerID, action.city_id, districtInfo.Hash, plotX, plotY) then
+                error("UI request for district placement could not be sent")
+            end
             return
         end
 
@@ -5245,24 +5756,87 @@ end
 -- MAIN AI TURN HANDLER (ASYNC VERSION)
 -- ============================================================================
 
--- State for async processing
-ClaudeAI.AsyncState = {
-    isWaiting = false,        -- Are we waiting for a response?
-    playerID = nil,           -- Which player we're processing for
-    pollHandler = nil,        -- The event handler for polling
-    pollCount = 0,            -- How many times we've polled
-    startTime = 0,            -- When polling started (os.clock())
-    timeoutSeconds = LIMITS.ASYNC_TIMEOUT_SECONDS,
-}
+-- State for async processing, one entry per Claude-controlled player so
+-- several requests can be in flight at once (see GetAsyncState)
+ClaudeAI.AsyncStates = {}
+
+-- The event handler polling every waiting player (nil when nobody is waiting)
+ClaudeAI.PollHandler = nil
+
+-- Get (or create) the async state for a player
+function ClaudeAI.GetAsyncState(playerID)
+    local state = ClaudeAI.AsyncStates[playerID]
+    if not state then
+        state = {
+            isWaiting = false,        -- Are we waiting for a response?
+            playerID = playerID,      -- Which player we're processing for
+            requestID = nil,          -- DLL request ID being polled (nil = latest request)
+            pollCount = 0,            -- How many times we've polled
+            startTime = 0,            -- When polling started (os.clock())
+            timeoutSeconds = LIMITS.ASYNC_TIMEOUT_SECONDS,
+            endTurnReached = false,   -- Has a streamed batch already executed end_turn?
+            adoptedPrefetch = false,  -- Is the request a speculative plan adopted at turn start?
+            serializeMs = 0,          -- Time spent building and sending the game state
+            decodeMs = 0,             -- Time spent decoding responses (streamed batches included)
+            executeMs = 0,            -- Time spent executing actions
+        }
+        ClaudeAI.AsyncStates[playerID] = state
+    end
+    return state
+end
+
+-- Is any player still waiting for a response (or for its game state to be built)?
+function ClaudeAI.IsAnyPlayerWaiting()
+    for _, state in pairs(ClaudeAI.AsyncStates) do
+        if state.isWaiting then
+            return true
+        end
+    end
+    return ClaudeAI.IsAnySerializationPending()
+end
+
+-- Is this player controlled by Claude (the controlled player or one of the additional ones)?
+function ClaudeAI.IsClaudeControlled(playerID)
+    if playerID == ClaudeAI.Config.controlledPlayerID then
+        return true
+    end
+    for _, additionalID in ipairs(ClaudeAI.Config.additionalPlayerIDs or {}) do
+        if playerID == additionalID then
+            return true
+        end
+    end
+    return false
+end
+
+-- One-line result of an executed action for Claude's conversation history
+function ClaudeAI.DescribeActionResult(action, success)
+    local target = ""
+    if action.unit_id then
+        target = " unit " .. tostring(action.unit_id)
+    elseif action.city_id then
+        target = " city " .. tostring(action.city_id)
+    end
+    local item = action.item or action.tech or action.civic or action.government
+    if item then
+        target = target .. " " .. tostring(item)
+    end
+    return (action.action or "unknown") .. target .. ": " .. (success and "ok" or "failed")
+end
 
 -- Process the response from Claude (shared by sync and async paths)
+-- Returns true if an end_turn action was executed
 function ClaudeAI.HandleResponse(playerID, actionJson)
+    local reachedEndTurn = false
     if actionJson then
         local previewLen = LIMITS.MAX_JSON_PREVIEW_LENGTH
         ClaudeAI.Log("Received response: " .. actionJson:sub(1, previewLen) .. (actionJson:len() > previewLen and "..." or ""))
 
+        local timings = ClaudeAI.GetAsyncState(playerID)
+
         -- Parse the response (returns table with "actions" array)
+        local decodeStart = os.clock()
         local response = ClaudeAI.DecodeJSON(actionJson)
+        timings.decodeMs = timings.decodeMs + (os.clock() - decodeStart) * 1000
 
         if response then
             -- Check for error response
@@ -5325,6 +5899,8 @@ function ClaudeAI.HandleResponse(playerID, actionJson)
 
                 local successCount = 0
                 local failCount = 0
+                local results = {}
+                local executeStart = os.clock()
 
                 for i, action in ipairs(reorderedActions) do
                     ClaudeAI.Log("--- Action " .. i .. "/" .. #response.actions .. ": " .. (action.action or "unknown") .. " ---")
@@ -5335,15 +5911,25 @@ function ClaudeAI.HandleResponse(playerID, actionJson)
                     else
                         failCount = failCount + 1
                     end
+                    results[#results + 1] = ClaudeAI.DescribeActionResult(action, success)
 
                     -- Stop processing if we hit end_turn
                     if action.action == "end_turn" then
                         ClaudeAI.Log("End turn action reached, stopping action processing")
+                        reachedEndTurn = true
                         break
                     end
                 end
 
+                timings.executeMs = timings.executeMs + (os.clock() - executeStart) * 1000
                 ClaudeAI.Log("Action execution complete: " .. successCount .. " succeeded, " .. failCount .. " failed")
+
+                -- Claude sees these at the start of its next turn
+                if RecordClaudeActionResults and #results > 0 then
+                    RecordClaudeActionResults(playerID, table.concat(results, "; "))
+                end
+            elseif actionJson:match('"streamed"%s*:%s*%d+') then
+                ClaudeAI.Log("All actions were already executed while streaming")
             else
                 ClaudeAI.Log("WARNING: No actions in response")
             end
@@ -5353,44 +5939,120 @@ function ClaudeAI.HandleResponse(playerID, actionJson)
     else
         ClaudeAI.Log("No response from Claude API")
     end
+    return reachedEndTurn
 end
 
--- Poll for async response
-function ClaudeAI.PollForResponse()
-    if not ClaudeAI.AsyncState.isWaiting then
+-- Execute a batch of actions that streamed in while Claude is still generating
+function ClaudeAI.HandleStreamedActions(playerID, actionJson)
+    local state = ClaudeAI.GetAsyncState(playerID)
+    if state.endTurnReached then
+        ClaudeAI.Log("[STREAM] Ignoring actions received after end_turn for player " .. tostring(playerID))
+        return
+    end
+
+    ClaudeAI.Log("[STREAM] Executing streamed actions for player " .. tostring(playerID))
+    state.endTurnReached = ClaudeAI.HandleResponse(playerID, actionJson)
+end
+
+-- Reassemble a response the DLL hands over in chunks (responses over the push limit)
+-- Returns the response string, or nil and an error message
+function ClaudeAI.TakeChunkedResponse(chunkCount)
+    if not GetClaudeResponseChunk then
+        ClaudeAI.Log("[ASYNC] ERROR: GetClaudeResponseChunk not available")
+        return nil, "GetClaudeResponseChunk not available"
+    end
+
+    local count = tonumber(chunkCount) or 0
+    local parts = {}
+    for i = 1, count do
+        local chunk = GetClaudeResponseChunk(i)
+        if not chunk then
+            ClaudeAI.Log("[ASYNC] ERROR: Missing response chunk " .. i .. " of " .. count)
+            return nil, "Failed to retrieve long response"
+        end
+        parts[i] = chunk
+    end
+
+    local response = table.concat(parts)
+    ClaudeAI.Log("[ASYNC] Reassembled long response from " .. count .. " chunks - length=" .. tostring(#response))
+    return response
+end
+
+-- Poll the DLL for a request, reading long responses back in pieces
+-- Returns the status ("pending", "partial", "ready", "error" or "idle") and the response or error
+function ClaudeAI.CheckResponse(requestID)
+    local status, response = CheckClaudeAPIResponse(requestID)
+
+    -- Handle "_chunked" statuses - long responses are read back in pieces
+    if status == "ready_chunked" or status == "partial_chunked" then
+        local fullResponse, err = ClaudeAI.TakeChunkedResponse(response)
+        if fullResponse then
+            response = fullResponse
+            status = (status == "ready_chunked") and "ready" or "partial"
+        else
+            status = "error"
+            response = err
+        end
+    end
+
+    return status, response
+end
+
+-- Poll every player that is waiting for a response, and every pending prefetch
+function ClaudeAI.PollAllPlayers()
+    -- Collect first: executing actions can start another player's request mid-loop
+    local waiting = {}
+    for playerID, state in pairs(ClaudeAI.AsyncStates) do
+        if state.isWaiting then
+            table.insert(waiting, playerID)
+        end
+    end
+    local prefetching = {}
+    for playerID, prefetch in pairs(ClaudeAI.Prefetches) do
+        if prefetch.status == "pending" then
+            table.insert(prefetching, playerID)
+        end
+    end
+
+    local serializing = {}
+    for playerID in pairs(ClaudeAI.Serializations) do
+        table.insert(serializing, playerID)
+    end
+
+    for _, playerID in ipairs(waiting) do
+        ClaudeAI.PollForResponse(playerID)
+    end
+    for _, playerID in ipairs(prefetching) do
+        ClaudeAI.PollPrefetch(playerID)
+    end
+    for _, playerID in ipairs(serializing) do
+        ClaudeAI.AdvanceSerialization(playerID)
+    end
+
+    ClaudeAI.DrainUICommandResults()
+end
+
+-- Poll for one player's async response
+function ClaudeAI.PollForResponse(playerID)
+    local state = ClaudeAI.GetAsyncState(playerID)
+    if not state.isWaiting then
         return
     end
 
     -- Check if async functions are available
     if not CheckClaudeAPIResponse then
         ClaudeAI.Log("ERROR: CheckClaudeAPIResponse not available!")
-        ClaudeAI.StopPolling()
+        ClaudeAI.StopPolling(playerID)
         return
     end
 
     -- Poll the C++ side
-    local status, response = CheckClaudeAPIResponse()
+    local status, response = ClaudeAI.CheckResponse(state.requestID)
 
-    -- Handle "ready_long" status - response stored in Game property due to 512 byte limit
-    if status == "ready_long" then
-        ClaudeAI.Log("[ASYNC] Long response stored in Game property, retrieving...")
-        if Game and Game.GetProperty then
-            response = Game.GetProperty(PROPERTY_KEYS.LONG_RESPONSE)
-            if response then
-                ClaudeAI.Log("[ASYNC] Retrieved long response from Game property - length=" .. tostring(#response))
-                -- Clear the property after reading
-                Game.SetProperty(PROPERTY_KEYS.LONG_RESPONSE, "")
-                status = "ready"  -- Treat as ready now
-            else
-                ClaudeAI.Log("[ASYNC] ERROR: Failed to retrieve long response from Game property")
-                status = "error"
-                response = "Failed to retrieve long response"
-            end
-        else
-            ClaudeAI.Log("[ASYNC] ERROR: Game.GetProperty not available")
-            status = "error"
-            response = "Game.GetProperty not available"
-        end
+    -- Streamed actions arrive while the request is still pending - execute and keep polling
+    if status == "partial" and response then
+        ClaudeAI.HandleStreamedActions(playerID, response)
+        return
     end
 
     -- DEBUG: Log immediately what we received from C++
@@ -5399,94 +6061,397 @@ function ClaudeAI.PollForResponse()
         ClaudeAI.Log("[ASYNC DEBUG] Last 50 chars: ..." .. response:sub(-50))
     end
 
-    ClaudeAI.AsyncState.pollCount = ClaudeAI.AsyncState.pollCount + 1
+    state.pollCount = state.pollCount + 1
 
     -- Log occasionally to show we're still polling
-    local elapsedTime = os.clock() - ClaudeAI.AsyncState.startTime
-    if ClaudeAI.AsyncState.pollCount % LIMITS.POLL_LOG_INTERVAL == 0 then
-        ClaudeAI.Log("[ASYNC] Poll #" .. ClaudeAI.AsyncState.pollCount .. " - elapsed: " .. string.format("%.1f", elapsedTime) .. "s - status: " .. tostring(status))
+    local elapsedTime = os.clock() - state.startTime
+    if state.pollCount % LIMITS.POLL_LOG_INTERVAL == 0 then
+        ClaudeAI.Log("[ASYNC] Player " .. tostring(playerID) .. " poll #" .. state.pollCount ..
+            " - elapsed: " .. string.format("%.1f", elapsedTime) .. "s - status: " .. tostring(status))
     end
 
     if status == "pending" then
         -- Still waiting, check for timeout (time-based, not poll-count based)
-        if elapsedTime >= ClaudeAI.AsyncState.timeoutSeconds then
-            ClaudeAI.Log("[ASYNC] Timeout waiting for response after " .. string.format("%.1f", elapsedTime) .. " seconds (" .. ClaudeAI.AsyncState.pollCount .. " polls)")
-            ClaudeAI.StopPolling()
-            ClaudeAI.NotifyTurnEnded(ClaudeAI.AsyncState.playerID)
+        if elapsedTime >= state.timeoutSeconds then
+            ClaudeAI.Log("[ASYNC] Timeout waiting for player " .. tostring(playerID) .. " response after " ..
+                string.format("%.1f", elapsedTime) .. " seconds (" .. state.pollCount .. " polls)")
+            -- Release the request so a late reply isn't kept in the DLL
+            if CancelClaudeAPIRequest and state.requestID then
+                CancelClaudeAPIRequest(state.requestID)
+            end
+            ClaudeAI.StopPolling(playerID)
+            ClaudeAI.NotifyTurnEnded(playerID)
         end
         -- Keep polling
         return
     end
 
     -- Response received (ready, error, or idle)
-    ClaudeAI.Log("[ASYNC] Response received with status: " .. tostring(status))
+    ClaudeAI.Log("[ASYNC] Player " .. tostring(playerID) .. " response received with status: " .. tostring(status))
 
-    local playerID = ClaudeAI.AsyncState.playerID
-    ClaudeAI.StopPolling()
+    ClaudeAI.StopPolling(playerID)
+
+    -- A speculative plan taken over at turn start joins the conversation once it arrives
+    if state.adoptedPrefetch and ResolveClaudeSpeculativeRequest then
+        ResolveClaudeSpeculativeRequest(playerID, status == "ready")
+    end
 
     if status == "ready" and response then
-        ClaudeAI.HandleResponse(playerID, response)
+        ClaudeAI.LogTokenUsage()
+        if state.endTurnReached then
+            ClaudeAI.Log("[STREAM] end_turn already executed from stream, ignoring remainder")
+        elseif state.adoptedPrefetch then
+            ClaudeAI.HandleResponse(playerID, ClaudeAI.ValidateAdoptedPlan(playerID, response))
+        else
+            ClaudeAI.HandleResponse(playerID, response)
+        end
     elseif status == "error" then
         ClaudeAI.Log("[ASYNC] Error from API: " .. tostring(response))
     else
         ClaudeAI.Log("[ASYNC] Unexpected status: " .. tostring(status))
     end
 
+    if status == "ready" or status == "error" then
+        ClaudeAI.ReportRequestTimings(playerID, state.requestID)
+    end
+
     -- Notify UI that turn is complete
     ClaudeAI.NotifyTurnEnded(playerID)
     ClaudeAI.Log("========================================")
-    ClaudeAI.Log("Turn processing complete")
+    ClaudeAI.Log("Turn processing complete for player " .. tostring(playerID))
     ClaudeAI.Log("========================================")
 end
 
--- Stop the polling loop
-function ClaudeAI.StopPolling()
-    ClaudeAI.AsyncState.isWaiting = false
-    ClaudeAI.AsyncState.pollCount = 0
+-- Log token and prompt cache usage reported by the DLL for the last request
+function ClaudeAI.LogTokenUsage()
+    if not GetClaudeAPIUsage then
+        return
+    end
 
-    -- Remove the event handler if it exists
-    if ClaudeAI.AsyncState.pollHandler and Events.GameCoreEventPublishComplete then
-        Events.GameCoreEventPublishComplete.Remove(ClaudeAI.AsyncState.pollHandler)
-        ClaudeAI.AsyncState.pollHandler = nil
-        ClaudeAI.Log("[ASYNC] Stopped polling")
+    local usage = GetClaudeAPIUsage()
+    if not usage then
+        return
+    end
+
+    ClaudeAI.Log("[USAGE] Last request: input=" .. tostring(usage.last_input) ..
+        " cache_read=" .. tostring(usage.last_cache_read) ..
+        " cache_write=" .. tostring(usage.last_cache_write) ..
+        " output=" .. tostring(usage.last_output))
+    ClaudeAI.Log("[USAGE] Session total (" .. tostring(usage.requests) .. " requests): input=" ..
+        tostring(usage.total_input) .. " cache_read=" .. tostring(usage.total_cache_read) ..
+        " cache_write=" .. tostring(usage.total_cache_write) .. " output=" .. tostring(usage.total_output))
+    if usage.response_cache_hits then
+        ClaudeAI.Log("[USAGE] Response cache: hits=" .. tostring(usage.response_cache_hits) ..
+            " (disk=" .. tostring(usage.response_cache_disk_hits) .. ") misses=" ..
+            tostring(usage.response_cache_misses) .. " expired=" .. tostring(usage.response_cache_expired))
     end
 end
 
--- Start the async polling loop
-function ClaudeAI.StartPolling(playerID)
-    ClaudeAI.AsyncState.isWaiting = true
-    ClaudeAI.AsyncState.playerID = playerID
-    ClaudeAI.AsyncState.pollCount = 0
-    ClaudeAI.AsyncState.startTime = os.clock()
+-- Hand the Lua-side stage times of a finished request to the DLL's metrics
+function ClaudeAI.ReportRequestTimings(playerID, requestID)
+    local state = ClaudeAI.GetAsyncState(playerID)
+    if ReportClaudeRequestTimings and requestID then
+        ReportClaudeRequestTimings(requestID, state.serializeMs, state.decodeMs, state.executeMs)
+    end
+    state.serializeMs = 0
+    state.decodeMs = 0
+    state.executeMs = 0
+end
+
+-- Register the shared poll handler if it isn't running yet
+function ClaudeAI.EnsurePollHandler()
+    if ClaudeAI.PollHandler then
+        return
+    end
 
     -- Create the poll handler
-    ClaudeAI.AsyncState.pollHandler = function()
-        ClaudeAI.PollForResponse()
+    ClaudeAI.PollHandler = function()
+        ClaudeAI.PollAllPlayers()
     end
 
     -- Register for frequent updates
     if Events.GameCoreEventPublishComplete then
-        Events.GameCoreEventPublishComplete.Add(ClaudeAI.AsyncState.pollHandler)
+        Events.GameCoreEventPublishComplete.Add(ClaudeAI.PollHandler)
         ClaudeAI.Log("[ASYNC] Started polling for response")
     else
         ClaudeAI.Log("[ASYNC] ERROR: GameCoreEventPublishComplete not available!")
     end
 end
 
+-- Remove the shared poll handler once no player or prefetch is waiting
+function ClaudeAI.ReleasePollHandler()
+    if ClaudeAI.IsAnyPlayerWaiting() or ClaudeAI.IsAnyPrefetchPending() then
+        return
+    end
+
+    -- Remove the event handler if it exists
+    if ClaudeAI.PollHandler and Events.GameCoreEventPublishComplete then
+        Events.GameCoreEventPublishComplete.Remove(ClaudeAI.PollHandler)
+        ClaudeAI.PollHandler = nil
+        ClaudeAI.Log("[ASYNC] Stopped polling")
+    end
+end
+
+-- Stop polling for a player; the shared handler is removed once nobody is waiting
+function ClaudeAI.StopPolling(playerID)
+    local state = ClaudeAI.GetAsyncState(playerID)
+    state.isWaiting = false
+    state.pollCount = 0
+
+    ClaudeAI.ReleasePollHandler()
+end
+
+-- Start polling for a player's response (other players keep polling alongside)
+function ClaudeAI.StartPolling(playerID, requestID)
+    local state = ClaudeAI.GetAsyncState(playerID)
+    state.isWaiting = true
+    state.requestID = requestID
+    state.pollCount = 0
+    state.startTime = os.clock()
+    state.endTurnReached = false
+    state.adoptedPrefetch = false
+    state.serializeMs = 0
+    state.decodeMs = 0
+    state.executeMs = 0
+
+    if ClaudeAI.PollHandler then
+        ClaudeAI.Log("[ASYNC] Polling for player " .. tostring(playerID) .. " alongside other requests")
+        return
+    end
+    ClaudeAI.EnsurePollHandler()
+end
+
+-- Queue a request for a game state table, encoded natively when possible
+-- deadlineSeconds overrides Config.requestDeadlineSeconds for this request (nil keeps it)
+-- Returns the DLL's result (request ID, true from older builds, or false)
+function ClaudeAI.StartRequest(gameState, priority, speculative, deadlineSeconds)
+    -- With the native encoder the DLL serializes the table itself, skipping the Lua string
+    if EncodeJSON and ClaudeAI.Config.nativeJsonEncoder then
+        return StartClaudeAPIRequest(gameState, priority, speculative, deadlineSeconds)
+    end
+    return StartClaudeAPIRequest(ClaudeAI.TableToJSON(gameState), priority, speculative, deadlineSeconds)
+end
+
+-- ============================================================================
+-- SPECULATIVE PREFETCH
+-- At the end of a turn, ask for a provisional plan for the next one so it is
+-- ready (or already on its way) when the turn starts
+-- ============================================================================
+
+-- Prefetched plans keyed by player ID:
+-- { requestID, turn, fingerprint, status = "pending"|"ready"|"error", response }
+ClaudeAI.Prefetches = {}
+
+function ClaudeAI.IsAnyPrefetchPending()
+    for _, prefetch in pairs(ClaudeAI.Prefetches) do
+        if prefetch.status == "pending" then
+            return true
+        end
+    end
+    return false
+end
+
+-- Cheap summary of what a plan depends on: our units and where they stand,
+-- our cities and their size, and who we are at war with
+-- Returns nil if the state couldn't be read
+function ClaudeAI.ComputeStateFingerprint(playerID)
+    local pPlayer = Players[playerID]
+    if not pPlayer then
+        return nil
+    end
+
+    local parts = {}
+    local success, err = pcall(function()
+        local pUnits = pPlayer:GetUnits()
+        if pUnits and pUnits.Members then
+            for _, pUnit in pUnits:Members() do
+                table.insert(parts, "u" .. pUnit:GetID() .. "@" .. pUnit:GetX() .. "," .. pUnit:GetY())
+            end
+        end
+
+        local pCities = pPlayer:GetCities()
+        if pCities and pCities.Members then
+            for _, pCity in pCities:Members() do
+                table.insert(parts, "c" .. pCity:GetID() .. ":" .. pCity:GetPopulation())
+            end
+        end
+
+        local pDiplomacy = pPlayer:GetDiplomacy()
+        local aliveMajors = PlayerManager.GetAliveMajors()
+        if pDiplomacy and pDiplomacy.IsAtWarWith and aliveMajors then
+            for _, otherPlayer in ipairs(aliveMajors) do
+                local otherID = otherPlayer:GetID()
+                if otherID ~= playerID and pDiplomacy:IsAtWarWith(otherID) then
+                    table.insert(parts, "w" .. otherID)
+                end
+            end
+        end
+    end)
+    if not success then
+        ClaudeAI.Log("[PREFETCH] WARNING: Error computing state fingerprint: " .. tostring(err))
+        return nil
+    end
+
+    -- Member iteration order isn't guaranteed to be stable
+    table.sort(parts)
+    return table.concat(parts, ";")
+end
+
+-- Send the post-action state for a provisional next-turn plan
+function ClaudeAI.StartPrefetch(playerID)
+    if not (StartClaudeAPIRequest and CheckClaudeAPIResponse and ResolveClaudeSpeculativeRequest) then
+        return
+    end
+
+    -- This turn's own request is still running
+    if ClaudeAI.GetAsyncState(playerID).isWaiting then
+        return
+    end
+
+    local previous = ClaudeAI.Prefetches[playerID]
+    if previous and previous.status == "pending" and CancelClaudeAPIRequest then
+        CancelClaudeAPIRequest(previous.requestID)
+    end
+    ClaudeAI.Prefetches[playerID] = nil
+
+    local serializeStart = os.clock()
+    local fingerprint = ClaudeAI.ComputeStateFingerprint(playerID)
+    local gameState = fingerprint and ClaudeAI.BuildGameState(playerID)
+    if not gameState then
+        ClaudeAI.ReleasePollHandler()
+        return
+    end
+
+    -- Low priority so other players' current turns are served first
+    local requestID = ClaudeAI.StartRequest(gameState, "low", true, ClaudeAI.Config.prefetchDeadlineSeconds)
+    if type(requestID) ~= "number" then
+        ClaudeAI.Log("[PREFETCH] Could not start speculative request for player " .. tostring(playerID))
+        ClaudeAI.ReleasePollHandler()
+        return
+    end
+
+    ClaudeAI.Prefetches[playerID] = {
+        requestID = requestID,
+        turn = gameState.turn,
+        fingerprint = fingerprint,
+        status = "pending",
+        serializeMs = (os.clock() - serializeStart) * 1000,
+    }
+    ClaudeAI.Log("[PREFETCH] Requested provisional plan for player " .. tostring(playerID) ..
+        " turn " .. tostring(gameState.turn + 1) .. " (request #" .. requestID .. ")")
+    ClaudeAI.EnsurePollHandler()
+end
+
+-- Poll a pending prefetch and keep its response for the next turn start
+function ClaudeAI.PollPrefetch(playerID)
+    local prefetch = ClaudeAI.Prefetches[playerID]
+    if not prefetch or prefetch.status ~= "pending" then
+        return
+    end
+
+    local status, response = ClaudeAI.CheckResponse(prefetch.requestID)
+    if status == "pending" or status == "partial" then
+        return
+    end
+
+    if status == "ready" and response then
+        prefetch.status = "ready"
+        prefetch.response = response
+        ClaudeAI.Log("[PREFETCH] Provisional plan ready for player " .. tostring(playerID) ..
+            " - length=" .. tostring(#response))
+    else
+        prefetch.status = "error"
+        ClaudeAI.Log("[PREFETCH] Speculative request failed for player " .. tostring(playerID) ..
+            ": " .. tostring(response))
+    end
+    ClaudeAI.ReleasePollHandler()
+end
+
+-- Check an adopted speculative plan against this turn's state, as the DLL checks
+-- turn requests itself (the plan was made before this state existed)
+-- Returns the response with invalid actions dropped, or unchanged if validation is off
+function ClaudeAI.ValidateAdoptedPlan(playerID, response)
+    if not (ValidateClaudeActions and ClaudeAI.Config.validateActions) then
+        return response
+    end
+    local gameState = ClaudeAI.BuildGameState(playerID)
+    if not gameState then
+        return response
+    end
+    return ValidateClaudeActions(ClaudeAI.EncodeJSON(gameState), response) or response
+end
+
+-- Use the plan prefetched at the end of the previous turn if the state it was
+-- made from still holds, otherwise discard it
+-- Returns true if the turn was handled (the plan executed or its request is being polled)
+function ClaudeAI.TakePrefetch(playerID)
+    local prefetch = ClaudeAI.Prefetches[playerID]
+    if not prefetch then
+        return false
+    end
+    ClaudeAI.Prefetches[playerID] = nil
+
+    local reason = nil
+    if prefetch.status == "error" then
+        reason = "request failed"
+    elseif prefetch.turn + 1 ~= Game.GetCurrentGameTurn() then
+        reason = "made for another turn"
+    elseif prefetch.fingerprint ~= ClaudeAI.ComputeStateFingerprint(playerID) then
+        reason = "state changed"
+    end
+
+    if reason then
+        ClaudeAI.Log("[PREFETCH] Discarding provisional plan for player " .. tostring(playerID) ..
+            " (" .. reason .. ")")
+        if prefetch.status == "pending" and CancelClaudeAPIRequest then
+            CancelClaudeAPIRequest(prefetch.requestID)
+        end
+        ResolveClaudeSpeculativeRequest(playerID, false)
+        ClaudeAI.ReleasePollHandler()
+        return false
+    end
+
+    if prefetch.status == "pending" then
+        -- Nothing changed but the plan is still being generated - wait for it like a normal request
+        ClaudeAI.Log("[PREFETCH] State unchanged, waiting for request #" .. prefetch.requestID .. " already in flight")
+        ClaudeAI.NotifyThinking(true)
+        ClaudeAI.StartPolling(playerID, prefetch.requestID)
+        local state = ClaudeAI.GetAsyncState(playerID)
+        state.adoptedPrefetch = true
+        state.serializeMs = prefetch.serializeMs
+        return true
+    end
+
+    ClaudeAI.Log("[PREFETCH] State unchanged, executing plan made at the end of turn " .. tostring(prefetch.turn))
+    ResolveClaudeSpeculativeRequest(playerID, true)
+    ClaudeAI.GetAsyncState(playerID).serializeMs = prefetch.serializeMs
+    ClaudeAI.HandleResponse(playerID, ClaudeAI.ValidateAdoptedPlan(playerID, prefetch.response))
+    ClaudeAI.ReportRequestTimings(playerID, prefetch.requestID)
+    ClaudeAI.NotifyTurnEnded(playerID)
+    return true
+end
+
 function ClaudeAI.ProcessTurn(playerID)
     ClaudeAI.Log("========================================")
     ClaudeAI.Log("Processing turn for player " .. playerID)
     ClaudeAI.Log("========================================")
 
+    -- Results of UI commands that finished after the poll handler stopped
+    ClaudeAI.DrainUICommandResults()
+
     -- TEMPORARILY DISABLED - May be causing crashes
     -- local isLocalPlayer = (Game.GetLocalPlayer() == playerID)
     -- if isLocalPlayer then
     --     ClaudeAI.RequestDismissNotifications()
     -- end
 
-    -- Check if we're already waiting for a response
-    if ClaudeAI.AsyncState.isWaiting then
-        ClaudeAI.Log("Already waiting for async response, skipping")
+    -- Check if we're already waiting for this player's response
+    if ClaudeAI.GetAsyncState(playerID).isWaiting then
+        ClaudeAI.Log("Already waiting for async response for player " .. tostring(playerID) .. ", skipping")
+        return
+    end
+    if ClaudeAI.Serializations[playerID] then
+        ClaudeAI.Log("Already building the game state for player " .. tostring(playerID) .. ", skipping")
         return
     end
 
@@ -5504,10 +6469,30 @@ function ClaudeAI.ProcessTurn(playerID)
         ClaudeAI.Log("Using BLOCKING API (async not available)")
     else
         ClaudeAI.Log("Using ASYNC API (non-blocking)")
+
+        if ClaudeAI.TakePrefetch(playerID) then
+            return
+        end
+    end
+
+    -- Build the game state over the next frames instead of stalling this one
+    if useAsync and ClaudeAI.CanSerializeIncrementally() then
+        if not Players[playerID] then
+            ClaudeAI.Log("ERROR: Invalid player ID " .. tostring(playerID))
+            return
+        end
+        ClaudeAI.NotifyThinking(true)
+        ClaudeAI.StartIncrementalGameState(playerID, ClaudeAI.OnTurnRequestStarted)
+        return
     end
 
     -- Get game state
-    local gameStateJson = ClaudeAI.GetGameState(playerID)
+    local serializeStart = os.clock()
+    local gameState = ClaudeAI.BuildGameState(playerID)
+    if not gameState then
+        ClaudeAI.Log("ERROR: Invalid player ID " .. tostring(playerID))
+        return
+    end
 
     -- Notify UI that Claude is thinking
     ClaudeAI.NotifyThinking(true)
@@ -5516,22 +6501,12 @@ function ClaudeAI.ProcessTurn(playerID)
         -- ASYNC PATH: Start request and set up polling
         ClaudeAI.Log("Starting async request to Claude API...")
 
-        local started = StartClaudeAPIRequest(gameStateJson)
-
-        if started then
-            ClaudeAI.Log("Async request started successfully")
-            ClaudeAI.StartPolling(playerID)
-            -- Return immediately - polling will handle the response
-            return
-        else
-            ClaudeAI.Log("ERROR: Failed to start async request")
-            ClaudeAI.NotifyTurnEnded(playerID)
-            return
-        end
+        local started = ClaudeAI.StartRequest(gameState)
+        ClaudeAI.OnTurnRequestStarted(playerID, started, (os.clock() - serializeStart) * 1000)
     else
         -- BLOCKING PATH (legacy fallback)
         ClaudeAI.Log("Sending game state to Claude API (blocking)...")
-        local actionJson = SendGameStateToClaudeAPI(gameStateJson)
+        local actionJson = SendGameStateToClaudeAPI(ClaudeAI.EncodeJSON(gameState))
 
         ClaudeAI.HandleResponse(playerID, actionJson)
 
@@ -5543,6 +6518,23 @@ function ClaudeAI.ProcessTurn(playerID)
     end
 end
 
+-- Set up polling for a turn's request once StartClaudeAPIRequest returned
+-- started is the DLL's result (request ID, true from older builds, or false)
+function ClaudeAI.OnTurnRequestStarted(playerID, started, serializeMs)
+    if started then
+        -- The DLL returns the request ID to poll (older builds return true)
+        local requestID = type(started) == "number" and started or nil
+        ClaudeAI.Log("Async request started successfully" .. (requestID and (" (request #" .. requestID .. ")") or ""))
+        ClaudeAI.StartPolling(playerID, requestID)
+        ClaudeAI.GetAsyncState(playerID).serializeMs = serializeMs
+        -- Return immediately - polling will handle the response
+    else
+        ClaudeAI.Log("ERROR: Failed to start async request")
+        ClaudeAI.NotifyTurnEnded(playerID)
+        ClaudeAI.ReleasePollHandler()
+    end
+end
+
 -- ============================================================================
 -- EVENT HANDLERS
 -- ============================================================================
@@ -5577,8 +6569,8 @@ function ClaudeAI.OnPlayerTurnStarted(playerID)
         end
     end
 
-    -- Check if this is the player Claude should control
-    if playerID ~= ClaudeAI.Config.controlledPlayerID then
+    -- Check if this is a player Claude should control
+    if not ClaudeAI.IsClaudeControlled(playerID) then
         return
     end
 
@@ -5596,7 +6588,7 @@ function ClaudeAI.OnPlayerTurnStarted(playerID)
         ClaudeAI.ProcessTurn(playerID)
         -- Note: For async, NotifyTurnEnded is called after response is received
         -- For sync, we call it here
-        if not ClaudeAI.AsyncState.isWaiting then
+        if not ClaudeAI.GetAsyncState(playerID).isWaiting then
             ClaudeAI.NotifyTurnEnded(playerID)
         end
     else
@@ -5604,12 +6596,59 @@ function ClaudeAI.OnPlayerTurnStarted(playerID)
     end
 end
 
+function ClaudeAI.OnPlayerTurnEnded(playerID)
+    if not ClaudeAI.Config.enabled or not ClaudeAI.Config.speculativePrefetch then
+        return
+    end
+
+    if ClaudeAI.IsClaudeControlled(playerID) then
+        ClaudeAI.StartPrefetch(playerID)
+    end
+end
+
+-- Push Lua-side configuration down to the DLL
+function ClaudeAI.ApplyAPIOptions()
+    if not SetClaudeAPIOption then
+        ClaudeAI.Log("  [--] SetClaudeAPIOption not available, using DLL defaults")
+        return
+    end
+
+    SetClaudeAPIOption("stream", tostring(ClaudeAI.Config.streamResponses))
+    SetClaudeAPIOption("log_level", ClaudeAI.Config.dllLogLevel)
+    SetClaudeAPIOption("delta", tostring(ClaudeAI.Config.deltaGameState))
+    SetClaudeAPIOption("keyframe_interval", tostring(ClaudeAI.Config.deltaKeyframeInterval))
+    SetClaudeAPIOption("compact_state", tostring(ClaudeAI.Config.compactGameState))
+    SetClaudeAPIOption("state_token_budget", tostring(ClaudeAI.Config.stateTokenBudget))
+    SetClaudeAPIOption("model_routing", tostring(ClaudeAI.Config.modelRouting))
+    SetClaudeAPIOption("validate_actions", tostring(ClaudeAI.Config.validateActions))
+    SetClaudeAPIOption("history_tokens", tostring(ClaudeAI.Config.historyTokenBudget))
+    SetClaudeAPIOption("response_cache", tostring(ClaudeAI.Config.responseCache))
+    SetClaudeAPIOption("response_cache_disk", tostring(ClaudeAI.Config.responseCacheOnDisk))
+    SetClaudeAPIOption("response_cache_ttl", tostring(ClaudeAI.Config.responseCacheTtlSeconds))
+    SetClaudeAPIOption("record_states", tostring(ClaudeAI.Config.recordGameStates))
+    SetClaudeAPIOption("record_requests_mb", tostring(ClaudeAI.Config.recordRequestsMaxMB))
+    SetClaudeAPIOption("record_requests", tostring(ClaudeAI.Config.recordRequests))
+    SetClaudeAPIOption("replay_requests", tostring(ClaudeAI.Config.replayRequestsFile))
+    SetClaudeAPIOption("request_deadline", tostring(ClaudeAI.Config.requestDeadlineSeconds))
+    SetClaudeAPIOption("retry_attempts", tostring(ClaudeAI.Config.retryAttempts))
+    SetClaudeAPIOption("retry_deadline", tostring(ClaudeAI.Config.retryDeadlineSeconds))
+    ClaudeAI.Log("  [OK] API options applied (stream=" .. tostring(ClaudeAI.Config.streamResponses) ..
+        ", log_level=" .. tostring(ClaudeAI.Config.dllLogLevel) ..
+        ", delta=" .. tostring(ClaudeAI.Config.deltaGameState) .. ")")
+end
+
 function ClaudeAI.OnLoadGameViewStateDone()
     print("[ClaudeAI] OnLoadGameViewStateDone triggered!")
 
     ClaudeAI.Log("Game view loaded - Claude will control local player")
     ClaudeAI.Log("Claude AI Enabled: " .. tostring(ClaudeAI.Config.enabled))
 
+    -- Drop UI requests and DLL state (conversations, baselines, trace, recording) left over from the previous game
+    ClaudeAI.ClearUIRequestProperties()
+    if ResetClaudeAPIGame then
+        ResetClaudeAPIGame()
+    end
+
     -- Scan for existing wonders (important when loading a save game)
     ClaudeAI.ScanExistingWonders()
 
@@ -5694,6 +6733,8 @@ function ClaudeAI.OnLoadGameViewStateDone()
         ClaudeAI.Log("Make sure version.dll is installed in the game directory")
     end
 
+    ClaudeAI.ApplyAPIOptions()
+
     -- Register PlayerTurnStarted handler here (late initialization)
     if Events.PlayerTurnStarted then
         Events.PlayerTurnStarted.Add(ClaudeAI.OnPlayerTurnStarted)
@@ -5713,6 +6754,12 @@ function ClaudeAI.OnLoadGameViewStateDone()
             print("[ClaudeAI] Registered PlayerTurnStarted handler via GameEvents")
         end
     end
+
+    -- Turn end starts the speculative prefetch (Config.speculativePrefetch)
+    if Events.PlayerTurnDeactivated then
+        Events.PlayerTurnDeactivated.Add(ClaudeAI.OnPlayerTurnEnded)
+        print("[ClaudeAI] Registered PlayerTurnDeactivated handler")
+    end
 end
 
 -- ============================================================================
@@ -212,6 +212,49 @@ local function UpdateStatusLabel(text)
     end
 end
 
+local function FormatSeconds(ms)
+    return string.format("%.1fs", (ms or 0) / 1000)
+end
+
+-- Show the latency breakdown of the last request under the status label
+local function UpdateMetricsLabel()
+    local metricsLabel = ContextPtr:LookUpControl("MetricsLabel")
+    if not metricsLabel or not GetClaudeAPIMetrics then
+        return
+    end
+
+    local metrics = GetClaudeAPIMetrics()
+    if not metrics then
+        return
+    end
+
+    if metrics.response_cache_hit then
+        metricsLabel:SetText("Last turn " .. FormatSeconds(metrics.total_ms) .. " (cached reply)")
+    else
+        metricsLabel:SetText("Last turn " .. FormatSeconds(metrics.total_ms) ..
+            " | TTFB " .. FormatSeconds(metrics.first_byte_ms) ..
+            " | dl " .. FormatSeconds(metrics.download_ms))
+    end
+
+    metricsLabel:SetToolTipString(string.format(
+        "Request #%d, turn %d[NEWLINE]" ..
+        "Model %s%s, max %d tokens[NEWLINE]" ..
+        "Serialize %.0f ms, queue %.0f ms, parse %.0f ms[NEWLINE]" ..
+        "Connect %.0f ms%s, first byte %.0f ms, download %.0f ms[NEWLINE]" ..
+        "Extract %.0f ms, decode %.0f ms, execute %.0f ms[NEWLINE]" ..
+        "Tokens: %d in, %d out, %d cache read, %d cache write[NEWLINE]" ..
+        "Average over %d requests: %.1fs total, %.1fs to first byte",
+        metrics.request, metrics.turn,
+        metrics.model or "?", (metrics.route and metrics.route ~= "") and (" (route " .. metrics.route .. ")") or "",
+        metrics.max_tokens or 0,
+        metrics.serialize_ms, metrics.queue_ms, metrics.parse_ms,
+        metrics.connect_ms, metrics.reused_connection and " (reused)" or "",
+        metrics.first_byte_ms, metrics.download_ms,
+        metrics.extract_ms, metrics.decode_ms, metrics.execute_ms,
+        metrics.input_tokens, metrics.output_tokens, metrics.cache_read, metrics.cache_write,
+        metrics.requests, metrics.avg_total_ms / 1000, metrics.avg_first_byte_ms / 1000))
+end
+
 -- ============================================================================
 -- PLAYER INFO
 -- ============================================================================
@@ -806,12 +849,14 @@ end
 
 -- ============================================================================
 -- REQUEST PROCESSING
--- Data-driven approach for handling Game property requests
+-- Data-driven approach for handling Game property requests, or the same
+-- requests drained in batches from the DLL's command queue
 -- ============================================================================
 
 local RequestHandlers = {
     {
         key = PROPERTY_KEYS.REQUEST_DISMISS_NOTIFICATIONS,
+        command = "dismiss_notifications",
         lastValue = function() return State.lastRequests.dismissNotification end,
         setLastValue = function(v) State.lastRequests.dismissNotification = v end,
         resetValue = 0,
@@ -825,6 +870,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_END_TURN,
+        command = "end_turn",
         lastValue = function() return State.processedEndTurn end,
         setLastValue = function(v) State.processedEndTurn = v end,
         resetValue = false,
@@ -839,6 +885,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_RESEARCH,
+        command = "research",
         lastValue = function() return State.lastRequests.research end,
         setLastValue = function(v) State.lastRequests.research = v end,
         resetValue = "",
@@ -852,6 +899,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_CIVIC,
+        command = "civic",
         lastValue = function() return State.lastRequests.civic end,
         setLastValue = function(v) State.lastRequests.civic = v end,
         resetValue = "",
@@ -865,6 +913,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_PRODUCTION,
+        command = "production",
         lastValue = function() return State.lastRequests.production end,
         setLastValue = function(v) State.lastRequests.production = v end,
         resetValue = "",
@@ -878,6 +927,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_GOVERNMENT,
+        command = "government",
         lastValue = function() return State.lastRequests.government end,
         setLastValue = function(v) State.lastRequests.government = v end,
         resetValue = "",
@@ -891,6 +941,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_POLICY,
+        command = "policy",
         lastValue = function() return State.lastRequests.policy end,
         setLastValue = function(v) State.lastRequests.policy = v end,
         resetValue = "",
@@ -905,6 +956,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_DIPLOMACY,
+        command = "diplomacy",
         lastValue = function() return State.lastRequests.diplomacy end,
         setLastValue = function(v) State.lastRequests.diplomacy = v end,
         resetValue = "",
@@ -915,6 +967,7 @@ local RequestHandlers = {
     },
     {
         key = PROPERTY_KEYS.REQUEST_PLACE_DISTRICT,
+        command = "place_district",
         lastValue = function() return State.lastRequests.districtPlacement end,
         setLastValue = function(v) State.lastRequests.districtPlacement = v end,
         resetValue = "",
@@ -928,7 +981,47 @@ local RequestHandlers = {
     },
 }
 
+-- Queue command name -> request handler
+local RequestHandlersByCommand = {}
+for _, req in ipairs(RequestHandlers) do
+    RequestHandlersByCommand[req.command] = req
+end
+
+-- Execute every command gameplay queued since the last frame, in order, and
+-- report each outcome back through the result queue
+local function ProcessQueuedUICommands()
+    local commands = DrainUICommands()
+    if not commands or #commands == 0 then return end
+
+    for _, command in ipairs(commands) do
+        local req = RequestHandlersByCommand[command.name]
+        local result
+        if req then
+            -- Queued commands run once each, so the duplicate guard starts clear
+            req.setLastValue(req.resetValue)
+            local success, err = SafeExecute(command.name, function()
+                req.handler(req.isNumeric and tonumber(command.payload) or command.payload)
+            end)
+            result = success and "ok" or tostring(err)
+        else
+            Log("WARNING: Unknown queued command: " .. tostring(command.name))
+            result = "unknown command"
+        end
+
+        if PushUICommandResult then
+            PushUICommandResult(command.name, result)
+        end
+    end
+    Log("Processed " .. #commands .. " queued UI commands")
+end
+
 local function ProcessUIActionRequests()
+    -- The DLL's queue replaces the per-key property polls when it is available
+    if DrainUICommands then
+        ProcessQueuedUICommands()
+        return
+    end
+
     if not Game or not Game.GetProperty then return end
 
     for _, req in ipairs(RequestHandlers) do
@@ -1086,6 +1179,7 @@ end
 local function OnClaudeTurnEnded(playerID)
     Log("LuaEvent: Claude turn ended - Player " .. tostring(playerID))
     State.turnEnded = true
+    SafeExecute("UpdateMetricsLabel", UpdateMetricsLabel)
 
     local elapsed = os.clock() - State.thinkingShowTime
     if elapsed >= MIN_SHOW_DURATION then
@@ -1188,7 +1282,8 @@ local function Initialize()
         LuaEvents.ClaudeAI_PlayerSet.Add(OnClaudePlayerSet)
         Log("Registered LuaEvents.ClaudeAI_PlayerSet")
 
-        Log("UI action requests will be processed via Game property polling")
+        Log(DrainUICommands and "UI action requests will be drained from the DLL command queue"
+            or "UI action requests will be processed via Game property polling")
     else
         Log("WARNING: LuaEvents not available")
     end
@@ -1217,6 +1312,14 @@ local function Initialize()
         end
     end
 
+    -- Profile builds of the DLL time the work done per rendered frame
+    if ProfileClaudeFrame then
+        ContextPtr:SetUpdate(function()
+            ProfileClaudeFrame()
+        end)
+        Log("Registered per-frame profiler marker")
+    end
+
     ShowThinkingIndicator(false)
     Log("UI initialization complete")
 end
@@ -0,0 +1,389 @@
+// ============================================================================
+// ModelRouting.cpp - Per-Request Model Selection Implementation
+// ============================================================================
+
+#include "ModelRouting.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+#include "ClaudeAPI.h"
+#include "Log.h"
+
+namespace ModelRouting
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+
+/// One rule of model_routing.json
+struct RoutingRule
+{
+    std::string name;
+    json when;                  ///< Conditions on the routing signals, all of which must hold
+    std::string model;
+    int maxTokens = 0;
+};
+
+/// Loaded routing rules, reloaded only when the file's last-write time changes
+struct CachedRouting
+{
+    std::mutex mutex;
+    std::string path;
+    bool pathResolved = false;
+    bool loaded = false;
+    bool fromFile = false;
+    FILETIME lastWriteTime{};
+    std::string defaultModel;   ///< From the file's "default" entry (empty for the caller's)
+    int defaultMaxTokens = 0;   ///< From the file's "default" entry (0 for the caller's)
+    std::vector<RoutingRule> rules;
+};
+
+CachedRouting g_modelRouting;
+
+} // anonymous namespace
+
+// ============================================================================
+// RULES
+// ============================================================================
+
+namespace
+{
+
+/// Signals a rule's "when" object can test; conditions are "name" (equal),
+/// "min_name" (at least) or "max_name" (at most)
+constexpr std::array<std::string_view, 8> kRoutingSignals = {
+    "turn", "cities", "units", "at_war", "enemies_visible", "settlers", "empty_queue", "diplomacy_pending"
+};
+
+/// Get the path to the routing rules file in the mod folder
+std::string GetModelRoutingPath()
+{
+    std::string modFolder = ClaudeAPI::GetModFolderPath();
+    return modFolder.empty() ? modFolder : modFolder + "model_routing.json";
+}
+
+/// Strip a "min_" or "max_" prefix from a condition key
+std::string_view ConditionSignal(std::string_view key)
+{
+    if (key.substr(0, 4) == "min_" || key.substr(0, 4) == "max_")
+    {
+        return key.substr(4);
+    }
+    return key;
+}
+
+/// Read a model and max_tokens pair from a rule or the "default" entry
+/// @return false if either is present but invalid
+bool ReadRouteTarget(const json& entry, std::string& outModel, int& outMaxTokens)
+{
+    auto model = entry.find("model");
+    if (model != entry.end())
+    {
+        if (!model->is_string() || model->get_ref<const std::string&>().empty())
+        {
+            return false;
+        }
+        outModel = model->get<std::string>();
+    }
+
+    auto maxTokens = entry.find("max_tokens");
+    if (maxTokens != entry.end())
+    {
+        if (!maxTokens->is_number_integer() || maxTokens->get<int>() <= 0)
+        {
+            return false;
+        }
+        outMaxTokens = maxTokens->get<int>();
+    }
+    return true;
+}
+
+/// Parse the routing file, skipping (and logging) rules that can't be used
+void ParseRoutingRules(const json& document)
+{
+    g_modelRouting.defaultModel.clear();
+    g_modelRouting.defaultMaxTokens = 0;
+    g_modelRouting.rules.clear();
+
+    auto fallback = document.find("default");
+    if (fallback != document.end() &&
+        (!fallback->is_object() ||
+         !ReadRouteTarget(*fallback, g_modelRouting.defaultModel, g_modelRouting.defaultMaxTokens)))
+    {
+        Log(LogLevel::Warning, "[ROUTING] WARNING: Ignoring invalid \"default\" entry");
+        g_modelRouting.defaultModel.clear();
+        g_modelRouting.defaultMaxTokens = 0;
+    }
+
+    auto routes = document.find("routes");
+    if (routes == document.end() || !routes->is_array())
+    {
+        return;
+    }
+
+    for (const json& entry : *routes)
+    {
+        if (!entry.is_object())
+        {
+            Log(LogLevel::Warning, "[ROUTING] WARNING: Skipping a route that is not an object");
+            continue;
+        }
+
+        RoutingRule rule;
+        rule.name = entry.value("name", "route " + std::to_string(g_modelRouting.rules.size() + 1));
+        auto when = entry.find("when");
+        bool valid = ReadRouteTarget(entry, rule.model, rule.maxTokens) &&
+                     (!rule.model.empty() || rule.maxTokens > 0) &&
+                     when != entry.end() && when->is_object();
+
+        if (valid)
+        {
+            for (auto condition = when->begin(); condition != when->end(); ++condition)
+            {
+                std::string_view signal = ConditionSignal(condition.key());
+                bool known =
+                    std::find(kRoutingSignals.begin(), kRoutingSignals.end(), signal) != kRoutingSignals.end();
+                if (!known || !(condition->is_number() || condition->is_boolean()))
+                {
+                    Log(LogLevel::Warning, "[ROUTING] WARNING: Unknown condition \"" + condition.key() +
+                        "\" in route " + rule.name);
+                    valid = false;
+                }
+            }
+        }
+
+        if (!valid)
+        {
+            Log(LogLevel::Warning, "[ROUTING] WARNING: Skipping invalid route " + rule.name);
+            continue;
+        }
+
+        rule.when = *when;
+        g_modelRouting.rules.push_back(std::move(rule));
+    }
+}
+
+/// Read and parse the routing file if it changed since the last load
+/// @note Caller must hold g_modelRouting.mutex
+void RefreshModelRouting()
+{
+    if (!g_modelRouting.pathResolved)
+    {
+        g_modelRouting.path = GetModelRoutingPath();
+        g_modelRouting.pathResolved = true;
+    }
+
+    const std::string& routingPath = g_modelRouting.path;
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    bool fileExists = !routingPath.empty() &&
+        GetFileAttributesExA(routingPath.c_str(), GetFileExInfoStandard, &attributes);
+
+    // Unchanged since last load - nothing to do
+    if (g_modelRouting.loaded && fileExists == g_modelRouting.fromFile &&
+        (!fileExists ||
+         (attributes.ftLastWriteTime.dwLowDateTime == g_modelRouting.lastWriteTime.dwLowDateTime &&
+          attributes.ftLastWriteTime.dwHighDateTime == g_modelRouting.lastWriteTime.dwHighDateTime)))
+    {
+        return;
+    }
+
+    g_modelRouting.defaultModel.clear();
+    g_modelRouting.defaultMaxTokens = 0;
+    g_modelRouting.rules.clear();
+
+    if (fileExists)
+    {
+        std::ifstream file(routingPath);
+        json document = file.is_open() ? json::parse(file, nullptr, false) : json();
+        if (document.is_object())
+        {
+            ParseRoutingRules(document);
+            Log("[ROUTING] Loaded " + std::to_string(g_modelRouting.rules.size()) + " routes from: " + routingPath);
+        }
+        else
+        {
+            Log(LogLevel::Warning, "[ROUTING] WARNING: Could not parse " + routingPath +
+                ", every request uses the default model");
+        }
+    }
+    else
+    {
+        LOG_DEBUG("[ROUTING] No routing file at " + routingPath + ", every request uses the default model");
+    }
+
+    g_modelRouting.fromFile = fileExists;
+    g_modelRouting.lastWriteTime = fileExists ? attributes.ftLastWriteTime : FILETIME{};
+    g_modelRouting.loaded = true;
+}
+
+/// Length of an array member, or 0 if it is missing
+size_t ArrayLength(const json& object, const char* key)
+{
+    auto member = object.find(key);
+    return member != object.end() && member->is_array() ? member->size() : 0;
+}
+
+/// Compute the routing signals from a parsed game state
+json ComputeRoutingSignals(const json& state)
+{
+    size_t settlers = 0;
+    auto units = state.find("units");
+    if (units != state.end() && units->is_array())
+    {
+        for (const json& unit : *units)
+        {
+            if (unit.is_object() && unit.value("isSettler", false))
+            {
+                settlers++;
+            }
+        }
+    }
+
+    size_t emptyQueues = 0;
+    auto cities = state.find("cities");
+    if (cities != state.end() && cities->is_array())
+    {
+        for (const json& city : *cities)
+        {
+            auto production = city.is_object() ? city.find("production") : city.end();
+            if (city.is_object() && (production == city.end() || production->is_null()))
+            {
+                emptyQueues++;
+            }
+        }
+    }
+
+    bool atWar = false;
+    bool diplomacyPending = false;
+    auto diplomacy = state.find("diplomacy");
+    if (diplomacy != state.end() && diplomacy->is_object())
+    {
+        atWar = ArrayLength(*diplomacy, "atWarWith") > 0;
+        diplomacyPending = diplomacy->value("hasPendingDeal", false);
+    }
+
+    return {
+        {"turn", state.value("turn", -1)},
+        {"cities", ArrayLength(state, "cities")},
+        {"units", ArrayLength(state, "units")},
+        {"at_war", atWar},
+        {"enemies_visible", ArrayLength(state, "visibleEnemyUnits") + ArrayLength(state, "visibleEnemyCities")},
+        {"settlers", settlers},
+        {"empty_queue", emptyQueues},
+        {"diplomacy_pending", diplomacyPending}
+    };
+}
+
+/// Numeric value of a signal or condition (booleans count as 0 and 1)
+double RoutingValue(const json& value)
+{
+    return value.is_boolean() ? (value.get<bool>() ? 1.0 : 0.0) : value.get<double>();
+}
+
+/// Check one rule's conditions against the signals
+/// @note A boolean condition on a count tests whether it is non-zero ("settlers": true)
+bool RouteMatches(const RoutingRule& rule, const json& signals)
+{
+    for (auto condition = rule.when.begin(); condition != rule.when.end(); ++condition)
+    {
+        const std::string& key = condition.key();
+        double value = RoutingValue(signals.at(std::string(ConditionSignal(key))));
+        double expected = RoutingValue(*condition);
+
+        bool matches;
+        if (key.compare(0, 4, "min_") == 0)
+        {
+            matches = value >= expected;
+        }
+        else if (key.compare(0, 4, "max_") == 0)
+        {
+            matches = value <= expected;
+        }
+        else
+        {
+            matches = condition->is_boolean() ? (value > 0) == condition->get<bool>() : value == expected;
+        }
+
+        if (!matches)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool HasRules()
+{
+    std::lock_guard<std::mutex> lock(g_modelRouting.mutex);
+    RefreshModelRouting();
+    return !g_modelRouting.rules.empty();
+}
+
+Decision Choose(const json& state, const std::string& defaultModel, int defaultMaxTokens)
+{
+    Decision decision{"", defaultModel, defaultMaxTokens};
+
+    std::lock_guard<std::mutex> lock(g_modelRouting.mutex);
+    RefreshModelRouting();
+    if (g_modelRouting.rules.empty())
+    {
+        return decision;
+    }
+
+    decision.route = "default";
+    if (!g_modelRouting.defaultModel.empty())
+    {
+        decision.model = g_modelRouting.defaultModel;
+    }
+    if (g_modelRouting.defaultMaxTokens > 0)
+    {
+        decision.maxTokens = g_modelRouting.defaultMaxTokens;
+    }
+    if (!state.is_object())
+    {
+        return decision;
+    }
+
+    json signals = ComputeRoutingSignals(state);
+    for (const RoutingRule& rule : g_modelRouting.rules)
+    {
+        if (RouteMatches(rule, signals))
+        {
+            decision.route = rule.name;
+            if (!rule.model.empty())
+            {
+                decision.model = rule.model;
+            }
+            if (rule.maxTokens > 0)
+            {
+                decision.maxTokens = rule.maxTokens;
+            }
+            break;
+        }
+    }
+
+    LOG_DEBUG("[ROUTING] Signals " + signals.dump() + " -> " + decision.route);
+    return decision;
+}
+
+} // namespace ModelRouting
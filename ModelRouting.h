@@ -0,0 +1,36 @@
+#pragma once
+
+// ============================================================================
+// ModelRouting.h - Per-Request Model Selection
+// Picks the model and max_tokens for each request from cheap signals in the
+// game state, using the rules in model_routing.json next to system_prompt.txt
+// ============================================================================
+
+#include <string>
+
+#include <json.hpp>
+
+namespace ModelRouting
+{
+
+/// Model and output limit chosen for one request
+struct Decision
+{
+    std::string route;          ///< Name of the matching rule, "default", or empty when no rules are loaded
+    std::string model;
+    int maxTokens = 0;
+};
+
+/// Check whether any routes are loaded, so the caller knows to parse the state
+/// @note Rereads model_routing.json when its last-write time changed
+[[nodiscard]] bool HasRules();
+
+/// Pick the model and max_tokens for a request
+/// @param state Parsed game state (not an object when parsing was skipped or failed)
+/// @param defaultModel Model used when no rule (and no "default" entry) applies
+/// @param defaultMaxTokens max_tokens used when no rule (and no "default" entry) applies
+/// @note The first matching route wins; with no match or no state the file's
+///       "default" entry is used, then the defaults passed in
+[[nodiscard]] Decision Choose(const nlohmann::json& state, const std::string& defaultModel, int defaultMaxTokens);
+
+} // namespace ModelRouting
@@ -0,0 +1,251 @@
+// ============================================================================
+// PlotIndex.cpp - Native Plot Neighborhood Index Implementation
+// ============================================================================
+
+#include "PlotIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Log.h"
+
+namespace PlotIndex
+{
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    /// Largest supported map side (Huge maps are 106x66), guarding the bitset against bad arguments
+    constexpr int kMaxMapDimension = 1024;
+
+    /// Largest supported radius around a position
+    constexpr int kMaxRadius = 16;
+
+    /// Bits per bitset word
+    constexpr int kWordBits = 64;
+}
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+    /// Signatures last reported for one player
+    struct PlayerPlots
+    {
+        double epoch = 0.0;
+        std::unordered_map<int, double> signatures;   ///< Plot index -> signature
+    };
+
+    /// Per-player signature store, keyed by player ID
+    std::unordered_map<int, PlayerPlots> g_playerPlots;
+    std::mutex g_playerPlotsMutex;
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+namespace
+{
+
+/// Read a flat array of numbers from a Lua table
+/// @return false if the value at index is not a table
+bool ReadNumberArray(hks::lua_State* L, int index, std::vector<double>& out)
+{
+    if (hks::type(L, index) != hks::TTABLE)
+    {
+        return false;
+    }
+
+    size_t length = static_cast<size_t>(hks::objlen(L, index));
+    out.clear();
+    out.reserve(length);
+    for (size_t i = 1; i <= length; i++)
+    {
+        hks::rawgeti(L, index, static_cast<int>(i));
+        out.push_back(hks::type(L, -1) == hks::TNUMBER ? hks::tonumber(L, -1) : 0.0);
+        hks::pop(L, 1);
+    }
+    return true;
+}
+
+/// Push a Lua array of integers
+void PushIntegerArray(hks::lua_State* L, const std::vector<int>& values)
+{
+    hks::createtable(L, static_cast<int>(values.size()), 0);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        hks::pushnumber(L, static_cast<double>(i + 1));
+        hks::pushnumber(L, static_cast<double>(values[i]));
+        hks::settable(L, -3);
+    }
+}
+
+/// Set the bits of every plot within radius of (x, y)
+/// @note Works in axial coordinates: with odd rows shifted east, column q = x - floor(y / 2),
+///       and a plot is within radius when |dq|, |dr| and |dq + dr| are all at most radius
+void MarkNeighborhood(std::vector<uint64_t>& bits, int width, int height, bool wrapX,
+                      int x, int y, int radius)
+{
+    const int centerQ = x - (y >> 1);
+    for (int dr = -radius; dr <= radius; dr++)
+    {
+        const int row = y + dr;
+        if (row < 0 || row >= height)
+        {
+            continue;
+        }
+
+        const int dqMin = std::max(-radius, -dr - radius);
+        const int dqMax = std::min(radius, -dr + radius);
+        for (int dq = dqMin; dq <= dqMax; dq++)
+        {
+            int column = centerQ + dq + (row >> 1);
+            if (wrapX)
+            {
+                column = ((column % width) + width) % width;
+            }
+            else if (column < 0 || column >= width)
+            {
+                continue;
+            }
+
+            const int plot = row * width + column;
+            bits[plot / kWordBits] |= uint64_t{1} << (plot % kWordBits);
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool IsAvailable()
+{
+    return hks::gettop && hks::checkinteger && hks::toboolean && hks::type && hks::objlen &&
+           hks::rawgeti && hks::tonumber && hks::pop && hks::createtable && hks::pushnumber &&
+           hks::settable;
+}
+
+int PushPlotsInRange(hks::lua_State* L)
+{
+    if (!L || !IsAvailable() || hks::gettop(L) < 5)
+    {
+        Log("[PLOT INDEX] PlotsInRange requires (width, height, wrapX, radius, positions)");
+        return 0;
+    }
+
+    const int width = hks::checkinteger(L, 1);
+    const int height = hks::checkinteger(L, 2);
+    const bool wrapX = hks::toboolean(L, 3) != 0;
+    const int radius = hks::checkinteger(L, 4);
+    if (width <= 0 || height <= 0 || width > kMaxMapDimension || height > kMaxMapDimension ||
+        radius < 0 || radius > kMaxRadius)
+    {
+        Log("[PLOT INDEX] Invalid map size or radius: " + std::to_string(width) + "x" +
+            std::to_string(height) + " r=" + std::to_string(radius));
+        return 0;
+    }
+
+    std::vector<double> positions;
+    if (!ReadNumberArray(L, 5, positions))
+    {
+        Log("[PLOT INDEX] PlotsInRange: positions must be a table");
+        return 0;
+    }
+
+    const int plotCount = width * height;
+    std::vector<uint64_t> bits((plotCount + kWordBits - 1) / kWordBits, 0);
+    for (size_t i = 0; i + 1 < positions.size(); i += 2)
+    {
+        const int x = static_cast<int>(positions[i]);
+        const int y = static_cast<int>(positions[i + 1]);
+        if (x >= 0 && x < width && y >= 0 && y < height)
+        {
+            MarkNeighborhood(bits, width, height, wrapX, x, y, radius);
+        }
+    }
+
+    std::vector<int> plots;
+    for (size_t word = 0; word < bits.size(); word++)
+    {
+        uint64_t remaining = bits[word];
+        while (remaining)
+        {
+            plots.push_back(static_cast<int>(word) * kWordBits + std::countr_zero(remaining));
+            remaining &= remaining - 1;
+        }
+    }
+
+    PushIntegerArray(L, plots);
+    return 1;
+}
+
+int PushChangedPlots(hks::lua_State* L)
+{
+    if (!L || !IsAvailable() || hks::gettop(L) < 4)
+    {
+        Log("[PLOT INDEX] ChangedPlots requires (playerID, epoch, plotIndices, signatures)");
+        return 0;
+    }
+
+    const int playerID = hks::checkinteger(L, 1);
+    const double epoch = hks::tonumber(L, 2);
+
+    std::vector<double> plots;
+    std::vector<double> signatures;
+    if (!ReadNumberArray(L, 3, plots) || !ReadNumberArray(L, 4, signatures) ||
+        plots.size() != signatures.size())
+    {
+        Log("[PLOT INDEX] ChangedPlots: plotIndices and signatures must be tables of equal length");
+        return 0;
+    }
+
+    std::vector<int> changed;
+    {
+        std::lock_guard<std::mutex> lock(g_playerPlotsMutex);
+        PlayerPlots& player = g_playerPlots[playerID];
+        const bool fullRefresh = player.epoch != epoch;
+
+        std::unordered_map<int, double> current;
+        current.reserve(plots.size());
+        for (size_t i = 0; i < plots.size(); i++)
+        {
+            const int plot = static_cast<int>(plots[i]);
+            if (!fullRefresh)
+            {
+                auto previous = player.signatures.find(plot);
+                if (previous != player.signatures.end() && previous->second == signatures[i])
+                {
+                    current.emplace(plot, signatures[i]);
+                    continue;
+                }
+            }
+            changed.push_back(static_cast<int>(i + 1));
+            current.emplace(plot, signatures[i]);
+        }
+
+        player.epoch = epoch;
+        player.signatures = std::move(current);
+    }
+
+    LOG_DEBUG("[PLOT INDEX] Player " + std::to_string(playerID) + ": " +
+        std::to_string(changed.size()) + " of " + std::to_string(plots.size()) + " plots changed");
+
+    PushIntegerArray(L, changed);
+    return 1;
+}
+
+} // namespace PlotIndex
@@ -0,0 +1,42 @@
+#pragma once
+
+// ============================================================================
+// PlotIndex.h - Native Plot Neighborhood Index for Terrain Serialization
+// Computes the union of hex neighborhoods around unit and city positions with
+// a bitset over the map, and tracks per-player plot signatures so Lua only
+// re-serializes plots that are newly in range or have changed
+// ============================================================================
+
+#include "HavokScript.h"
+
+namespace PlotIndex
+{
+
+// ============================================================================
+// LUA STACK API
+// ============================================================================
+
+/// Check that the hks functions the index needs were resolved
+/// @return true if PushPlotsInRange and PushChangedPlots can be used
+[[nodiscard]] bool IsAvailable();
+
+/// Push the sorted plot indices within a hex radius of any position
+/// @param L Lua state with (width, height, wrapX, radius, positions) at stack indices 1-5
+/// @return Number of values pushed: the index array, or 0 on invalid arguments
+/// @note positions is a flat array {x1, y1, x2, y2, ...}; positions off the map are ignored
+/// @note Plot index is y * width + x, matching Map.GetPlotByIndex
+/// @note Rows use Civ VI's offset layout (odd rows shifted half a plot east),
+///       and x wraps around when wrapX is true
+[[nodiscard]] int PushPlotsInRange(hks::lua_State* L);
+
+/// Push the positions of plots that are new or changed since the player's last call
+/// @param L Lua state with (playerID, epoch, plotIndices, signatures) at stack indices 1-4
+/// @return Number of values pushed: an array of 1-based positions into plotIndices, or 0 on invalid arguments
+/// @note signatures is parallel to plotIndices; a plot is reported when its signature
+///       differs from the one stored for the player
+/// @note A different epoch than last time reports every plot, for changes the
+///       signature can't see (e.g. yields from new techs)
+/// @note Plots no longer in plotIndices are forgotten, so they count as new when they return
+[[nodiscard]] int PushChangedPlots(hks::lua_State* L);
+
+} // namespace PlotIndex
@@ -0,0 +1,382 @@
+// ============================================================================
+// Profiler.cpp - Hot-Path Instrumentation Implementation
+// Compiled into every configuration but empty unless CLAUDEMOD_PROFILE is set
+// ============================================================================
+
+#include "Profiler.h"
+
+#ifdef CLAUDEMOD_PROFILE
+
+#include <array>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <Windows.h>
+#include <TraceLoggingProvider.h>
+
+#include "Log.h"
+
+// ============================================================================
+// ETW PROVIDER
+// Named "ClaudeMod"; the GUID is the EventSource hash of the name, so tools
+// that resolve provider names (WPR profiles, PerfView) accept "*ClaudeMod"
+// ============================================================================
+
+TRACELOGGING_DEFINE_PROVIDER(
+    g_profileProvider,
+    "ClaudeMod",
+    // {a49dfff4-cce8-50ae-5898-289ca62cdc13}
+    (0xa49dfff4, 0xcce8, 0x50ae, 0x58, 0x98, 0x28, 0x9c, 0xa6, 0x2c, 0xdc, 0x13));
+
+namespace Profiler
+{
+
+namespace
+{
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+/// ETW keywords, so a session can enable only the events it needs
+constexpr uint64_t kKeywordZones = 0x1;
+constexpr uint64_t kKeywordFrames = 0x2;
+constexpr uint64_t kKeywordLocks = 0x4;
+constexpr uint64_t kKeywordSummary = 0x8;
+
+/// Seconds between summaries in the log
+constexpr int64_t kSummaryIntervalSeconds = 30;
+constexpr int64_t kNsPerSecond = 1000000000;
+
+/// Lock waits at least this long are also sent as individual ETW events
+constexpr int64_t kLockWaitEventNs = 10000;
+
+constexpr std::array<const char*, static_cast<size_t>(Zone::Count)> kZoneNames =
+{
+    "PcallHook", "CheckResponse", "PushString", "WorkerRequest", "HttpPost"
+};
+
+constexpr std::array<const char*, static_cast<size_t>(Counter::Count)> kCounterNames =
+{
+    "LuaBytesPushed", "RequestBytesSent", "ResponseBytesReceived", "PcallFastPath"
+};
+
+constexpr std::array<const char*, static_cast<size_t>(Lock::Count)> kLockNames =
+{
+    "AsyncRequests", "RegisteredStates"
+};
+
+// ============================================================================
+// STATISTICS
+// Written lock-free from any thread; maxima reset with each summary
+// ============================================================================
+
+struct ZoneStats
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+};
+
+struct LockStats
+{
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> waitNs{0};
+    std::atomic<uint64_t> maxWaitNs{0};
+};
+
+std::array<ZoneStats, static_cast<size_t>(Zone::Count)> g_zones;
+std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> g_counters{};
+std::array<LockStats, static_cast<size_t>(Lock::Count)> g_locks;
+
+/// Totals at the previous summary, so each summary covers one interval
+struct Snapshot
+{
+    std::array<uint64_t, static_cast<size_t>(Zone::Count)> zoneCalls{};
+    std::array<uint64_t, static_cast<size_t>(Zone::Count)> zoneNs{};
+    std::array<uint64_t, static_cast<size_t>(Counter::Count)> counters{};
+    std::array<uint64_t, static_cast<size_t>(Lock::Count)> lockAcquisitions{};
+    std::array<uint64_t, static_cast<size_t>(Lock::Count)> lockContended{};
+    std::array<uint64_t, static_cast<size_t>(Lock::Count)> lockWaitNs{};
+};
+
+/// Frame and summary state, touched by MarkFrame (UI thread) and Shutdown
+struct FrameState
+{
+    int64_t intervalStartNs = 0;
+    int64_t lastFrameNs = 0;
+    uint64_t lastFramePcallNs = 0;  ///< PcallHook total at the previous frame
+    uint64_t frames = 0;            ///< Frames this interval
+    uint64_t maxFramePcallNs = 0;   ///< Worst per-frame pcall hook time this interval
+    int64_t maxFrameIntervalNs = 0;
+    Snapshot last;
+};
+
+std::mutex g_frameMutex;
+FrameState g_frame;
+bool g_started = false;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+void UpdateMax(std::atomic<uint64_t>& maximum, uint64_t value)
+{
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current &&
+        !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+double ToUs(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000.0;
+}
+
+double ToMs(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000000.0;
+}
+
+/// Log and trace the interval since the last summary, then start the next one
+/// @note Caller holds g_frameMutex
+void WriteSummary(int64_t nowNs)
+{
+    const double seconds = static_cast<double>(nowNs - g_frame.intervalStartNs) / kNsPerSecond;
+    Snapshot current;
+
+    const size_t pcallIndex = static_cast<size_t>(Zone::PcallHook);
+    const uint64_t pcallNs = g_zones[pcallIndex].totalNs.load(std::memory_order_relaxed) -
+        g_frame.last.zoneNs[pcallIndex];
+
+    {
+        std::ostringstream o;
+        o << std::fixed << std::setprecision(1)
+          << "[PROFILE] " << seconds << "s: " << g_frame.frames << " frames";
+        if (seconds > 0)
+        {
+            o << " (" << g_frame.frames / seconds << "/s)";
+        }
+        if (g_frame.frames > 0)
+        {
+            o << std::setprecision(2)
+              << ", pcall hook " << ToUs(pcallNs / g_frame.frames) << "us/frame avg"
+              << ", " << ToUs(g_frame.maxFramePcallNs) << "us/frame max"
+              << ", longest frame " << ToMs(g_frame.maxFrameIntervalNs) << "ms";
+        }
+        Log(o.str());
+    }
+
+    for (size_t i = 0; i < g_zones.size(); i++)
+    {
+        current.zoneCalls[i] = g_zones[i].calls.load(std::memory_order_relaxed);
+        current.zoneNs[i] = g_zones[i].totalNs.load(std::memory_order_relaxed);
+        const uint64_t calls = current.zoneCalls[i] - g_frame.last.zoneCalls[i];
+        const uint64_t totalNs = current.zoneNs[i] - g_frame.last.zoneNs[i];
+        const uint64_t maxNs = g_zones[i].maxNs.exchange(0, std::memory_order_relaxed);
+        if (calls == 0)
+        {
+            continue;
+        }
+
+        std::ostringstream o;
+        o << std::fixed << std::setprecision(2)
+          << "[PROFILE]   " << kZoneNames[i] << ": " << calls << " calls"
+          << ", " << ToUs(totalNs / calls) << "us avg"
+          << ", " << ToUs(maxNs) << "us max"
+          << ", " << ToMs(totalNs) << "ms total";
+        Log(o.str());
+
+        TraceLoggingWrite(g_profileProvider, "ZoneSummary",
+            TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingKeyword(kKeywordSummary),
+            TraceLoggingString(kZoneNames[i], "Zone"),
+            TraceLoggingUInt64(calls, "Calls"),
+            TraceLoggingUInt64(totalNs, "TotalNs"),
+            TraceLoggingUInt64(maxNs, "MaxNs"));
+    }
+
+    for (size_t i = 0; i < g_counters.size(); i++)
+    {
+        current.counters[i] = g_counters[i].load(std::memory_order_relaxed);
+        const uint64_t amount = current.counters[i] - g_frame.last.counters[i];
+        if (amount == 0)
+        {
+            continue;
+        }
+
+        Log("[PROFILE]   " + std::string(kCounterNames[i]) + ": " + std::to_string(amount));
+
+        TraceLoggingWrite(g_profileProvider, "CounterSummary",
+            TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingKeyword(kKeywordSummary),
+            TraceLoggingString(kCounterNames[i], "Counter"),
+            TraceLoggingUInt64(amount, "Amount"));
+    }
+
+    for (size_t i = 0; i < g_locks.size(); i++)
+    {
+        current.lockAcquisitions[i] = g_locks[i].acquisitions.load(std::memory_order_relaxed);
+        current.lockContended[i] = g_locks[i].contended.load(std::memory_order_relaxed);
+        current.lockWaitNs[i] = g_locks[i].waitNs.load(std::memory_order_relaxed);
+        const uint64_t acquisitions = current.lockAcquisitions[i] - g_frame.last.lockAcquisitions[i];
+        const uint64_t contended = current.lockContended[i] - g_frame.last.lockContended[i];
+        const uint64_t waitNs = current.lockWaitNs[i] - g_frame.last.lockWaitNs[i];
+        const uint64_t maxWaitNs = g_locks[i].maxWaitNs.exchange(0, std::memory_order_relaxed);
+        if (acquisitions == 0)
+        {
+            continue;
+        }
+
+        std::ostringstream o;
+        o << std::fixed << std::setprecision(2)
+          << "[PROFILE]   lock " << kLockNames[i] << ": " << acquisitions << " acquisitions"
+          << ", " << contended << " contended"
+          << ", " << ToMs(waitNs) << "ms waited"
+          << ", " << ToUs(maxWaitNs) << "us max";
+        Log(o.str());
+
+        TraceLoggingWrite(g_profileProvider, "LockSummary",
+            TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingKeyword(kKeywordSummary),
+            TraceLoggingString(kLockNames[i], "Lock"),
+            TraceLoggingUInt64(acquisitions, "Acquisitions"),
+            TraceLoggingUInt64(contended, "Contended"),
+            TraceLoggingUInt64(waitNs, "WaitNs"),
+            TraceLoggingUInt64(maxWaitNs, "MaxWaitNs"));
+    }
+
+    g_frame.last = current;
+    g_frame.intervalStartNs = nowNs;
+    g_frame.frames = 0;
+    g_frame.maxFramePcallNs = 0;
+    g_frame.maxFrameIntervalNs = 0;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void Startup()
+{
+    std::lock_guard<std::mutex> lock(g_frameMutex);
+    if (g_started)
+    {
+        return;
+    }
+
+    HRESULT hr = TraceLoggingRegister(g_profileProvider);
+    g_frame.intervalStartNs = NowNs();
+    g_started = true;
+
+    Log(SUCCEEDED(hr)
+        ? "[PROFILE] Profiling enabled, ETW provider ClaudeMod {a49dfff4-cce8-50ae-5898-289ca62cdc13} registered"
+        : "[PROFILE] Profiling enabled, ETW provider registration failed (hr=" + std::to_string(hr) + ")");
+}
+
+void Shutdown()
+{
+    std::lock_guard<std::mutex> lock(g_frameMutex);
+    if (!g_started)
+    {
+        return;
+    }
+
+    Log("[PROFILE] Final summary:");
+    WriteSummary(NowNs());
+
+    TraceLoggingUnregister(g_profileProvider);
+    g_started = false;
+}
+
+void EndZone(Zone zone, int64_t elapsedNs)
+{
+    ZoneStats& stats = g_zones[static_cast<size_t>(zone)];
+    const uint64_t ns = static_cast<uint64_t>(elapsedNs);
+    stats.calls.fetch_add(1, std::memory_order_relaxed);
+    stats.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    UpdateMax(stats.maxNs, ns);
+
+    // The event carries the zone's duration; its timestamp marks the zone's end
+    TraceLoggingWrite(g_profileProvider, "Zone",
+        TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+        TraceLoggingKeyword(kKeywordZones),
+        TraceLoggingString(kZoneNames[static_cast<size_t>(zone)], "Zone"),
+        TraceLoggingInt64(elapsedNs, "DurationNs"));
+}
+
+void Add(Counter counter, uint64_t amount)
+{
+    g_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void RecordLockWait(Lock lock, int64_t waitNs)
+{
+    LockStats& stats = g_locks[static_cast<size_t>(lock)];
+    stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (waitNs <= 0)
+    {
+        return;
+    }
+
+    const uint64_t ns = static_cast<uint64_t>(waitNs);
+    stats.contended.fetch_add(1, std::memory_order_relaxed);
+    stats.waitNs.fetch_add(ns, std::memory_order_relaxed);
+    UpdateMax(stats.maxWaitNs, ns);
+
+    if (waitNs >= kLockWaitEventNs)
+    {
+        TraceLoggingWrite(g_profileProvider, "LockWait",
+            TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingKeyword(kKeywordLocks),
+            TraceLoggingString(kLockNames[static_cast<size_t>(lock)], "Lock"),
+            TraceLoggingInt64(waitNs, "WaitNs"));
+    }
+}
+
+void MarkFrame()
+{
+    std::lock_guard<std::mutex> lock(g_frameMutex);
+    if (!g_started)
+    {
+        return;
+    }
+
+    const int64_t nowNs = NowNs();
+    const uint64_t pcallTotalNs =
+        g_zones[static_cast<size_t>(Zone::PcallHook)].totalNs.load(std::memory_order_relaxed);
+    const uint64_t framePcallNs = pcallTotalNs - g_frame.lastFramePcallNs;
+    const int64_t frameIntervalNs = g_frame.lastFrameNs ? nowNs - g_frame.lastFrameNs : 0;
+
+    g_frame.lastFramePcallNs = pcallTotalNs;
+    g_frame.lastFrameNs = nowNs;
+    g_frame.frames++;
+    if (framePcallNs > g_frame.maxFramePcallNs)
+    {
+        g_frame.maxFramePcallNs = framePcallNs;
+    }
+    if (frameIntervalNs > g_frame.maxFrameIntervalNs)
+    {
+        g_frame.maxFrameIntervalNs = frameIntervalNs;
+    }
+
+    TraceLoggingWrite(g_profileProvider, "Frame",
+        TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+        TraceLoggingKeyword(kKeywordFrames),
+        TraceLoggingUInt64(framePcallNs, "PcallHookNs"),
+        TraceLoggingInt64(frameIntervalNs, "FrameNs"));
+
+    if (nowNs - g_frame.intervalStartNs >= kSummaryIntervalSeconds * kNsPerSecond)
+    {
+        WriteSummary(nowNs);
+    }
+}
+
+} // namespace Profiler
+
+#endif // CLAUDEMOD_PROFILE
@@ -0,0 +1,155 @@
+#pragma once
+
+// ============================================================================
+// Profiler.h - Hot-Path Instrumentation for the Profile Configuration
+// Scoped zones, atomic counters and lock-wait timers around the pcall hook,
+// response polling, Lua string pushes and the request workers. Published as
+// ETW TraceLogging events and summarized in the log periodically.
+// Without CLAUDEMOD_PROFILE (every configuration but Profile) the macros
+// compile to nothing and their arguments are never evaluated
+// ============================================================================
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// ============================================================================
+// INSTRUMENTATION POINTS
+// ============================================================================
+
+namespace Profiler
+{
+
+/// Timed code regions
+enum class Zone : uint32_t
+{
+    PcallHook,      ///< HookedPcall's own work before the original pcall
+    CheckResponse,  ///< lua_CheckClaudeAPIResponse, polled every tick while waiting
+    PushString,     ///< PushStringToLua
+    WorkerRequest,  ///< One request on an AsyncWorkerThread, queue pop to completion
+    HttpPost,       ///< One HttpPost including retries
+    Count
+};
+
+/// Summed quantities
+enum class Counter : uint32_t
+{
+    LuaBytesPushed,         ///< String bytes handed to Lua by PushStringToLua
+    RequestBytesSent,       ///< HTTP request bodies
+    ResponseBytesReceived,  ///< HTTP response bodies
+    PcallFastPath,          ///< Pcalls whose state the lock-free cache resolved
+    Count
+};
+
+/// Mutexes whose acquisition is timed
+enum class Lock : uint32_t
+{
+    AsyncRequests,      ///< g_asyncMutex in ClaudeAPI.cpp (request table, queue)
+    RegisteredStates,   ///< g_registeredStatesMutex in HavokScriptIntegration.cpp
+    Count
+};
+
+#ifdef CLAUDEMOD_PROFILE
+
+// ============================================================================
+// PROFILE BUILD API (use the macros below instead)
+// ============================================================================
+
+/// Register the ETW provider and start the summary clock (call once at DLL startup)
+void Startup();
+
+/// Log a final summary and unregister the ETW provider (call on DLL_PROCESS_DETACH)
+void Shutdown();
+
+/// Record one finished zone
+void EndZone(Zone zone, int64_t elapsedNs);
+
+/// Add to a counter
+void Add(Counter counter, uint64_t amount);
+
+/// Record one acquisition of a timed mutex
+void RecordLockWait(Lock lock, int64_t waitNs);
+
+/// Close the current frame; logs a summary every kSummaryIntervalSeconds
+/// @note Called from the UI context's per-frame update through ProfileClaudeFrame
+void MarkFrame();
+
+/// Monotonic clock in nanoseconds (QueryPerformanceCounter on MSVC)
+inline int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Times the enclosing scope as one zone
+class ScopedZone
+{
+public:
+    explicit ScopedZone(Zone zone) : m_zone(zone), m_startNs(NowNs()) {}
+    ~ScopedZone() { EndZone(m_zone, NowNs() - m_startNs); }
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+    Zone m_zone;
+    int64_t m_startNs;
+};
+
+/// Lock a mutex and record how long the acquisition waited
+/// @return The locked mutex, for a lock_guard constructed with std::adopt_lock
+inline std::mutex& TimedLock(std::mutex& mutex, Lock lock)
+{
+    // Uncontended acquisitions skip the clock
+    if (mutex.try_lock())
+    {
+        RecordLockWait(lock, 0);
+        return mutex;
+    }
+
+    const int64_t startNs = NowNs();
+    mutex.lock();
+    RecordLockWait(lock, NowNs() - startNs);
+    return mutex;
+}
+
+#endif // CLAUDEMOD_PROFILE
+
+} // namespace Profiler
+
+// ============================================================================
+// MACROS
+// ============================================================================
+
+#ifdef CLAUDEMOD_PROFILE
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+/// Time the rest of the enclosing scope as Profiler::Zone::zone
+#define PROFILE_ZONE(zone) \
+    ::Profiler::ScopedZone PROFILE_CONCAT(profileZone_, __LINE__)(::Profiler::Zone::zone)
+
+/// Add amount to Profiler::Counter::counter
+#define PROFILE_COUNT(counter, amount) \
+    ::Profiler::Add(::Profiler::Counter::counter, static_cast<uint64_t>(amount))
+
+/// Declare std::lock_guard<std::mutex> name on target, timing the wait as Profiler::Lock::lockId
+#define PROFILE_LOCK_GUARD(name, target, lockId) \
+    std::lock_guard<std::mutex> name(::Profiler::TimedLock(target, ::Profiler::Lock::lockId), std::adopt_lock)
+
+#define PROFILE_FRAME() ::Profiler::MarkFrame()
+#define PROFILE_STARTUP() ::Profiler::Startup()
+#define PROFILE_SHUTDOWN() ::Profiler::Shutdown()
+
+#else
+
+#define PROFILE_ZONE(zone) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_LOCK_GUARD(name, target, lockId) std::lock_guard<std::mutex> name(target)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_STARTUP() ((void)0)
+#define PROFILE_SHUTDOWN() ((void)0)
+
+#endif // CLAUDEMOD_PROFILE
@@ -0,0 +1,545 @@
+// ============================================================================
+// RequestRecorder.cpp - Request/Response Recorder and Replay Implementation
+// ============================================================================
+
+#include "RequestRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include <Windows.h>
+#include <compressapi.h>
+
+#include "Log.h"
+
+#pragma comment(lib, "Cabinet.lib")
+
+namespace RequestRecorder
+{
+
+// ============================================================================
+// FILE FORMAT
+// A FileHeader followed by records, each a RecordHeader and its stored bytes.
+// The stored bytes are the compressed (or, if compression failed, raw) payload:
+// path, request body and response, each as a uint32 length and its bytes
+// ============================================================================
+
+namespace
+{
+    constexpr char kFileMagic[4] = {'C', '6', 'R', 'Q'};
+    constexpr uint32_t kFileVersion = 1;
+    constexpr const char* kRecordingPrefix = "civ6_claude_requests_";
+    constexpr size_t kMaxPayloadBytes = 64 * 1024 * 1024;  ///< Larger rawBytes mean a corrupt record
+    constexpr size_t kMaxCompressionRatio = 64;             ///< Far above what JSON and event streams reach
+    constexpr int kMaxRecordingNameAttempts = 100;          ///< Numbered names tried when one is taken
+
+    /// How a record's payload is stored
+    enum Codec : uint32_t
+    {
+        kCodecNone = 0,
+        kCodecXpressHuff = 1
+    };
+
+#pragma pack(push, 1)
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t usedBytes;         ///< Header plus complete records; written after each record
+        uint64_t recordCount;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t storedBytes;       ///< Bytes following this header
+        uint32_t rawBytes;          ///< Payload size before compression
+        uint32_t codec;
+        uint32_t statusCode;
+        uint64_t bodyHash;          ///< FNV-1a of the request body, for replay lookups
+        double firstByteMs;
+        double totalMs;
+    };
+#pragma pack(pop)
+}
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+    /// The open recording of the current game
+    struct Recording
+    {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+        uint8_t* view = nullptr;
+        size_t capacity = 0;
+        std::string path;
+        bool full = false;          ///< An exchange didn't fit; the rest of the game isn't recorded
+        bool failed = false;        ///< The file couldn't be opened; retried next game
+    };
+
+    std::mutex g_recordMutex;
+    bool g_recordingEnabled = false;
+    size_t g_maxRecordingBytes = 0;
+    Recording g_recording;
+    COMPRESSOR_HANDLE g_compressor = nullptr;
+
+    /// A loaded recording being replayed
+    struct ReplaySet
+    {
+        std::vector<Exchange> exchanges;
+        std::vector<uint64_t> hashes;
+        std::vector<bool> served;
+        size_t servedCount = 0;
+    };
+
+    std::mutex g_replayMutex;
+    bool g_replaying = false;
+    ReplaySet g_replay;
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+namespace
+{
+
+/// 64-bit FNV-1a hash
+uint64_t HashBytes(const std::string& bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : bytes)
+    {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// Append a uint32 length and the bytes
+void AppendField(std::string& out, const std::string& field)
+{
+    uint32_t length = static_cast<uint32_t>(field.size());
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out += field;
+}
+
+/// Read a field written by AppendField
+/// @return false if the payload ends early
+bool ReadField(const std::string& payload, size_t& offset, std::string& out)
+{
+    uint32_t length = 0;
+    if (payload.size() - offset < sizeof(length))
+    {
+        return false;
+    }
+    std::memcpy(&length, payload.data() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (payload.size() - offset < length)
+    {
+        return false;
+    }
+    out.assign(payload, offset, length);
+    offset += length;
+    return true;
+}
+
+FileHeader* GetFileHeader()
+{
+    return reinterpret_cast<FileHeader*>(g_recording.view);
+}
+
+/// Unmap the current file and cut it to the bytes actually used
+/// Note: Caller must hold g_recordMutex lock
+void CloseRecording()
+{
+    if (g_recording.view)
+    {
+        uint64_t usedBytes = GetFileHeader()->usedBytes;
+        uint64_t recordCount = GetFileHeader()->recordCount;
+        FlushViewOfFile(g_recording.view, static_cast<size_t>(usedBytes));
+        UnmapViewOfFile(g_recording.view);
+        CloseHandle(g_recording.mapping);
+
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(usedBytes);
+        if (!SetFilePointerEx(g_recording.file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(g_recording.file))
+        {
+            Log(LogLevel::Warning, "[RECORDER] WARNING: Could not trim " + g_recording.path);
+        }
+        Log("[RECORDER] Closed " + g_recording.path + ": " + std::to_string(recordCount) + " exchanges, " +
+            std::to_string(usedBytes) + " bytes");
+    }
+    if (g_recording.file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(g_recording.file);
+    }
+    g_recording = Recording();
+}
+
+/// Create and map this game's file at its full capacity
+/// Note: Caller must hold g_recordMutex lock
+bool OpenRecording()
+{
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    char stamp[32];
+    sprintf_s(stamp, "%04d%02d%02d_%02d%02d%02d",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    g_recording.capacity = g_maxRecordingBytes;
+
+    // Never overwrite: two games started within a second get _2, _3, ...
+    for (int attempt = 1; attempt <= kMaxRecordingNameAttempts; attempt++)
+    {
+        g_recording.path = std::string(kRecordingPrefix) + stamp +
+            (attempt > 1 ? "_" + std::to_string(attempt) : std::string()) + ".bin";
+        g_recording.file = CreateFileA(g_recording.path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                       nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (g_recording.file != INVALID_HANDLE_VALUE || GetLastError() != ERROR_FILE_EXISTS)
+        {
+            break;
+        }
+    }
+    if (g_recording.file == INVALID_HANDLE_VALUE)
+    {
+        Log(LogLevel::Warning, "[RECORDER] WARNING: Could not create " + g_recording.path + " (error " +
+            std::to_string(GetLastError()) + ")");
+        return false;
+    }
+
+    // Mapping past the end extends the file, so the view never has to grow
+    ULARGE_INTEGER size;
+    size.QuadPart = g_recording.capacity;
+    g_recording.mapping = CreateFileMappingA(g_recording.file, nullptr, PAGE_READWRITE,
+                                             size.HighPart, size.LowPart, nullptr);
+    g_recording.view = g_recording.mapping
+        ? static_cast<uint8_t*>(MapViewOfFile(g_recording.mapping, FILE_MAP_WRITE, 0, 0, g_recording.capacity))
+        : nullptr;
+    if (!g_recording.view)
+    {
+        Log(LogLevel::Warning, "[RECORDER] WARNING: Could not map " + g_recording.path + " (error " +
+            std::to_string(GetLastError()) + ")");
+        if (g_recording.mapping)
+        {
+            CloseHandle(g_recording.mapping);
+        }
+        CloseHandle(g_recording.file);
+        g_recording = Recording();
+        return false;
+    }
+
+    FileHeader* header = GetFileHeader();
+    std::memcpy(header->magic, kFileMagic, sizeof(kFileMagic));
+    header->version = kFileVersion;
+    header->recordCount = 0;
+    header->usedBytes = sizeof(FileHeader);
+
+    if (!g_compressor && !CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &g_compressor))
+    {
+        Log(LogLevel::Warning, "[RECORDER] WARNING: No compressor (error " + std::to_string(GetLastError()) +
+            "), storing exchanges uncompressed");
+        g_compressor = nullptr;
+    }
+
+    Log("[RECORDER] Recording requests to " + g_recording.path + " (up to " +
+        std::to_string(g_recording.capacity / (1024 * 1024)) + " MB)");
+    return true;
+}
+
+/// Parse the records of a recording file
+/// @return false if the file isn't a recording
+bool ParseRecording(const std::string& bytes, ReplaySet& out)
+{
+    FileHeader header;
+    if (bytes.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 || header.version != kFileVersion)
+    {
+        return false;
+    }
+
+    DECOMPRESSOR_HANDLE decompressor = nullptr;
+    CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &decompressor);
+
+    // A file from a crashed game was never trimmed, but usedBytes still covers whole records
+    size_t end = static_cast<size_t>((std::min)(header.usedBytes, static_cast<uint64_t>(bytes.size())));
+    size_t offset = sizeof(header);
+    while (end - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader record;
+        std::memcpy(&record, bytes.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (end - offset < record.storedBytes)
+        {
+            break;
+        }
+
+        std::string payload;
+        const char* stored = bytes.data() + offset;
+        offset += record.storedBytes;
+        if (record.codec == kCodecNone)
+        {
+            payload.assign(stored, record.storedBytes);
+        }
+        else
+        {
+            // Checked before allocating: a corrupt header could otherwise ask for gigabytes
+            if (record.rawBytes > kMaxPayloadBytes || record.rawBytes > bytes.size() * kMaxCompressionRatio)
+            {
+                Log(LogLevel::Warning, "[REPLAY] WARNING: Skipping a record with an implausible size (" +
+                    std::to_string(record.rawBytes) + " bytes)");
+                continue;
+            }
+            payload.resize(record.rawBytes);
+            SIZE_T decompressed = 0;
+            if (record.codec != kCodecXpressHuff || !decompressor ||
+                !Decompress(decompressor, stored, record.storedBytes, payload.data(), payload.size(), &decompressed) ||
+                decompressed != record.rawBytes)
+            {
+                Log(LogLevel::Warning, "[REPLAY] WARNING: Skipping a record that did not decompress");
+                continue;
+            }
+        }
+
+        Exchange exchange;
+        size_t fieldOffset = 0;
+        if (!ReadField(payload, fieldOffset, exchange.path) ||
+            !ReadField(payload, fieldOffset, exchange.requestBody) ||
+            !ReadField(payload, fieldOffset, exchange.response))
+        {
+            Log(LogLevel::Warning, "[REPLAY] WARNING: Skipping a truncated record");
+            continue;
+        }
+        exchange.statusCode = record.statusCode;
+        exchange.firstByteMs = record.firstByteMs;
+        exchange.totalMs = record.totalMs;
+
+        out.exchanges.push_back(std::move(exchange));
+        out.hashes.push_back(record.bodyHash);
+    }
+
+    if (decompressor)
+    {
+        CloseDecompressor(decompressor);
+    }
+    out.served.assign(out.exchanges.size(), false);
+    return true;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+void StartRecording(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(g_recordMutex);
+    if (g_recordingEnabled && g_maxRecordingBytes != maxBytes)
+    {
+        CloseRecording();
+    }
+    g_recordingEnabled = true;
+    g_maxRecordingBytes = maxBytes;
+}
+
+void StopRecording()
+{
+    std::lock_guard<std::mutex> lock(g_recordMutex);
+    CloseRecording();
+    g_recordingEnabled = false;
+    if (g_compressor)
+    {
+        CloseCompressor(g_compressor);
+        g_compressor = nullptr;
+    }
+}
+
+void StartNewGame()
+{
+    std::lock_guard<std::mutex> lock(g_recordMutex);
+    CloseRecording();
+}
+
+bool IsRecording()
+{
+    std::lock_guard<std::mutex> lock(g_recordMutex);
+    return g_recordingEnabled;
+}
+
+void Record(const Exchange& exchange)
+{
+    std::string payload;
+    payload.reserve(exchange.path.size() + exchange.requestBody.size() + exchange.response.size() +
+        3 * sizeof(uint32_t));
+    AppendField(payload, exchange.path);
+    AppendField(payload, exchange.requestBody);
+    AppendField(payload, exchange.response);
+
+    std::lock_guard<std::mutex> lock(g_recordMutex);
+    if (!g_recordingEnabled || g_recording.full || g_recording.failed)
+    {
+        return;
+    }
+    if (!g_recording.view && !OpenRecording())
+    {
+        g_recording.failed = true;
+        return;
+    }
+
+    FileHeader* header = GetFileHeader();
+    size_t offset = static_cast<size_t>(header->usedBytes);
+    size_t room = g_recording.capacity - offset;
+    if (room <= sizeof(RecordHeader))
+    {
+        g_recording.full = true;
+    }
+    else
+    {
+        // Compressed straight into the mapped view; a payload that doesn't shrink is stored as is
+        uint8_t* storedAt = g_recording.view + offset + sizeof(RecordHeader);
+        room -= sizeof(RecordHeader);
+
+        RecordHeader record{};
+        SIZE_T storedBytes = 0;
+        record.codec = kCodecXpressHuff;
+        if (!g_compressor || !Compress(g_compressor, payload.data(), payload.size(), storedAt, room, &storedBytes) ||
+            storedBytes >= payload.size())
+        {
+            record.codec = kCodecNone;
+            storedBytes = payload.size();
+            if (storedBytes > room)
+            {
+                g_recording.full = true;
+            }
+            else
+            {
+                std::memcpy(storedAt, payload.data(), payload.size());
+            }
+        }
+
+        if (!g_recording.full)
+        {
+            record.storedBytes = static_cast<uint32_t>(storedBytes);
+            record.rawBytes = static_cast<uint32_t>(payload.size());
+            record.statusCode = exchange.statusCode;
+            record.bodyHash = HashBytes(exchange.requestBody);
+            record.firstByteMs = exchange.firstByteMs;
+            record.totalMs = exchange.totalMs;
+            std::memcpy(g_recording.view + offset, &record, sizeof(record));
+
+            // Published last, so a reader (or a crash) never sees a partial record
+            header->recordCount++;
+            header->usedBytes = offset + sizeof(record) + storedBytes;
+            LOG_DEBUG("[RECORDER] Recorded " + std::to_string(payload.size()) + " bytes as " +
+                std::to_string(storedBytes) + " (" + exchange.path + ", status " +
+                std::to_string(exchange.statusCode) + ")");
+            return;
+        }
+    }
+
+    Log("[RECORDER] " + g_recording.path + " is full (" + std::to_string(g_recording.capacity) +
+        " bytes), not recording the rest of this game");
+}
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+
+bool StartReplay(const std::string& path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        Log(LogLevel::Warning, "[REPLAY] WARNING: Could not open " + path);
+        return false;
+    }
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    ReplaySet replay;
+    if (!ParseRecording(bytes, replay))
+    {
+        Log(LogLevel::Warning, "[REPLAY] WARNING: " + path + " is not a request recording");
+        return false;
+    }
+    if (replay.exchanges.empty())
+    {
+        Log(LogLevel::Warning, "[REPLAY] WARNING: " + path + " holds no exchanges");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_replayMutex);
+    Log("[REPLAY] Serving " + std::to_string(replay.exchanges.size()) + " recorded exchanges from " + path);
+    g_replay = std::move(replay);
+    g_replaying = true;
+    return true;
+}
+
+void StopReplay()
+{
+    std::lock_guard<std::mutex> lock(g_replayMutex);
+    if (g_replaying)
+    {
+        Log("[REPLAY] Stopped after " + std::to_string(g_replay.servedCount) + " of " +
+            std::to_string(g_replay.exchanges.size()) + " exchanges");
+    }
+    g_replay = ReplaySet();
+    g_replaying = false;
+}
+
+bool IsReplaying()
+{
+    std::lock_guard<std::mutex> lock(g_replayMutex);
+    return g_replaying;
+}
+
+bool TakeReplay(const std::string& path, const std::string& requestBody, Exchange& out)
+{
+    uint64_t hash = HashBytes(requestBody);
+
+    std::lock_guard<std::mutex> lock(g_replayMutex);
+    size_t match = g_replay.exchanges.size();
+    size_t next = g_replay.exchanges.size();
+    for (size_t i = 0; i < g_replay.exchanges.size(); i++)
+    {
+        const Exchange& exchange = g_replay.exchanges[i];
+        if (g_replay.served[i] || exchange.path != path)
+        {
+            continue;
+        }
+        if (next == g_replay.exchanges.size())
+        {
+            next = i;
+        }
+        if (g_replay.hashes[i] == hash && exchange.requestBody == requestBody)
+        {
+            match = i;
+            break;
+        }
+    }
+
+    size_t chosen = match != g_replay.exchanges.size() ? match : next;
+    if (chosen == g_replay.exchanges.size())
+    {
+        Log("[REPLAY] No recorded exchange left for " + path);
+        return false;
+    }
+
+    g_replay.served[chosen] = true;
+    g_replay.servedCount++;
+    out = g_replay.exchanges[chosen];
+    LOG_DEBUG("[REPLAY] Serving exchange #" + std::to_string(chosen + 1) +
+        (chosen == match ? " (same request)" : " (next in order)"));
+    return true;
+}
+
+} // namespace RequestRecorder
@@ -0,0 +1,73 @@
+#pragma once
+
+// ============================================================================
+// RequestRecorder.h - Request/Response Recording and Deterministic Replay
+// Appends every Messages API exchange (request body, raw response, timings)
+// to a compressed, length-prefixed file per game through a memory-mapped view,
+// and serves a recorded file back in place of the network
+// ============================================================================
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RequestRecorder
+{
+
+/// One HTTP exchange as sent and received
+struct Exchange
+{
+    std::string path;           ///< Request path (e.g. /v1/messages)
+    std::string requestBody;
+    std::string response;       ///< Body as received: JSON, or the raw event stream when streaming
+    uint32_t statusCode = 0;    ///< 0 when no response arrived
+    double firstByteMs = 0;     ///< Request sent until the response headers arrived
+    double totalMs = 0;         ///< Send started until the body was read
+};
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+/// Record exchanges from now on, into civ6_claude_requests_<date>_<time>[_<n>].bin files
+/// @param maxBytes Size limit of one game's file; exchanges that don't fit are dropped
+/// @note The file is created on the first exchange and capped at maxBytes up front
+void StartRecording(size_t maxBytes);
+
+/// Close the current file and stop recording
+void StopRecording();
+
+/// Close the current file so the next exchange starts a file for the new game
+void StartNewGame();
+
+/// Check whether exchanges are being recorded
+[[nodiscard]] bool IsRecording();
+
+/// Append an exchange to this game's file
+/// @note Thread-safe; a failure is logged once and recording continues with the next game
+void Record(const Exchange& exchange);
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+
+/// Serve requests from a recording instead of the network
+/// @param path Recording written by Record
+/// @return false if the file can't be read or holds no exchanges
+[[nodiscard]] bool StartReplay(const std::string& path);
+
+/// Go back to the network
+void StopReplay();
+
+/// Check whether requests are served from a recording
+[[nodiscard]] bool IsReplaying();
+
+/// Take the recorded exchange for a request
+/// @param out Receives the exchange
+/// @return false if the recording has nothing left for the path
+/// @note An identical request body is matched first; otherwise the next unused
+///       exchange for the path is served, so runs whose bodies drift (history,
+///       timings in the state) still replay in order. Each exchange is served once
+[[nodiscard]] bool TakeReplay(const std::string& path, const std::string& requestBody, Exchange& out);
+
+} // namespace RequestRecorder
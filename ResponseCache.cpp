@@ -0,0 +1,440 @@
+// ============================================================================
+// ResponseCache.cpp - Content-Addressed Response Cache Implementation
+// ============================================================================
+
+#include "ResponseCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+#include "Log.h"
+#include "StateDelta.h"
+
+namespace ResponseCache
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    constexpr size_t kMaxMemoryCacheEntries = 64;
+    constexpr size_t kMaxDiskCacheEntries = 256;
+    constexpr uint64_t kFileTimeTicksPerSecond = 10000000;    ///< FILETIME counts 100ns intervals
+    constexpr const char* kFolderName = "response_cache";
+
+    constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t kFnvPrime = 1099511628211ull;
+}
+
+// ============================================================================
+// MODULE STATE
+// ============================================================================
+
+namespace
+{
+    /// A cached reply; the action document is rebuilt from the text on a hit
+    struct ResponseCacheEntry
+    {
+        std::string text;                       ///< Claude's reply as received
+        FILETIME storedAt{};
+        std::list<uint64_t>::iterator order;    ///< Position in g_responseCacheOrder
+    };
+
+    std::atomic<bool> g_diskEnabled{false};
+    std::atomic<uint64_t> g_ttlSeconds{kDefaultTtlSeconds};
+
+    // Content-addressed response cache (guarded by g_responseCacheMutex)
+    std::mutex g_responseCacheMutex;
+    std::unordered_map<uint64_t, ResponseCacheEntry> g_responseCache;
+    std::list<uint64_t> g_responseCacheOrder;      ///< Most recently used first
+    ClaudeAPI::ResponseCacheStats g_responseCacheStats;
+    std::mutex g_diskCacheMutex;                   ///< Serializes access to the cache folder
+}
+
+// ============================================================================
+// HASHING
+// ============================================================================
+
+namespace
+{
+
+void HashBytes(uint64_t& hash, std::string_view bytes)
+{
+    for (unsigned char c : bytes)
+    {
+        hash ^= c;
+        hash *= kFnvPrime;
+    }
+}
+
+/// Hash a scalar with a type tag; numbers are formatted with to_chars, strings
+/// hashed raw behind their length, so no value is serialized
+void HashScalar(uint64_t& hash, const json& value)
+{
+    char buffer[32];
+    char* end = buffer;
+    switch (value.type())
+    {
+    case json::value_t::string:
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        buffer[0] = 's';
+        end = std::to_chars(buffer + 1, std::end(buffer), text.size()).ptr;
+        *end++ = ':';
+        HashBytes(hash, std::string_view(buffer, end - buffer));
+        HashBytes(hash, text);
+        return;
+    }
+    case json::value_t::number_integer:
+        buffer[0] = 'i';
+        end = std::to_chars(buffer + 1, std::end(buffer), value.get<int64_t>()).ptr;
+        break;
+    case json::value_t::number_unsigned:
+        buffer[0] = 'u';
+        end = std::to_chars(buffer + 1, std::end(buffer), value.get<uint64_t>()).ptr;
+        break;
+    case json::value_t::number_float:
+        buffer[0] = 'd';
+        end = std::to_chars(buffer + 1, std::end(buffer), value.get<double>()).ptr;
+        break;
+    case json::value_t::boolean:
+        buffer[0] = value.get<bool>() ? 't' : 'f';
+        end = buffer + 1;
+        break;
+    default:
+        buffer[0] = 'n';
+        end = buffer + 1;
+        break;
+    }
+    *end++ = ',';
+    HashBytes(hash, std::string_view(buffer, end - buffer));
+}
+
+/// Hash a value independently of key order and of the order of keyed array
+/// elements (units, cities, plots), which Lua's table iteration doesn't keep stable
+void HashCanonical(uint64_t& hash, const json& value)
+{
+    if (value.is_object())
+    {
+        // nlohmann's object map iterates in sorted key order
+        HashBytes(hash, "{");
+        for (auto it = value.begin(); it != value.end(); ++it)
+        {
+            HashBytes(hash, it.key());
+            HashBytes(hash, ":");
+            HashCanonical(hash, it.value());
+        }
+        HashBytes(hash, "}");
+        return;
+    }
+
+    if (value.is_array())
+    {
+        std::vector<std::pair<std::string, const json*>> keyed;
+        keyed.reserve(value.size());
+        for (const json& element : value)
+        {
+            std::string key = StateDelta::ElementKey(element);
+            if (key.empty())
+            {
+                keyed.clear();
+                break;
+            }
+            keyed.emplace_back(std::move(key), &element);
+        }
+
+        HashBytes(hash, "[");
+        if (!keyed.empty())
+        {
+            std::sort(keyed.begin(), keyed.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (const auto& [key, element] : keyed)
+            {
+                HashCanonical(hash, *element);
+            }
+        }
+        else
+        {
+            for (const json& element : value)
+            {
+                HashCanonical(hash, element);
+            }
+        }
+        HashBytes(hash, "]");
+        return;
+    }
+
+    HashScalar(hash, value);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+namespace
+{
+
+/// Age of a cache entry or file in seconds
+uint64_t SecondsSince(const FILETIME& time)
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER nowValue{{now.dwLowDateTime, now.dwHighDateTime}};
+    ULARGE_INTEGER timeValue{{time.dwLowDateTime, time.dwHighDateTime}};
+    if (nowValue.QuadPart <= timeValue.QuadPart)
+    {
+        return 0;
+    }
+    return (nowValue.QuadPart - timeValue.QuadPart) / kFileTimeTicksPerSecond;
+}
+
+std::string GetResponseCacheFolder()
+{
+    std::string modFolder = ClaudeAPI::GetModFolderPath();
+    return modFolder.empty() ? modFolder : modFolder + kFolderName + "\\";
+}
+
+std::string GetResponseCacheFilePath(uint64_t key)
+{
+    std::string folder = GetResponseCacheFolder();
+    return folder.empty() ? folder : folder + FormatKey(key) + ".txt";
+}
+
+/// Read a cached reply from disk if it exists and hasn't expired
+/// @note Caller must hold g_diskCacheMutex lock
+bool ReadDiskCacheEntry(uint64_t key, uint64_t ttlSeconds, std::string& outText)
+{
+    std::string path = GetResponseCacheFilePath(key);
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (path.empty() || !GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    if (SecondsSince(attributes.ftLastWriteTime) > ttlSeconds)
+    {
+        DeleteFileA(path.c_str());
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    outText.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    file.close();
+
+    // The write time dates the entry for the TTL; the access time orders it for pruning
+    HANDLE handle = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        SetFileTime(handle, nullptr, &now, nullptr);
+        CloseHandle(handle);
+    }
+    return !outText.empty();
+}
+
+/// Delete the least recently used files once the folder holds too many
+/// @note Caller must hold g_diskCacheMutex lock
+void PruneDiskCache(const std::string& folder)
+{
+    std::vector<std::pair<uint64_t, std::string>> files;  // (access time, name)
+
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA((folder + "*.txt").c_str(), &findData);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    do
+    {
+        const FILETIME& accessed = findData.ftLastAccessTime;
+        ULARGE_INTEGER accessTime{{accessed.dwLowDateTime, accessed.dwHighDateTime}};
+        files.emplace_back(accessTime.QuadPart, findData.cFileName);
+    } while (FindNextFileA(find, &findData));
+    FindClose(find);
+
+    if (files.size() <= kMaxDiskCacheEntries)
+    {
+        return;
+    }
+
+    std::sort(files.begin(), files.end());
+    size_t excess = files.size() - kMaxDiskCacheEntries;
+    for (size_t i = 0; i < excess; i++)
+    {
+        DeleteFileA((folder + files[i].second).c_str());
+    }
+    Log("[RESPONSE CACHE] Pruned " + std::to_string(excess) + " old files from disk");
+}
+
+/// Write a reply to the disk cache
+/// @note Caller must hold g_diskCacheMutex lock
+void WriteDiskCacheEntry(uint64_t key, const std::string& text)
+{
+    std::string folder = GetResponseCacheFolder();
+    if (folder.empty())
+    {
+        return;
+    }
+    CreateDirectoryA(folder.c_str(), nullptr);
+
+    std::ofstream file(folder + FormatKey(key) + ".txt", std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        Log(LogLevel::Warning, "[RESPONSE CACHE] WARNING: Could not write " + folder + FormatKey(key) +
+            ".txt");
+        return;
+    }
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    file.close();
+
+    PruneDiskCache(folder);
+}
+
+/// Add a reply to the in-memory cache, evicting the least recently used entry when full
+/// @note Caller must hold g_responseCacheMutex lock
+void InsertMemoryCacheEntry(uint64_t key, std::string text)
+{
+    auto existing = g_responseCache.find(key);
+    if (existing != g_responseCache.end())
+    {
+        g_responseCacheOrder.erase(existing->second.order);
+        g_responseCache.erase(existing);
+    }
+
+    while (g_responseCache.size() >= kMaxMemoryCacheEntries && !g_responseCacheOrder.empty())
+    {
+        g_responseCache.erase(g_responseCacheOrder.back());
+        g_responseCacheOrder.pop_back();
+    }
+
+    g_responseCacheOrder.push_front(key);
+    ResponseCacheEntry& entry = g_responseCache[key];
+    entry.text = std::move(text);
+    GetSystemTimeAsFileTime(&entry.storedAt);
+    entry.order = g_responseCacheOrder.begin();
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+uint64_t ComputeKey(const std::string& model, const std::string& systemPrompt, const json& state)
+{
+    uint64_t hash = kFnvOffsetBasis;
+    HashBytes(hash, model);
+    HashBytes(hash, "\n");
+    HashBytes(hash, systemPrompt);
+    HashBytes(hash, "\n");
+    HashCanonical(hash, state);
+    return hash;
+}
+
+std::string FormatKey(uint64_t key)
+{
+    char buffer[17];
+    sprintf_s(buffer, "%016llx", static_cast<unsigned long long>(key));
+    return buffer;
+}
+
+bool Lookup(uint64_t key, std::string& outText)
+{
+    uint64_t ttlSeconds = g_ttlSeconds.load();
+    {
+        std::lock_guard<std::mutex> lock(g_responseCacheMutex);
+        auto it = g_responseCache.find(key);
+        if (it != g_responseCache.end())
+        {
+            if (SecondsSince(it->second.storedAt) <= ttlSeconds)
+            {
+                g_responseCacheOrder.splice(g_responseCacheOrder.begin(), g_responseCacheOrder,
+                                            it->second.order);
+                outText = it->second.text;
+                g_responseCacheStats.hits++;
+                return true;
+            }
+            g_responseCacheOrder.erase(it->second.order);
+            g_responseCache.erase(it);
+            g_responseCacheStats.expired++;
+        }
+    }
+
+    if (g_diskEnabled.load())
+    {
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(g_diskCacheMutex);
+            found = ReadDiskCacheEntry(key, ttlSeconds, outText);
+        }
+        if (found)
+        {
+            std::lock_guard<std::mutex> lock(g_responseCacheMutex);
+            InsertMemoryCacheEntry(key, outText);
+            g_responseCacheStats.hits++;
+            g_responseCacheStats.diskHits++;
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_responseCacheMutex);
+    g_responseCacheStats.misses++;
+    return false;
+}
+
+void Store(uint64_t key, const std::string& text)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_responseCacheMutex);
+        InsertMemoryCacheEntry(key, text);
+        g_responseCacheStats.stores++;
+    }
+
+    if (g_diskEnabled.load())
+    {
+        std::lock_guard<std::mutex> lock(g_diskCacheMutex);
+        WriteDiskCacheEntry(key, text);
+    }
+}
+
+void SetDiskEnabled(bool enabled)
+{
+    g_diskEnabled.store(enabled);
+}
+
+void SetTtlSeconds(uint64_t seconds)
+{
+    g_ttlSeconds.store(seconds);
+}
+
+ClaudeAPI::ResponseCacheStats GetStats()
+{
+    std::lock_guard<std::mutex> lock(g_responseCacheMutex);
+    return g_responseCacheStats;
+}
+
+} // namespace ResponseCache
@@ -0,0 +1,49 @@
+#pragma once
+
+// ============================================================================
+// ResponseCache.h - Content-Addressed Response Cache
+// Claude's replies keyed by a hash of the canonical game state, so a reloaded
+// save or a refired turn event is answered without a new API call
+// ============================================================================
+
+#include <cstdint>
+#include <string>
+
+#include <json.hpp>
+
+#include "ClaudeAPI.h"
+
+namespace ResponseCache
+{
+
+/// Seconds a cached reply stays valid unless the "response_cache_ttl" option says otherwise
+constexpr uint64_t kDefaultTtlSeconds = 24 * 60 * 60;
+
+/// Key for a request: model, rendered system prompt and canonical game state
+/// @note The state is hashed independently of key order and of the order of keyed
+///       array elements (units, cities, plots), which Lua's table iteration doesn't keep stable
+[[nodiscard]] uint64_t ComputeKey(const std::string& model, const std::string& systemPrompt,
+                                  const nlohmann::json& state);
+
+/// Format a key as 16 hex digits (also the name of its file in the cache folder)
+[[nodiscard]] std::string FormatKey(uint64_t key);
+
+/// Look up a reply for a cache key (memory first, then disk if enabled)
+/// @return true and the reply text on a hit
+[[nodiscard]] bool Lookup(uint64_t key, std::string& outText);
+
+/// Remember a reply under its cache key
+/// @note The in-memory cache keeps the 64 most recently used replies, the
+///       mod's response_cache folder the 256 most recently read
+void Store(uint64_t key, const std::string& text);
+
+/// Also keep replies in the mod's response_cache folder ("response_cache_disk" option)
+void SetDiskEnabled(bool enabled);
+
+/// Set how long a cached reply stays valid ("response_cache_ttl" option)
+void SetTtlSeconds(uint64_t seconds);
+
+/// Get the hit/miss counters since the DLL was loaded
+[[nodiscard]] ClaudeAPI::ResponseCacheStats GetStats();
+
+} // namespace ResponseCache
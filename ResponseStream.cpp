@@ -0,0 +1,279 @@
+// ============================================================================
+// ResponseStream.cpp - Streamed Messages API Responses Implementation
+// ============================================================================
+
+#include "ResponseStream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "Log.h"
+
+namespace ResponseStream
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// ACTION SCANNER
+// ============================================================================
+
+void ActionScanner::Scan(const std::string& text, const ActionCallback& onAction)
+{
+    static const std::string kActionsKey = "\"actions\"";
+
+    while (m_pos < text.length() && m_phase != Phase::Done)
+    {
+        if (m_phase == Phase::FindKey)
+        {
+            size_t keyPos = text.find(kActionsKey, m_pos);
+            if (keyPos == std::string::npos)
+            {
+                // Keep a tail in case the key is split across deltas
+                if (text.length() > kActionsKey.length())
+                {
+                    m_pos = (std::max)(m_pos, text.length() - kActionsKey.length());
+                }
+                return;
+            }
+            m_pos = keyPos + kActionsKey.length();
+            m_phase = Phase::FindArray;
+        }
+        else if (m_phase == Phase::FindArray)
+        {
+            char c = text[m_pos];
+            if (c == '[')
+            {
+                m_phase = Phase::InArray;
+            }
+            else if (c != ':' && c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            {
+                // "actions" was not an array key (e.g. mentioned in a string) - keep looking
+                m_phase = Phase::FindKey;
+                continue;
+            }
+            m_pos++;
+        }
+        else
+        {
+            ScanArray(text, onAction);
+        }
+    }
+}
+
+void ActionScanner::ScanArray(const std::string& text, const ActionCallback& onAction)
+{
+    for (; m_pos < text.length(); m_pos++)
+    {
+        char c = text[m_pos];
+
+        if (m_depth == 0)
+        {
+            if (c == '{')
+            {
+                m_objectStart = m_pos;
+                m_depth = 1;
+            }
+            else if (c == ']')
+            {
+                m_phase = Phase::Done;
+                m_pos++;
+                return;
+            }
+            continue;
+        }
+
+        if (m_inString)
+        {
+            if (m_escaped)
+            {
+                m_escaped = false;
+            }
+            else if (c == '\\')
+            {
+                m_escaped = true;
+            }
+            else if (c == '"')
+            {
+                m_inString = false;
+            }
+            continue;
+        }
+
+        if (c == '"')
+        {
+            m_inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            m_depth++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            m_depth--;
+            if (m_depth == 0)
+            {
+                size_t length = m_pos - m_objectStart + 1;
+                m_parsedBytes += length;
+                json action = json::parse(text.begin() + static_cast<std::ptrdiff_t>(m_objectStart),
+                                          text.begin() + static_cast<std::ptrdiff_t>(m_pos + 1),
+                                          nullptr, false);
+                if (!action.is_discarded())
+                {
+                    m_emittedCount++;
+                    if (onAction)
+                    {
+                        onAction(std::move(action));
+                    }
+                }
+                else
+                {
+                    Log("[STREAM] Skipping malformed streamed action");
+                }
+            }
+        }
+    }
+}
+
+// ============================================================================
+// SERVER-SENT EVENTS
+// ============================================================================
+
+void MessageStream::Feed(const char* data, size_t length)
+{
+    m_lineBuffer.append(data, length);
+
+    size_t lineStart = 0;
+    size_t newline = 0;
+    while ((newline = m_lineBuffer.find('\n', lineStart)) != std::string::npos)
+    {
+        size_t lineEnd = newline;
+        if (lineEnd > lineStart && m_lineBuffer[lineEnd - 1] == '\r')
+        {
+            lineEnd--;
+        }
+        ProcessLine(m_lineBuffer.substr(lineStart, lineEnd - lineStart));
+        lineStart = newline + 1;
+    }
+    m_lineBuffer.erase(0, lineStart);
+}
+
+void MessageStream::ProcessLine(const std::string& line)
+{
+    if (line.empty())
+    {
+        DispatchEvent();
+        return;
+    }
+
+    if (line[0] == ':')
+    {
+        return; // SSE comment
+    }
+
+    size_t colon = line.find(':');
+    std::string field = line.substr(0, colon);
+    std::string value = colon == std::string::npos ? "" : line.substr(colon + 1);
+    if (!value.empty() && value[0] == ' ')
+    {
+        value.erase(0, 1);
+    }
+
+    if (field == "event")
+    {
+        m_eventType = value;
+    }
+    else if (field == "data")
+    {
+        if (!m_eventData.empty())
+        {
+            m_eventData += '\n';
+        }
+        m_eventData += value;
+    }
+}
+
+void MessageStream::DispatchEvent()
+{
+    std::string eventType = std::move(m_eventType);
+    std::string eventData = std::move(m_eventData);
+    m_eventType.clear();
+    m_eventData.clear();
+
+    if (eventData.empty())
+    {
+        return;
+    }
+
+    m_parsedBytes += eventData.size();
+    json event = json::parse(eventData, nullptr, false);
+    if (event.is_discarded())
+    {
+        Log("[STREAM] Unparseable event data for '" + eventType + "'");
+        return;
+    }
+
+    std::string type = event.value("type", eventType);
+
+    if (type == "message_start")
+    {
+        m_started = true;
+        if (event.contains("message"))
+        {
+            ParseUsage(event["message"].value("usage", json::object()), m_usage);
+        }
+    }
+    else if (type == "content_block_delta")
+    {
+        const json& delta = event["delta"];
+        if (delta.value("type", "") == "text_delta")
+        {
+            m_text += delta.value("text", "");
+            m_scanner.Scan(m_text, m_onAction);
+        }
+    }
+    else if (type == "message_delta")
+    {
+        // Carries the final output_tokens count
+        ParseUsage(event.value("usage", json::object()), m_usage);
+    }
+    else if (type == "message_stop")
+    {
+        m_complete = true;
+    }
+    else if (type == "error")
+    {
+        m_error = event.contains("error") ? event["error"].value("message", "Stream error") : "Stream error";
+        m_errorType = event.contains("error") ? event["error"].value("type", "") : "";
+        Log("[STREAM] Error event: " + m_error);
+    }
+}
+
+// ============================================================================
+// TOKEN USAGE
+// ============================================================================
+
+void ParseUsage(const json& usage, ClaudeAPI::TokenUsage& out)
+{
+    if (!usage.is_object())
+    {
+        return;
+    }
+
+    auto read = [&usage](const char* key, uint64_t& field)
+    {
+        auto it = usage.find(key);
+        if (it != usage.end() && it->is_number_unsigned())
+        {
+            field = it->get<uint64_t>();
+        }
+    };
+
+    read("input_tokens", out.inputTokens);
+    read("output_tokens", out.outputTokens);
+    read("cache_creation_input_tokens", out.cacheCreationTokens);
+    read("cache_read_input_tokens", out.cacheReadTokens);
+}
+
+} // namespace ResponseStream
@@ -0,0 +1,114 @@
+#pragma once
+
+// ============================================================================
+// ResponseStream.h - Streamed Messages API Responses
+// Server-sent event parsing and incremental extraction of completed actions
+// ============================================================================
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include <json.hpp>
+
+#include "ClaudeAPI.h"
+
+namespace ResponseStream
+{
+
+/// Receives each complete element of the "actions" array as soon as it is generated
+using ActionCallback = std::function<void(nlohmann::json action)>;
+
+/// Incrementally extracts complete elements of the "actions" array from partial model text
+class ActionScanner
+{
+public:
+    /// Scan text appended since the last call, emitting each newly completed action object
+    void Scan(const std::string& text, const ActionCallback& onAction);
+
+    /// Number of actions emitted so far
+    size_t GetEmittedCount() const { return m_emittedCount; }
+
+    /// JSON bytes parsed for the emitted (and malformed) actions
+    size_t GetParsedBytes() const { return m_parsedBytes; }
+
+private:
+    enum class Phase
+    {
+        FindKey,    ///< Looking for "actions"
+        FindArray,  ///< Looking for the '[' after the key
+        InArray,    ///< Inside the array, splitting elements
+        Done        ///< Array closed
+    };
+
+    void ScanArray(const std::string& text, const ActionCallback& onAction);
+
+    Phase m_phase = Phase::FindKey;
+    size_t m_pos = 0;          ///< Next unscanned offset into the text
+    size_t m_objectStart = 0;  ///< Offset of the '{' that opened the current element
+    int m_depth = 0;           ///< Nesting depth inside the current element (0 = between elements)
+    bool m_inString = false;
+    bool m_escaped = false;
+    size_t m_emittedCount = 0;
+    size_t m_parsedBytes = 0;
+};
+
+/// Parses a Messages API server-sent event stream into assistant text
+class MessageStream
+{
+public:
+    explicit MessageStream(ActionCallback onAction) : m_onAction(std::move(onAction)) {}
+
+    /// Feed raw body bytes as they arrive
+    void Feed(const char* data, size_t length);
+
+    /// Assistant text received so far
+    const std::string& GetText() const { return m_text; }
+
+    /// Error reported by an "error" event (empty if none)
+    const std::string& GetError() const { return m_error; }
+
+    /// Type of the "error" event's error (e.g. "overloaded_error")
+    const std::string& GetErrorType() const { return m_errorType; }
+
+    /// True once message_start has been seen
+    bool HasStarted() const { return m_started; }
+
+    /// True once message_stop has been seen
+    bool IsComplete() const { return m_complete; }
+
+    /// Number of actions handed to the callback
+    size_t GetStreamedActionCount() const { return m_scanner.GetEmittedCount(); }
+
+    /// Token usage from message_start and message_delta events
+    const ClaudeAPI::TokenUsage& GetUsage() const { return m_usage; }
+
+    /// JSON bytes parsed for events and streamed actions
+    size_t GetParsedBytes() const { return m_parsedBytes + m_scanner.GetParsedBytes(); }
+
+private:
+    void ProcessLine(const std::string& line);
+    void DispatchEvent();
+
+    ActionCallback m_onAction;
+    ActionScanner m_scanner;
+    std::string m_lineBuffer;
+    std::string m_eventType;
+    std::string m_eventData;
+    std::string m_text;
+    std::string m_error;
+    std::string m_errorType;
+    ClaudeAPI::TokenUsage m_usage;
+    size_t m_parsedBytes = 0;
+    bool m_started = false;
+    bool m_complete = false;
+};
+
+/// Copy the fields present in a "usage" object into out
+/// @note Streams report usage in pieces (message_start, then message_delta), so
+///       absent fields leave the existing value untouched
+/// @note Also used for the "usage" object of a response that wasn't streamed
+void ParseUsage(const nlohmann::json& usage, ClaudeAPI::TokenUsage& out);
+
+} // namespace ResponseStream
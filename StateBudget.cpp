@@ -0,0 +1,279 @@
+// ============================================================================
+// StateBudget.cpp - Game State Token Budget Implementation
+// ============================================================================
+
+#include "StateBudget.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+
+#include "Log.h"
+
+namespace StateBudget
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    constexpr int kNearTerrainDistance = 1;    ///< Plots this close to our units and cities survive the terrain trim
+    constexpr int kNearEnemyDistance = 3;      ///< Units this close to a visible enemy keep their full detail
+    constexpr size_t kBudgetLogSections = 5;   ///< Largest sections listed when a state is over budget
+}
+
+// ============================================================================
+// MAP POSITIONS
+// ============================================================================
+
+namespace
+{
+
+/// A map position read from the game state
+struct MapPosition
+{
+    int x = 0;
+    int y = 0;
+};
+
+/// Read x/y from a state element
+bool ReadPosition(const json& element, MapPosition& out)
+{
+    auto x = element.find("x");
+    auto y = element.find("y");
+    if (x == element.end() || y == element.end() || !x->is_number() || !y->is_number())
+    {
+        return false;
+    }
+    out = {x->get<int>(), y->get<int>()};
+    return true;
+}
+
+/// Positions of the elements of the given top-level arrays
+std::vector<MapPosition> CollectPositions(const json& state, std::initializer_list<const char*> sections)
+{
+    std::vector<MapPosition> positions;
+    for (const char* section : sections)
+    {
+        auto array = state.find(section);
+        if (array == state.end() || !array->is_array())
+        {
+            continue;
+        }
+        for (const json& element : *array)
+        {
+            MapPosition position;
+            if (element.is_object() && ReadPosition(element, position))
+            {
+                positions.push_back(position);
+            }
+        }
+    }
+    return positions;
+}
+
+/// Hex distance on Civ VI's offset grid (odd rows shifted east); map wrap is ignored
+int HexDistance(const MapPosition& a, const MapPosition& b)
+{
+    int dq = (b.x - (b.y >> 1)) - (a.x - (a.y >> 1));
+    int dr = b.y - a.y;
+    return (std::abs(dq) + std::abs(dr) + std::abs(dq + dr)) / 2;
+}
+
+/// Whether an element's position is within distance of any of the positions
+bool IsNear(const json& element, const std::vector<MapPosition>& positions, int distance)
+{
+    MapPosition position;
+    if (!element.is_object() || !ReadPosition(element, position))
+    {
+        return true;   // No position - never counted as distant
+    }
+    for (const MapPosition& other : positions)
+    {
+        if (HexDistance(position, other) <= distance)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// TRIMMING
+// ============================================================================
+
+namespace
+{
+
+/// What one tier removed from its section
+struct TrimResult
+{
+    size_t count = 0;   ///< Elements removed, or elements that lost fields
+    size_t bytes = 0;   ///< Serialized size of what was removed, separators included
+};
+
+/// Remove the array elements the predicate selects
+TrimResult EraseIf(json& array, const std::function<bool(const json&)>& predicate)
+{
+    TrimResult result;
+    if (!array.is_array())
+    {
+        return result;
+    }
+
+    json kept = json::array();
+    for (json& element : array)
+    {
+        if (predicate(element))
+        {
+            result.count++;
+            result.bytes += element.dump().size() + 1;
+            continue;
+        }
+        kept.push_back(std::move(element));
+    }
+    array = std::move(kept);
+    return result;
+}
+
+/// Remove fields from the array elements the predicate selects
+TrimResult EraseFields(json& array, const std::function<bool(const json&)>& applies,
+                       std::initializer_list<const char*> fields)
+{
+    TrimResult result;
+    if (!array.is_array())
+    {
+        return result;
+    }
+
+    for (json& element : array)
+    {
+        if (!element.is_object() || !applies(element))
+        {
+            continue;
+        }
+        bool erased = false;
+        for (const char* field : fields)
+        {
+            auto value = element.find(field);
+            if (value == element.end())
+            {
+                continue;
+            }
+            // "key": value plus the separating comma
+            result.bytes += value.key().size() + 3 + value->dump().size() + 1;
+            element.erase(value);
+            erased = true;
+        }
+        result.count += erased ? 1 : 0;
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool Apply(json& state, size_t budgetTokens, std::vector<std::string>& outTrimmed)
+{
+    if (!state.is_object())
+    {
+        return false;
+    }
+
+    // Sized once; the tiers below subtract what they remove instead of serializing again
+    std::unordered_map<std::string, size_t> sectionBytes;
+    std::vector<std::pair<size_t, std::string>> sections;
+    size_t totalBytes = 0;
+    for (auto it = state.begin(); it != state.end(); ++it)
+    {
+        size_t bytes = it.value().dump().size();
+        sectionBytes.emplace(it.key(), bytes);
+        sections.emplace_back(bytes / kBytesPerToken, it.key());
+        totalBytes += bytes;
+    }
+    // Compared in tokens, so no budget is large enough to overflow
+    if (totalBytes / kBytesPerToken <= budgetTokens)
+    {
+        return false;
+    }
+    const size_t budgetBytes = budgetTokens * kBytesPerToken;
+
+    std::sort(sections.begin(), sections.end(), std::greater<>());
+    std::string largest;
+    for (size_t i = 0; i < sections.size() && i < kBudgetLogSections; i++)
+    {
+        largest += (i == 0 ? "" : ", ") + sections[i].second + " ~" + std::to_string(sections[i].first);
+    }
+    Log("[BUDGET] State ~" + std::to_string(totalBytes / kBytesPerToken) + " tokens, budget " +
+        std::to_string(budgetTokens) + " (largest: " + largest + ")");
+
+    // Runs one tier while still over budget and records what it saved
+    auto trim = [&](const char* section, const std::function<TrimResult(json&)>& apply, const std::string& what)
+    {
+        auto target = state.find(section);
+        if (totalBytes <= budgetBytes || target == state.end())
+        {
+            return;
+        }
+        TrimResult removed = apply(*target);
+        if (removed.count == 0)
+        {
+            return;
+        }
+        size_t& remaining = sectionBytes[section];
+        size_t saved = std::min(removed.bytes, remaining);
+        remaining -= saved;
+        totalBytes -= std::min(totalBytes, saved);
+        outTrimmed.push_back(std::string(section) + ": " + std::to_string(removed.count) + " " + what +
+            " (~" + std::to_string(saved / kBytesPerToken) + " tokens)");
+    };
+
+    const std::vector<MapPosition> ownPositions = CollectPositions(state, {"units", "cities"});
+    const std::vector<MapPosition> enemyPositions =
+        CollectPositions(state, {"visibleEnemyUnits", "visibleEnemyCities"});
+
+    trim("visibleTerrain", [&](json& plots)
+    {
+        return EraseIf(plots, [&](const json& plot) { return !IsNear(plot, ownPositions, kNearTerrainDistance); });
+    }, "plots away from units and cities");
+
+    trim("cities", [&](json& cities)
+    {
+        return EraseFields(cities, [](const json& city)
+        {
+            auto production = city.find("production");
+            return production != city.end() && !production->is_null();
+        }, {"canBuild", "canPurchaseGold", "canPurchaseFaith", "districtPlacements"});
+    }, "build menus of cities with production set");
+
+    trim("units", [&](json& units)
+    {
+        return EraseFields(units, [&](const json& unit) { return !IsNear(unit, enemyPositions, kNearEnemyDistance); },
+            {"availablePromotions", "tradeDestinations", "promotions"});
+    }, "unit details away from enemies");
+
+    trim("visibleTerrain", [&](json& plots)
+    {
+        return EraseIf(plots, [](const json&) { return true; });
+    }, "remaining plots");
+
+    if (totalBytes > budgetBytes)
+    {
+        Log("[BUDGET] Still ~" + std::to_string(totalBytes / kBytesPerToken) + " tokens after trimming");
+    }
+    return !outTrimmed.empty();
+}
+
+} // namespace StateBudget
@@ -0,0 +1,33 @@
+#pragma once
+
+// ============================================================================
+// StateBudget.h - Game State Token Budget
+// Trims low-priority parts of a game state that is over the token budget,
+// tier by tier, until its estimated size fits
+// ============================================================================
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+namespace StateBudget
+{
+
+/// Rough bytes per token, used by every size estimate sent to the log or a budget
+constexpr size_t kBytesPerToken = 4;
+
+/// Drop low-priority parts of the state until its estimated size fits the budget
+/// @param budgetTokens Estimated tokens the state may take
+/// @param outTrimmed Receives one line per trimming step that was applied
+/// @return true if the state was changed
+/// @note Tiers, first trimmed first: terrain away from our units and cities, the build
+///       menus of cities that already have production, optional detail on units away
+///       from enemies, then the rest of the terrain. Units near enemies and cities with
+///       an empty queue are never trimmed
+/// @note The state is serialized once to size its sections; each tier then subtracts
+///       the size of what it removed
+[[nodiscard]] bool Apply(nlohmann::json& state, size_t budgetTokens, std::vector<std::string>& outTrimmed);
+
+} // namespace StateBudget
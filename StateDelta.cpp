@@ -0,0 +1,216 @@
+// ============================================================================
+// StateDelta.cpp - Structural Diff of Game States Implementation
+// ============================================================================
+
+#include "StateDelta.h"
+
+#include <unordered_map>
+#include <utility>
+
+namespace StateDelta
+{
+
+using json = nlohmann::json;
+
+// ============================================================================
+// DIFFING
+// ============================================================================
+
+namespace
+{
+
+bool DiffValue(const json& before, const json& after, json& out);
+
+/// The fields ElementKey reads, so the model can tell which entry changed
+json ElementIdentity(const json& element)
+{
+    json identity = json::object();
+
+    auto id = element.find("id");
+    if (id != element.end() && id->is_number())
+    {
+        identity["id"] = *id;
+        auto owner = element.find("owner");
+        if (owner != element.end())
+        {
+            identity["owner"] = *owner;
+        }
+        return identity;
+    }
+
+    identity["x"] = element.at("x");
+    identity["y"] = element.at("y");
+    return identity;
+}
+
+/// Index array elements by identity; fails if any element lacks one or two collide
+bool IndexElements(const json& array, std::unordered_map<std::string, const json*>& out)
+{
+    out.reserve(array.size());
+    for (const json& element : array)
+    {
+        std::string key = ElementKey(element);
+        if (key.empty() || !out.emplace(std::move(key), &element).second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Diff arrays of identifiable elements as {"added":[...],"updated":[...],"removed":[...]}
+/// @return false if the arrays aren't keyed (caller replaces the whole array)
+bool DiffKeyedArray(const json& before, const json& after, json& out, bool& changed)
+{
+    std::unordered_map<std::string, const json*> previous;
+    std::unordered_map<std::string, const json*> current;
+    if (!IndexElements(before, previous) || !IndexElements(after, current))
+    {
+        return false;
+    }
+
+    json added = json::array();
+    json updated = json::array();
+    json removed = json::array();
+
+    for (const json& element : after)
+    {
+        auto match = previous.find(ElementKey(element));
+        if (match == previous.end())
+        {
+            added.push_back(element);
+            continue;
+        }
+
+        json fields;
+        if (DiffValue(*match->second, element, fields))
+        {
+            json entry = ElementIdentity(element);
+            entry.update(fields);
+            updated.push_back(std::move(entry));
+        }
+    }
+
+    for (const json& element : before)
+    {
+        if (current.find(ElementKey(element)) == current.end())
+        {
+            removed.push_back(ElementIdentity(element));
+        }
+    }
+
+    out = json::object();
+    if (!added.empty())
+    {
+        out["added"] = std::move(added);
+    }
+    if (!updated.empty())
+    {
+        out["updated"] = std::move(updated);
+    }
+    if (!removed.empty())
+    {
+        out["removed"] = std::move(removed);
+    }
+    changed = !out.empty();
+    return true;
+}
+
+/// Diff two objects: changed keys only, null for removed keys
+bool DiffObject(const json& before, const json& after, json& out)
+{
+    out = json::object();
+
+    for (const auto& [key, value] : after.items())
+    {
+        auto previous = before.find(key);
+        if (previous == before.end())
+        {
+            out[key] = value;
+            continue;
+        }
+
+        json change;
+        if (DiffValue(*previous, value, change))
+        {
+            out[key] = std::move(change);
+        }
+    }
+
+    for (const auto& [key, value] : before.items())
+    {
+        if (!after.contains(key))
+        {
+            out[key] = nullptr;
+        }
+    }
+
+    return !out.empty();
+}
+
+/// Diff any two values
+/// @return true if they differ (out holds the change)
+bool DiffValue(const json& before, const json& after, json& out)
+{
+    if (before.is_object() && after.is_object())
+    {
+        return DiffObject(before, after, out);
+    }
+
+    if (before.is_array() && after.is_array())
+    {
+        bool changed = false;
+        if (DiffKeyedArray(before, after, out, changed))
+        {
+            return changed;
+        }
+    }
+
+    if (before == after)
+    {
+        return false;
+    }
+    out = after;
+    return true;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+std::string ElementKey(const json& element)
+{
+    if (!element.is_object())
+    {
+        return {};
+    }
+
+    auto id = element.find("id");
+    if (id != element.end() && id->is_number())
+    {
+        std::string key = "id:" + id->dump();
+        auto owner = element.find("owner");
+        if (owner != element.end())
+        {
+            key += "/" + owner->dump();
+        }
+        return key;
+    }
+
+    auto x = element.find("x");
+    auto y = element.find("y");
+    if (x != element.end() && y != element.end() && x->is_number() && y->is_number())
+    {
+        return "xy:" + x->dump() + "," + y->dump();
+    }
+    return {};
+}
+
+bool Diff(const json& before, const json& after, json& out)
+{
+    return DiffValue(before, after, out);
+}
+
+} // namespace StateDelta
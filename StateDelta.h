@@ -0,0 +1,29 @@
+#pragma once
+
+// ============================================================================
+// StateDelta.h - Structural Diff of Game States
+// Computes the changes between two parsed game states, matching array elements
+// by identity so moved units and changed plots show up as small updates
+// ============================================================================
+
+#include <string>
+
+#include <json.hpp>
+
+namespace StateDelta
+{
+
+/// Identity of an array element: "id" (plus "owner" for other players' units),
+/// or "x"/"y" for plots
+/// @return The key, or an empty string if the element has neither
+[[nodiscard]] std::string ElementKey(const nlohmann::json& element);
+
+/// Diff two values
+/// @param out Receives the change when they differ: for objects only the changed keys,
+///        with null for a removed key; for arrays whose elements all have an ElementKey,
+///        {"added":[...],"updated":[...],"removed":[...]} where updated and removed entries
+///        carry the element's identity fields; any other value is replaced whole
+/// @return true if they differ
+[[nodiscard]] bool Diff(const nlohmann::json& before, const nlohmann::json& after, nlohmann::json& out);
+
+} // namespace StateDelta
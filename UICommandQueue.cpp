@@ -0,0 +1,233 @@
+// ============================================================================
+// UICommandQueue.cpp - Gameplay/UI Command Queue Implementation
+// ============================================================================
+
+#include "UICommandQueue.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "Log.h"
+
+namespace UICommandQueue
+{
+
+// ============================================================================
+// CONSTANTS
+// ============================================================================
+
+namespace
+{
+    /// Commands a ring holds before pushes fail (a busy turn queues a few dozen)
+    constexpr size_t kRingCapacity = 256;
+    static_assert((kRingCapacity & (kRingCapacity - 1)) == 0, "Ring capacity must be a power of two");
+}
+
+// ============================================================================
+// COMMAND RING
+// ============================================================================
+
+namespace
+{
+
+/// One queued command: what to do and its arguments in the request's string format
+struct Command
+{
+    std::string name;
+    std::string payload;
+    uint32_t generation = 0;   ///< g_generation when queued; older commands were cleared
+};
+
+/// Fixed-capacity ring, lock-free between its producer and consumer side
+/// @note Indices only grow; a slot is index % capacity. The producer publishes a
+///       slot with a release store of m_tail, the consumer frees it with m_head.
+///       Each side takes its own mutex, so a second state calling the same side
+///       (another UI context, a mod) waits instead of racing on a slot
+class CommandRing
+{
+public:
+    /// Add a command at the tail
+    /// @return false if the ring is full
+    bool Push(Command command)
+    {
+        std::lock_guard<std::mutex> lock(m_producerMutex);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == kRingCapacity)
+        {
+            return false;
+        }
+
+        m_slots[tail & (kRingCapacity - 1)] = std::move(command);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Take the command at the head
+    /// @return false if the ring is empty
+    bool Pop(Command& out)
+    {
+        std::lock_guard<std::mutex> lock(m_consumerMutex);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        out = std::move(m_slots[head & (kRingCapacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<Command, kRingCapacity> m_slots;
+    std::atomic<size_t> m_head{0};     ///< Next slot to read (written by the consumer)
+    std::atomic<size_t> m_tail{0};     ///< Next slot to write (written by the producer)
+    std::mutex m_producerMutex;
+    std::mutex m_consumerMutex;
+};
+
+/// Gameplay -> UI commands
+CommandRing g_toUI;
+
+/// UI -> gameplay command results
+CommandRing g_toGameplay;
+
+/// Bumped by ClearCommands; commands queued under an older value are discarded
+std::atomic<uint32_t> g_generation{0};
+
+} // anonymous namespace
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+namespace
+{
+
+/// Read a string argument
+/// @return false if the value at index is not a string
+bool ReadString(hks::lua_State* L, int index, std::string& out)
+{
+    if (hks::type(L, index) != hks::TSTRING)
+    {
+        return false;
+    }
+
+    size_t length = 0;
+    const char* text = hks::checklstring(L, index, &length);
+    out.assign(text ? text : "", text ? length : 0);
+    return true;
+}
+
+/// Push (name, payload) from the stack onto a ring, leaving true or false on the stack
+int PushToRing(hks::lua_State* L, CommandRing& ring, const char* function)
+{
+    if (!L || !IsAvailable())
+    {
+        return 0;
+    }
+
+    Command command;
+    if (hks::gettop(L) < 2 || !ReadString(L, 1, command.name) || !ReadString(L, 2, command.payload))
+    {
+        Log(std::string("[UI QUEUE] ") + function + " requires (name, payload) strings");
+        hks::pushboolean(L, false);
+        return 1;
+    }
+
+    command.generation = g_generation.load(std::memory_order_acquire);
+    std::string name = command.name;
+    bool queued = ring.Push(std::move(command));
+    if (!queued)
+    {
+        Log(std::string("[UI QUEUE] ") + function + ": queue full, dropping " + name);
+    }
+
+    hks::pushboolean(L, queued);
+    return 1;
+}
+
+/// Push everything on a ring as a Lua array of {name, payload} tables
+int DrainRing(hks::lua_State* L, CommandRing& ring)
+{
+    if (!L || !IsAvailable())
+    {
+        return 0;
+    }
+
+    hks::createtable(L, 0, 0);
+    Command command;
+    int count = 0;
+    int discarded = 0;
+    while (ring.Pop(command))
+    {
+        // Read per command: a clear during the drain must not drop what was pushed after it
+        if (command.generation != g_generation.load(std::memory_order_acquire))
+        {
+            discarded++;
+            continue;
+        }
+        count++;
+        hks::pushnumber(L, static_cast<double>(count));
+        hks::createtable(L, 0, 2);
+        hks::pushlstring(L, command.name.c_str(), command.name.size());
+        hks::setfield(L, -2, "name");
+        hks::pushlstring(L, command.payload.c_str(), command.payload.size());
+        hks::setfield(L, -2, "payload");
+        hks::settable(L, -3);
+    }
+
+    if (count > 0)
+    {
+        LOG_DEBUG("[UI QUEUE] Drained " + std::to_string(count) + " commands");
+    }
+    if (discarded > 0)
+    {
+        Log("[UI QUEUE] Discarded " + std::to_string(discarded) + " commands queued before the last clear");
+    }
+    return 1;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool IsAvailable()
+{
+    return hks::gettop && hks::type && hks::checklstring && hks::createtable && hks::pushnumber &&
+           hks::pushlstring && hks::pushboolean && hks::setfield && hks::settable;
+}
+
+int PushCommand(hks::lua_State* L)
+{
+    return PushToRing(L, g_toUI, "PushUICommand");
+}
+
+int DrainCommands(hks::lua_State* L)
+{
+    return DrainRing(L, g_toUI);
+}
+
+int PushResult(hks::lua_State* L)
+{
+    return PushToRing(L, g_toGameplay, "PushUICommandResult");
+}
+
+int DrainResults(hks::lua_State* L)
+{
+    return DrainRing(L, g_toGameplay);
+}
+
+void ClearCommands()
+{
+    g_generation.fetch_add(1, std::memory_order_acq_rel);
+    LOG_DEBUG("[UI QUEUE] Cleared queued commands");
+}
+
+} // namespace UICommandQueue
@@ -0,0 +1,53 @@
+#pragma once
+
+// ============================================================================
+// UICommandQueue.h - Command Queues Between the Gameplay and UI Lua States
+// One ring per direction, lock-free between its two sides: gameplay
+// pushes UI commands (research, production, end turn, ...) and the UI drains
+// a whole batch per tick, then reports each command's result the other way.
+// The rings outlive turns and game loads, so clearing them discards whatever
+// was queued before (by generation, since neither side may reset the other's index)
+// ============================================================================
+
+#include "HavokScript.h"
+
+namespace UICommandQueue
+{
+
+// ============================================================================
+// LUA STACK API
+// ============================================================================
+
+/// Check that the hks functions the queues need were resolved
+/// @return true if the Push and Drain functions can be used
+[[nodiscard]] bool IsAvailable();
+
+/// Queue a command for the UI state
+/// @param L Lua state with (name, payload) at stack indices 1-2
+/// @return Number of values pushed: true if queued, false if invalid or the queue is full
+/// @note Meant for the gameplay state; pushes from other states are serialized
+[[nodiscard]] int PushCommand(hks::lua_State* L);
+
+/// Take every queued UI command, oldest first
+/// @param L Lua state
+/// @return Number of values pushed: an array of {name, payload} tables (empty if none)
+/// @note Meant for the UI state; drains from other states are serialized
+[[nodiscard]] int DrainCommands(hks::lua_State* L);
+
+/// Queue a command's result for the gameplay state
+/// @param L Lua state with (name, result) at stack indices 1-2
+/// @return Number of values pushed: true if queued, false if invalid or the queue is full
+/// @note Meant for the UI state; pushes from other states are serialized
+[[nodiscard]] int PushResult(hks::lua_State* L);
+
+/// Take every queued command result, oldest first
+/// @param L Lua state
+/// @return Number of values pushed: an array of {name, payload} tables (empty if none)
+/// @note Meant for the gameplay state; drains from other states are serialized
+[[nodiscard]] int DrainResults(hks::lua_State* L);
+
+/// Discard every command and result queued so far; they are dropped when drained
+/// @note Called by the gameplay state at the start of each turn and on game load
+void ClearCommands();
+
+} // namespace UICommandQueue
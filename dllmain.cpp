@@ -10,6 +10,7 @@
 #include "HavokScriptIntegration.h"
 #include "Log.h"
 #include "MinHook.h"
+#include "Profiler.h"
 
 // ============================================================================
 // CONSTANTS
@@ -20,17 +21,11 @@ namespace
     /// Offset to DllCreateGameContext in GameCore_XP2_FinalRelease.dll
     constexpr uintptr_t kDllCreateGameContextOffset = 0x752d50;
 
-    /// Time to wait for game initialization after Lua state captured
-    constexpr DWORD kGameInitWaitMs = 2000;
+    /// Maximum time to wait for Lua state after GameCore is hooked (30 seconds)
+    constexpr DWORD kLuaStateWaitTimeoutMs = 30000;
 
-    /// Polling interval for Lua state capture
-    constexpr DWORD kLuaStatePollIntervalMs = 500;
-
-    /// Maximum time to wait for Lua state (30 seconds)
-    constexpr int kLuaStateMaxWaitIterations = 60;
-
-    /// Delay after GameCore detection before hook installation
-    constexpr DWORD kGameCoreDetectionDelayMs = 200;
+    /// GameCore re-check interval, only used when the DLL load notification is unavailable
+    constexpr DWORD kGameCoreFallbackPollMs = 500;
 
     /// Brief delay during shutdown for threads to notice
     constexpr DWORD kShutdownDelayMs = 100;
@@ -149,11 +144,20 @@ namespace
 
     /// DLL notification cookie for cleanup
     PVOID g_dllNotificationCookie = nullptr;
+
+    /// Manual-reset event set by the DLL load notification once XP2 GameCore is handled
+    HANDLE g_gameCoreLoadedEvent = nullptr;
+
+    /// Manual-reset event set on process detach so waiting startup threads wake and exit
+    HANDLE g_shutdownEvent = nullptr;
 }
 
 /// Shutdown flag - signals threads to exit (used by HavokScriptIntegration)
 std::atomic<bool> g_shutdownRequested{false};
 
+/// Manual-reset event set by HookedPcall when the first Lua state is captured
+HANDLE g_luaStateCapturedEvent = nullptr;
+
 // ============================================================================
 // VERSION.DLL LOADING
 // ============================================================================
@@ -170,7 +174,7 @@ namespace
         g_original.hOriginal = LoadLibraryW(systemPath);
         if (!g_original.hOriginal)
         {
-            Log("ERROR: Failed to load original version.dll");
+            Log(LogLevel::Error, "ERROR: Failed to load original version.dll");
             return FALSE;
         }
 
@@ -178,7 +182,7 @@ namespace
 
 #define LOAD_FUNC(name) \
         g_original.name = (name##_t)GetProcAddress(g_original.hOriginal, #name); \
-        if (!g_original.name) { Log("ERROR: Failed to load " #name); return FALSE; }
+        if (!g_original.name) { Log(LogLevel::Error, "ERROR: Failed to load " #name); return FALSE; }
 
         LOAD_FUNC(GetFileVersionInfoA);
         LOAD_FUNC(GetFileVersionInfoW);
@@ -286,45 +290,36 @@ namespace
     {
         Log("Waiting for Lua state to be captured...");
 
-        for (int i = 0; i < kLuaStateMaxWaitIterations; i++)
-        {
-            if (g_shutdownRequested.load())
-            {
-                Log("Lua state thread: shutdown requested, exiting");
-                return 0;
-            }
-
-            if (g_luaState.load())
-            {
-                Log("========================================");
-                Log("[OK] LUA STATE READY!");
-                Log("========================================");
-
-                // Wait a bit more for game to fully initialize
-                Sleep(kGameInitWaitMs);
+        HANDLE waitHandles[] = { g_luaStateCapturedEvent, g_shutdownEvent };
+        DWORD waitResult = WaitForMultipleObjects(
+            ARRAYSIZE(waitHandles), waitHandles, FALSE, kLuaStateWaitTimeoutMs);
 
-                if (g_shutdownRequested.load())
-                {
-                    return 0;
-                }
+        if (waitResult == WAIT_OBJECT_0 + 1 || g_shutdownRequested.load())
+        {
+            Log("Lua state thread: shutdown requested, exiting");
+            return 0;
+        }
 
-                // Test Lua execution (intentionally ignore return values for test prints)
-                (void)ExecuteLuaCode("print('========================================')");
-                (void)ExecuteLuaCode("print('CLAUDE AI INTEGRATION ACTIVE')");
-                (void)ExecuteLuaCode("print('========================================')");
+        if (waitResult != WAIT_OBJECT_0 || !g_luaState.load())
+        {
+            Log(LogLevel::Error, "ERROR: Lua state was never captured (timeout)");
+            return 1;
+        }
 
-                // Note: Claude API functions are automatically registered in all Lua states
-                // via the HookedPcall function in HavokScriptIntegration.cpp
+        Log("========================================");
+        Log("[OK] LUA STATE READY!");
+        Log("========================================");
 
-                Log("Claude AI integration complete!");
-                return 0;
-            }
+        // Test Lua execution (intentionally ignore return values for test prints)
+        (void)ExecuteLuaCode("print('========================================')");
+        (void)ExecuteLuaCode("print('CLAUDE AI INTEGRATION ACTIVE')");
+        (void)ExecuteLuaCode("print('========================================')");
 
-            Sleep(kLuaStatePollIntervalMs);
-        }
+        // Note: Claude API functions are automatically registered in all Lua states
+        // via the HookedPcall function in HavokScriptIntegration.cpp
 
-        Log("ERROR: Lua state was never captured (timeout)");
-        return 1;
+        Log("Claude AI integration complete!");
+        return 0;
     }
 
     /// Hooked DllCreateGameContext - initializes HavokScript integration
@@ -354,7 +349,13 @@ namespace
     }
 
     /// Install hooks into GameCore DLL
-    void InstallGameCoreHooks()
+    /// @param gameCoreBase Module base from the load notification, or nullptr to look it up
+    /// @return true if the hook is installed (now or earlier)
+    /// @note Runs inside the load notification so the hook is live before the game's first
+    ///       DllCreateGameContext call, which follows LoadLibrary immediately. That call
+    ///       holds the loader lock, so with a non-null gameCoreBase this must stay free of
+    ///       module lookups, library loads and cross-thread waits
+    [[nodiscard]] bool InstallGameCoreHooks(void* gameCoreBase)
     {
         EnterCriticalSection(&g_hookLock);
 
@@ -362,18 +363,20 @@ namespace
         {
             Log("Hooks already installed, skipping");
             LeaveCriticalSection(&g_hookLock);
-            return;
+            return true;
         }
 
         Log("InstallGameCoreHooks() called");
         Log("Attempting to locate GameCore_XP2_FinalRelease.dll...");
 
-        HMODULE gameCore = GetModuleHandleA("GameCore_XP2_FinalRelease.dll");
+        HMODULE gameCore = gameCoreBase
+            ? static_cast<HMODULE>(gameCoreBase)
+            : GetModuleHandleA("GameCore_XP2_FinalRelease.dll");
         if (!gameCore)
         {
             Log("GameCore_XP2_FinalRelease.dll not loaded yet");
             LeaveCriticalSection(&g_hookLock);
-            return;
+            return false;
         }
 
         Log("GameCore module found!");
@@ -395,9 +398,9 @@ namespace
         {
             char buf[kErrorBufferSize];
             sprintf_s(buf, "ERROR: Failed to create hook! MH_STATUS: %d", status);
-            Log(buf);
+            Log(LogLevel::Error, buf);
             LeaveCriticalSection(&g_hookLock);
-            return;
+            return false;
         }
         Log("Hook created successfully");
 
@@ -406,9 +409,9 @@ namespace
         {
             char buf[kErrorBufferSize];
             sprintf_s(buf, "ERROR: Failed to enable hook! MH_STATUS: %d", status);
-            Log(buf);
+            Log(LogLevel::Error, buf);
             LeaveCriticalSection(&g_hookLock);
-            return;
+            return false;
         }
 
         Log("Hook enabled successfully!");
@@ -417,6 +420,20 @@ namespace
         g_hooksInstalled = true;
         LeaveCriticalSection(&g_hookLock);
         Log("InstallGameCoreHooks() completed successfully");
+        return true;
+    }
+
+    /// Log the outcome of InstallGameCoreHooks
+    void LogHookInstallResult(bool installed)
+    {
+        if (installed)
+        {
+            Log("Hook installation complete");
+        }
+        else
+        {
+            Log(LogLevel::Error, "ERROR: Hook installation failed, Claude AI integration stays disabled");
+        }
     }
 }
 
@@ -463,10 +480,17 @@ namespace
 
                 if (wcsstr(baseDllName, L"XP2") != nullptr && !g_hooksInstalled)
                 {
+                    // Hook before returning: the game calls DllCreateGameContext as soon as
+                    // LoadLibrary returns, so a hook installed later could miss it. There is no
+                    // earlier point to block that call from, so this runs under the loader lock:
+                    // InstallGameCoreHooks (and MinHook under it) must never load a module, call
+                    // GetModuleHandle, or wait on another thread, and the startup thread must not
+                    // do any of those while holding g_hookLock, or the two deadlock
                     Log("This is XP2 GameCore - installing hooks...");
-                    Sleep(kGameCoreDetectionDelayMs);
-                    InstallGameCoreHooks();
-                    Log("Hook installation complete");
+                    LogHookInstallResult(InstallGameCoreHooks(NotificationData->Loaded.DllBase));
+
+                    // The startup thread is no longer needed either way
+                    SetEvent(g_gameCoreLoadedEvent);
                 }
                 else if (wcsstr(baseDllName, L"Base") != nullptr)
                 {
@@ -476,32 +500,46 @@ namespace
         }
     }
 
-    /// Polling thread to detect GameCore as a backup mechanism
-    DWORD WINAPI GameCorePollingThread(LPVOID)
+    /// Startup thread - hooks GameCore if it was loaded before the notification was
+    /// registered (or the notification is unavailable); exits once the notification handled it
+    DWORD WINAPI GameCoreStartupThread(LPVOID)
     {
-        Log("Polling thread started as backup");
+        Log("Startup thread waiting for GameCore");
+
+        // Without the load notification the event never fires; re-check the module list instead
+        const DWORD timeoutMs = g_dllNotificationCookie ? INFINITE : kGameCoreFallbackPollMs;
+        HANDLE waitHandles[] = { g_gameCoreLoadedEvent, g_shutdownEvent };
 
         while (!g_shutdownRequested.load())
         {
-            if (g_hooksInstalled)
-            {
-                Log("Hooks detected as installed, polling thread exiting");
-                return 0;
-            }
-
+            // Covers GameCore already being loaded before the notification was registered
             HMODULE gc = GetModuleHandleA("GameCore_XP2_FinalRelease.dll");
             if (gc)
             {
-                Log("*** GAMECORE XP2 DETECTED BY POLLING THREAD! ***");
+                Log("*** GAMECORE XP2 DETECTED BY STARTUP THREAD! ***");
                 LogHex("GameCore_XP2_FinalRelease base address", gc);
-                InstallGameCoreHooks();
-                return 0;
+                LogHookInstallResult(InstallGameCoreHooks(gc));
+                break;
             }
 
-            Sleep(kLuaStatePollIntervalMs);
+            DWORD waitResult = WaitForMultipleObjects(
+                ARRAYSIZE(waitHandles), waitHandles, FALSE, timeoutMs);
+
+            if (waitResult == WAIT_OBJECT_0)
+            {
+                // The load notification already installed (or failed to install) the hook
+                break;
+            }
+            if (waitResult != WAIT_TIMEOUT)
+            {
+                break;
+            }
         }
 
-        Log("Polling thread: shutdown requested, exiting");
+        if (g_shutdownRequested.load())
+        {
+            Log("Startup thread: shutdown requested, exiting");
+        }
         return 0;
     }
 }
@@ -517,7 +555,12 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         DisableThreadLibraryCalls(hModule);
         InitializeCriticalSection(&g_hookLock);
 
+        g_gameCoreLoadedEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        g_luaStateCapturedEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        g_shutdownEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
         InitLog();
+        PROFILE_STARTUP();
         Log("========================================");
         Log("Proxy version.dll loaded into process");
         LogHex("Process base", GetModuleHandle(NULL));
@@ -525,14 +568,14 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
 
         if (!LoadOriginalVersionDll())
         {
-            Log("FATAL: Failed to load original version.dll");
+            Log(LogLevel::Error, "FATAL: Failed to load original version.dll");
             return FALSE;
         }
 
         MH_STATUS status = MH_Initialize();
         if (status != MH_OK)
         {
-            Log("ERROR: MinHook initialization failed!");
+            Log(LogLevel::Error, "ERROR: MinHook initialization failed!");
             return FALSE;
         }
         Log("MinHook initialized successfully");
@@ -562,18 +605,18 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
                 }
                 else
                 {
-                    Log("WARNING: Failed to register DLL notification");
+                    Log(LogLevel::Warning, "WARNING: Failed to register DLL notification");
                 }
             }
             else
             {
-                Log("WARNING: Failed to load ntdll.dll notification functions");
+                Log(LogLevel::Warning, "WARNING: Failed to load ntdll.dll notification functions");
             }
         }
 
-        // Start polling thread as backup
-        HANDLE hPollThread = CreateThread(nullptr, 0, GameCorePollingThread, nullptr, 0, nullptr);
-        if (hPollThread) CloseHandle(hPollThread);  // Close handle - thread continues running
+        // Start the thread that installs the GameCore hook once the notification fires
+        HANDLE hStartupThread = CreateThread(nullptr, 0, GameCoreStartupThread, nullptr, 0, nullptr);
+        if (hStartupThread) CloseHandle(hStartupThread);  // Close handle - thread continues running
 
         Log("Proxy DLL initialization complete");
         Log("Waiting for GameCore to load...");
@@ -584,13 +627,17 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
 
         // Signal all threads to exit
         g_shutdownRequested.store(true);
+        if (g_shutdownEvent) SetEvent(g_shutdownEvent);
         Log("Shutdown flag set, waiting for threads to exit...");
         Sleep(kShutdownDelayMs);
 
         // Cancel any pending async API requests
-        ClaudeAPI::CancelAsyncRequest();
+        ClaudeAPI::CancelAllAsyncRequests();
         Log("Async API requests cancelled");
 
+        // Stop the worker pool and close the persistent HTTP connection
+        ClaudeAPI::Shutdown();
+
         // Clean up HavokScript integration (removes pcall hook)
         CleanupHavokScriptIntegration();
 
@@ -620,6 +667,16 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         // Delete critical section
         DeleteCriticalSection(&g_hookLock);
 
+        // Close startup events (HookedPcall is unhooked, so nothing signals them anymore)
+        for (HANDLE* event : { &g_gameCoreLoadedEvent, &g_luaStateCapturedEvent, &g_shutdownEvent })
+        {
+            if (*event)
+            {
+                CloseHandle(*event);
+                *event = nullptr;
+            }
+        }
+
         // Free original version.dll
         if (g_original.hOriginal)
         {
@@ -629,6 +686,12 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         }
 
         Log("Cleanup complete");
+
+        // Final profile summary once nothing instrumented is running anymore
+        PROFILE_SHUTDOWN();
+
+        // Flush queued log messages last so the whole shutdown sequence is on disk
+        ShutdownLog();
     }
 
     return TRUE;